@@ -5,7 +5,7 @@
 #include "test_utilities.h"
 
 /*The number of tests*/
-#define NUMBER_TESTS 5
+#define NUMBER_TESTS 9
 #define MAX_STR_LEN 128 //Must be greater than 1
 #define MAX_VOTES 10 //Must be greater than 1
 #define NUM_OF_AREAS 101 //Do not lower beneath 12
@@ -21,6 +21,8 @@
 #define SECOND_AREA 2 
 #define THIRD_AREA 3   
 #define FOURTH_AREA 404
+#define ONE_DIGIT_TRIBE 9 //Lower than TWO_DIGITS_TRIBE as a number, but not as a string
+#define TWO_DIGITS_TRIBE 10
 
 static char *rand_string(char *str, size_t size)
 {
@@ -202,13 +204,99 @@ bool raiseHell()
     return true;
 }
 
+bool testAddVotesAccumulate()
+{
+    Election election = electionCreate();
+    ASSERT_TEST(electionAddArea(election, FIRST_AREA, "first area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, FIRST_TRIBE, "first tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, SECOND_TRIBE, "second tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, SECOND_TRIBE, 5) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 5
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, FIRST_TRIBE, 10) == ELECTION_SUCCESS); //area 1->tribe 1 :: TOTAL: 10
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, SECOND_TRIBE, 7) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 12, not 7
+    Map tester = NULL;
+    ASSERT_TEST((tester = electionComputeAreasToTribesMapping(election)) != NULL);
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(FIRST_AREA)), TOSTRING(SECOND_TRIBE)));
+    mapDestroy(tester);
+    electionDestroy(election);
+    return true;
+}
+
+bool testTieGoesToLowestTribeId()
+{
+    Election election = electionCreate();
+    ASSERT_TEST(electionAddArea(election, FIRST_AREA, "first area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddArea(election, SECOND_AREA, "second area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, TWO_DIGITS_TRIBE, "two digits") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, ONE_DIGIT_TRIBE, "one digit") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, TWO_DIGITS_TRIBE, 8) == ELECTION_SUCCESS); //area 1->tribe 10 :: TOTAL: 8
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, ONE_DIGIT_TRIBE, 8) == ELECTION_SUCCESS); //area 1->tribe 9 :: TOTAL: 8
+    /**
+     * AREA 1: a tie, 9 is lower than 10 (though "10" is lower than "9")
+     * AREA 2: no votes at all, so the lowest ID wins as well
+     * */
+    Map tester = NULL;
+    ASSERT_TEST((tester = electionComputeAreasToTribesMapping(election)) != NULL);
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(FIRST_AREA)), TOSTRING(ONE_DIGIT_TRIBE)));
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(SECOND_AREA)), TOSTRING(ONE_DIGIT_TRIBE)));
+    mapDestroy(tester);
+    electionDestroy(election);
+    return true;
+}
+
+bool testRemoveAreaRemovesVotes()
+{
+    Election election = electionCreate();
+    ASSERT_TEST(electionAddArea(election, FIRST_AREA, "first area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddArea(election, SECOND_AREA, "second area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, FIRST_TRIBE, "first tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, SECOND_TRIBE, "second tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, SECOND_TRIBE, 30) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 30
+    ASSERT_TEST(electionAddVote(election, SECOND_AREA, SECOND_TRIBE, 20) == ELECTION_SUCCESS); //area 2->tribe 2 :: TOTAL: 20
+    ASSERT_TEST(electionRemoveAreas(election, deleteOnlyFirstArea) == ELECTION_SUCCESS);
+    //A new area with the same ID starts without the votes of the removed one
+    ASSERT_TEST(electionAddArea(election, FIRST_AREA, "first area again") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionRemoveVote(election, FIRST_AREA, SECOND_TRIBE, 25) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 0
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, FIRST_TRIBE, 1) == ELECTION_SUCCESS); //area 1->tribe 1 :: TOTAL: 1
+    Map tester = NULL;
+    ASSERT_TEST((tester = electionComputeAreasToTribesMapping(election)) != NULL);
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(FIRST_AREA)), TOSTRING(FIRST_TRIBE)));
+    //The votes of the other areas stay
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(SECOND_AREA)), TOSTRING(SECOND_TRIBE)));
+    mapDestroy(tester);
+    electionDestroy(election);
+    return true;
+}
+
+bool testRemoveVotesStopsAtZero()
+{
+    Election election = electionCreate();
+    ASSERT_TEST(electionAddArea(election, FIRST_AREA, "first area") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, FIRST_TRIBE, "first tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddTribe(election, SECOND_TRIBE, "second tribe") == ELECTION_SUCCESS);
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, SECOND_TRIBE, 5) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 5
+    ASSERT_TEST(electionRemoveVote(election, FIRST_AREA, SECOND_TRIBE, 30) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 0, not -25
+    ASSERT_TEST(electionRemoveVote(election, FIRST_AREA, FIRST_TRIBE, 4) == ELECTION_SUCCESS); //area 1->tribe 1 :: TOTAL: STAYS 0
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, SECOND_TRIBE, 3) == ELECTION_SUCCESS); //area 1->tribe 2 :: TOTAL: 3
+    ASSERT_TEST(electionAddVote(election, FIRST_AREA, FIRST_TRIBE, 2) == ELECTION_SUCCESS); //area 1->tribe 1 :: TOTAL: 2
+    Map tester = NULL;
+    ASSERT_TEST((tester = electionComputeAreasToTribesMapping(election)) != NULL);
+    ASSERT_TEST(!strcmp(mapGet(tester, TOSTRING(FIRST_AREA)), TOSTRING(SECOND_TRIBE)));
+    mapDestroy(tester);
+    electionDestroy(election);
+    return true;
+}
+
 /*The functions for the tests should be added here*/
 bool (*tests[]) (void) = {
                         testElectionRemoveAreas,
                         testElectionRemoveAddtribe,
                         testAddRemoveVotes,
                         testComputeAreasToTribesMapping,
-                        raiseHell
+                        raiseHell,
+                        testAddVotesAccumulate,
+                        testTieGoesToLowestTribeId,
+                        testRemoveAreaRemovesVotes,
+                        testRemoveVotesStopsAtZero
 };
 
 /*The names of the test functions should be added here*/
@@ -217,7 +305,11 @@ const char* testNames[] = {
                             "testElectionRemoveAddtribe",
                             "testAddRemoveVotes",
                             "testComputeAreasToTribesMapping",
-                            "raiseHell"
+                            "raiseHell",
+                            "testAddVotesAccumulate",
+                            "testTieGoesToLowestTribeId",
+                            "testRemoveAreaRemovesVotes",
+                            "testRemoveVotesStopsAtZero"
 };
 
 int main(int argc, char* argv[]) {
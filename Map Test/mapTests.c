@@ -0,0 +1,1656 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include "map.h"
+#include "orderedMap.h"
+#include "intern.h"
+#include "genericMap.h"
+#include "pool.h"
+#include "epoch.h"
+#include "test_utilities.h"
+
+/*The number of tests*/
+#define NUMBER_TESTS 31
+#define KEY_LEN 32
+#define INDEX_KEYS 1000 //More than the slots of a new index, so it grows
+#define REMOVED_EVERY 3 //The keys removed in between are 0, 3, 6...
+
+#define LONG_VALUE_LEN 200 //Longer than the room a key leaves after its value
+
+#define ARENA_KEYS 5000 //Enough pairs to fill several chunks of an arena
+
+#define SCAN_KEYS 70 //Past the size at which a map stops scanning its fingerprints
+
+#define ORDERED_KEYS 1000 //Enough for a tree of several levels
+#define ORDERED_STEP 7919 //A prime, so the keys are put in a scrambled order
+
+#define CURSOR_KEYS 200
+#define CURSOR_PARTS 7 //Does not divide the number of keys, so the ranges differ in size
+
+#define COPY_KEYS 300 //More than a page, so copies share several pages and an index
+
+#define BATCH_KEYS 500
+
+#define USAGE_KEYS 2000 //Enough keys for a hash index
+#define SMALL_KEYS 32 //Few enough keys to scan their fingerprints
+
+#define COUNTER_KEYS 100
+
+#define COUNTING_THREADS 4
+#define COUNTING_KEYS 16 //Fewer than the increments, so threads add to the same keys
+#define COUNTING_INCREMENTS 20000
+
+#define READ_MOSTLY_KEYS 100
+#define READ_MOSTLY_ROUNDS 200
+#define READ_MOSTLY_READERS 2
+
+#define INTERNED_KEYS 500
+
+#define IMAGE_PATH "mapTests.image" //Written in the working directory, and removed by the test
+#define IMAGE_KEYS 1000
+
+#define JOURNAL_PATH "mapTests.journal" //Its log is JOURNAL_PATH ".log"
+#define JOURNAL_KEYS 100
+#define TORN_BYTES 3 //Cut from the end of the log, in the middle of its last change
+
+#define STATS_KEYS 1000 //Enough keys for a hash index
+
+#define COMPACT_KEYS 1000 //Enough keys for a hash index
+#define COMPACT_ROUNDS 30 //Enough rewrites of every value to make the buffer drop its garbage
+
+#define GENERIC_SLOTS 8 //The slots of a new generic map
+#define WRAPPED_KEYS 6 //Keys whose home slots are the last two, so most of them wrap around
+
+#define GROWTH_KEYS 5000 //Enough for the index to grow several times
+
+#define POOL_KEYS 1000
+#define POOL_ROUNDS 5 //Rounds of puts and removes after the first, which reuse its blocks
+#define POOL_BLOCK 40 //Rounded up to the size of a block of the pool
+
+#define PREFIX_KEYS 300
+#define PREFIX_MATCHES 111 //The keys of 0 to PREFIX_KEYS - 1 which start with "key1": 1, 10-19 and 100-199
+
+#define FILTER_KEYS 2000
+#define FILTER_KEPT_EVERY 4 //The keys kept by the removals are 0, 4, 8..., so the filter is rebuilt
+
+#define ARRAY_KEYS 20000 //Enough for the index to be filled in several parts
+#define ARRAY_REPEATS 3 //The times each key appears in the arrays
+
+#define CHUNKED_KEYS 5000 //Enough for an index of several chunks
+#define CHUNKED_KEPT_EVERY 3 //The keys kept in the copy are 0, 3, 6...
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+
+/**
+ * Writes the key number i, and the value it gets in the given version of a map.
+ */
+static void makePair(char *key, char *value, int i, int version)
+{
+    sprintf(key, "key%d", i);
+    sprintf(value, "value%d.%d", i, version);
+}
+
+/**
+ * @return
+ * True if the map holds exactly the keys first to last - 1, each with its value
+ * of the given version.
+ */
+static bool hasPairs(Map map, int first, int last, int version)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    if (mapGetSize(map) != last - first)
+    {
+        return false;
+    }
+    for (int i = first; i < last; i++)
+    {
+        makePair(key, value, i, version);
+        char *data = mapGet(map, key);
+        if (data == NULL || strcmp(data, value) != 0)
+        {
+            return false;
+        }
+    }
+    int count = 0;
+    MAP_CURSOR_FOREACH(iterator, cursor, map)
+    {
+        count++;
+    }
+    return count == last - first;
+}
+
+/**
+ * Puts the keys first to last - 1 with their values of the given version.
+ */
+static bool putPairs(Map map, int first, int last, int version)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = first; i < last; i++)
+    {
+        makePair(key, value, i, version);
+        if (mapPut(map, key, value) != MAP_SUCCESS)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testIndexRemoveAndReinsert()
+{
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, INDEX_KEYS, 0));
+    ASSERT_TEST(hasPairs(map, 0, INDEX_KEYS, 0));
+    ASSERT_TEST(!mapContains(map, "key" TOSTRING(INDEX_KEYS)));
+    //Removing a key moves the last key of the array into its place
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = 0; i < INDEX_KEYS; i += REMOVED_EVERY)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapRemove(map, key) == MAP_SUCCESS);
+        ASSERT_TEST(mapRemove(map, key) == MAP_ITEM_DOES_NOT_EXIST);
+    }
+    int left = 0;
+    for (int i = 0; i < INDEX_KEYS; i++)
+    {
+        makePair(key, value, i, 0);
+        char *data = mapGet(map, key);
+        if (i % REMOVED_EVERY == 0)
+        {
+            ASSERT_TEST(data == NULL);
+            continue;
+        }
+        ASSERT_TEST(data != NULL && strcmp(data, value) == 0);
+        left++;
+    }
+    ASSERT_TEST(mapGetSize(map) == left);
+    //The removed keys come back, and the others get their new values
+    ASSERT_TEST(putPairs(map, 0, INDEX_KEYS, 1));
+    ASSERT_TEST(hasPairs(map, 0, INDEX_KEYS, 1));
+    //A copy of a map bigger than a new one holds all of its pairs
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && hasPairs(copy, 0, INDEX_KEYS, 1));
+    ASSERT_TEST(mapClear(map) == MAP_SUCCESS);
+    ASSERT_TEST(hasPairs(map, 0, 0, 0) && !mapContains(map, "key0"));
+    ASSERT_TEST(putPairs(map, 0, INDEX_KEYS, 2));
+    ASSERT_TEST(hasPairs(map, 0, INDEX_KEYS, 2));
+    ASSERT_TEST(hasPairs(copy, 0, INDEX_KEYS, 1));
+    mapDestroy(copy);
+    mapDestroy(map);
+    return true;
+}
+
+bool testValueRewrite()
+{
+    Map map = mapCreate();
+    char value[LONG_VALUE_LEN + 1];
+    ASSERT_TEST(mapPut(map, "key", "short") == MAP_SUCCESS);
+    //Values which outgrow their room, and values which fit back in it
+    for (int len = 0; len <= LONG_VALUE_LEN; len += 7)
+    {
+        memset(value, 'a' + len % 26, len);
+        value[len] = '\0';
+        ASSERT_TEST(mapPut(map, "key", value) == MAP_SUCCESS);
+        ASSERT_TEST(strcmp(mapGet(map, "key"), value) == 0);
+        ASSERT_TEST(mapPut(map, "key", "") == MAP_SUCCESS);
+        ASSERT_TEST(strcmp(mapGet(map, "key"), "") == 0);
+        ASSERT_TEST(mapPut(map, "key", value) == MAP_SUCCESS);
+    }
+    //A value may be set from the value it replaces
+    char *data = mapGet(map, "key");
+    ASSERT_TEST(mapPut(map, "key", data) == MAP_SUCCESS);
+    ASSERT_TEST(mapPut(map, "key", data + 1) == MAP_SUCCESS);
+    ASSERT_TEST(strcmp(mapGet(map, "key"), value + 1) == 0);
+    ASSERT_TEST(mapGetSize(map) == 1);
+    mapDestroy(map);
+    return true;
+}
+
+bool testArenaMap()
+{
+    Map map = mapCreateArena();
+    ASSERT_TEST(map != NULL);
+    for (int round = 0; round < 3; round++)
+    {
+        ASSERT_TEST(putPairs(map, 0, ARENA_KEYS, 0));
+        //A longer value replaces its key by a bigger one from the arena
+        ASSERT_TEST(putPairs(map, 0, ARENA_KEYS, 1000000 * round + 1));
+        ASSERT_TEST(hasPairs(map, 0, ARENA_KEYS, 1000000 * round + 1));
+        ASSERT_TEST(mapRemove(map, "key0") == MAP_SUCCESS);
+        ASSERT_TEST(hasPairs(map, 1, ARENA_KEYS, 1000000 * round + 1));
+        //A copy is an arena map of its own
+        Map copy = mapCopy(map);
+        ASSERT_TEST(copy != NULL);
+        ASSERT_TEST(mapClear(map) == MAP_SUCCESS);
+        ASSERT_TEST(hasPairs(map, 0, 0, 0));
+        ASSERT_TEST(hasPairs(copy, 1, ARENA_KEYS, 1000000 * round + 1));
+        mapDestroy(copy);
+    }
+    mapDestroy(map);
+    return true;
+}
+
+bool testFingerprintScan()
+{
+    //Every size around a whole block of fingerprints, and past the scanned sizes
+    for (int size = 1; size <= SCAN_KEYS; size++)
+    {
+        Map map = mapCreate();
+        ASSERT_TEST(putPairs(map, 0, size, 0));
+        ASSERT_TEST(hasPairs(map, 0, size, 0));
+        ASSERT_TEST(!mapContains(map, "key" TOSTRING(SCAN_KEYS)) && !mapContains(map, ""));
+        ASSERT_TEST(mapPut(map, "", "empty key") == MAP_SUCCESS);
+        ASSERT_TEST(strcmp(mapGet(map, ""), "empty key") == 0);
+        //Removing the first key moves the last one, with its fingerprint, into its place
+        ASSERT_TEST(mapRemove(map, "") == MAP_SUCCESS && mapRemove(map, "key0") == MAP_SUCCESS);
+        ASSERT_TEST(hasPairs(map, 1, size, 0) && !mapContains(map, "key0"));
+        //A cleared map scans again
+        ASSERT_TEST(mapClear(map) == MAP_SUCCESS);
+        ASSERT_TEST(putPairs(map, 0, size / 2, 1));
+        ASSERT_TEST(hasPairs(map, 0, size / 2, 1));
+        mapDestroy(map);
+    }
+    return true;
+}
+
+bool testOrderedMapRanges()
+{
+    OrderedMap map = orderedMapCreate(orderedMapCompareNumeric);
+    char key[KEY_LEN];
+    for (int i = 0; i < ORDERED_KEYS; i++)
+    {
+        sprintf(key, "%d", i * ORDERED_STEP % ORDERED_KEYS);
+        ASSERT_TEST(orderedMapPut(map, key, key) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(orderedMapGetSize(map) == ORDERED_KEYS);
+    ASSERT_TEST(strcmp(orderedMapGetMin(map), "0") == 0);
+    ASSERT_TEST(atoi(orderedMapGetMax(map)) == ORDERED_KEYS - 1);
+    int expected = 0;
+    ORDERED_MAP_FOREACH(iterator, map)
+    {
+        ASSERT_TEST(atoi(iterator) == expected++);
+    }
+    ASSERT_TEST(expected == ORDERED_KEYS);
+    //Removing the even keys leaves bounds which are not in the map
+    for (int i = 0; i < ORDERED_KEYS; i += 2)
+    {
+        sprintf(key, "%d", i);
+        ASSERT_TEST(orderedMapRemove(map, key) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(orderedMapGetSize(map) == ORDERED_KEYS / 2);
+    ASSERT_TEST(strcmp(orderedMapGetMin(map), "1") == 0);
+    ASSERT_TEST(strcmp(orderedMapLowerBound(map, "500"), "501") == 0);
+    ASSERT_TEST(strcmp(orderedMapLowerBound(map, "501"), "501") == 0);
+    ASSERT_TEST(orderedMapLowerBound(map, TOSTRING(ORDERED_KEYS)) == NULL);
+    expected = 101;
+    ORDERED_MAP_FOREACH_IN_RANGE(iterator, map, "100", "200")
+    {
+        ASSERT_TEST(atoi(iterator) == expected);
+        ASSERT_TEST(strcmp(orderedMapGet(map, iterator), iterator) == 0);
+        expected += 2;
+    }
+    ASSERT_TEST(expected == 201);
+    ASSERT_TEST(orderedMapGetFirstInRange(map, "200", "200") == NULL);
+    ASSERT_TEST(orderedMapGetFirstInRange(map, "300", "100") == NULL);
+    ASSERT_TEST(orderedMapClear(map) == MAP_SUCCESS);
+    ASSERT_TEST(orderedMapGetMin(map) == NULL && orderedMapLowerBound(map, "0") == NULL);
+    orderedMapDestroy(map);
+    return true;
+}
+
+bool testCursors()
+{
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, CURSOR_KEYS, 0));
+    //Cursors are independent, so walks over the same map may nest
+    int pairs = 0;
+    MAP_CURSOR_FOREACH(outer, outer_cursor, map)
+    {
+        MAP_CURSOR_FOREACH(inner, inner_cursor, map)
+        {
+            pairs++;
+        }
+        char expected[KEY_LEN];
+        ASSERT_TEST(sprintf(expected, "value%s.0", outer + strlen("key")) > 0);
+        ASSERT_TEST(strcmp(mapCursorGetValue(&outer_cursor), expected) == 0);
+    }
+    ASSERT_TEST(pairs == CURSOR_KEYS * CURSOR_KEYS);
+    //The ranges of any number of parts hold every key exactly once
+    for (int parts = 1; parts <= CURSOR_PARTS; parts++)
+    {
+        char seen[CURSOR_KEYS] = { 0 };
+        for (int part = 0; part < parts; part++)
+        {
+            MapCursor cursor = mapCursorCreateRange(map, part, parts);
+            for (char *key = mapCursorNext(&cursor); key != NULL; key = mapCursorNext(&cursor))
+            {
+                int i = atoi(key + strlen("key"));
+                ASSERT_TEST(i >= 0 && i < CURSOR_KEYS && !seen[i]);
+                seen[i] = 1;
+            }
+        }
+        ASSERT_TEST(memchr(seen, 0, CURSOR_KEYS) == NULL);
+    }
+    MapCursor empty = mapCursorCreateRange(map, CURSOR_PARTS, CURSOR_PARTS);
+    ASSERT_TEST(mapCursorNext(&empty) == NULL && mapCursorGetValue(&empty) == NULL);
+    mapDestroy(map);
+    return true;
+}
+
+bool testCopyIsolation()
+{
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, COPY_KEYS, 0));
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL);
+    //Changing the original leaves the copy as it was
+    ASSERT_TEST(putPairs(map, 0, COPY_KEYS / 2, 1));
+    ASSERT_TEST(mapRemove(map, "key0") == MAP_SUCCESS);
+    ASSERT_TEST(hasPairs(copy, 0, COPY_KEYS, 0));
+    //...and changing the copy leaves the original as it is
+    ASSERT_TEST(putPairs(copy, COPY_KEYS, COPY_KEYS + 10, 0));
+    ASSERT_TEST(mapRemove(copy, "key5") == MAP_SUCCESS);
+    ASSERT_TEST(mapGetSize(map) == COPY_KEYS - 1);
+    ASSERT_TEST(mapGet(map, "key0") == NULL);
+    ASSERT_TEST(strcmp(mapGet(map, "key5"), "value5.1") == 0);
+    ASSERT_TEST(!mapContains(map, "key" TOSTRING(COPY_KEYS)));
+    ASSERT_TEST(mapGetSize(copy) == COPY_KEYS + 9);
+    ASSERT_TEST(strcmp(mapGet(copy, "key6"), "value6.0") == 0);
+    mapDestroy(map);
+    //The copy outlives the original
+    ASSERT_TEST(mapGet(copy, "key5") == NULL);
+    ASSERT_TEST(strcmp(mapGet(copy, "key0"), "value0.0") == 0);
+    mapDestroy(copy);
+    return true;
+}
+
+bool testCopyOfCopies()
+{
+    Map maps[4];
+    maps[0] = mapCreateArena();
+    ASSERT_TEST(putPairs(maps[0], 0, COPY_KEYS, 0));
+    for (int i = 1; i < 4; i++)
+    {
+        ASSERT_TEST((maps[i] = mapCopy(maps[i - 1])) != NULL);
+        ASSERT_TEST(putPairs(maps[i], 0, COPY_KEYS, i));
+    }
+    ASSERT_TEST(mapClear(maps[2]) == MAP_SUCCESS);
+    ASSERT_TEST(mapShrinkToFit(maps[1]) == MAP_SUCCESS);
+    ASSERT_TEST(hasPairs(maps[0], 0, COPY_KEYS, 0));
+    ASSERT_TEST(hasPairs(maps[1], 0, COPY_KEYS, 1));
+    ASSERT_TEST(hasPairs(maps[2], 0, 0, 2));
+    ASSERT_TEST(hasPairs(maps[3], 0, COPY_KEYS, 3));
+    for (int i = 0; i < 4; i++)
+    {
+        mapDestroy(maps[i]);
+    }
+    return true;
+}
+
+/**
+ * A predicate which is true for the keys whose number is odd.
+ */
+static bool isOddKey(const char *key, const char *data, void *context)
+{
+    int *calls = context;
+    (*calls)++;
+    return atoi(key + strlen("key")) % 2 == 1;
+}
+
+bool testRemoveIfAndBatches()
+{
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, BATCH_KEYS, 0));
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL);
+    int calls = 0;
+    ASSERT_TEST(mapRemoveIf(map, isOddKey, &calls) == MAP_SUCCESS);
+    ASSERT_TEST(calls == BATCH_KEYS && mapGetSize(map) == BATCH_KEYS / 2);
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = 0; i < BATCH_KEYS; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapContains(map, key) == (i % 2 == 0));
+    }
+    ASSERT_TEST(hasPairs(copy, 0, BATCH_KEYS, 0));
+    ASSERT_TEST(mapRemoveIf(map, NULL, NULL) == MAP_NULL_ARGUMENT);
+    //A batch puts the odd keys back, and a repeated key gets its last data element
+    const char *keys[BATCH_KEYS / 2 + 1];
+    const char *data[BATCH_KEYS / 2 + 1];
+    char strings[BATCH_KEYS / 2][2][KEY_LEN];
+    for (int i = 0; i < BATCH_KEYS / 2; i++)
+    {
+        makePair(strings[i][0], strings[i][1], 2 * i + 1, 0);
+        keys[i] = strings[i][0];
+        data[i] = strings[i][1];
+    }
+    keys[BATCH_KEYS / 2] = "key1";
+    data[BATCH_KEYS / 2] = "value1.1";
+    ASSERT_TEST(mapPutBatch(map, keys, data, BATCH_KEYS / 2 + 1) == MAP_SUCCESS);
+    ASSERT_TEST(mapGetSize(map) == BATCH_KEYS && strcmp(mapGet(map, "key1"), "value1.1") == 0);
+    ASSERT_TEST(mapPut(map, "key1", "value1.0") == MAP_SUCCESS && hasPairs(map, 0, BATCH_KEYS, 0));
+    //A NULL anywhere in a batch leaves the map as it was
+    data[0] = NULL;
+    ASSERT_TEST(mapPutBatch(map, keys, data, BATCH_KEYS / 2) == MAP_NULL_ARGUMENT);
+    keys[BATCH_KEYS / 2 - 1] = NULL;
+    ASSERT_TEST(mapRemoveBatch(map, keys, BATCH_KEYS / 2) == MAP_NULL_ARGUMENT);
+    //So does a negative count
+    ASSERT_TEST(mapPutBatch(map, keys, data, -1) == MAP_ERROR && mapRemoveBatch(map, keys, -1) == MAP_ERROR);
+    ASSERT_TEST(hasPairs(map, 0, BATCH_KEYS, 0));
+    //Removing a batch skips the keys which are not in the map
+    keys[BATCH_KEYS / 2 - 1] = "missing";
+    ASSERT_TEST(mapRemoveBatch(map, keys, BATCH_KEYS / 2) == MAP_SUCCESS);
+    ASSERT_TEST(mapGetSize(map) == BATCH_KEYS / 2 + 1 && !mapContains(map, "key1"));
+    ASSERT_TEST(mapContains(map, strings[BATCH_KEYS / 2 - 1][0]));
+    mapDestroy(copy);
+    mapDestroy(map);
+    return true;
+}
+
+/**
+ * @return
+ * True if the parts of a memory usage add up to its total (the keys and values
+ * of an arena map are inside its arena).
+ */
+static bool usageAddsUp(Map map, MapMemoryUsage *usage)
+{
+    size_t total = mapMemoryUsage(map, usage);
+    size_t elements = usage->arena > 0 ? usage->arena : usage->keys + usage->values;
+    return total == usage->table + usage->index + elements;
+}
+
+bool testShrinkAndMemoryUsage()
+{
+    MapMemoryUsage usage, before;
+    Map map = mapCreate();
+    ASSERT_TEST(usageAddsUp(map, &usage));
+    ASSERT_TEST(usage.index == 0 && usage.keys == 0 && usage.values == 0 && usage.arena == 0);
+    mapDestroy(map);
+    //A map made with enough capacity does not grow its index
+    ASSERT_TEST(mapCreateWithCapacity(-1) == NULL);
+    map = mapCreateWithCapacity(USAGE_KEYS);
+    ASSERT_TEST(map != NULL && usageAddsUp(map, &before) && before.index > 0);
+    ASSERT_TEST(putPairs(map, 0, USAGE_KEYS, 0));
+    ASSERT_TEST(usageAddsUp(map, &usage));
+    ASSERT_TEST(usage.index == before.index && usage.keys > 0);
+    //Shrinking after most keys are removed gives back memory and keeps the rest
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL);
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = USAGE_KEYS / 10; i < USAGE_KEYS; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapRemove(map, key) == MAP_SUCCESS);
+    }
+    size_t removed = mapMemoryUsage(map, NULL);
+    ASSERT_TEST(mapShrinkToFit(map) == MAP_SUCCESS);
+    ASSERT_TEST(mapMemoryUsage(map, NULL) < removed);
+    ASSERT_TEST(hasPairs(map, 0, USAGE_KEYS / 10, 0));
+    ASSERT_TEST(hasPairs(copy, 0, USAGE_KEYS, 0));
+    //...and a map small enough to scan drops its index
+    for (int i = SMALL_KEYS; i < USAGE_KEYS / 10; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapRemove(map, key) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(mapShrinkToFit(map) == MAP_SUCCESS && usageAddsUp(map, &usage) && usage.index == 0);
+    ASSERT_TEST(putPairs(map, 0, USAGE_KEYS, 1) && hasPairs(map, 0, USAGE_KEYS, 1));
+    mapDestroy(copy);
+    mapDestroy(map);
+    //An arena map counts its chunks
+    map = mapCreateArena();
+    ASSERT_TEST(putPairs(map, 0, USAGE_KEYS, 0));
+    ASSERT_TEST(usageAddsUp(map, &usage) && usage.arena > 0);
+    mapDestroy(map);
+    ASSERT_TEST(mapMemoryUsage(NULL, NULL) == 0 && mapShrinkToFit(NULL) == MAP_NULL_ARGUMENT);
+    return true;
+}
+
+bool testCounters()
+{
+    Map map = mapCreateCounters();
+    char key[KEY_LEN];
+    int64_t value = 0;
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < COUNTER_KEYS; i++)
+        {
+            sprintf(key, "key%d", i);
+            ASSERT_TEST(mapIncrement(map, key, i, &value) == MAP_SUCCESS && value == (round + 1) * i);
+        }
+    }
+    ASSERT_TEST(mapIncrement(map, "key1", -4, &value) == MAP_SUCCESS && value == -1);
+    ASSERT_TEST(mapPutInt(map, "key1", INT64_MAX) == MAP_SUCCESS);
+    ASSERT_TEST(mapGetInt(map, "key1", &value) == MAP_SUCCESS && value == INT64_MAX);
+    ASSERT_TEST(mapGetInt(map, "missing", &value) == MAP_ITEM_DOES_NOT_EXIST);
+    //Counters have no string data elements
+    ASSERT_TEST(mapPut(map, "key1", "1") == MAP_ERROR && mapGet(map, "key1") == NULL);
+    int64_t total = 0;
+    MAP_CURSOR_FOREACH(iterator, cursor, map)
+    {
+        ASSERT_TEST(mapCursorGetInt(&cursor, &value) == MAP_SUCCESS);
+        ASSERT_TEST(mapCursorGetValue(&cursor) == NULL);
+        total += strcmp(iterator, "key1") == 0 ? 0 : value;
+    }
+    ASSERT_TEST(total == 3 * (COUNTER_KEYS * (COUNTER_KEYS - 1) / 2 - 1));
+    //A copy is a counters map, with counters of its own
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && mapIncrement(copy, "key0", 5, NULL) == MAP_SUCCESS);
+    ASSERT_TEST(mapGetInt(map, "key0", &value) == MAP_SUCCESS && value == 0);
+    ASSERT_TEST(mapGetInt(copy, "key0", &value) == MAP_SUCCESS && value == 5);
+    mapDestroy(copy);
+    mapDestroy(map);
+    //...and a map of strings has no counters
+    map = mapCreate();
+    ASSERT_TEST(mapIncrement(map, "key", 1, NULL) == MAP_ERROR && mapGetInt(map, "key", &value) == MAP_ERROR);
+    mapDestroy(map);
+    return true;
+}
+
+/**
+ * Adds 1 to every key of a concurrent counters map in turn, and the number of
+ * the key to a total of all the keys.
+ */
+static void *countConcurrently(void *map)
+{
+    char key[KEY_LEN];
+    for (int i = 0; i < COUNTING_INCREMENTS; i++)
+    {
+        sprintf(key, "key%d", i % COUNTING_KEYS);
+        if (mapIncrement(map, key, 1, NULL) != MAP_SUCCESS ||
+            mapIncrement(map, "total", i % COUNTING_KEYS, NULL) != MAP_SUCCESS)
+        {
+            return map;
+        }
+    }
+    return NULL;
+}
+
+bool testConcurrentCounters()
+{
+    Map map = mapCreateConcurrentCounters(4);
+    ASSERT_TEST(map != NULL);
+    pthread_t threads[COUNTING_THREADS];
+    for (int i = 0; i < COUNTING_THREADS; i++)
+    {
+        ASSERT_TEST(pthread_create(&threads[i], NULL, countConcurrently, map) == 0);
+    }
+    bool failed = false;
+    for (int i = 0; i < COUNTING_THREADS; i++)
+    {
+        void *result = NULL;
+        pthread_join(threads[i], &result);
+        failed = failed || result != NULL;
+    }
+    ASSERT_TEST(!failed);
+    //No increment is lost, even of keys which threads added at the same time
+    ASSERT_TEST(mapGetSize(map) == COUNTING_KEYS + 1);
+    char key[KEY_LEN];
+    int64_t value = 0, total = 0;
+    for (int i = 0; i < COUNTING_KEYS; i++)
+    {
+        sprintf(key, "key%d", i);
+        ASSERT_TEST(mapGetInt(map, key, &value) == MAP_SUCCESS);
+        ASSERT_TEST(value == COUNTING_THREADS * (COUNTING_INCREMENTS / COUNTING_KEYS));
+        total += i * value;
+    }
+    ASSERT_TEST(mapGetInt(map, "total", &value) == MAP_SUCCESS && value == total);
+    mapDestroy(map);
+    return true;
+}
+
+/**
+ * Adds and removes keys past READ_MOSTLY_KEYS in a read-mostly map until
+ * told to stop.
+ */
+static void *churnKeys(void *map)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int round = 0; !mapContains(map, "stop"); round++)
+    {
+        makePair(key, value, READ_MOSTLY_KEYS + round % READ_MOSTLY_KEYS, round);
+        if (mapPut(map, key, value) != MAP_SUCCESS || mapRemove(map, key) != MAP_SUCCESS)
+        {
+            return map;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks that the keys below READ_MOSTLY_KEYS stay in a read-mostly map while
+ * another thread changes it.
+ */
+static void *readKeys(void *map)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int round = 0; round < READ_MOSTLY_ROUNDS; round++)
+    {
+        for (int i = 0; i < READ_MOSTLY_KEYS; i++)
+        {
+            makePair(key, value, i, 0);
+            int size = mapGetSize(map);
+            if (!mapContains(map, key) || size < READ_MOSTLY_KEYS || size > READ_MOSTLY_KEYS + 2)
+            {
+                return map;
+            }
+        }
+    }
+    return NULL;
+}
+
+bool testReadMostlyReaders()
+{
+    Map map = mapCreateReadMostly();
+    ASSERT_TEST(map != NULL && putPairs(map, 0, READ_MOSTLY_KEYS, 0));
+    pthread_t writer, readers[READ_MOSTLY_READERS];
+    ASSERT_TEST(pthread_create(&writer, NULL, churnKeys, map) == 0);
+    for (int i = 0; i < READ_MOSTLY_READERS; i++)
+    {
+        ASSERT_TEST(pthread_create(&readers[i], NULL, readKeys, map) == 0);
+    }
+    bool failed = false;
+    for (int i = 0; i < READ_MOSTLY_READERS; i++)
+    {
+        void *result = NULL;
+        pthread_join(readers[i], &result);
+        failed = failed || result != NULL;
+    }
+    mapPut(map, "stop", "");
+    void *result = NULL;
+    pthread_join(writer, &result);
+    ASSERT_TEST(!failed && result == NULL);
+    ASSERT_TEST(mapRemove(map, "stop") == MAP_SUCCESS && hasPairs(map, 0, READ_MOSTLY_KEYS, 0));
+    //A failed batch leaves the map as it was
+    const char *keys[] = { "key0", NULL };
+    ASSERT_TEST(mapRemoveBatch(map, keys, 2) == MAP_NULL_ARGUMENT);
+    ASSERT_TEST(hasPairs(map, 0, READ_MOSTLY_KEYS, 0));
+    //A copy is changed on its own
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && putPairs(copy, 0, READ_MOSTLY_KEYS, 1));
+    ASSERT_TEST(hasPairs(map, 0, READ_MOSTLY_KEYS, 0) && hasPairs(copy, 0, READ_MOSTLY_KEYS, 1));
+    mapDestroy(copy);
+    mapDestroy(map);
+    return true;
+}
+
+bool testInterning()
+{
+    size_t empty_pool = internGetMemoryUsage();
+    char string[KEY_LEN] = "interned";
+    const char *first = internAcquire(string);
+    const char *second = internAcquire("interned");
+    ASSERT_TEST(first != NULL && first == second && first != string);
+    const char *other = internAcquire("other");
+    ASSERT_TEST(other != NULL && other != first);
+    internRelease(other);
+    internRelease(first);
+    ASSERT_TEST(strcmp(second, "interned") == 0);
+    //Interned maps share their strings, and each keeps them while it needs them
+    Map maps[2] = { mapCreateInterned(), mapCreateInterned() };
+    ASSERT_TEST(maps[0] != NULL && maps[1] != NULL);
+    ASSERT_TEST(putPairs(maps[0], 0, INTERNED_KEYS, 0) && putPairs(maps[1], 0, INTERNED_KEYS, 0));
+    ASSERT_TEST(mapGet(maps[0], "key7") == mapGet(maps[1], "key7"));
+    ASSERT_TEST(putPairs(maps[1], 0, INTERNED_KEYS, 1));
+    ASSERT_TEST(mapRemove(maps[0], "key7") == MAP_SUCCESS);
+    mapDestroy(maps[1]);
+    ASSERT_TEST(mapGetSize(maps[0]) == INTERNED_KEYS - 1);
+    ASSERT_TEST(mapGet(maps[0], "key7") == NULL && strcmp(mapGet(maps[0], "key8"), "value8.0") == 0);
+    //A key taken from the map finds its pair
+    MAP_CURSOR_FOREACH(iterator, cursor, maps[0])
+    {
+        ASSERT_TEST(mapGet(maps[0], iterator) == mapCursorGetValue(&cursor));
+    }
+    mapDestroy(maps[0]);
+    internRelease(second);
+    ASSERT_TEST(internGetMemoryUsage() == empty_pool);
+    return true;
+}
+
+bool testSaveOpenMapped()
+{
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, IMAGE_KEYS, 0));
+    ASSERT_TEST(mapPut(map, "", "empty key") == MAP_SUCCESS);
+    ASSERT_TEST(mapSave(map, IMAGE_PATH) == MAP_SUCCESS);
+    ASSERT_TEST(mapRemove(map, "") == MAP_SUCCESS);
+    Map mapped = mapOpenMapped(IMAGE_PATH);
+    ASSERT_TEST(mapped != NULL);
+    ASSERT_TEST(strcmp(mapGet(mapped, ""), "empty key") == 0);
+    ASSERT_TEST(mapGet(mapped, "key" TOSTRING(IMAGE_KEYS)) == NULL);
+    //An opened image is read-only
+    ASSERT_TEST(mapPut(mapped, "key0", "changed") == MAP_ERROR);
+    ASSERT_TEST(mapRemove(mapped, "") == MAP_ERROR);
+    //Saving the map again replaces the file, while the image opened before keeps its contents
+    ASSERT_TEST(mapSave(map, IMAGE_PATH) == MAP_SUCCESS);
+    Map copy = mapCopy(mapped);
+    mapDestroy(mapped);
+    ASSERT_TEST(copy != NULL && mapGetSize(copy) == IMAGE_KEYS + 1);
+    ASSERT_TEST(strcmp(mapGet(copy, ""), "empty key") == 0);
+    ASSERT_TEST(strcmp(mapGet(copy, "key999"), "value999.0") == 0);
+    mapDestroy(copy);
+    ASSERT_TEST((mapped = mapOpenMapped(IMAGE_PATH)) != NULL);
+    ASSERT_TEST(hasPairs(mapped, 0, IMAGE_KEYS, 0));
+    mapDestroy(mapped);
+    mapDestroy(map);
+    //A counters map comes back as one
+    map = mapCreateCounters();
+    ASSERT_TEST(mapIncrement(map, "votes", 42, NULL) == MAP_SUCCESS);
+    ASSERT_TEST(mapSave(map, IMAGE_PATH) == MAP_SUCCESS);
+    mapDestroy(map);
+    ASSERT_TEST((mapped = mapOpenMapped(IMAGE_PATH)) != NULL);
+    int64_t votes = 0;
+    ASSERT_TEST(mapGetInt(mapped, "votes", &votes) == MAP_SUCCESS && votes == 42);
+    mapDestroy(mapped);
+    remove(IMAGE_PATH);
+    ASSERT_TEST(mapOpenMapped(IMAGE_PATH) == NULL);
+    return true;
+}
+
+/**
+ * Cuts the last bytes of a file, as a crash in the middle of a write would.
+ */
+static bool cutFile(const char *path, long bytes)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    char buffer[1 << 16];
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    if (size < (size_t)bytes || size == sizeof(buffer) || (file = fopen(path, "wb")) == NULL)
+    {
+        return false;
+    }
+    bool written = fwrite(buffer, 1, size - bytes, file) == size - bytes;
+    return fclose(file) == 0 && written;
+}
+
+bool testJournalReplay()
+{
+    const MapJournalOptions every_change = { 1, 0, 0 };
+    remove(JOURNAL_PATH);
+    remove(JOURNAL_PATH ".log");
+    Map map = mapOpenJournaled(JOURNAL_PATH, &every_change);
+    ASSERT_TEST(map != NULL);
+    ASSERT_TEST(putPairs(map, 0, JOURNAL_KEYS, 0));
+    ASSERT_TEST(putPairs(map, 0, JOURNAL_KEYS / 2, 1));
+    ASSERT_TEST(mapRemove(map, "key0") == MAP_SUCCESS);
+    mapDestroy(map);
+    //Reopening replays the log
+    ASSERT_TEST((map = mapOpenJournaled(JOURNAL_PATH, &every_change)) != NULL);
+    ASSERT_TEST(mapGetSize(map) == JOURNAL_KEYS - 1 && mapGet(map, "key0") == NULL);
+    ASSERT_TEST(strcmp(mapGet(map, "key1"), "value1.1") == 0);
+    ASSERT_TEST(!mapContains(map, "key" TOSTRING(JOURNAL_KEYS)));
+    ASSERT_TEST(putPairs(map, 0, 1, 2));
+    ASSERT_TEST(mapPut(map, "last", "torn") == MAP_SUCCESS);
+    mapDestroy(map);
+    //A change which was only partly written is dropped, the ones before it are kept
+    ASSERT_TEST(cutFile(JOURNAL_PATH ".log", TORN_BYTES));
+    ASSERT_TEST((map = mapOpenJournaled(JOURNAL_PATH, &every_change)) != NULL);
+    ASSERT_TEST(mapGet(map, "last") == NULL);
+    ASSERT_TEST(strcmp(mapGet(map, "key0"), "value0.2") == 0);
+    ASSERT_TEST(mapGetSize(map) == JOURNAL_KEYS);
+    //...and the map goes on from there
+    ASSERT_TEST(mapPut(map, "last", "whole") == MAP_SUCCESS);
+    mapDestroy(map);
+    ASSERT_TEST((map = mapOpenJournaled(JOURNAL_PATH, &every_change)) != NULL);
+    ASSERT_TEST(strcmp(mapGet(map, "last"), "whole") == 0);
+    mapDestroy(map);
+    remove(JOURNAL_PATH);
+    remove(JOURNAL_PATH ".log");
+    return true;
+}
+
+bool testStats()
+{
+#ifdef MAP_ENABLE_STATS
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, STATS_KEYS, 0));
+    MapStats before, after;
+    ASSERT_TEST(mapGetStats(map, &before) == MAP_SUCCESS);
+    ASSERT_TEST(before.key_allocations == STATS_KEYS && before.expansions > 0 && before.bytes_reallocated > 0);
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = 0; i < STATS_KEYS; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapGet(map, key) != NULL);
+    }
+    ASSERT_TEST(!mapContains(map, "missing"));
+    ASSERT_TEST(mapGetStats(map, &after) == MAP_SUCCESS);
+    ASSERT_TEST(after.lookups - before.lookups == STATS_KEYS + 1);
+    ASSERT_TEST(after.hits - before.hits == STATS_KEYS && after.misses - before.misses == 1);
+    ASSERT_TEST(after.comparisons - before.comparisons >= STATS_KEYS);
+    ASSERT_TEST(after.probes - before.probes >= STATS_KEYS + 1 && after.longest_probe >= 1);
+    ASSERT_TEST(after.key_allocations == STATS_KEYS);
+    //A copy counts from zero
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && mapGetStats(copy, &after) == MAP_SUCCESS);
+    ASSERT_TEST(after.lookups == 0 && after.key_allocations == 0);
+    mapDestroy(copy);
+    mapDestroy(map);
+    ASSERT_TEST(mapGetStats(NULL, &after) == MAP_NULL_ARGUMENT);
+#endif
+    //Without MAP_ENABLE_STATS a map keeps no counts, so there is nothing to check
+    return true;
+}
+
+/**
+ * @return
+ * The bytes of the keys first to last - 1 and of their values of the given
+ * version, with their '\0's.
+ */
+static size_t pairBytes(int first, int last, int version)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    size_t bytes = 0;
+    for (int i = first; i < last; i++)
+    {
+        makePair(key, value, i, version);
+        bytes += strlen(key) + 1 + strlen(value) + 1;
+    }
+    return bytes;
+}
+
+bool testCompactMap()
+{
+    Map map = mapCreateCompact();
+    ASSERT_TEST(map != NULL && putPairs(map, 0, COMPACT_KEYS, 0) && hasPairs(map, 0, COMPACT_KEYS, 0));
+    //A removal moves the last pair into the hole
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = 0; i < COMPACT_KEYS / 2; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapRemove(map, key) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(hasPairs(map, COMPACT_KEYS / 2, COMPACT_KEYS, 0));
+    //Strings returned by the map may be put back into it
+    makePair(key, value, COMPACT_KEYS - 1, 0);
+    ASSERT_TEST(mapPut(map, "alias", mapGet(map, key)) == MAP_SUCCESS);
+    ASSERT_TEST(mapPut(map, key, mapGet(map, key)) == MAP_SUCCESS);
+    ASSERT_TEST(strcmp(mapGet(map, "alias"), value) == 0 && strcmp(mapGet(map, key), value) == 0);
+    ASSERT_TEST(mapRemove(map, "alias") == MAP_SUCCESS);
+    //Replaced values become garbage, which is dropped instead of growing the buffer for ever
+    MapMemoryUsage usage;
+    for (int round = 1; round <= COMPACT_ROUNDS; round++)
+    {
+        ASSERT_TEST(putPairs(map, COMPACT_KEYS / 2, COMPACT_KEYS, round));
+    }
+    ASSERT_TEST(hasPairs(map, COMPACT_KEYS / 2, COMPACT_KEYS, COMPACT_ROUNDS));
+    ASSERT_TEST(usageAddsUp(map, &usage));
+    size_t live = pairBytes(COMPACT_KEYS / 2, COMPACT_KEYS, COMPACT_ROUNDS);
+    ASSERT_TEST(usage.keys + usage.values == live && usage.table < 8 * live);
+    size_t table = usage.table;
+    ASSERT_TEST(mapShrinkToFit(map) == MAP_SUCCESS && usageAddsUp(map, &usage) && usage.table < table);
+    ASSERT_TEST(hasPairs(map, COMPACT_KEYS / 2, COMPACT_KEYS, COMPACT_ROUNDS));
+    //A copy has its own arrays and buffer
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && putPairs(copy, 0, COMPACT_KEYS, 0));
+    ASSERT_TEST(hasPairs(copy, 0, COMPACT_KEYS, 0) && hasPairs(map, COMPACT_KEYS / 2, COMPACT_KEYS, COMPACT_ROUNDS));
+    ASSERT_TEST(mapClear(copy) == MAP_SUCCESS && mapGetSize(copy) == 0 && putPairs(copy, 0, SMALL_KEYS, 1));
+    ASSERT_TEST(hasPairs(copy, 0, SMALL_KEYS, 1));
+    mapDestroy(copy);
+    mapDestroy(map);
+    return true;
+}
+
+/** The hash of a slot map: the key itself, so a test chooses the home slot of every key */
+static unsigned int slotHash(int key)
+{
+    return (unsigned int)key;
+}
+
+DEFINE_MAP(SlotMap, int, int, slotHash, GENERIC_MAP_EQUALS)
+
+/**
+ * @return
+ * The key which gets the home slot GENERIC_SLOTS - 2 or GENERIC_SLOTS - 1, for i = 0, 1, 2...
+ */
+static int wrappedKey(int i)
+{
+    return (i / 2) * GENERIC_SLOTS + GENERIC_SLOTS - 2 + i % 2;
+}
+
+static bool isEvenSlotKey(int key, int value, void *context)
+{
+    (void)value;
+    (void)context;
+    return key % 2 == 0;
+}
+
+static bool isAnySlotKey(int key, int value, void *context)
+{
+    (void)key;
+    (void)value;
+    (void)context;
+    return true;
+}
+
+bool testGenericRemoveIfWrapAround()
+{
+    SlotMap map = SlotMapCreate();
+    ASSERT_TEST(map != NULL);
+    for (int i = 0; i < WRAPPED_KEYS; i++)
+    {
+        ASSERT_TEST(SlotMapPut(map, wrappedKey(i), i) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(map->capacity == GENERIC_SLOTS && SlotMapGetSize(map) == WRAPPED_KEYS);
+    //The keys fill the last two slots and the first ones, and the removals move them back across the end
+    ASSERT_TEST(SlotMapRemoveIf(map, isEvenSlotKey, NULL) == MAP_SUCCESS);
+    ASSERT_TEST(SlotMapGetSize(map) == WRAPPED_KEYS / 2);
+    for (int i = 0; i < WRAPPED_KEYS; i++)
+    {
+        int* value = SlotMapGet(map, wrappedKey(i));
+        ASSERT_TEST(i % 2 == 0 ? value == NULL : value != NULL && *value == i);
+    }
+    int count = 0;
+    GENERIC_MAP_FOREACH(SlotMap, slot, map)
+    {
+        ASSERT_TEST(SlotMapKeyAt(map, slot) % 2 == 1);
+        count++;
+    }
+    ASSERT_TEST(count == WRAPPED_KEYS / 2);
+    ASSERT_TEST(SlotMapRemoveIf(map, isAnySlotKey, NULL) == MAP_SUCCESS && SlotMapGetSize(map) == 0);
+    ASSERT_TEST(SlotMapNext(map, -1) == -1 && SlotMapRemoveIf(map, NULL, NULL) == MAP_NULL_ARGUMENT);
+    SlotMapDestroy(map);
+    return true;
+}
+
+bool testIncrementalGrowth()
+{
+    Map map = mapCreateIncremental();
+    Map copy = NULL;
+    char key[KEY_LEN], value[KEY_LEN], expected[KEY_LEN];
+    for (int i = 0; i < GROWTH_KEYS; i++)
+    {
+        makePair(key, value, i, 0);
+        ASSERT_TEST(mapPut(map, key, value) == MAP_SUCCESS);
+        //Keys still in the old index and keys already moved are both found
+        for (int j = i; j >= 0; j -= 1 + j / 8)
+        {
+            makePair(key, expected, j, 0);
+            ASSERT_TEST(mapGet(map, key) != NULL && strcmp(mapGet(map, key), expected) == 0);
+        }
+        ASSERT_TEST(!mapContains(map, "missing"));
+        if (i == GROWTH_KEYS / 2)
+        {
+            //A copy made in the middle of a growth goes on growing on its own
+            ASSERT_TEST((copy = mapCopy(map)) != NULL);
+        }
+    }
+    ASSERT_TEST(hasPairs(map, 0, GROWTH_KEYS, 0));
+    //Replacing and removing keys while the index grows
+    ASSERT_TEST(putPairs(copy, 0, GROWTH_KEYS / 4, 1));
+    for (int i = 0; i < GROWTH_KEYS / 4; i++)
+    {
+        makePair(key, value, i, 1);
+        ASSERT_TEST(mapRemove(copy, key) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(putPairs(copy, GROWTH_KEYS / 4, GROWTH_KEYS, 0));
+    ASSERT_TEST(hasPairs(copy, GROWTH_KEYS / 4, GROWTH_KEYS, 0));
+    ASSERT_TEST(hasPairs(map, 0, GROWTH_KEYS, 0));
+    mapDestroy(map);
+    mapDestroy(copy);
+    return true;
+}
+
+/** The context of a counting allocator: the bytes it allocated and not released yet */
+typedef struct Outstanding_t {
+    long bytes;
+    long blocks;
+} Outstanding;
+
+static void *countAllocate(void *context, size_t size)
+{
+    Outstanding *outstanding = context;
+    outstanding->bytes += (long)size;
+    outstanding->blocks++;
+    return malloc(size);
+}
+
+static void *countReallocate(void *context, void *block, size_t old_size, size_t new_size)
+{
+    Outstanding *outstanding = context;
+    void *new_block = realloc(block, new_size);
+    if (new_block != NULL)
+    {
+        outstanding->bytes += (long)new_size - (long)old_size;
+        outstanding->blocks += block == NULL;
+    }
+    return new_block;
+}
+
+static void countRelease(void *context, void *block, size_t size)
+{
+    Outstanding *outstanding = context;
+    outstanding->bytes -= block != NULL ? (long)size : 0;
+    outstanding->blocks -= block != NULL;
+    free(block);
+}
+
+/**
+ * Puts keys first to last - 1 in a map, updates them to longer values and
+ * removes every other one.
+ */
+static bool churnPairs(Map map, int first, int last)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    if (!putPairs(map, first, last, 0) || !putPairs(map, first, last, POOL_ROUNDS * POOL_KEYS))
+    {
+        return false;
+    }
+    for (int i = first; i < last; i += 2)
+    {
+        makePair(key, value, i, 0);
+        if (mapRemove(map, key) != MAP_SUCCESS)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testPoolAllocator()
+{
+    Pool pool = poolCreate();
+    ASSERT_TEST(pool != NULL && poolAllocate(NULL, POOL_BLOCK) == NULL);
+    //A released block is the next one given out for its size
+    char *block = poolAllocate(pool, POOL_BLOCK);
+    ASSERT_TEST(block != NULL && ((size_t)block & 15) == 0);
+    strcpy(block, "pooled");
+    char *bigger = poolReallocate(pool, block, POOL_BLOCK, 4 * POOL_BLOCK);
+    ASSERT_TEST(bigger != NULL && strcmp(bigger, "pooled") == 0);
+    poolRelease(pool, bigger, 4 * POOL_BLOCK);
+    ASSERT_TEST(poolAllocate(pool, 4 * POOL_BLOCK) == bigger);
+    poolRelease(pool, bigger, 4 * POOL_BLOCK);
+    //A map gives back every block it took, and its churn reuses them
+    MapAllocator allocator = poolGetAllocator(pool);
+    ASSERT_TEST(mapCreateWithAllocator(NULL) == NULL);
+    Map map = mapCreateWithAllocator(&allocator);
+    ASSERT_TEST(map != NULL && churnPairs(map, 0, POOL_KEYS));
+    size_t pool_size = poolGetSize(pool);
+    for (int round = 0; round < POOL_ROUNDS; round++)
+    {
+        ASSERT_TEST(churnPairs(map, 0, POOL_KEYS));
+    }
+    ASSERT_TEST(poolGetSize(pool) == pool_size);
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && putPairs(copy, 0, POOL_KEYS, 1) && hasPairs(copy, 0, POOL_KEYS, 1));
+    mapDestroy(copy);
+    mapDestroy(map);
+    poolDestroy(pool);
+    //The sizes given back match the sizes allocated
+    Outstanding outstanding = { 0, 0 };
+    MapAllocator counting = { countAllocate, countReallocate, countRelease, &outstanding };
+    map = mapCreateWithAllocator(&counting);
+    ASSERT_TEST(map != NULL && churnPairs(map, 0, POOL_KEYS) && outstanding.blocks > 0);
+    copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && putPairs(copy, 0, POOL_KEYS, 1) && mapShrinkToFit(copy) == MAP_SUCCESS);
+    mapDestroy(map);
+    mapDestroy(copy);
+    ASSERT_TEST(outstanding.bytes == 0 && outstanding.blocks == 0);
+    return true;
+}
+
+/** What a prefix walk saw */
+typedef struct
+{
+    int visited;
+    int limit; //The walk is stopped after this many pairs
+    bool valid; //Every pair had its own data element
+    bool ordered; //The keys came in strcmp order
+    char last[KEY_LEN];
+} PrefixWalk;
+
+/**
+ * Counts the pairs of a prefix walk, and checks their data elements and order.
+ */
+static bool visitPrefix(const char *key, const char *data, void *context)
+{
+    PrefixWalk *walk = context;
+    char expected_key[KEY_LEN];
+    int i;
+    walk->valid = walk->valid && data != NULL && sscanf(data, "value%d.", &i) == 1 &&
+                  sprintf(expected_key, "key%d", i) > 0 && strcmp(key, expected_key) == 0;
+    walk->ordered = walk->ordered && (walk->visited == 0 || strcmp(walk->last, key) < 0);
+    strcpy(walk->last, key);
+    return ++walk->visited < walk->limit;
+}
+
+/**
+ * @return
+ * The number of pairs a walk of the prefix visited, -1 if one was wrong (or
+ * out of order, if 'ordered').
+ */
+static int walkPrefix(Map map, const char *prefix, int limit, bool ordered)
+{
+    PrefixWalk walk = { 0, limit, true, true, "" };
+    if (mapForEachPrefix(map, prefix, visitPrefix, &walk) != MAP_SUCCESS || !walk.valid ||
+        (ordered && !walk.ordered))
+    {
+        return -1;
+    }
+    return walk.visited;
+}
+
+bool testPrefixWalks()
+{
+    Map maps[2] = { mapCreateRadix(), mapCreate() };
+    for (int i = 0; i < 2; i++)
+    {
+        //Only the radix map visits the pairs in order
+        bool ordered = i == 0;
+        ASSERT_TEST(putPairs(maps[i], 0, PREFIX_KEYS, 0));
+        ASSERT_TEST(walkPrefix(maps[i], "key1", PREFIX_KEYS, ordered) == PREFIX_MATCHES);
+        ASSERT_TEST(walkPrefix(maps[i], "", PREFIX_KEYS, ordered) == PREFIX_KEYS);
+        ASSERT_TEST(walkPrefix(maps[i], "key299", PREFIX_KEYS, ordered) == 1);
+        ASSERT_TEST(walkPrefix(maps[i], "key2999", PREFIX_KEYS, ordered) == 0);
+        ASSERT_TEST(walkPrefix(maps[i], "value", PREFIX_KEYS, ordered) == 0);
+        //The visitor stops the walk
+        ASSERT_TEST(walkPrefix(maps[i], "key1", 5, ordered) == 5);
+        //Removing the keys of a prefix leaves the keys under it
+        ASSERT_TEST(mapRemove(maps[i], "key1") == MAP_SUCCESS);
+        ASSERT_TEST(mapRemove(maps[i], "key10") == MAP_SUCCESS);
+        ASSERT_TEST(walkPrefix(maps[i], "key1", PREFIX_KEYS, ordered) == PREFIX_MATCHES - 2);
+        ASSERT_TEST(walkPrefix(maps[i], "key10", PREFIX_KEYS, ordered) == 10);
+        //A copy walks its own pairs
+        Map copy = mapCopy(maps[i]);
+        ASSERT_TEST(copy != NULL && mapPut(copy, "key1", "value1.0") == MAP_SUCCESS);
+        ASSERT_TEST(walkPrefix(copy, "key1", PREFIX_KEYS, ordered) == PREFIX_MATCHES - 1);
+        ASSERT_TEST(walkPrefix(maps[i], "key1", PREFIX_KEYS, ordered) == PREFIX_MATCHES - 2);
+        mapDestroy(copy);
+        mapDestroy(maps[i]);
+    }
+    ASSERT_TEST(mapForEachPrefix(NULL, "", visitPrefix, NULL) == MAP_NULL_ARGUMENT);
+    return true;
+}
+
+/**
+ * @return
+ * True if the map holds the keys first to last - 1 which are multiples of 'every'
+ * with their value of the given version, and none of the others.
+ */
+static bool hasEvery(Map map, int first, int last, int every, int version)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int i = first; i < last; i++)
+    {
+        makePair(key, value, i, version);
+        char *data = mapGet(map, key);
+        if (i % every == 0 ? data == NULL || strcmp(data, value) != 0 : data != NULL || mapContains(map, key))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool testFilter()
+{
+    Map maps[2] = { mapCreate(), mapCreateCompact() };
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int m = 0; m < 2; m++)
+    {
+        Map map = maps[m];
+        ASSERT_TEST(mapEnableFilter(map) == MAP_SUCCESS && mapEnableFilter(map) == MAP_SUCCESS);
+        //The filter grows with the map
+        ASSERT_TEST(putPairs(map, 0, FILTER_KEYS, 0) && hasPairs(map, 0, FILTER_KEYS, 0));
+        ASSERT_TEST(hasEvery(map, FILTER_KEYS, 2 * FILTER_KEYS, 2 * FILTER_KEYS + 1, 0));
+#ifdef MAP_ENABLE_STATS
+        MapStats before, after;
+        ASSERT_TEST(mapGetStats(map, &before) == MAP_SUCCESS);
+#endif
+        //Removing most keys leaves stale bits, until the filter is rebuilt from the rest
+        for (int i = 0; i < FILTER_KEYS; i++)
+        {
+            makePair(key, value, i, 0);
+            ASSERT_TEST(i % FILTER_KEPT_EVERY == 0 || mapRemove(map, key) == MAP_SUCCESS);
+        }
+        ASSERT_TEST(mapGetSize(map) == FILTER_KEYS / FILTER_KEPT_EVERY);
+        ASSERT_TEST(hasEvery(map, 0, FILTER_KEYS, FILTER_KEPT_EVERY, 0));
+#ifdef MAP_ENABLE_STATS
+        //Only the keys removed since the last rebuild (fewer than half as many as the keys kept) get
+        //through the filter, each searched twice by hasEvery, and a few false positives
+        ASSERT_TEST(mapGetStats(map, &after) == MAP_SUCCESS);
+        ASSERT_TEST(after.filter_rejections - before.filter_rejections > FILTER_KEYS);
+        ASSERT_TEST(after.filter_false_positives - before.filter_false_positives < FILTER_KEYS / FILTER_KEPT_EVERY);
+#endif
+        //A copy shares the filter until one of them changes
+        Map copy = mapCopy(map);
+        ASSERT_TEST(copy != NULL && putPairs(copy, 0, FILTER_KEYS, 1) && hasPairs(copy, 0, FILTER_KEYS, 1));
+        ASSERT_TEST(hasEvery(map, 0, FILTER_KEYS, FILTER_KEPT_EVERY, 0));
+        ASSERT_TEST(mapClear(copy) == MAP_SUCCESS && !mapContains(copy, key) && mapContains(map, "key0"));
+        mapDestroy(copy);
+        mapDestroy(map);
+    }
+    ASSERT_TEST(mapEnableFilter(NULL) == MAP_NULL_ARGUMENT);
+    return true;
+}
+
+bool testFreeze()
+{
+    Map map = mapCreateCompact();
+    ASSERT_TEST(putPairs(map, 0, IMAGE_KEYS, 0));
+    Map frozen = mapFreeze(map);
+    ASSERT_TEST(frozen != NULL);
+    //The map is unchanged, and later changes of it do not reach the frozen copy
+    ASSERT_TEST(hasPairs(map, 0, IMAGE_KEYS, 0));
+    ASSERT_TEST(putPairs(map, 0, IMAGE_KEYS, 1));
+    mapDestroy(map);
+    ASSERT_TEST(hasPairs(frozen, 0, IMAGE_KEYS, 0));
+    ASSERT_TEST(!mapContains(frozen, "key" TOSTRING(IMAGE_KEYS)));
+    ASSERT_TEST(!mapContains(frozen, ""));
+    ASSERT_TEST(mapPut(frozen, "key0", "changed") == MAP_ERROR);
+    ASSERT_TEST(mapRemove(frozen, "key0") == MAP_ERROR);
+    //A saved frozen map opens as the same frozen map
+    ASSERT_TEST(mapSave(frozen, IMAGE_PATH) == MAP_SUCCESS);
+    mapDestroy(frozen);
+    Map mapped = mapOpenMapped(IMAGE_PATH);
+    ASSERT_TEST(mapped != NULL);
+    ASSERT_TEST(hasPairs(mapped, 0, IMAGE_KEYS, 0));
+    ASSERT_TEST(!mapContains(mapped, "key" TOSTRING(IMAGE_KEYS)));
+    //...and freezing an image (or an empty map) works as on any map
+    ASSERT_TEST((frozen = mapFreeze(mapped)) != NULL);
+    mapDestroy(mapped);
+    remove(IMAGE_PATH);
+    ASSERT_TEST(hasPairs(frozen, 0, IMAGE_KEYS, 0));
+    mapDestroy(frozen);
+    map = mapCreate();
+    ASSERT_TEST((frozen = mapFreeze(map)) != NULL);
+    ASSERT_TEST(hasPairs(frozen, 0, 0, 0) && !mapContains(frozen, "key0"));
+    mapDestroy(frozen);
+    mapDestroy(map);
+    return true;
+}
+
+bool testEntries()
+{
+    Map maps[3] = { mapCreate(), mapCreateArena(), mapCreateCompact() };
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TEST(putPairs(maps[i], 0, COPY_KEYS, 0));
+        Map copy = mapCopy(maps[i]);
+        ASSERT_TEST(copy != NULL);
+        bool inserted = true;
+        MapEntry found = mapFindOrInsert(maps[i], "key7", &inserted);
+        ASSERT_TEST(!inserted && strcmp(mapEntryGetKey(&found), "key7") == 0);
+        ASSERT_TEST(strcmp(mapEntryGetValue(&found), "value7.0") == 0);
+        MapEntry added = mapFindOrInsert(maps[i], "new", &inserted);
+        ASSERT_TEST(inserted && strcmp(mapEntryGetValue(&added), "") == 0);
+        //Both entries stay valid while they are used, and change only their map
+        ASSERT_TEST(mapEntrySetValue(&found, "value7.1") == MAP_SUCCESS);
+        ASSERT_TEST(mapEntrySetValue(&added, "added") == MAP_SUCCESS);
+        ASSERT_TEST(mapEntrySetValue(&found, "value7.2") == MAP_SUCCESS);
+        ASSERT_TEST(strcmp(mapEntryGetValue(&added), "added") == 0);
+        int64_t counter = 0;
+        ASSERT_TEST(mapEntryGetInt(&found, &counter) == MAP_ERROR);
+        ASSERT_TEST(mapGetSize(maps[i]) == COPY_KEYS + 1);
+        ASSERT_TEST(strcmp(mapGet(maps[i], "key7"), "value7.2") == 0);
+        ASSERT_TEST(strcmp(mapGet(maps[i], "new"), "added") == 0);
+        ASSERT_TEST(hasPairs(copy, 0, COPY_KEYS, 0));
+        mapDestroy(copy);
+        mapDestroy(maps[i]);
+    }
+    //A counters map has counters instead of data elements
+    Map counters = mapCreateCounters();
+    bool inserted = false;
+    MapEntry entry = mapFindOrInsert(counters, "votes", &inserted);
+    int64_t value = -1;
+    ASSERT_TEST(inserted && mapEntryGetInt(&entry, &value) == MAP_SUCCESS && value == 0);
+    ASSERT_TEST(mapEntrySetInt(&entry, 40) == MAP_SUCCESS);
+    ASSERT_TEST(mapEntryGetValue(&entry) == NULL && mapEntrySetValue(&entry, "40") == MAP_ERROR);
+    ASSERT_TEST(mapIncrement(counters, "votes", 2, &value) == MAP_SUCCESS && value == 42);
+    entry = mapFindOrInsert(counters, "votes", &inserted);
+    ASSERT_TEST(!inserted && mapEntryGetInt(&entry, &value) == MAP_SUCCESS && value == 42);
+    mapDestroy(counters);
+    //Maps which are not changed in place have no entries
+    Map concurrent = mapCreateConcurrent(2);
+    inserted = true;
+    entry = mapFindOrInsert(concurrent, "key", &inserted);
+    ASSERT_TEST(!inserted);
+    ASSERT_TEST(mapEntryGetKey(&entry) == NULL && mapEntrySetValue(&entry, "value") == MAP_NULL_ARGUMENT);
+    ASSERT_TEST(mapGetSize(concurrent) == 0);
+    mapDestroy(concurrent);
+    entry = mapFindOrInsert(NULL, "key", &inserted);
+    ASSERT_TEST(mapEntryGetKey(&entry) == NULL && mapEntryGetKey(NULL) == NULL);
+    return true;
+}
+
+bool testFromArraysDuplicates()
+{
+    const char *keys[] = { "a", "b", "a", "c", "b", "a" };
+    const char *values[] = { "1", "2", "3", "4", "5", "6" };
+    Map map = mapCreateFromArrays(keys, values, 6, 0);
+    ASSERT_TEST(map != NULL && mapGetSize(map) == 3);
+    //A repeated key gets its last data element, at the place of its first appearance
+    ASSERT_TEST(strcmp(mapGet(map, "a"), "6") == 0);
+    ASSERT_TEST(strcmp(mapGet(map, "b"), "5") == 0);
+    ASSERT_TEST(strcmp(mapGet(map, "c"), "4") == 0);
+    ASSERT_TEST(strcmp(mapGetFirst(map), "a") == 0);
+    ASSERT_TEST(strcmp(mapGetNext(map), "b") == 0);
+    ASSERT_TEST(strcmp(mapGetNext(map), "c") == 0);
+    ASSERT_TEST(mapGetNext(map) == NULL);
+    //The map changes as any compact map
+    ASSERT_TEST(mapPut(map, "b", "7") == MAP_SUCCESS && mapRemove(map, "a") == MAP_SUCCESS);
+    ASSERT_TEST(mapGetSize(map) == 2 && strcmp(mapGet(map, "b"), "7") == 0);
+    mapDestroy(map);
+    //Many repeated keys, each given its versions in turn
+    char **big_keys = malloc(sizeof(char *) * ARRAY_KEYS * ARRAY_REPEATS);
+    char **big_values = malloc(sizeof(char *) * ARRAY_KEYS * ARRAY_REPEATS);
+    char *strings = malloc(2 * KEY_LEN * ARRAY_KEYS * ARRAY_REPEATS);
+    ASSERT_TEST(big_keys != NULL && big_values != NULL && strings != NULL);
+    for (int version = 0; version < ARRAY_REPEATS; version++)
+    {
+        for (int i = 0; i < ARRAY_KEYS; i++)
+        {
+            int pair = version * ARRAY_KEYS + i;
+            big_keys[pair] = strings + 2 * KEY_LEN * pair;
+            big_values[pair] = big_keys[pair] + KEY_LEN;
+            makePair(big_keys[pair], big_values[pair], i, version);
+        }
+    }
+    map = mapCreateFromArrays((const char *const *)big_keys, (const char *const *)big_values,
+                              ARRAY_KEYS * ARRAY_REPEATS, 0);
+    ASSERT_TEST(map != NULL && hasPairs(map, 0, ARRAY_KEYS, ARRAY_REPEATS - 1));
+    mapDestroy(map);
+    //Distinct keys may skip the search for duplicates
+    map = mapCreateFromArrays((const char *const *)big_keys, (const char *const *)big_values,
+                              ARRAY_KEYS, MAP_ARRAYS_UNIQUE_KEYS);
+    ASSERT_TEST(map != NULL && hasPairs(map, 0, ARRAY_KEYS, 0));
+    mapDestroy(map);
+    big_values[ARRAY_KEYS - 1] = NULL;
+    ASSERT_TEST(mapCreateFromArrays((const char *const *)big_keys, (const char *const *)big_values,
+                                    ARRAY_KEYS, 0) == NULL);
+    free(strings);
+    free(big_values);
+    free(big_keys);
+    ASSERT_TEST((map = mapCreateFromArrays(keys, values, 0, 0)) != NULL && mapGetSize(map) == 0);
+    mapDestroy(map);
+    ASSERT_TEST(mapCreateFromArrays(keys, values, -1, 0) == NULL);
+    return true;
+}
+
+bool testNestedReadSections()
+{
+    ASSERT_TEST(epochEnter());
+    //No other thread reads, so the oldest epoch is the one this thread entered at
+    unsigned long outer = epochGetOldest();
+    epochAdvance();
+    ASSERT_TEST(epochEnter());
+    epochExit();
+    //The inner exit leaves the thread in the epoch of the outer section
+    ASSERT_TEST(epochGetOldest() == outer);
+    epochExit();
+    ASSERT_TEST(epochGetOldest() > outer);
+    return true;
+}
+
+/**
+ * Replaces the values of a read-mostly map until told to stop.
+ */
+static void *replaceValues(void *map)
+{
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int version = 1; mapGet(map, "stop") == NULL; version++)
+    {
+        makePair(key, value, version % READ_MOSTLY_KEYS, version);
+        mapPut(map, key, value);
+    }
+    return NULL;
+}
+
+/** The map a visitor reads again, and whether every pair it saw matched */
+typedef struct
+{
+    Map map;
+    bool valid;
+} NestedRead;
+
+/**
+ * A visitor which reads another key of the map (a nested read) before it
+ * checks that the value of its pair belongs to its key.
+ */
+static bool visitWithNestedRead(const char *key, const char *data, void *context)
+{
+    NestedRead *read = context;
+    mapGet(read->map, "missing");
+    char expected_key[KEY_LEN];
+    int i;
+    if (sscanf(data, "value%d.", &i) != 1)
+    {
+        read->valid = false;
+        return false;
+    }
+    sprintf(expected_key, "key%d", i);
+    read->valid = read->valid && strcmp(key, expected_key) == 0;
+    return read->valid;
+}
+
+bool testReadMostlyNestedRead()
+{
+    Map map = mapCreateReadMostly();
+    ASSERT_TEST(putPairs(map, 0, READ_MOSTLY_KEYS, 0));
+    pthread_t writer;
+    ASSERT_TEST(pthread_create(&writer, NULL, replaceValues, map) == 0);
+    NestedRead read = { map, true };
+    for (int round = 0; round < READ_MOSTLY_ROUNDS && read.valid; round++)
+    {
+        mapForEachPrefix(map, "key", visitWithNestedRead, &read);
+    }
+    mapPut(map, "stop", "");
+    pthread_join(writer, NULL);
+    ASSERT_TEST(read.valid);
+    mapDestroy(map);
+    return true;
+}
+
+bool testJournalRemoveIfFailure()
+{
+    const MapJournalOptions every_change = { 1, 0, 0 };
+    remove(JOURNAL_PATH);
+    remove(JOURNAL_PATH ".log");
+    Map map = mapOpenJournaled(JOURNAL_PATH, &every_change);
+    ASSERT_TEST(map != NULL && putPairs(map, 0, JOURNAL_KEYS, 0));
+    //No file may grow meanwhile, so the log cannot take the removals (nothing is printed before the limit is lifted)
+    struct rlimit limit;
+    ASSERT_TEST(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    struct rlimit no_growth = { 0, limit.rlim_max };
+    void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    bool limited = setrlimit(RLIMIT_FSIZE, &no_growth) == 0;
+    int calls = 0;
+    MapResult result = mapRemoveIf(map, isOddKey, &calls);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    signal(SIGXFSZ, handler);
+    ASSERT_TEST(limited && result == MAP_ERROR);
+    //The removal which was not logged did not happen, and neither did the ones after it
+    ASSERT_TEST(hasPairs(map, 0, JOURNAL_KEYS, 0));
+    mapDestroy(map);
+    ASSERT_TEST((map = mapOpenJournaled(JOURNAL_PATH, &every_change)) != NULL);
+    ASSERT_TEST(hasPairs(map, 0, JOURNAL_KEYS, 0));
+    mapDestroy(map);
+    remove(JOURNAL_PATH);
+    remove(JOURNAL_PATH ".log");
+    return true;
+}
+
+bool testReadMostlyWalkWhileWriting()
+{
+    Map map = mapCreateReadMostly();
+    ASSERT_TEST(map != NULL && putPairs(map, 0, READ_MOSTLY_KEYS, 0));
+    //A cursor walks the version it started with, while every key it passes is removed or replaced
+    //(and shrinking frees every replaced version which is not pinned)
+    char key[KEY_LEN], value[KEY_LEN];
+    int count = 0;
+    MapCursor cursor = mapCursorCreate(map);
+    for (char *id = mapCursorNext(&cursor); id != NULL; id = mapCursorNext(&cursor))
+    {
+        int i = atoi(id + strlen("key"));
+        makePair(key, value, i, 0);
+        ASSERT_TEST(strcmp(id, key) == 0 && strcmp(mapCursorGetValue(&cursor), value) == 0);
+        ASSERT_TEST(i % 2 == 0 ? mapRemove(map, id) == MAP_SUCCESS : mapPut(map, id, "replaced") == MAP_SUCCESS);
+        ASSERT_TEST(mapShrinkToFit(map) == MAP_SUCCESS);
+        count++;
+    }
+    ASSERT_TEST(count == READ_MOSTLY_KEYS && mapGetSize(map) == READ_MOSTLY_KEYS / 2);
+    //So does the internal iterator
+    count = 0;
+    for (char *id = mapGetFirst(map); id != NULL; id = mapGetNext(map))
+    {
+        ASSERT_TEST(strcmp(mapGet(map, id), "replaced") == 0);
+        ASSERT_TEST(mapRemove(map, id) == MAP_SUCCESS && mapShrinkToFit(map) == MAP_SUCCESS);
+        count++;
+    }
+    ASSERT_TEST(count == READ_MOSTLY_KEYS / 2 && mapGetSize(map) == 0);
+    //A cursor left early is released, after which it returns no keys
+    ASSERT_TEST(putPairs(map, 0, READ_MOSTLY_KEYS, 1));
+    cursor = mapCursorCreate(map);
+    ASSERT_TEST(mapCursorNext(&cursor) != NULL);
+    mapCursorRelease(&cursor);
+    ASSERT_TEST(mapCursorNext(&cursor) == NULL && mapCursorGetValue(&cursor) == NULL);
+    mapCursorRelease(&cursor);
+    mapCursorRelease(NULL);
+    ASSERT_TEST(mapClear(map) == MAP_SUCCESS && mapShrinkToFit(map) == MAP_SUCCESS && mapGetSize(map) == 0);
+    mapDestroy(map);
+    return true;
+}
+
+bool testChunkedIndexCopies()
+{
+    Map maps[4] = { mapCreate(), mapCreateCompact(), mapCreateIncremental(), mapCreateReadMostly() };
+    char key[KEY_LEN], value[KEY_LEN];
+    for (int m = 0; m < 4; m++)
+    {
+        Map map = maps[m];
+        //An incremental map is copied while it still moves keys to its grown index
+        ASSERT_TEST(map != NULL && putPairs(map, 0, CHUNKED_KEYS, 0));
+        Map copy = mapCopy(map);
+        ASSERT_TEST(copy != NULL);
+        for (int i = 0; i < CHUNKED_KEYS; i++)
+        {
+            makePair(key, value, i, 0);
+            ASSERT_TEST(i % CHUNKED_KEPT_EVERY == 0 || mapRemove(copy, key) == MAP_SUCCESS);
+        }
+        ASSERT_TEST(putPairs(copy, CHUNKED_KEYS, 2 * CHUNKED_KEYS, 1));
+        ASSERT_TEST(hasPairs(map, 0, CHUNKED_KEYS, 0));
+        ASSERT_TEST(hasEvery(copy, 0, CHUNKED_KEYS, CHUNKED_KEPT_EVERY, 0));
+        ASSERT_TEST(hasEvery(copy, CHUNKED_KEYS, 2 * CHUNKED_KEYS, 1, 1));
+        //And the other way around
+        ASSERT_TEST(putPairs(map, 0, CHUNKED_KEYS, 2) && hasPairs(map, 0, CHUNKED_KEYS, 2));
+        ASSERT_TEST(hasEvery(copy, 0, CHUNKED_KEYS, CHUNKED_KEPT_EVERY, 0));
+        mapDestroy(copy);
+        ASSERT_TEST(hasPairs(map, 0, CHUNKED_KEYS, 2));
+        mapDestroy(map);
+    }
+#ifdef MAP_ENABLE_STATS
+    //A change to a copy copies the chunks of the index it writes to, not the whole index
+    Map map = mapCreate();
+    ASSERT_TEST(putPairs(map, 0, CHUNKED_KEYS, 0));
+    MapStats built, changed;
+    ASSERT_TEST(mapGetStats(map, &built) == MAP_SUCCESS);
+    Map copy = mapCopy(map);
+    ASSERT_TEST(copy != NULL && mapRemove(copy, "key1") == MAP_SUCCESS && mapPut(copy, "new", "value") == MAP_SUCCESS);
+    ASSERT_TEST(mapGetStats(copy, &changed) == MAP_SUCCESS);
+    ASSERT_TEST(changed.bytes_reallocated < built.bytes_reallocated / 4);
+    mapDestroy(copy);
+    mapDestroy(map);
+#endif
+    return true;
+}
+
+/*The functions for the tests should be added here*/
+bool (*tests[]) (void) = {
+                        testIndexRemoveAndReinsert,
+                        testValueRewrite,
+                        testArenaMap,
+                        testFingerprintScan,
+                        testOrderedMapRanges,
+                        testCursors,
+                        testCopyIsolation,
+                        testCopyOfCopies,
+                        testRemoveIfAndBatches,
+                        testShrinkAndMemoryUsage,
+                        testCounters,
+                        testConcurrentCounters,
+                        testReadMostlyReaders,
+                        testInterning,
+                        testSaveOpenMapped,
+                        testJournalReplay,
+                        testStats,
+                        testCompactMap,
+                        testGenericRemoveIfWrapAround,
+                        testIncrementalGrowth,
+                        testPoolAllocator,
+                        testPrefixWalks,
+                        testFilter,
+                        testFreeze,
+                        testEntries,
+                        testFromArraysDuplicates,
+                        testNestedReadSections,
+                        testReadMostlyNestedRead,
+                        testJournalRemoveIfFailure,
+                        testReadMostlyWalkWhileWriting,
+                        testChunkedIndexCopies
+};
+
+/*The names of the test functions should be added here*/
+const char* testNames[] = {
+                            "testIndexRemoveAndReinsert",
+                            "testValueRewrite",
+                            "testArenaMap",
+                            "testFingerprintScan",
+                            "testOrderedMapRanges",
+                            "testCursors",
+                            "testCopyIsolation",
+                            "testCopyOfCopies",
+                            "testRemoveIfAndBatches",
+                            "testShrinkAndMemoryUsage",
+                            "testCounters",
+                            "testConcurrentCounters",
+                            "testReadMostlyReaders",
+                            "testInterning",
+                            "testSaveOpenMapped",
+                            "testJournalReplay",
+                            "testStats",
+                            "testCompactMap",
+                            "testGenericRemoveIfWrapAround",
+                            "testIncrementalGrowth",
+                            "testPoolAllocator",
+                            "testPrefixWalks",
+                            "testFilter",
+                            "testFreeze",
+                            "testEntries",
+                            "testFromArraysDuplicates",
+                            "testNestedReadSections",
+                            "testReadMostlyNestedRead",
+                            "testJournalRemoveIfFailure",
+                            "testReadMostlyWalkWhileWriting",
+                            "testChunkedIndexCopies"
+};
+
+int main(int argc, char* argv[]) {
+    if (argc == 1) {
+        for (int test_idx = 0; test_idx < NUMBER_TESTS; test_idx++) {
+            RUN_TEST(tests[test_idx], testNames[test_idx]);
+        }
+        return 0;
+    }
+    if (argc != 2) {
+        fprintf(stdout, "Usage: mapTests <test index>\n");
+        return 0;
+    }
+
+    int test_idx = strtol(argv[1], NULL, 10);
+    if (test_idx < 1 || test_idx > NUMBER_TESTS) {
+        fprintf(stderr, "Invalid test index %d\n", test_idx);
+        return 0;
+    }
+
+    RUN_TEST(tests[test_idx - 1], testNames[test_idx - 1]);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "intern.h"
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+/** The size of the table of a pool which was just created (a power of 2) */
+#define INTERN_MIN_TABLE_SIZE 64
+
+/** The table is doubled once more than LOAD_NUMERATOR/LOAD_DENOMINATOR of it is used */
+#define INTERN_LOAD_NUMERATOR 3
+#define INTERN_LOAD_DENOMINATOR 4
+
+//--------------------INTERN-STRUCT--------------------//
+/**
+ * A pooled string, with its owners and its hash in front of it.
+ * The users of the pool only see 'string'.
+ */
+typedef struct interned_t
+{
+    unsigned int refcount;
+    unsigned int hash;
+    char string[];
+} *Interned;
+
+/**
+ * The pool: an open-addressing table (linear probing) of the pooled strings,
+ * NULL in unused slots.
+ */
+static Interned* intern_table = NULL;
+static int intern_table_size = 0;
+static int intern_count = 0;
+static size_t intern_bytes = 0;
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int internHash(const char* string);
+static Interned internFromString(const char* string);
+static void internInsert(Interned* table, int size, Interned interned);
+static int internFind(const char* string, unsigned int hash);
+static void internRemove(int slot);
+static bool internGrow(void);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @return
+ * The hashString of the string, the same as the maps give its keys.
+ */
+static unsigned int internHash(const char* string)
+{
+    return hashString(string);
+}
+
+/**
+ * @param string - A string returned by 'internAcquire'
+ * @return
+ * The pooled string it belongs to.
+ */
+static Interned internFromString(const char* string)
+{
+    return (Interned)(string - offsetof(struct interned_t, string));
+}
+
+/**
+ * Puts a string in the first free slot of its probe sequence.
+ * The table must have at least one free slot.
+ */
+static void internInsert(Interned* table, int size, Interned interned)
+{
+    int slot = interned->hash & (size - 1);
+    while (table[slot] != NULL)
+    {
+        slot = (slot + 1) & (size - 1);
+    }
+    table[slot] = interned;
+}
+
+/**
+ * @return
+ * The slot of the pooled copy of a string, or -1 if it is not in the pool.
+ */
+static int internFind(const char* string, unsigned int hash)
+{
+    if (intern_table == NULL)
+    {
+        return -1;
+    }
+    int mask = intern_table_size - 1;
+    for (int slot = hash & mask; intern_table[slot] != NULL; slot = (slot + 1) & mask)
+    {
+        if (intern_table[slot]->hash == hash && !strcmp(intern_table[slot]->string, string))
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Empties a slot, shifting back the following slots of the cluster so no
+ * probe sequence is broken.
+ */
+static void internRemove(int slot)
+{
+    int mask = intern_table_size - 1;
+    int hole = slot;
+    for (int next = (hole + 1) & mask; intern_table[next] != NULL; next = (next + 1) & mask)
+    {
+        int home = intern_table[next]->hash & mask;
+        //The string may fill the hole only if the hole is between its home slot and its current slot
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            intern_table[hole] = intern_table[next];
+            hole = next;
+        }
+    }
+    intern_table[hole] = NULL;
+}
+
+/**
+ * Doubles the table (or creates it).
+ * @return
+ * false if the allocation failed, in which case the table is unchanged.
+ */
+static bool internGrow(void)
+{
+    int size = intern_table_size > 0 ? 2 * intern_table_size : INTERN_MIN_TABLE_SIZE;
+    Interned* table = calloc(size, sizeof(*table));
+    if (table == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < intern_table_size; i++)
+    {
+        if (intern_table[i] != NULL)
+        {
+            internInsert(table, size, intern_table[i]);
+        }
+    }
+    free(intern_table);
+    intern_table = table;
+    intern_table_size = size;
+    return true;
+}
+
+//--------------------INTERN-FUNCTIONS--------------------//
+const char* internAcquire(const char* string)
+{
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    unsigned int hash = internHash(string);
+    pthread_mutex_lock(&intern_lock);
+    int slot = internFind(string, hash);
+    if (slot >= 0)
+    {
+        Interned interned = intern_table[slot];
+        interned->refcount++;
+        pthread_mutex_unlock(&intern_lock);
+        return interned->string;
+    }
+    if ((intern_count + 1) * INTERN_LOAD_DENOMINATOR > intern_table_size * INTERN_LOAD_NUMERATOR && !internGrow())
+    {
+        pthread_mutex_unlock(&intern_lock);
+        return NULL;
+    }
+    size_t size = strlen(string) + 1;
+    Interned interned = malloc(sizeof(*interned) + size);
+    if (interned == NULL)
+    {
+        pthread_mutex_unlock(&intern_lock);
+        return NULL;
+    }
+    interned->refcount = 1;
+    interned->hash = hash;
+    memcpy(interned->string, string, size);
+    internInsert(intern_table, intern_table_size, interned);
+    intern_count++;
+    intern_bytes += sizeof(*interned) + size;
+    pthread_mutex_unlock(&intern_lock);
+    return interned->string;
+}
+
+void internRelease(const char* interned)
+{
+    if (interned == NULL)
+    {
+        return;
+    }
+    Interned pooled = internFromString(interned);
+    pthread_mutex_lock(&intern_lock);
+    assert(pooled->refcount > 0);
+    if (--pooled->refcount > 0)
+    {
+        pthread_mutex_unlock(&intern_lock);
+        return;
+    }
+    int slot = pooled->hash & (intern_table_size - 1);
+    while (intern_table[slot] != pooled)
+    {
+        slot = (slot + 1) & (intern_table_size - 1);
+    }
+    internRemove(slot);
+    intern_count--;
+    intern_bytes -= sizeof(*pooled) + strlen(interned) + 1;
+    if (intern_count == 0)
+    {
+        //An empty pool gives back its table, so a program which is done with it leaks nothing
+        free(intern_table);
+        intern_table = NULL;
+        intern_table_size = 0;
+    }
+    pthread_mutex_unlock(&intern_lock);
+    free(pooled);
+}
+
+size_t internGetMemoryUsage(void)
+{
+    pthread_mutex_lock(&intern_lock);
+    size_t bytes = intern_bytes + intern_table_size * sizeof(*intern_table);
+    pthread_mutex_unlock(&intern_lock);
+    return bytes;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+/**
+* String Interning Pool
+*
+* Keeps a single copy of every distinct string it was given, in one pool for
+* the whole program. Users of the same string share that copy instead of
+* keeping their own, and two pooled strings are equal exactly when they are
+* the same pointer.
+*
+* The following functions are available:
+*   internAcquire	- Returns the pooled copy of a string, adding it if needed.
+*   internRelease	- Gives back a pooled copy.
+*   internGetMemoryUsage	- Returns the bytes the pool uses.
+*
+* Every pooled string is reference counted: internAcquire adds an owner and
+* internRelease removes one, and the copy is freed with its last owner.
+* The pool is guarded by a lock, so it may be used from any thread.
+*/
+
+/**
+ * @param string - The string to look for.
+ * @return
+ * NULL - if @param string is NULL or the allocation failed.
+ * Otherwise the pooled copy of the string, which now has one more owner. It
+ * must not be changed, and must be given back with internRelease.
+ */
+const char* internAcquire(const char* string);
+
+/**
+ * @param interned - A string returned by internAcquire (if NULL nothing is done).
+ *      Once its last owner released it, it is freed.
+ */
+void internRelease(const char* interned);
+
+/**
+ * @return
+ * The bytes of all the pooled strings and of the pool's table.
+ */
+size_t internGetMemoryUsage(void);
+
+#endif
\ No newline at end of file
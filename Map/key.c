@@ -1,26 +1,187 @@
 #include "key.h"
+#include "intern.h"
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
+
+/** The smallest room kept for a value, so short values can grow in place */
+#define KEY_MIN_VALUE_CAPACITY 8
+
+/** Keys are allocated in multiples of this size, the padding is given to the value */
+#define KEY_ALLOCATION_ALIGNMENT 16
+
+/** The factor by which an out-of-line value buffer is over-allocated when it grows */
+#define KEY_VALUE_GROWTH_FACTOR 2
+
+/** The room an integer key keeps for its value, enough for an aligned int64_t anywhere in it */
+#define KEY_INT_ROOM (2 * sizeof(int64_t) - 1)
+
+/** Keys may be shared by maps used from different threads, so their counts are atomic */
+#if defined(__GNUC__)
+#define KEY_REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define KEY_REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#define KEY_REFCOUNT_LOAD(count) __atomic_load_n(&(count), __ATOMIC_ACQUIRE)
+#define KEY_INT_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_RELAXED)
+#define KEY_INT_STORE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELAXED)
+#define KEY_INT_ADD(pointer, delta) __atomic_add_fetch(pointer, delta, __ATOMIC_RELAXED)
+#else
+#define KEY_REFCOUNT_INCREMENT(count) (++(count))
+#define KEY_REFCOUNT_DECREMENT(count) (--(count))
+#define KEY_REFCOUNT_LOAD(count) (count)
+#define KEY_INT_LOAD(pointer) (*(pointer))
+#define KEY_INT_STORE(pointer, value) (*(pointer) = (value))
+#define KEY_INT_ADD(pointer, delta) (*(pointer) += (delta))
+#endif
+
 //--------------------KEY-STRUCT--------------------//
+/**
+ * A key is a single allocation: the header, then the id and then the value,
+ * with spare room after the value. A value that outgrows the room is moved to
+ * its own buffer ('value' no longer points into 'data').
+ * 'owned' is false for keys built by 'keyCreateInBuffer', whose memory belongs
+ * to the caller.
+ * Once the value moved out, its old room (at least KEY_MIN_VALUE_CAPACITY bytes)
+ * holds the size of that room, for 'keyGetMemoryUsage'.
+ * The value of an 'integer' key is an int64_t at the first aligned address of
+ * its room, and never moves out.
+ * An 'interned' key has no room: 'value' is a pooled string, and 'data' holds
+ * a pointer to the pooled ID.
+ */
 struct key_t
 {
-    char* id;
     char* value;
+    unsigned int id_length;
+    unsigned int value_capacity;
+    unsigned int refcount;
+    bool owned;
+    bool integer;
+    bool interned;
+    char data[];
 };
 
+static bool keyValueIsInline(Key key);
+static size_t keyGetAllocationSize(size_t id_length, size_t value_size);
+static size_t keyGetOwnSize(Key key);
+static void* keyAllocate(const KeyAllocator* allocator, size_t size);
+static void keyRelease(const KeyAllocator* allocator, void* block, size_t size);
+static Key keyInit(void* buffer, size_t total, const char* key_id, size_t id_length, const char* key_value,
+                   size_t value_size);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @param key - The key to check
+ * @return
+ * true if the value is stored inside the key's own allocation.
+ */
+static bool keyValueIsInline(Key key)
+{
+    return key->integer || key->value == key->data + key->id_length + 1;
+}
+
+/**
+ * @param id_length - The length of the key's id
+ * @param value_size - The size of the key's value, including the '\0'
+ * @return
+ * The number of bytes a key needs, including the spare room for the value.
+ */
+static size_t keyGetAllocationSize(size_t id_length, size_t value_size)
+{
+    size_t capacity = value_size > KEY_MIN_VALUE_CAPACITY ? value_size : KEY_MIN_VALUE_CAPACITY;
+    size_t total = sizeof(struct key_t) + id_length + 1 + capacity;
+    return (total + KEY_ALLOCATION_ALIGNMENT - 1) / KEY_ALLOCATION_ALIGNMENT * KEY_ALLOCATION_ALIGNMENT;
+}
+
+/**
+ * @param key - A key which is not interned
+ * @return
+ * The size the key was allocated with (without a value which moved out).
+ */
+static size_t keyGetOwnSize(Key key)
+{
+    unsigned int inline_capacity = key->value_capacity;
+    if (!keyValueIsInline(key))
+    {
+        memcpy(&inline_capacity, key->data + key->id_length + 1, sizeof(inline_capacity));
+    }
+    return sizeof(*key) + key->id_length + 1 + inline_capacity;
+}
+
+/**
+ * @return
+ * A block of 'size' bytes from the allocator (malloc if it is NULL), or NULL.
+ */
+static void* keyAllocate(const KeyAllocator* allocator, size_t size)
+{
+    return allocator == NULL ? malloc(size) : allocator->allocate(allocator->context, size);
+}
+
+/**
+ * Gives a block of 'size' bytes back to the allocator it came from (free if it is NULL).
+ */
+static void keyRelease(const KeyAllocator* allocator, void* block, size_t size)
+{
+    if (allocator == NULL)
+    {
+        free(block);
+    }
+    else
+    {
+        allocator->release(allocator->context, block, size);
+    }
+}
+
+/**
+ * Builds a key inside a buffer of 'total' bytes (as returned by 'keyGetAllocationSize').
+ * @return
+ * The new key, which is the start of the buffer.
+ */
+static Key keyInit(void* buffer, size_t total, const char* key_id, size_t id_length, const char* key_value,
+                   size_t value_size)
+{
+    Key key = buffer;
+    key->refcount = 1;
+    key->owned = true;
+    key->integer = false;
+    key->interned = false;
+    key->id_length = id_length;
+    key->value_capacity = total - sizeof(struct key_t) - id_length - 1;
+    key->value = key->data + id_length + 1;
+    memcpy(key->data, key_id, id_length + 1);
+    memcpy(key->value, key_value, value_size);
+    return key;
+}
+
 //--------------------KEY-FUNCTIONS--------------------//
 /**
- * @param key - A key struct to destroy and deallocate all it's components.
+ * @param key - A key to release. Once its last owner released it, the key and
+ * all it's components are deallocated.
  * */
 void keyDestroy(Key key)
 {
-    if (key == NULL)
+    keyDestroyWithAllocator(key, NULL);
+}
+
+void keyDestroyWithAllocator(Key key, const KeyAllocator* allocator)
+{
+    if (key == NULL || KEY_REFCOUNT_DECREMENT(key->refcount) > 0)
+    {
+        return;
+    }
+    if (key->interned)
     {
+        internRelease(keyGetID(key));
+        internRelease(key->value);
+        free(key);
         return;
     }
-    free(key->id);
-    free(key->value);
-    free(key);
+    if (!keyValueIsInline(key))
+    {
+        keyRelease(allocator, key->value, key->value_capacity);
+    }
+    if (key->owned)
+    {
+        keyRelease(allocator, key, keyGetOwnSize(key));
+    }
 }
 
 /**
@@ -31,26 +192,104 @@ void keyDestroy(Key key)
  * In case of SUCCESS - a pointer for the new allocated key.
  * */
 Key keyCreate(const char* key_id, const char* key_value)
+{
+    return keyCreateWithAllocator(key_id, key_value, NULL);
+}
+
+Key keyCreateWithAllocator(const char* key_id, const char* key_value, const KeyAllocator* allocator)
 {
     if(!key_id || !key_value)
     {
         return NULL;
     }
-    char *id = malloc(strlen(key_id) + 1);
-    char *value = malloc(strlen(key_value) + 1);
-    if(!id || !key_value)
+    size_t id_length = strlen(key_id);
+    size_t value_size = strlen(key_value) + 1;
+    size_t total = keyGetAllocationSize(id_length, value_size);
+    void* buffer = keyAllocate(allocator, total);
+    if(!buffer)
     {
         return NULL;
     }
-    strcpy(id, key_id);
-    strcpy(value, key_value);
-    Key key = malloc(sizeof(*key));
-    if(!key)
+    return keyInit(buffer, total, key_id, id_length, key_value, value_size);
+}
+
+Key keyCreateInt(const char* key_id, int64_t value)
+{
+    return keyCreateIntWithAllocator(key_id, value, NULL);
+}
+
+Key keyCreateIntWithAllocator(const char* key_id, int64_t value, const KeyAllocator* allocator)
+{
+    if(!key_id)
+    {
+        return NULL;
+    }
+    size_t id_length = strlen(key_id);
+    size_t total = keyGetAllocationSize(id_length, KEY_INT_ROOM);
+    void* buffer = keyAllocate(allocator, total);
+    if(!buffer)
+    {
+        return NULL;
+    }
+    Key key = keyInit(buffer, total, key_id, id_length, "", 1);
+    uintptr_t address = (uintptr_t)key->value;
+    key->value += (sizeof(int64_t) - address % sizeof(int64_t)) % sizeof(int64_t);
+    key->integer = true;
+    *(int64_t*)key->value = value;
+    return key;
+}
+
+Key keyCreateInterned(const char* key_id, const char* key_value)
+{
+    if(!key_id || !key_value)
     {
         return NULL;
     }
-    key->id = id;
-    key->value = value;
+    const char* id = internAcquire(key_id);
+    const char* value = internAcquire(key_value);
+    Key key = malloc(sizeof(*key) + sizeof(id));
+    if(!id || !value || !key)
+    {
+        internRelease(id);
+        internRelease(value);
+        free(key);
+        return NULL;
+    }
+    key->refcount = 1;
+    key->owned = true;
+    key->integer = false;
+    key->interned = true;
+    key->id_length = strlen(id);
+    key->value_capacity = 0;
+    key->value = (char*)value;
+    memcpy(key->data, &id, sizeof(id));
+    return key;
+}
+
+size_t keyGetRequiredSize(const char* key_id, const char* key_value)
+{
+    if(!key_id || !key_value)
+    {
+        return 0;
+    }
+    return keyGetAllocationSize(strlen(key_id), strlen(key_value) + 1);
+}
+
+Key keyCreateInBuffer(void* buffer, size_t buffer_size, const char* key_id, const char* key_value)
+{
+    if(!buffer || !key_id || !key_value)
+    {
+        return NULL;
+    }
+    size_t id_length = strlen(key_id);
+    size_t value_size = strlen(key_value) + 1;
+    size_t total = keyGetAllocationSize(id_length, value_size);
+    if(buffer_size < total)
+    {
+        return NULL;
+    }
+    Key key = keyInit(buffer, total, key_id, id_length, key_value, value_size);
+    key->owned = false;
     return key;
 }
 
@@ -63,25 +302,128 @@ Key keyCreate(const char* key_id, const char* key_value)
  * KEY_SUCCESS - if the value successfully set
  */
 KeyResult keySetValue(Key key, const char *value)
+{
+    return keySetValueWithAllocator(key, value, NULL);
+}
+
+KeyResult keySetValueWithAllocator(Key key, const char *value, const KeyAllocator* allocator)
 {
     if (key == NULL || value == NULL)
     {
         return KEY_NULL_ARGUMENT;
     }
-    char* new_value = malloc((strlen(value) +1)*sizeof(char));
-    if (new_value == NULL)
+    assert(!key->integer);
+    if (key->interned)
     {
-        return KEY_OUT_OF_MEMORY;
+        const char* new_value = internAcquire(value);
+        if (new_value == NULL)
+        {
+            return KEY_OUT_OF_MEMORY;
+        }
+        internRelease(key->value);
+        key->value = (char*)new_value;
+        return KEY_SUCCESS;
     }
-    strcpy(new_value, value);
-    free(key->value);
-    key->value = new_value;
+    size_t value_size = strlen(value) + 1;
+    if (value_size > key->value_capacity)
+    {
+        size_t new_capacity = value_size * KEY_VALUE_GROWTH_FACTOR;
+        char* new_value = keyAllocate(allocator, new_capacity);
+        if (new_value == NULL)
+        {
+            return KEY_OUT_OF_MEMORY;
+        }
+        memcpy(new_value, value, value_size);
+        if (!keyValueIsInline(key))
+        {
+            keyRelease(allocator, key->value, key->value_capacity);
+        }
+        else
+        {
+            unsigned int inline_capacity = key->value_capacity;
+            memcpy(key->value, &inline_capacity, sizeof(inline_capacity));
+        }
+        key->value = new_value;
+        key->value_capacity = new_capacity;
+        return KEY_SUCCESS;
+    }
+    memmove(key->value, value, value_size);
     return KEY_SUCCESS;
 }
 
+Key keyShare(Key key)
+{
+    if (key != NULL)
+    {
+        KEY_REFCOUNT_INCREMENT(key->refcount);
+    }
+    return key;
+}
+
+bool keyIsShared(Key key)
+{
+    return key != NULL && KEY_REFCOUNT_LOAD(key->refcount) > 1;
+}
+
+size_t keyGetMemoryUsage(Key key, size_t* value_bytes)
+{
+    if (key == NULL)
+    {
+        return 0;
+    }
+    if (key->interned)
+    {
+        if (value_bytes != NULL)
+        {
+            *value_bytes = 0;
+        }
+        return sizeof(*key) + sizeof(char*);
+    }
+    if (value_bytes != NULL)
+    {
+        *value_bytes = key->value_capacity;
+        if (!keyValueIsInline(key))
+        {
+            unsigned int inline_capacity;
+            memcpy(&inline_capacity, key->data + key->id_length + 1, sizeof(inline_capacity));
+            *value_bytes += inline_capacity;
+        }
+    }
+    return sizeof(*key) + key->id_length + 1;
+}
+
+int64_t keyGetInt(Key key)
+{
+    assert(key != NULL && key->integer);
+    return KEY_INT_LOAD((int64_t*)key->value);
+}
+
+void keySetInt(Key key, int64_t value)
+{
+    assert(key != NULL && key->integer);
+    KEY_INT_STORE((int64_t*)key->value, value);
+}
+
+int64_t keyAddInt(Key key, int64_t delta)
+{
+    assert(key != NULL && key->integer);
+    return KEY_INT_ADD((int64_t*)key->value, delta);
+}
+
+bool keyValueFits(Key key, const char *value)
+{
+    return key != NULL && !key->integer && !key->interned && value != NULL && strlen(value) + 1 <= key->value_capacity;
+}
+
 char *keyGetID(Key key)
 {
-    return key != NULL? key->id : NULL;
+    if (key != NULL && key->interned)
+    {
+        char* id;
+        memcpy(&id, key->data, sizeof(id));
+        return id;
+    }
+    return key != NULL? key->data : NULL;
 }
 
 char *keyGetValue(Key key)
@@ -1,22 +1,64 @@
 #ifndef KEY_H
 #define KEY_H
 
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
 /**
 * Key Container
 *
 * Implements a key container type.
 * The type of the key and the value is string (char *)
+* The ID and the value are stored in the same allocation as the key itself,
+* with spare room after the value, so updating a value to one which is not
+* longer does not allocate.
 *
 * The following functions are available:
 *   keyCreate		- Creates a new key with an ID and a value as const strings.
+*   keyCreateWithAllocator	- Creates a new key whose memory comes from a given allocator.
 *   keyDestroy		- Deletes an existing key and frees all resources
+*   keyDestroyWithAllocator	- Deletes a key created by keyCreateWithAllocator.
+*   keyGetRequiredSize	- Returns the size of the buffer a key needs.
+*   keyCreateInBuffer	- Creates a new key inside a buffer given by the caller.
+*   keyValueFits	- Returns whether a value can be set without allocating.
+*   keyShare		- Adds an owner to a key.
+*   keyIsShared		- Returns whether a key has more than one owner.
+*   keyCreateInt	- Creates a new key with an ID and an int64_t value.
+*   keyCreateIntWithAllocator	- Creates an int64_t key whose memory comes from a given allocator.
+*   keyGetInt		- Returns the value of an integer key.
+*   keySetInt		- Sets the value of an integer key.
+*   keyAddInt		- Adds to the value of an integer key, atomically.
+*   keyCreateInterned	- Creates a new key whose ID and value are pooled strings.
+*   keyGetMemoryUsage	- Returns the bytes a key uses for its ID and for its value.
+*
+* A key is reference counted: keyCreate gives it a single owner, keyShare adds
+* one, and keyDestroy removes one and frees the key when the last one is gone.
+* The count is updated atomically, so owners may live in different threads.
+* A shared key must be treated as immutable (do not call keySetValue on it).
 *   keySetValue		- Sets a new value to a given key.
+*   keySetValueWithAllocator	- Sets a new value to a key created by keyCreateWithAllocator.
 *   keyGetID  	    - Returns the ID of a key as a char* (not a copy).
 *   keyGetValue		- Returns the value of a key as a char* (not a copy).
 */
 
 typedef struct key_t *Key;
 
+/**
+ * Where a key gets its memory from, instead of malloc, realloc and free.
+ * The functions get 'context' first, and the size of every block they free or
+ * reallocate (the size it was allocated with), so a pool can keep blocks of
+ * each size apart. A key does not remember its allocator: the functions which
+ * may allocate or free (keyDestroyWithAllocator, keySetValueWithAllocator) get
+ * it again. A NULL allocator means malloc, realloc and free.
+ */
+typedef struct KeyAllocator_t {
+    void* (*allocate)(void* context, size_t size);
+    void* (*reallocate)(void* context, void* block, size_t old_size, size_t new_size);
+    void (*release)(void* context, void* block, size_t size);
+    void* context;
+} KeyAllocator;
+
 typedef enum
 {
     KEY_SUCCESS = 0, 
@@ -25,10 +67,17 @@ typedef enum
 } KeyResult;
 
 /**
- * @param key - A key struct to destroy and deallocate all it's components.
+ * @param key - A key to release. Once its last owner released it, the key and
+ * all it's components are deallocated.
  * */
 void keyDestroy(Key key);
 
+/**
+ * Like keyDestroy, for a key created by keyCreateWithAllocator.
+ * @param allocator - The allocator the key was created with.
+ */
+void keyDestroyWithAllocator(Key key, const KeyAllocator* allocator);
+
 /**
  * @param key_id - Constant string for the ID of the key.
  * @param key_value - constant string for the value of the key.
@@ -38,6 +87,45 @@ void keyDestroy(Key key);
  * */
 Key keyCreate(const char* key_id, const char* key_value);
 
+/**
+ * Like keyCreate, with the memory of the key coming from 'allocator' (NULL for
+ * malloc). Such a key must be destroyed with keyDestroyWithAllocator and
+ * changed with keySetValueWithAllocator, with the same allocator.
+ */
+Key keyCreateWithAllocator(const char* key_id, const char* key_value, const KeyAllocator* allocator);
+
+/**
+ * Creates an integer key, whose value is an int64_t instead of a string.
+ * Its value is read and changed only with keyGetInt, keySetInt and keyAddInt
+ * (keySetValue must not be used on it, and keyGetValue does not return a string).
+ * @param key_id - Constant string for the ID of the key.
+ * @param value - The value of the key.
+ * @return
+ * NULL - in case of a null ID or a memory allocation fail.
+ * In case of SUCCESS - a pointer for the new allocated key.
+ */
+Key keyCreateInt(const char* key_id, int64_t value);
+
+/**
+ * Like keyCreateInt, with the memory of the key coming from 'allocator' (NULL
+ * for malloc). Such a key must be destroyed with keyDestroyWithAllocator.
+ */
+Key keyCreateIntWithAllocator(const char* key_id, int64_t value, const KeyAllocator* allocator);
+
+/**
+ * Creates an interned key, which keeps no copy of its ID and value: both are
+ * the pooled copies of the interning pool (see intern.h), shared with every
+ * other interned key with the same strings. keySetValue works on it, and so
+ * does everything else except keyCreateInBuffer and the integer functions.
+ * keyGetID and keyGetValue return the pooled copies, which must not be changed.
+ * @param key_id - Constant string for the ID of the key.
+ * @param key_value - constant string for the value of the key.
+ * @return
+ * NULL - in case of null arguments or a memory allocation fail.
+ * In case of SUCCESS - a pointer for the new allocated key.
+ */
+Key keyCreateInterned(const char* key_id, const char* key_value);
+
 /**
  * @param key - The key you want to chang it's value
  * @param value - The new value of the key
@@ -48,6 +136,91 @@ Key keyCreate(const char* key_id, const char* key_value);
  */
  KeyResult keySetValue(Key key, const char *value);
 
+/**
+ * Like keySetValue, for a key created by keyCreateWithAllocator.
+ * @param allocator - The allocator the key was created with.
+ */
+KeyResult keySetValueWithAllocator(Key key, const char *value, const KeyAllocator* allocator);
+
+/**
+ * @param key_id - Constant string for the ID of the key.
+ * @param key_value - constant string for the value of the key.
+ * @return
+ * 0 - in case of null arguments.
+ * Otherwise the number of bytes 'keyCreateInBuffer' needs for such a key.
+ */
+size_t keyGetRequiredSize(const char* key_id, const char* key_value);
+
+/**
+ * Creates a key inside memory owned by the caller, without allocating.
+ * keyDestroy never frees the buffer itself, and keySetValue may only be
+ * used on such a key with values for which keyValueFits returns true.
+ * @param buffer - The memory for the key, aligned for any type.
+ * @param buffer_size - The size of the buffer.
+ * @param key_id - Constant string for the ID of the key.
+ * @param key_value - constant string for the value of the key.
+ * @return
+ * NULL - in case of null arguments or if the buffer is smaller than keyGetRequiredSize.
+ * In case of SUCCESS - the new key (which starts at @param buffer).
+ */
+Key keyCreateInBuffer(void* buffer, size_t buffer_size, const char* key_id, const char* key_value);
+
+/**
+ * @param key - The key to share.
+ * @return
+ * The same key, which now has one more owner (NULL if @param key is NULL).
+ */
+Key keyShare(Key key);
+
+/**
+ * @param key - The key to check.
+ * @return
+ * true if the key has more than one owner, false otherwise or if @param key is NULL.
+ */
+bool keyIsShared(Key key);
+
+/**
+ * @param key - The key to measure.
+ * @param value_bytes - Set to the bytes reserved for the value: its room in the
+ *      key, or its own buffer (plus the room it left in the key) once it moved
+ *      out (0 for an interned key, whose strings are in the pool). May be NULL.
+ * @return
+ * The bytes the key uses for everything else (its header and ID), 0 if @param key is NULL.
+ */
+size_t keyGetMemoryUsage(Key key, size_t* value_bytes);
+
+/**
+ * @param key - An integer key.
+ * @return
+ * The value of the key.
+ */
+int64_t keyGetInt(Key key);
+
+/**
+ * @param key - An integer key, which is not shared.
+ * @param value - The new value of the key.
+ */
+void keySetInt(Key key, int64_t value);
+
+/**
+ * Adds to the value of an integer key in place. The addition is atomic, so
+ * threads which share a (non-shared) key may add to it at the same time.
+ * @param key - An integer key, which is not shared.
+ * @param delta - The number to add.
+ * @return
+ * The new value of the key.
+ */
+int64_t keyAddInt(Key key, int64_t delta);
+
+/**
+ * @param key - The key you want to change it's value
+ * @param value - The new value
+ * @return
+ * true if keySetValue would store the value in place, without allocating.
+ * false otherwise or if one of the args are NULL.
+ */
+ bool keyValueFits(Key key, const char *value);
+
 /**
  * @param key - The key you want it's ID
  * @return 
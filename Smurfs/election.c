@@ -4,50 +4,37 @@
 #include <assert.h>
 #include <stdbool.h>
 #include "election.h"
+#include "orderedMap.h"
+#include "genericMap.h"
 
 //--------------------DEFINES--------------------//
 #define ELECTION_STR_TO_INT '0'
-#define ELECTION_INITIAL_SIZE 100
-#define ELECTION_RESIZE_FACTOR 2
 
-#define REPEATED_MAP_REMOVE(map, item_bank, num_of_items) \
-    do { \
-        for(int i = 0; i < num_of_items; i++) \
-        { \
-            mapRemove(map, item_bank[i]); \
-        } \
-    } while(0)
+/** The most digits of a non-negative int ID */
+#define ELECTION_MAX_ID_LENGTH 10
 
-#define FREE_ARRAY(array, counter) \
-    do \
-    { \
-        for(int i = 0; i < counter; i++) \
-        { \
-            free(array[i]); \
-        } \
-        free(array); \
-    } while(0)
+/** The key of the votes of a tribe in an area: the area ID in the high 32 bits, the tribe ID in the low ones */
+#define ELECTION_VOTE_KEY(area_id, tribe_id) (((int64_t)(area_id) << 32) | (int64_t)(tribe_id))
+#define ELECTION_VOTE_AREA(vote_key) ((int)((vote_key) >> 32))
+#define ELECTION_VOTE_TRIBE(vote_key) ((int)((vote_key) & 0xffffffff))
 
 //----------STRUCT&FUNCTION-DECLARATIONS----------//
+DEFINE_MAP(ElectionVotes, int64_t, int64_t, genericMapHashInteger, GENERIC_MAP_EQUALS)
+
 struct election_t
 {
     Map areas;
-    Map tribes;
-    Map votes; //Key syntax: "area_key-tribe_key"
+    OrderedMap tribes; //Ordered by the numeric value of the tribe ID
+    ElectionVotes votes; //Key: ELECTION_VOTE_KEY of the area and the tribe
 };
 
 static int stringToInt(const char *str);
 static char *intToString(int num);
 static bool isValidName(const char *name);
-static char *voteKeyToAreaKey(const char *vote_key);
-static void *expand(void *ptr, int current_size);
-static const char *electionFindLowestID(Map map);
-static char *electionGenerateVoteKey(const char *area, const char *tribe);
 static const char *electionGetChosenTribeByArea(Election election, const char *area);
-static ElectionResult electionGetVoteListByArea(Election election, const char *area, char ***votes_bank,
-                                                int *votes_size, int *votes_counter);
-static ElectionResult electionGetVoteListByTribe(Election election, const char *tribe, char ***votes_bank,
-                                                int *votes_size, int *votes_counter);
+static bool electionIsAreaToRemove(const char *area, const char *name, void *should_delete_area);
+static bool electionIsVoteOfRemovedArea(int64_t vote_key, int64_t votes, void *areas);
+static bool electionIsVoteOfTribe(int64_t vote_key, int64_t votes, void *tribe_id);
 
 //--------------------STATIC-FUNCTIONS--------------------//
 /** 
@@ -101,44 +88,6 @@ static char *intToString(int num)
     return new_str;
 }
 
-/**
- * @param vote_key - a vote key.
- * @return
- * If reaches the EOS but a dash was not encountered - NULL
- * Allocation failed - NULL
- * ELSE - a pointer to an area key string 
- */
-static char *voteKeyToAreaKey(const char *vote_key)
-{
-    assert(vote_key != NULL);
-    int counter = 0;
-    bool dash = false;
-    while(*(vote_key+counter) && !dash)
-    {
-        if(*(vote_key + counter) == '-')
-        {
-            dash = true;
-            continue;
-        }
-        counter++;
-    }
-    if(!dash)
-    {
-        return NULL;
-    }
-    char *area_key = malloc(counter + 1); //+1 for the '\0' char
-    if(area_key == NULL)
-    {
-        return NULL;
-    }
-    for(int i = 0; i < counter; i++)
-    {
-        area_key[i] = vote_key[i];
-    }
-    area_key[counter] = '\0';
-    return area_key;
-}
-
 /**
  * @param name - A name of a tribe/area to test.
  * @return
@@ -158,203 +107,87 @@ static bool isValidName(const char *name)
     return true;
 }
 
-/**
- * @param ptr - Pointer to the array you want to expand
- * @param current_size - The current size of the array
- * @return 
- * An address to the new pointer, if allocation was successful
- * NULL, if the allocation failed.
- * ----If allocation fails, @param ptr will still be allocated!----
- */
-static void *expand(void *ptr, int current_size)
-{
-    void *new_ptr = realloc(ptr, current_size * ELECTION_RESIZE_FACTOR);
-    return new_ptr;
-}
-
-/**
- * @param map - A map with keys of strings that represent int numbers.
- * @return 
- * An pointer to the key with the lowest ID in the map - if allocation was successful (NOT A COPY!)
- * NULL, if the allocation failed or if the map is empty.
- */
-static const char *electionFindLowestID(Map map)
-{
-    const char *lowest_id = mapGetFirst(map);
-    if(lowest_id == NULL)
-    {
-        return NULL;
-    }
-    MAP_FOREACH(element, map)
-    {
-        if(stringToInt(element) <= stringToInt(lowest_id))
-        {
-            lowest_id = element;
-        }
-    }
-    return lowest_id;
-}
-
-/**
- * @param area - The area key as a const string.
- * @param tribe - The tribe key as a const string.
- * @return 
- * A new string with the format of the corresponding vote key.
- * NULL, if the allocation failed.
- */
-static char *electionGenerateVoteKey(const char *area, const char *tribe)
-{
-    assert(area != NULL && tribe != NULL);
-    char *vote_key = malloc(strlen(area) + strlen(tribe) + 1 + 1);
-    if(vote_key == NULL)
-    {
-        return NULL;
-    }
-    sprintf(vote_key,"%s-%s", area, tribe);
-    return vote_key;
-}
 
 /**
  * @param election - A pointer to the election struct.
  * @param area - An area key as a const string.
  * @return 
  * A pointer to the key of the chosen tribe by the @param area.
- * NULL, if the allocation failed, or if the map is empty.
+ * NULL, if the tribes map is empty.
  */
 static const char *electionGetChosenTribeByArea(Election election, const char *area)
 {
-    int tribe_votes = 0, max_votes = 0;
-    const char *max_ptr = electionFindLowestID(election->tribes);
+    int64_t max_votes = 0;
+    const char *max_ptr = orderedMapGetMin(election->tribes);
     if(max_ptr == NULL)
     {
         return NULL;
     }
-    MAP_FOREACH(tribe, election->tribes)
+    int area_id = stringToInt(area);
+    //The tribes are visited by increasing ID, so on a tie the first (lowest ID) tribe is kept
+    ORDERED_MAP_FOREACH(tribe, election->tribes)
     {
-        char *vote_key = electionGenerateVoteKey(area, tribe);
-        if(vote_key == NULL)
-        {
-            return NULL;
-        }
-        if(mapContains(election->votes, vote_key))
+        int64_t *tribe_votes = ElectionVotesGet(election->votes, ELECTION_VOTE_KEY(area_id, stringToInt(tribe)));
+        if(tribe_votes != NULL && *tribe_votes > max_votes)
         {
-            tribe_votes = stringToInt(mapGet(election->votes, vote_key));
-            if(tribe_votes > max_votes)
-            {
-                max_votes = tribe_votes;
-                max_ptr = tribe;
-            }
-            else if(tribe_votes == max_votes)
-            {
-                if(stringToInt(tribe) < stringToInt(max_ptr))
-                {
-                    max_ptr = tribe;
-                }
-            }
+            max_votes = *tribe_votes;
+            max_ptr = tribe;
         }
-        free(vote_key);
-        tribe_votes = 0;
     }
     return max_ptr;
 }
 
 /**
- * @param election - A pointer to the election struct.
- * @param area - An area key as a const string.
- * @param votes_bank - A pointer to the allocated array of strings to store all the votes by the area in.
- * @param votes_size - A pointer to the initial size of the array.
- * @param votes_counter - A pointer to a variable to store the number of votes by the area.
+ * A predicate for mapRemoveIf over the areas.
+ * @param area - An area key.
+ * @param should_delete_area - A pointer to the AreaConditionFunction.
  * @return 
- * ELECTION_SUCCESS - if the function succeeds.
- * ELECTION_OUT_OF_MEMORY - in case of allocation or re-allocation fail.
- * --IN CASE OF ALLOCATION FAIL, @param votes_bank WILL STILL BE ALLOCATED!--
+ * True if the area should be removed.
  */
-static ElectionResult electionGetVoteListByArea(Election election, const char *area, char ***votes_bank,
-                                                int *votes_size, int *votes_counter)
+static bool electionIsAreaToRemove(const char *area, const char *name, void *should_delete_area)
 {
-    MAP_FOREACH(vote, election->votes)
-    {
-        char *tmp = voteKeyToAreaKey(vote);
-        if(tmp == NULL)
-        {
-            return ELECTION_OUT_OF_MEMORY;
-        }
-        if(!strcmp(area, tmp))
-        {
-            if(*votes_counter >= *votes_size) //Checks to see if it goes out-of-bounds
-            {
-                char **tmp_ptr = expand(*votes_bank, *votes_size * sizeof(**votes_bank));
-                *votes_size *= ELECTION_RESIZE_FACTOR;
-                if(tmp_ptr == NULL)
-                {
-                    free(tmp);
-                    return ELECTION_OUT_OF_MEMORY;
-                }
-                *votes_bank = tmp_ptr;
-            }
-            (*votes_bank)[(*votes_counter)++] = vote;
-        }
-        free(tmp);
-    }
-    return ELECTION_SUCCESS;
+    return (*(AreaConditionFunction *)should_delete_area)(stringToInt(area));
 }
 
 /**
- * @param election - A pointer to the election struct.
- * @param tribe - An tribe key as a const string.
- * @param votes_bank - A pointer to the allocated array of strings to store all the votes by the tribe in.
- * @param votes_size - A pointer to the initial size of the array.
- * @param votes_counter - A pointer to a variable to store the number of votes by the tribe.
+ * A predicate for ElectionVotesRemoveIf.
+ * @param vote_key - A vote key.
+ * @param areas - The areas map, after the removed areas were removed from it.
  * @return 
- * ELECTION_SUCCESS - if the function succeeds.
- * ELECTION_OUT_OF_MEMORY - in case of allocation or re-allocation fail.
- * --IN CASE OF ALLOCATION FAIL, @param votes_bank WILL STILL BE ALLOCATED!-- 
+ * True if the area of the vote is no longer in the areas map.
  */
-static ElectionResult electionGetVoteListByTribe(Election election, const char *tribe, char ***votes_bank,
-                                                int *votes_size, int *votes_counter)
+static bool electionIsVoteOfRemovedArea(int64_t vote_key, int64_t votes, void *areas)
 {
-    MAP_FOREACH(area, election->areas)
-    {
-        char *area_vote = electionGenerateVoteKey(area, tribe);
-        if (area_vote == NULL)
-        {
-            return ELECTION_OUT_OF_MEMORY;
-        }
-        if (mapContains(election->votes,area_vote))
-        {
-            if (*votes_counter >= *votes_size) //Check to see if the pointer goes out-of-bounds
-            {
-                char **tmp_ptr = expand(*votes_bank, (*votes_size) * sizeof(**votes_bank));
-                *votes_size *= ELECTION_RESIZE_FACTOR;
-                if(tmp_ptr == NULL)
-                {
-                    return ELECTION_OUT_OF_MEMORY;
-                }
-                *votes_bank = tmp_ptr;
-            }
-            (*votes_bank)[(*votes_counter)++]= area_vote;
-        }
-        else
-        {
-            free(area_vote);
-        }
-    }
-    return ELECTION_SUCCESS;
+    char area[ELECTION_MAX_ID_LENGTH + 1];
+    sprintf(area, "%d", ELECTION_VOTE_AREA(vote_key));
+    return !mapContains(areas, area);
+}
+
+/**
+ * A predicate for ElectionVotesRemoveIf.
+ * @param vote_key - A vote key.
+ * @param tribe_id - A pointer to a tribe ID.
+ * @return 
+ * True if the vote is for the tribe.
+ */
+static bool electionIsVoteOfTribe(int64_t vote_key, int64_t votes, void *tribe_id)
+{
+    return ELECTION_VOTE_TRIBE(vote_key) == *(int *)tribe_id;
 }
 
 //--------------------HEADER-FUNCTIONS--------------------//
 Election electionCreate()
 {
-    Map new_areas_map = mapCreate();
-    Map new_tribes_map = mapCreate();
-    Map new_votes_map = mapCreate();
+    Map new_areas_map = mapCreateReadMostly();
+    OrderedMap new_tribes_map = orderedMapCreate(orderedMapCompareNumeric);
+    ElectionVotes new_votes_map = ElectionVotesCreate();
     Election new_election = malloc(sizeof(*new_election));
     if (!new_areas_map || !new_tribes_map || !new_votes_map || !new_election)
     {
-        mapDestroy(new_votes_map);
+        ElectionVotesDestroy(new_votes_map);
         mapDestroy(new_areas_map);
-        mapDestroy(new_tribes_map);
-        electionDestroy(new_election);
+        orderedMapDestroy(new_tribes_map);
+        free(new_election);
         return NULL;
     }
     new_election->areas = new_areas_map;
@@ -369,9 +202,9 @@ void electionDestroy(Election election)
     {
         return;
     }
-    mapDestroy(election->votes);
+    ElectionVotesDestroy(election->votes);
     mapDestroy(election->areas);
-    mapDestroy(election->tribes);
+    orderedMapDestroy(election->tribes);
     free(election);
 }
 
@@ -390,7 +223,7 @@ ElectionResult electionAddTribe (Election election, int tribe_id, const char* tr
     {
         return ELECTION_OUT_OF_MEMORY;
     }
-    if (mapContains(election->tribes, tribe_char_id))
+    if (orderedMapContains(election->tribes, tribe_char_id))
     {
         free(tribe_char_id);
         return ELECTION_TRIBE_ALREADY_EXIST;
@@ -400,7 +233,7 @@ ElectionResult electionAddTribe (Election election, int tribe_id, const char* tr
         free(tribe_char_id);
         return ELECTION_INVALID_NAME;
     }
-    if (mapPut(election->tribes, tribe_char_id, tribe_name) != MAP_SUCCESS)
+    if (orderedMapPut(election->tribes, tribe_char_id, tribe_name) != MAP_SUCCESS)
     {
         free(tribe_char_id);
         return ELECTION_OUT_OF_MEMORY;
@@ -455,7 +288,7 @@ char* electionGetTribeName (Election election, int tribe_id) ////////TO CHANGE
     {
         return NULL;
     }
-    char* tmp = mapGet(election->tribes, tribe_char_id);
+    char* tmp = orderedMapGet(election->tribes, tribe_char_id);
     if(!tmp)
     {
         free(tribe_char_id);
@@ -500,38 +333,22 @@ ElectionResult electionAddVote(Election election, int area_id, int tribe_id, int
         free(tribe_char_id);
         return ELECTION_AREA_NOT_EXIST;
     }
-    if (!mapContains(election->tribes, tribe_char_id))
+    if (!orderedMapContains(election->tribes, tribe_char_id))
     {
         free(area_char_id);
         free(tribe_char_id);
         return ELECTION_TRIBE_NOT_EXIST;
     }
-    char* vote_key = electionGenerateVoteKey(area_char_id,tribe_char_id);
-    if (vote_key == NULL)
-    {
-        free(area_char_id);
-        free(tribe_char_id);
-        return ELECTION_OUT_OF_MEMORY;
-    }
-    char *new_num_of_votes_str = mapContains(election->votes, tribe_char_id)?
-    intToString(stringToInt(mapGet(election->votes, vote_key)) + num_of_votes) : intToString(num_of_votes);
-    if (new_num_of_votes_str == NULL)
+    //A new vote key starts from 0 votes, so adding to it is a single search either way
+    bool inserted;
+    int64_t *votes = ElectionVotesFindOrInsert(election->votes, ELECTION_VOTE_KEY(area_id, tribe_id), &inserted);
+    if (votes == NULL)
     {
-        free(vote_key);
-        free(area_char_id);
-        free(tribe_char_id);
-        return ELECTION_OUT_OF_MEMORY; 
-    }
-    if (mapPut(election->votes, vote_key, new_num_of_votes_str) != MAP_SUCCESS)
-    {
-        free(new_num_of_votes_str);
-        free(vote_key);
         free(area_char_id);
         free(tribe_char_id);
         return ELECTION_OUT_OF_MEMORY;
     }
-    free(new_num_of_votes_str);
-    free(vote_key);
+    *votes += num_of_votes;
     free(area_char_id);
     free(tribe_char_id);
     return ELECTION_SUCCESS;
@@ -565,48 +382,20 @@ ElectionResult electionRemoveVote(Election election, int area_id, int tribe_id,
         free(str_tribe_id);
         return ELECTION_AREA_NOT_EXIST;
     }
-    if(!mapContains(election->tribes, str_tribe_id))
+    if(!orderedMapContains(election->tribes, str_tribe_id))
     {
         free(str_area_id);
         free(str_tribe_id);
         return ELECTION_TRIBE_NOT_EXIST;
     }
-    char *vote_key = electionGenerateVoteKey(str_area_id,str_tribe_id);
-    if(!vote_key)
+    int64_t *votes = ElectionVotesGet(election->votes, ELECTION_VOTE_KEY(area_id, tribe_id));
+    //The votes never go below 0
+    if(votes != NULL)
     {
-        free(str_area_id);
-        free(str_tribe_id);
-        return ELECTION_OUT_OF_MEMORY;
-    }
-    if(!mapContains(election->votes, vote_key))
-    {
-        free(vote_key);
-        free(str_area_id);
-        free(str_tribe_id);
-        return ELECTION_SUCCESS;
-    }
-    int new_votes = (stringToInt(mapGet(election->votes, vote_key)) - num_of_votes) <= 0?
-                     0 : (stringToInt(mapGet(election->votes, vote_key)) - num_of_votes);
-    char *str_new_votes = intToString(new_votes);
-    if(!str_new_votes)
-    {
-        free(vote_key);
-        free(str_area_id);
-        free(str_tribe_id);
-        return ELECTION_OUT_OF_MEMORY;
+        *votes -= *votes < num_of_votes ? *votes : num_of_votes;
     }
-    if(mapPut(election->votes, vote_key, str_new_votes) == MAP_OUT_OF_MEMORY)
-    {
-        free(vote_key);
-        free(str_area_id);
-        free(str_tribe_id);
-        free(str_new_votes);
-        return ELECTION_OUT_OF_MEMORY;
-    }
-    free(vote_key);
     free(str_area_id);
     free(str_tribe_id);
-    free(str_new_votes);
     return ELECTION_SUCCESS;
 }
 
@@ -625,7 +414,7 @@ ElectionResult electionSetTribeName (Election election, int tribe_id, const char
     {
         return ELECTION_OUT_OF_MEMORY;
     }
-    if(!mapContains(election->tribes, str_tribe_id))
+    if(!orderedMapContains(election->tribes, str_tribe_id))
     {
         free(str_tribe_id);
         return ELECTION_TRIBE_NOT_EXIST;
@@ -635,7 +424,7 @@ ElectionResult electionSetTribeName (Election election, int tribe_id, const char
         free(str_tribe_id);
         return ELECTION_INVALID_NAME;
     }
-    if(mapPut(election->tribes, str_tribe_id, tribe_name) == MAP_OUT_OF_MEMORY)
+    if(orderedMapPut(election->tribes, str_tribe_id, tribe_name) == MAP_OUT_OF_MEMORY)
     {
         free(str_tribe_id);
         return ELECTION_OUT_OF_MEMORY;
@@ -660,28 +449,17 @@ ElectionResult electionRemoveTribe(Election election, int tribe_id)
     {
         return ELECTION_OUT_OF_MEMORY;
     }
-    if (!mapContains(election->tribes, tribe_char_id))
+    if (!orderedMapContains(election->tribes, tribe_char_id))
     {
         free(tribe_char_id);
         return ELECTION_TRIBE_NOT_EXIST;
     }
-    char** remove_votes = malloc(ELECTION_INITIAL_SIZE*sizeof(*remove_votes));
-    if (remove_votes == NULL)
+    if(ElectionVotesRemoveIf(election->votes, electionIsVoteOfTribe, &tribe_id) != MAP_SUCCESS)
     {
         free(tribe_char_id);
         return ELECTION_OUT_OF_MEMORY;
     }
-    int counter = 0, elements_number = ELECTION_INITIAL_SIZE;
-    if(electionGetVoteListByTribe(election,tribe_char_id,&remove_votes, &elements_number, &counter) != ELECTION_SUCCESS)
-    {
-        FREE_ARRAY(remove_votes, counter);
-        mapRemove(election->tribes, tribe_char_id);
-        free(tribe_char_id);
-        return ELECTION_OUT_OF_MEMORY;
-    }
-    REPEATED_MAP_REMOVE(election->votes, remove_votes, counter);
-    FREE_ARRAY(remove_votes, counter);
-    mapRemove(election->tribes, tribe_char_id);
+    orderedMapRemove(election->tribes, tribe_char_id);
     free(tribe_char_id);
     return ELECTION_SUCCESS;
 }
@@ -692,67 +470,29 @@ ElectionResult electionRemoveAreas(Election election, AreaConditionFunction shou
     {
         return ELECTION_NULL_ARGUMENT;
     }
-    char **votes_to_remove = malloc(ELECTION_INITIAL_SIZE * sizeof(*votes_to_remove));
-    char **areas_to_remove = malloc(ELECTION_INITIAL_SIZE * sizeof(*areas_to_remove));
-    if(areas_to_remove == NULL || votes_to_remove == NULL)
+    //The votes of the removed areas are the ones whose area is gone afterwards
+    if(mapRemoveIf(election->areas, electionIsAreaToRemove, &should_delete_area) != MAP_SUCCESS ||
+       ElectionVotesRemoveIf(election->votes, electionIsVoteOfRemovedArea, election->areas) != MAP_SUCCESS)
     {
-        free(areas_to_remove);
-        free(votes_to_remove);
         return ELECTION_OUT_OF_MEMORY;
     }
-    int votes_counter = 0, areas_counter = 0, votes_element_number = ELECTION_INITIAL_SIZE,
-        areas_element_number = ELECTION_INITIAL_SIZE;
-    MAP_FOREACH(area, election->areas)
-    {
-        if(should_delete_area(stringToInt(area)))
-        {
-            if(electionGetVoteListByArea(election, area, &votes_to_remove, &votes_element_number, &votes_counter)
-            != ELECTION_SUCCESS)
-            {
-                free(areas_to_remove);
-                free(votes_to_remove);
-                return ELECTION_OUT_OF_MEMORY;
-            }
-            if(areas_counter >= areas_element_number) //Checks to see if it goes out-of-bounds
-            {
-                // char **tmp_ptr = realloc(areas_to_remove, (areas_element_number * sizeof(*areas_to_remove)) * ELECTION_RESIZE_FACTOR);
-                char **tmp_ptr = expand(areas_to_remove, areas_element_number * sizeof(*areas_to_remove));
-                areas_element_number *= ELECTION_RESIZE_FACTOR;
-                if(tmp_ptr == NULL)
-                {
-                    free(areas_to_remove);
-                    free(votes_to_remove);
-                    return ELECTION_OUT_OF_MEMORY;
-                }
-                areas_to_remove = tmp_ptr;
-            }
-            areas_to_remove[areas_counter++] = area;
-        }
-    }
-    REPEATED_MAP_REMOVE(election->areas, areas_to_remove, areas_counter);
-    REPEATED_MAP_REMOVE(election->votes, votes_to_remove, votes_counter);
-    free(areas_to_remove);
-    free(votes_to_remove);
     return ELECTION_SUCCESS;
 }
 
 Map electionComputeAreasToTribesMapping (Election election)
 {
-    Map statistics = mapCreate();
+    Map statistics = mapCreateInterned();
     if(statistics == NULL)
     {
         return NULL;
     }
     const char *max_ptr = NULL;
-    MAP_FOREACH(area, election->areas)
+    MAP_CURSOR_FOREACH(area, areas_cursor, election->areas)
     {
         max_ptr = electionGetChosenTribeByArea(election, area);
-        if(max_ptr == NULL)
-        {
-            return NULL;
-        }
-        if(mapPut(statistics, area, max_ptr) != MAP_SUCCESS)
+        if(max_ptr == NULL || mapPut(statistics, area, max_ptr) != MAP_SUCCESS)
         {
+            mapCursorRelease(&areas_cursor);
             mapDestroy(statistics);
             return NULL;
         }
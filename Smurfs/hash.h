@@ -0,0 +1,64 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+* String Hashing
+*
+* The FNV-1a hash shared by the containers, so a string hashes the same in
+* every one of them.
+*
+* The following functions are available:
+*   hashBytes		- Adds bytes to an FNV-1a hash.
+*   hashString		- Returns the mixed FNV-1a hash of a string.
+*
+* They are static inline, so the hash of a key is computed where it is looked
+* up, without a call.
+*/
+
+/** FNV-1a parameters: the hash of no bytes, and the prime every byte is multiplied by */
+#define HASH_OFFSET_BASIS 2166136261u
+#define HASH_PRIME 16777619u
+
+/**
+ * @param hash - HASH_OFFSET_BASIS, or the hash of the bytes before these.
+ * @param bytes - The bytes to add.
+ * @param size - The number of bytes.
+ * @return
+ * The FNV-1a hash of the bytes, continued from @param hash. It is not mixed, so
+ * it is meant for checksums, not for picking a slot.
+ */
+static inline uint32_t hashBytes(uint32_t hash, const void* bytes, size_t size)
+{
+    const unsigned char* byte = bytes;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= byte[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @param string - The string to hash (not NULL).
+ * @return
+ * The FNV-1a hash of the string, with a final mix so the low bits
+ * (used to pick a slot) depend on every character.
+ */
+static inline unsigned int hashString(const char* string)
+{
+    uint32_t hash = HASH_OFFSET_BASIS;
+    while (*string)
+    {
+        hash ^= (unsigned char)*string++;
+        hash *= HASH_PRIME;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+#endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define MAP_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 /**
 * Map Container
@@ -14,6 +15,29 @@
 *
 * The following functions are available:
 *   mapCreate		- Creates a new empty map
+*   mapCreateWithCapacity	- Creates a new empty map with room for a given
+*   				  number of elements
+*   mapCreateArena	- Creates a new empty map which allocates its elements
+*   				  from big chunks, so clearing and destroying it are cheap
+*   mapCreateIncremental	- Creates a new empty map which grows its hash index
+*   				  a few slots at a time, so no single put moves all the keys
+*   mapCreateCompact	- Creates a new empty map which keeps all its elements
+*   				  in a few arrays, without an allocation per element
+*   mapCreateFromArrays	- Creates a compact map from arrays of key and data
+*   				  elements, sizing it once
+*   mapCreateWithAllocator	- Creates a new empty map which gets its memory
+*   				  from given functions instead of malloc
+*   mapCreateRadix	- Creates a new empty map which indexes its keys in a
+*   				  radix tree, so keys with a common prefix are found fast
+*   mapCreateCounters	- Creates a new empty map whose data elements are
+*   				  int64_t counters instead of strings
+*   mapCreateInterned	- Creates a new empty map which shares its key and data
+*   				  elements with other maps instead of copying them
+*   mapCreateConcurrent	- Creates a new empty map which many threads may
+*   				  use at the same time
+*   mapCreateConcurrentCounters	- Creates a new empty concurrent counters map
+*   mapCreateReadMostly	- Creates a new empty map which many threads may read
+*   				  without waiting, while one thread at a time changes it
 *   mapDestroy		- Deletes an existing map and frees all resources
 *   mapCopy		- Copies an existing map
 *   mapGetSize		- Returns the size of a given map
@@ -22,19 +46,157 @@
 *   				  If the key exists, the value is overridden.
 *   mapGet  	    - Returns the data paired to a key which matches the given key.
 *					  Iterator status unchanged
+*   mapPutInt		- Gives a key of a counters map a given value.
+*   mapGetInt		- Returns the value of a key of a counters map.
+*   mapIncrement	- Adds to the value of a key of a counters map, in place.
+*   mapFindOrInsert	- Finds a key, adding it if it is missing, and returns
+*   				  an entry through which its value is read and replaced
+*   				  without searching again.
+*   mapEntryGetKey	- Returns the key element of an entry.
+*   mapEntryGetValue	- Returns the data element of an entry.
+*   mapEntrySetValue	- Replaces the data element of an entry.
+*   mapEntryGetInt	- Returns the counter of an entry of a counters map.
+*   mapEntrySetInt	- Replaces the counter of an entry of a counters map.
 *   mapRemove		- Removes a pair of (key,data) elements for which the key
 *                    matches a given element (using the strcmp function).
+*   mapRemoveIf	- Removes all the pairs for which a given predicate holds,
+*   				  in a single pass.
+*   mapForEachPrefix	- Calls a function for all the pairs whose key starts
+*   				  with a given prefix.
+*   mapPutBatch	- Puts an array of pairs, growing the map at most once.
+*   mapRemoveBatch	- Removes an array of keys.
 *   mapGetFirst	- Sets the internal iterator to the first key in the
 *   				  map, and returns it.
 *   mapGetNext		- Advances the internal iterator to the next key and
 *   				  returns it.
 *	 mapClear		- Clears the contents of the map. Frees all the elements of
 *	 				  the map using the free function.
+*   mapShrinkToFit	- Frees the room the map holds beyond its elements.
+*   mapEnableFilter	- Adds a Bloom filter to a map, which answers most
+*   				  searches for missing keys without searching the map.
+*   mapMemoryUsage	- Returns the bytes the map uses, and where they go.
+*   mapSave		- Writes the map to a file, in a form mapOpenMapped can use as is.
+*   mapOpenMapped	- Opens a file written by mapSave as a read-only map.
+*   mapFreeze		- Creates a read-only copy of a map, indexed by a minimal
+*   				  perfect hash.
+*   mapOpenJournaled	- Opens a map whose changes are logged to a file, so
+*   				  they survive a crash.
+*   mapSync		- Makes all the changes of a journaled map durable.
+*   mapGetStats	- Returns the counts of a map's lookups and growth (only
+*   				  when compiled with MAP_ENABLE_STATS).
 * 	 MAP_FOREACH	- A macro for iterating over the map's elements.
+*   mapCursorCreate	- Creates an external cursor over all the keys of a map.
+*   mapCursorCreateRange - Creates an external cursor over one of several
+*   				  disjoint parts of a map.
+*   mapCursorNext	- Advances a cursor and returns its key.
+*   mapCursorGetValue	- Returns the data paired to the cursor's current key.
+*   mapCursorGetInt	- Returns the counter paired to the cursor's current key.
+*   mapCursorRelease	- Ends the walk of a cursor before it reached its end.
+* 	 MAP_CURSOR_FOREACH	- A macro for iterating over the map's elements with a cursor.
+*
+* Cursors are independent of the internal iterator and of each other, and
+* reading through them does not change the map, so any number of cursors
+* (for example in different threads, or in nested loops) may walk the same map
+* as long as nobody changes it. A cursor over a read-mostly map may be walked
+* while the map changes, and keeps the version it walks until it reaches its end
+* or is given to mapCursorRelease.
 */
+
 /** Type for defining the map */
 typedef struct Map_t* Map;
 
+/**
+ * Type of an external cursor. It is meant to be kept on the stack, and its
+ * fields are private to the map.
+ */
+typedef struct MapCursor_t {
+    Map map;
+    int next;
+    int end;
+    int current;
+    int stripe;
+    int offset;
+    bool pinned;
+} MapCursor;
+
+/**
+ * Type of an entry of a map, as returned by mapFindOrInsert. It is meant to be
+ * kept on the stack, and its fields are private to the map.
+ */
+typedef struct MapEntry_t {
+    Map map;
+    int position;
+} MapEntry;
+
+/**
+ * Type of a predicate for mapRemoveIf. It gets a key element, its data
+ * element and the context given to mapRemoveIf, and returns true if the pair
+ * should be removed. It must not change the map.
+ */
+typedef bool (*MapPredicate)(const char* key, const char* data, void* context);
+
+/**
+ * Type of a visitor for mapForEachPrefix. It gets a key element, its data
+ * element and the context given to mapForEachPrefix, and returns false to stop
+ * the walk. It must not change the map.
+ */
+typedef bool (*MapVisitor)(const char* key, const char* data, void* context);
+
+/**
+ * The bytes a map uses, as returned by mapMemoryUsage. Elements shared with
+ * copies of the map are counted by every map which shares them.
+ */
+typedef struct MapMemoryUsage_t {
+    size_t table;  //The map itself and the table which holds its key elements
+    size_t index;  //The hash index (only maps with more than a few dozen elements have one)
+    size_t keys;   //The key elements, with their bookkeeping
+    size_t values; //The data elements, including the room kept for them to grow
+    size_t arena;  //The chunks of an arena map (which hold its keys and values), used or not
+} MapMemoryUsage;
+
+/**
+ * The group commit settings of a journaled map (see mapOpenJournaled).
+ */
+typedef struct MapJournalOptions_t {
+    int batch;            //The log is synced once this many changes wait for it (1 syncs every change)
+    int delay_ms;         //...and at most this many milliseconds after a change (0 for only by 'batch')
+    size_t compact_bytes; //The log is compacted into the snapshot once it grows past this size (0 for never)
+} MapJournalOptions;
+
+/**
+ * The functions a map gets its memory from (see mapCreateWithAllocator). Each
+ * gets 'context' first. 'reallocate' and 'release' also get the size the block
+ * was allocated (or last reallocated) with, so the allocator does not need to
+ * remember it.
+ */
+typedef struct MapAllocator_t {
+    void* (*allocate)(void* context, size_t size);                                   //NULL if out of memory
+    void* (*reallocate)(void* context, void* block, size_t old_size, size_t new_size); //NULL (block kept) if out of memory
+    void (*release)(void* context, void* block, size_t size);
+    void* context;
+} MapAllocator;
+
+#ifdef MAP_ENABLE_STATS
+/**
+ * The counts of a map, as returned by mapGetStats. They exist only when the
+ * map library (and the code which uses them) is compiled with MAP_ENABLE_STATS;
+ * otherwise the map keeps no counts at all.
+ */
+typedef struct MapStats_t {
+    uint64_t lookups;                //Searches for a key, by any function (a put or a remove also searches)
+    uint64_t hits;                   //Searches which found the key
+    uint64_t misses;                 //Searches which did not
+    uint64_t comparisons;            //Key elements compared with the wanted key (strcmp calls)
+    uint64_t probes;                 //Slots of the hash index visited (small maps have no index)
+    uint64_t longest_probe;          //The most slots one search visited
+    uint64_t expansions;             //Times the table, a page of elements, the index or the filter grew
+    uint64_t bytes_reallocated;      //Bytes allocated to grow those, or to copy them from a copy of the map
+    uint64_t key_allocations;        //Key elements created
+    uint64_t filter_rejections;      //Misses the Bloom filter answered alone (see mapEnableFilter)
+    uint64_t filter_false_positives; //Misses the filter let through to a search of the map
+} MapStats;
+#endif
+
 /** Type used for returning error codes from map functions */
 typedef enum MapResult_t {
     MAP_SUCCESS,
@@ -54,6 +216,223 @@ typedef enum MapResult_t {
 */
 Map mapCreate();
 
+/**
+* mapCreateWithCapacity: Allocates a new empty map with room for 'capacity'
+* elements, so putting that many elements does not grow it.
+* (mapCreate allocates nothing until the first element is put.)
+*
+* @param capacity - The expected number of elements.
+* @return
+* 	NULL - if capacity is negative or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateWithCapacity(int capacity);
+
+/**
+* mapCreateCounters: Allocates a new empty map whose data elements are int64_t
+* counters. They are set and read with mapPutInt, mapGetInt, mapIncrement and
+* mapCursorGetInt, without formatting or parsing any string. On such a map
+* mapPut returns MAP_ERROR, mapGet and mapCursorGetValue return NULL, and
+* mapRemoveIf passes NULL as the data element. All the other functions work
+* as on any map.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateCounters();
+
+/**
+* mapCreateInterned: Allocates a new empty map whose key and data elements are
+* interned: every distinct string is kept once, in a pool shared by all the
+* interned maps of the program, and the map only holds references to it. Maps
+* which keep the same short strings (IDs, names) then keep a single copy of
+* them. Looking up a key element taken from an interned map (for example by
+* mapGetFirst or a cursor) compares pointers instead of characters.
+* All the functions work as on any map, except that the elements returned by
+* mapGet, the iterator and cursors are the pooled copies, which must not be
+* changed. mapMemoryUsage does not count the pool (see internGetMemoryUsage).
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateInterned();
+
+/**
+* mapCreateConcurrent: Allocates a new empty map which any number of threads
+* may use at the same time. The keys are split between 'stripes' independently
+* locked parts: reads of a part take a shared lock and changes take an
+* exclusive one, so operations on keys of different parts never wait for each
+* other. More stripes than threads keep the waiting low.
+* All the functions work as on any map, with these differences:
+* - The data element returned by mapGet is valid only while no other thread
+*   changes or removes its key.
+* - mapIncrement adds to an existing counter under the shared lock.
+* - The internal iterator and cursors should be used only while no other thread
+*   changes the map. mapGetSize, mapMemoryUsage, mapCopy and the functions
+*   which work on the whole map lock one part at a time, so they see each part
+*   at a different moment.
+*
+* @param stripes - The number of parts, at least 1.
+* @return
+* 	NULL - if stripes is not positive or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateConcurrent(int stripes);
+
+/**
+* mapCreateConcurrentCounters: Allocates a new empty map which is both a
+* counters map (see mapCreateCounters) and a concurrent map (see
+* mapCreateConcurrent), for counting from many threads.
+*
+* @param stripes - The number of parts, at least 1.
+* @return
+* 	NULL - if stripes is not positive or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateConcurrentCounters(int stripes);
+
+/**
+* mapCreateReadMostly: Allocates a new empty map for many threads which read
+* it often and change it rarely. Readers never wait and never write to memory
+* which other readers use: mapGet, mapContains and mapGetSize take no lock and
+* no atomic read-modify-write operation. A change is made on a copy of the map (which shares
+* every part the change does not touch), and the copy then replaces the map
+* for the readers which come after it. The replaced version is freed only once
+* every reader which could still see it finished.
+* All the functions work as on any map, with these differences:
+* - Changes take a lock, so one thread at a time changes the map, and each of
+*   them copies the part of the map it changes: the pages of the keys it
+*   changes, the chunks of 1024 slots of the hash index it writes to, and the
+*   table of pages (a pointer for every 64 keys, which is the part of a change
+*   that still grows with the map). Batches and mapRemoveIf are made visible
+*   at once, and a failed change leaves the map as it was.
+* - The data element returned by mapGet is valid only while no other thread
+*   changes or removes its key.
+* - The internal iterator and cursors walk the version of the map of the time
+*   they started, even while the map changes (in this thread or another), and
+*   keep that version from being freed until they reach their end. A cursor
+*   which stops earlier must be given to mapCursorRelease.
+* - It cannot be a counters map.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateReadMostly();
+
+/**
+* mapCreateArena: Allocates a new empty map whose key and data elements are
+* allocated from big chunks owned by the map.
+* mapClear only resets the chunks and mapDestroy frees just the chunks, no
+* matter how many elements the map holds. The memory of removed or
+* overridden elements is reused only after mapClear, so this mode suits
+* maps which are mostly filled and then cleared or destroyed as a whole.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateArena();
+
+/**
+* mapCreateIncremental: Allocates a new empty map which grows its hash index
+* incrementally. A map grows its index by moving all its keys to a bigger one,
+* which makes a single mapPut slow once the map is big. This map allocates the
+* bigger index early instead, and each of the next puts of new keys first
+* prepares a few slots of it, then moves the keys of a few slots of the old
+* index, while lookups check both indexes.
+* Other changes that need the whole index (mapRemoveIf, mapShrinkToFit,
+* mapPutBatch...) finish the growth first. Copies of the map are incremental
+* too.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateIncremental();
+
+/**
+* mapCreateCompact: Allocates a new empty map which keeps its key and data
+* elements in one growing buffer of strings, and their hashes and places in
+* three arrays, instead of allocating each element on its own.
+* Finding a key reads the array of hashes and then the buffer, and walking the
+* map reads the buffer in order, which suits maps of many short elements.
+* Removed or overridden elements become garbage in the buffer, which is
+* dropped the next time the buffer grows (or on mapShrinkToFit). mapCopy copies
+* the arrays and the buffer.
+* A pointer returned by mapGet, mapGetFirst, mapGetNext or a cursor of a
+* compact map is valid only until the map is changed. The buffer holds at most
+* 4GB of strings.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateCompact();
+
+/** A flag of mapCreateFromArrays: the caller promises the keys are distinct, so they are not compared */
+#define MAP_ARRAYS_UNIQUE_KEYS 1u
+
+/**
+* mapCreateFromArrays: Allocates a new map (a compact map, as created by
+* mapCreateCompact) with the pairs keys[i], values[i], as if they were put in
+* order with mapPut: a key which appears more than once gets its last data
+* element, at the position of its first appearance. Unlike count calls to
+* mapPut, the arrays and the hash index are sized once, and all the elements
+* are copied into one buffer of exactly their size. The keys are hashed once,
+* and duplicates are found while the index is filled; with
+* MAP_ARRAYS_UNIQUE_KEYS they are not looked for at all, and the map is
+* undefined if there are any.
+*
+* @param keys - The key elements.
+* @param values - The data elements, one for each key element.
+* @param count - The number of pairs.
+* @param flags - 0, or MAP_ARRAYS_UNIQUE_KEYS.
+* @return
+* 	NULL - if a NULL was sent (as an array or an element of one), count is
+* 	negative, an allocation failed, or the elements take more than 4GB.
+* 	A new Map in case of success.
+*/
+Map mapCreateFromArrays(const char* const* keys, const char* const* values, int count, unsigned int flags);
+
+/**
+* mapCreateWithAllocator: Allocates a new empty map whose memory comes from
+* the functions of 'allocator' instead of malloc, realloc and free: the map
+* itself, its key and data elements, and the table and the hash index which
+* hold them. A pool of blocks of the sizes the map asks for (see pool.h) makes
+* puts and removes of short elements cheaper than malloc does.
+* The functions are copied, but they and their context must stay valid until
+* the map and all its copies (which use the same allocator) are destroyed.
+* They are called by whichever thread changes or destroys the map or one of
+* its copies, so an allocator which is not thread safe (such as a pool) suits a
+* map and copies used by a single thread.
+*
+* @param allocator - The functions to allocate with (none of them may be NULL)
+* @return
+* 	NULL - if 'allocator' is NULL or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateWithAllocator(const MapAllocator* allocator);
+
+/**
+* mapCreateRadix: Allocates a new empty map whose index is a compressed radix
+* tree of its keys, instead of a hash index. Finding a key costs O(its length)
+* byte comparisons rather than a hash and a strcmp, and mapForEachPrefix visits
+* the keys which start with a prefix in O(the prefix's length + the keys
+* found), in strcmp order, instead of comparing every key of the map.
+* The tree holds a copy of every key element (but of common prefixes only
+* once), and copies of the map share it until one of them changes. A lookup
+* visits a node per level of the tree, which makes single lookups of a big map
+* slower than with a hash index: this map suits maps searched by prefix.
+*
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateRadix();
+
 /**
 * mapDestroy: Deallocates an existing map. Clears all elements.
 *
@@ -64,6 +443,12 @@ void mapDestroy(Map map);
 
 /**
 * mapCopy: Creates a copy of target map.
+* The copy shares the elements of the map, and a page of elements (or a chunk
+* of the hash index) is only copied when one of the maps changes it, so copying
+* takes constant time. The first change to either map copies the table of its
+* pages, which has a pointer for every 64 elements.
+* A copy may be read by another thread while the original keeps changing.
+* The data returned by mapGet must not be changed in place once a map was copied.
 * Iterator values for both maps is undefined after this operation.
 *
 * @param map - Target map.
@@ -124,6 +509,141 @@ we want to get.
 * 	A pointer to the data element associated with the key otherwise.
 */
 char* mapGet(Map map, const char* key);
+
+/**
+*	mapPutInt: Gives a key of a counters map a value. If the key does not exist
+*	it is added.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The counters map.
+* @param key - The key element.
+* @param value - The new value of the key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or key
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_OUT_OF_MEMORY if an allocation failed
+* 	MAP_SUCCESS the value had been set successfully
+*/
+MapResult mapPutInt(Map map, const char* key, int64_t value);
+
+/**
+*	mapGetInt: Returns the value of a key of a counters map.
+*	Iterator status unchanged
+*
+* @param map - The counters map.
+* @param key - The key element.
+* @param value - Set to the value of the key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_ITEM_DOES_NOT_EXIST if the map does not contain the key
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapGetInt(Map map, const char* key, int64_t* value);
+
+/**
+*	mapIncrement: Adds delta to the value of a key of a counters map, in place.
+*	A key which does not exist is added with the value delta (as if it was 0).
+*	The addition to an existing key is done atomically on the counter, so on a
+*	concurrent map many threads may add to the same key without losing updates.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The counters map.
+* @param key - The key element.
+* @param delta - The number to add (may be negative).
+* @param new_value - Set to the value after the addition. May be NULL.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or key
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_OUT_OF_MEMORY if an allocation failed
+* 	MAP_SUCCESS the value had been changed successfully
+*/
+MapResult mapIncrement(Map map, const char* key, int64_t delta, int64_t* new_value);
+
+/**
+*	mapFindOrInsert: Finds a key element, adding it if the map does not have
+*	it, with an empty data element ("") or, in a counters map, the value 0.
+*	The entry it returns reads and replaces the key's data element without
+*	searching for the key again, so a read-modify-write of a key hashes it and
+*	searches for it once. The entry stays valid until the map is changed by
+*	anything but the mapEntry functions (which may also be called on several
+*	entries of the map at once).
+*	Concurrent, read-mostly, journaled and read-only maps are not changed in
+*	place, so they have no entries.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The map.
+* @param key - The key element.
+* @param inserted - Set to true if the key was added, false otherwise (unless a
+* 	NULL was sent).
+* @return
+* 	An entry for which mapEntryGetKey returns NULL if a NULL was sent, the map
+* 	has no entries, or an allocation failed.
+* 	The entry of the key otherwise.
+*/
+MapEntry mapFindOrInsert(Map map, const char* key, bool* inserted);
+
+/**
+*	mapEntryGetKey: Returns the key element (not a copy) of an entry.
+*
+* @param entry - An entry returned by mapFindOrInsert.
+* @return
+* 	NULL if a NULL was sent or mapFindOrInsert failed.
+* 	The key element of the entry otherwise.
+*/
+char* mapEntryGetKey(const MapEntry* entry);
+
+/**
+*	mapEntryGetValue: Returns the data element (not a copy) of an entry.
+*	The data element is valid until the map is changed (through any entry too).
+*
+* @param entry - An entry returned by mapFindOrInsert.
+* @return
+* 	NULL if a NULL was sent, mapFindOrInsert failed, or the map is a counters map.
+* 	The data element of the entry otherwise.
+*/
+char* mapEntryGetValue(const MapEntry* entry);
+
+/**
+*	mapEntrySetValue: Replaces the data element of an entry with a copy of
+*	data, as mapPut would, without searching for the key.
+*
+* @param entry - An entry returned by mapFindOrInsert.
+* @param data - The new data element.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent, or mapFindOrInsert failed
+* 	MAP_ERROR if the map is a counters map
+* 	MAP_OUT_OF_MEMORY if an allocation failed (the old data element is kept)
+* 	MAP_SUCCESS the data element had been replaced successfully
+*/
+MapResult mapEntrySetValue(const MapEntry* entry, const char* data);
+
+/**
+*	mapEntryGetInt: Returns the counter of an entry of a counters map.
+*
+* @param entry - An entry returned by mapFindOrInsert.
+* @param value - Set to the counter of the entry.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent, or mapFindOrInsert failed
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapEntryGetInt(const MapEntry* entry, int64_t* value);
+
+/**
+*	mapEntrySetInt: Replaces the counter of an entry of a counters map, as
+*	mapPutInt would, without searching for the key.
+*
+* @param entry - An entry returned by mapFindOrInsert.
+* @param value - The new counter.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent, or mapFindOrInsert failed
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_OUT_OF_MEMORY if an allocation failed
+* 	MAP_SUCCESS the counter had been replaced successfully
+*/
+MapResult mapEntrySetInt(const MapEntry* entry, int64_t value);
+
 /**
 * 	mapRemove: Removes a pair of key and data elements from the map. The elements
 *  are found using the comparison function strcmp. Once found,
@@ -138,10 +658,88 @@ char* mapGet(Map map, const char* key);
 * @return
 * 	MAP_NULL_ARGUMENT if a NULL was sent to the function
 *  MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in the map
+*  MAP_OUT_OF_MEMORY if the map shared the elements with a copy and copying them failed
 * 	MAP_SUCCESS the paired elements had been removed successfully
 */
 MapResult mapRemove(Map map, const char* key);
 
+/**
+*	mapRemoveIf: Removes all the pairs of key and data elements for which the
+*	predicate returns true, and deallocates them. The predicate is called once
+*	for every pair, and the remaining pairs are compacted in the same pass.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The map to remove the elements from.
+* @param predicate - Returns true for the pairs to remove.
+* @param context - Passed as is to every call of the predicate. May be NULL.
+* @return
+* 	MAP_NULL_ARGUMENT if map or predicate are NULL
+*  MAP_OUT_OF_MEMORY if the map shared the elements with a copy and copying them
+*  failed. The map is unchanged in that case.
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapRemoveIf(Map map, MapPredicate predicate, void* context);
+
+/**
+*	mapForEachPrefix: Calls the visitor for every pair whose key element starts
+*	with the prefix (every pair, for an empty prefix), until it returns false.
+*	A map created by mapCreateRadix finds these pairs in its tree and visits
+*	them in strcmp order of their keys. Other maps compare all their keys with
+*	the prefix, and visit the pairs in no particular order.
+*	Counters maps pass NULL as the data element.
+*	Iterator's value is unchanged.
+*
+* @param map - The map to search.
+* @param prefix - The prefix of the wanted keys.
+* @param visitor - Called for every pair found. It must not change the map.
+* @param context - Passed as is to every call of the visitor. May be NULL.
+* @return
+* 	MAP_NULL_ARGUMENT if map, prefix or visitor are NULL
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapForEachPrefix(Map map, const char* prefix, MapVisitor visitor, void* context);
+
+/**
+*	mapPutBatch: Gives each of the keys the data element in the same index, as
+*	mapPut would. The arguments are checked and the map is grown for all the
+*	pairs before any of them is put. A key which appears more than once gets the
+*	last of its data elements.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The map to put the pairs in.
+* @param keys - An array of count key elements.
+* @param data - An array of count data elements.
+* @param count - The number of pairs.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent (including in the arrays). Nothing is
+* 	put in that case.
+* 	MAP_ERROR if count is negative or the map is read-only. Nothing is put in
+* 	that case.
+* 	MAP_OUT_OF_MEMORY if an allocation failed. The pairs before the failing one
+* 	were put.
+* 	MAP_SUCCESS if all the pairs were put
+*/
+MapResult mapPutBatch(Map map, const char* const* keys, const char* const* data, int count);
+
+/**
+*	mapRemoveBatch: Removes the pairs of each of the keys, as mapRemove would.
+*	Keys which are not in the map are skipped.
+*	Iterator's value is undefined after this operation.
+*
+* @param map - The map to remove the elements from.
+* @param keys - An array of count key elements.
+* @param count - The number of keys.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent (including in the array). Nothing is
+* 	removed in that case.
+* 	MAP_ERROR if count is negative or the map is read-only. Nothing is removed
+* 	in that case.
+* 	MAP_OUT_OF_MEMORY if the map shared the elements with a copy and copying
+* 	them failed. The keys before the failing one were removed.
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapRemoveBatch(Map map, const char* const* keys, int count);
+
 /**
 *	mapGetFirst: Sets the internal iterator (also called current key element) to
 *	the first key element in the map. There doesn't need to be an internal order
@@ -169,6 +767,128 @@ char* mapGetFirst(Map map);
 char* mapGetNext(Map map);
 
 
+/**
+* mapSave: Writes the map to a file as a binary image: a hash index and the
+* elements, laid out so mapOpenMapped can look keys up in the file itself.
+* The image is written next to the file and then renamed over it, so maps
+* which have the old image open keep reading it. The map must not be changed
+* while it is saved. Iterator status undefined.
+*
+* @param map - The map to save (any kind of map).
+* @param path - The file to write.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_OUT_OF_MEMORY - if an allocation failed.
+* 	MAP_ERROR - if the file could not be written, or the map changed meanwhile.
+* 	The old file, if there was one, is unchanged in these cases.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapSave(Map map, const char* path);
+
+/**
+* mapOpenMapped: Opens a file written by mapSave as a read-only map, by
+* mapping it into memory. Only the header of the file is read: lookups go
+* straight to the mapped index and elements, which the system pages in when
+* they are first used, so opening takes the same time for any size of map.
+* The map is a counters map if the saved map was one. mapGetSize, mapContains,
+* mapGet, mapGetInt, mapCopy (which shares the file), the iterator, cursors
+* and mapSave work as on any map. The elements they return are in the read-only
+* mapping and must not be changed. All the functions which change a map return
+* MAP_ERROR.
+* Files written on a machine of another byte order, or by another version of
+* the map, are rejected.
+*
+* @param path - The file to open.
+* @return
+* 	NULL - if the file could not be opened or mapped, is not a map image, or
+* 	an allocation failed.
+* 	A new Map in case of success.
+*/
+Map mapOpenMapped(const char* path);
+
+/**
+* mapFreeze: Creates a read-only copy of a map, for a map which is done
+* changing but is still searched. The copy is an image, as written by mapSave,
+* built in memory: a single buffer which holds all the key and data elements,
+* and a minimal perfect hash of the keys (hash and displace, with a bucket per
+* 3 keys) instead of a hash index. The perfect hash gives every key its own
+* position, so finding a key costs one 32-bit displacement, one offset and a
+* single comparison, whether the key is there or not. Besides the bytes of
+* the elements (and their '\0's), the copy takes under 10 bytes per element.
+* The copy works like a map opened by mapOpenMapped: the functions which change
+* it return MAP_ERROR. mapSave writes its buffer as it is, so opening the file
+* with mapOpenMapped gives the frozen map back without building it again.
+* The map must not be changed while it is frozen, and it is unchanged.
+* Iterator status of the map undefined.
+*
+* @param map - The map to freeze (any kind of map).
+* @return
+* 	NULL - if a NULL was sent, an allocation failed, or no perfect hash was
+* 	found (which is all but impossible).
+* 	A new frozen Map in case of success.
+*/
+Map mapFreeze(Map map);
+
+/**
+* mapOpenJournaled: Opens a map whose contents survive a crash, kept in a
+* snapshot at 'path' (written by mapSave) and a log of the changes made since,
+* at 'path' with ".log" appended (and ".log.old" while it is compacted).
+* Opening reads the snapshot, replays the log and saves the result as the new
+* snapshot; a change which was only partly written to the log is dropped.
+* mapPut, mapRemove, mapRemoveIf, mapClear and the batches apply each change
+* in memory and append it to a buffer, which is written and synced in groups:
+* once 'batch' changes wait for it, by the call which makes the batch full, or
+* 'delay_ms' after the first of them, by a background thread. So a crash loses
+* at most the changes of the last group, and with a batch of 1 every change
+* is durable when it returns. Once the log grows past 'compact_bytes', a
+* background thread copies the map between two changes and saves the copy as
+* the new snapshot, while new changes go to a new log.
+* All the other functions work as on any map, and mapCopy returns an ordinary
+* map which is not journaled. Like most maps it should be used by one thread
+* at a time. It cannot be a counters map. mapDestroy syncs the changes which
+* are still buffered.
+* If a change could not be logged it returns MAP_ERROR although it was made in
+* memory (but a mapRemoveIf keeps the keys from the first removal it could not
+* log on), and the map takes no more changes: reopening it gives the durable state.
+*
+* @param path - The file of the snapshot. The log is created next to it.
+* @param options - The group commit settings, NULL for a batch of 64, a delay of
+* 	10 milliseconds and compaction past 64MB.
+* @return
+* 	NULL - if path is NULL, the snapshot or the log could not be read or
+* 	written, or an allocation failed.
+* 	A new Map in case of success.
+*/
+Map mapOpenJournaled(const char* path, const MapJournalOptions* options);
+
+/**
+* mapSync: Writes and syncs the changes of a journaled map which still wait
+* in its buffer. Does nothing for any other map.
+*
+* @param map - The map to sync.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_ERROR - if the log could not be written.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapSync(Map map);
+
+#ifdef MAP_ENABLE_STATS
+/**
+* mapGetStats: Returns the counts of a map since it was created (a copy starts
+* from zero). A concurrent map adds up the counts of its stripes. The counts of
+* a map used by many threads at once are only approximate.
+* Only available when compiled with MAP_ENABLE_STATS.
+*
+* @param map - The map to look at.
+* @param stats - Where to return the counts.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapGetStats(Map map, MapStats* stats);
+#endif
+
 /**
 * mapClear: Removes all key and data elements from target map.
 * The elements are deallocated.
@@ -180,6 +900,137 @@ char* mapGetNext(Map map);
 */
 MapResult mapClear(Map map);
 
+/**
+* mapShrinkToFit: Frees the room the map holds beyond its current elements,
+* for example after many elements were removed. Room shared with a copy of the
+* map, and the chunks of an arena map, are kept.
+*
+* @param map - Target map.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_OUT_OF_MEMORY - if a smaller hash index could not be allocated. The map
+* 	is unchanged but for the freed room in that case.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapShrinkToFit(Map map);
+
+/**
+* mapEnableFilter: Adds a blocked Bloom filter to the map, which every search
+* for a key checks first. The filter keeps 16 bits per key (about 2 bytes, and
+* up to twice as many right after it grows), split into blocks of one cache
+* line, and a key sets 8 bits of a single block. A key whose bits are not all
+* set is not in the map, so most searches for a missing key (a mapContains,
+* mapGet or mapRemove which finds nothing) read one cache line, instead of
+* probing the index and comparing keys. Searches for keys which are in the map
+* read that line on top of the search, so the filter suits maps which are
+* mostly searched for keys they do not have.
+* The filter is kept up to date by every change of the map: removed keys leave
+* their bits set, and the filter is rebuilt from the keys once there are too
+* many of those, or once it is too small for the map. Copies of the map share
+* it until one of them changes. With MAP_ENABLE_STATS, the share of the
+* searches for missing keys which the filter let through (its false positive
+* rate) is filter_false_positives / (filter_false_positives + filter_rejections),
+* as counted by mapGetStats. A journaled map loses its filter when it is
+* opened again.
+*
+* @param map - Target map. A map which already has a filter is unchanged.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_ERROR - if the map was opened by mapOpenMapped (it cannot change).
+* 	MAP_OUT_OF_MEMORY - if the filter could not be allocated. The map is
+* 	unchanged in that case (but for the stripes of a concurrent map which
+* 	already got their filters).
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapEnableFilter(Map map);
+
+/**
+* mapMemoryUsage: Returns the bytes the map uses (not counting the overhead of
+* malloc itself). Iterator status unchanged.
+*
+* @param map - Target map.
+* @param usage - Set to the bytes of each part of the map. May be NULL.
+* @return
+* 	0 if a NULL map was sent.
+* 	The total bytes otherwise. The keys and values of an arena map are counted
+* 	by their arena's chunks.
+*/
+size_t mapMemoryUsage(Map map, MapMemoryUsage* usage);
+
+/**
+*	mapCursorCreate: Creates a cursor over all the key elements of a map. The
+*	cursor is positioned before the first key element, so the first call to
+*	mapCursorNext returns it. The map and its internal iterator are unchanged.
+*
+* @param map - The map to walk.
+* @return
+* 	A cursor over the map. If map is NULL, a cursor which returns no keys.
+*/
+MapCursor mapCursorCreate(Map map);
+
+/**
+*	mapCursorCreateRange: Splits the key elements of a map into 'parts' disjoint
+*	parts of about the same size, and creates a cursor over part number 'part'.
+*	Cursors over all the parts together visit every key element exactly once, so
+*	each part can be walked by a different thread.
+*
+* @param map - The map to walk.
+* @param part - The part to walk, from 0 to parts - 1.
+* @param parts - The number of parts.
+* @return
+* 	A cursor over the part. If map is NULL or part is not between 0 and
+* 	parts - 1, a cursor which returns no keys.
+*/
+MapCursor mapCursorCreateRange(Map map, int part, int parts);
+
+/**
+*	mapCursorNext: Advances the cursor to the next key element and returns it.
+*	The result is undefined if the map was changed since the cursor was created
+*	(unless it is a read-mostly map). Once it returns NULL the cursor is released,
+*	as by mapCursorRelease.
+*
+* @param cursor - The cursor to advance.
+* @return
+* 	NULL if the cursor reached its end or a NULL was sent as argument.
+* 	The next key element otherwise.
+*/
+char* mapCursorNext(MapCursor* cursor);
+
+/**
+*	mapCursorGetValue: Returns the data element (not a copy) paired to the key
+*	element the cursor returned last, without searching for the key.
+*
+* @param cursor - The cursor.
+* @return
+* 	NULL if a NULL was sent, or mapCursorNext was not called or returned NULL.
+* 	The data element of the current key element otherwise.
+*/
+char* mapCursorGetValue(const MapCursor* cursor);
+
+/**
+*	mapCursorGetInt: Returns the value paired to the key element the cursor
+*	returned last, in a counters map.
+*
+* @param cursor - The cursor.
+* @param value - Set to the value of the current key element.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent, or mapCursorNext was not called or returned NULL.
+* 	MAP_ERROR if the map was not created by mapCreateCounters
+* 	MAP_SUCCESS otherwise
+*/
+MapResult mapCursorGetInt(const MapCursor* cursor, int64_t* value);
+
+/**
+*	mapCursorRelease: Ends the walk of a cursor, which then returns no more key
+*	elements. A cursor over a read-mostly map keeps the version of the map it
+*	walks from being freed, so a cursor which is left before mapCursorNext
+*	returned NULL (such as by a break out of MAP_CURSOR_FOREACH) must be
+*	released. Releasing a cursor again, or one which reached its end, does nothing.
+*
+* @param cursor - The cursor (if NULL nothing is done).
+*/
+void mapCursorRelease(MapCursor* cursor);
+
 /*!
 * Macro for iterating over a map.
 * Declares a new iterator for the loop.
@@ -188,4 +1039,18 @@ MapResult mapClear(Map map);
     for(char* iterator = (char*) mapGetFirst(map) ; \
         iterator ;\
         iterator = mapGetNext(map))
+
+/*!
+* Macro for iterating over a map with an external cursor, which leaves the map
+* and its internal iterator untouched (so it can be nested, or used by several
+* readers at once). Declares the cursor and the iterator for the loop.
+*/
+#define MAP_CURSOR_FOREACH(iterator, cursor, map) \
+    for(MapCursor cursor = mapCursorCreate(map), *cursor##_loop = &cursor ; \
+        cursor##_loop ; \
+        cursor##_loop = NULL) \
+        for(char* iterator = mapCursorNext(&cursor) ; \
+            iterator ; \
+            iterator = mapCursorNext(&cursor))
+
 #endif /* MAP_H_ */
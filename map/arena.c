@@ -0,0 +1,200 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/** Every block returned by the arena is aligned to this size */
+#define ARENA_ALIGNMENT 16
+
+/** Chunks stop doubling once they reach this size */
+#define ARENA_MAX_CHUNK_SIZE (16 * 1024 * 1024)
+
+/** The factor by which every new chunk is bigger than the previous one */
+#define ARENA_GROWTH_FACTOR 2
+
+/** Arenas may be shared by maps used from different threads, so their counts are atomic */
+#if defined(__GNUC__)
+#define ARENA_REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define ARENA_REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#define ARENA_REFCOUNT_LOAD(count) __atomic_load_n(&(count), __ATOMIC_ACQUIRE)
+#else
+#define ARENA_REFCOUNT_INCREMENT(count) (++(count))
+#define ARENA_REFCOUNT_DECREMENT(count) (--(count))
+#define ARENA_REFCOUNT_LOAD(count) (count)
+#endif
+
+//--------------------ARENA-STRUCT--------------------//
+typedef struct chunk_t
+{
+    struct chunk_t* next;
+    size_t size;
+    size_t used;
+    //Keeps 'data' aligned for any type
+    union
+    {
+        long double alignment_long_double;
+        void* alignment_pointer;
+        long long alignment_long_long;
+    } data[];
+} *Chunk;
+
+struct arena_t
+{
+    Chunk first;
+    Chunk current;
+    size_t next_chunk_size;
+    unsigned int refcount;
+    struct arena_t* kept; //An arena released together with this one, see 'arenaKeepAlive'
+};
+
+static Chunk arenaNewChunk(size_t size);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @param size - The number of usable bytes in the chunk
+ * @return
+ * NULL if the allocation failed, otherwise a new empty chunk.
+ */
+static Chunk arenaNewChunk(size_t size)
+{
+    Chunk chunk = malloc(sizeof(*chunk) + size);
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+//--------------------ARENA-FUNCTIONS--------------------//
+Arena arenaCreate(size_t chunk_size)
+{
+    Arena arena = malloc(sizeof(*arena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->next_chunk_size = chunk_size > 0 ? chunk_size : ARENA_ALIGNMENT;
+    arena->refcount = 1;
+    arena->kept = NULL;
+    return arena;
+}
+
+void arenaDestroy(Arena arena)
+{
+    if (arena == NULL || ARENA_REFCOUNT_DECREMENT(arena->refcount) > 0)
+    {
+        return;
+    }
+    arenaDestroy(arena->kept);
+    Chunk chunk = arena->first;
+    while (chunk != NULL)
+    {
+        Chunk next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void* arenaAllocate(Arena arena, size_t size)
+{
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    assert(!arenaIsShared(arena));
+    size = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    //Chunks kept by 'arenaReset' are reused before new ones are allocated
+    while (arena->current != NULL && arena->current->used + size > arena->current->size &&
+           arena->current->next != NULL)
+    {
+        arena->current = arena->current->next;
+        arena->current->used = 0;
+    }
+    if (arena->current == NULL || arena->current->used + size > arena->current->size)
+    {
+        size_t chunk_size = arena->next_chunk_size > size ? arena->next_chunk_size : size;
+        Chunk chunk = arenaNewChunk(chunk_size);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+        if (arena->current == NULL)
+        {
+            arena->first = chunk;
+        }
+        else
+        {
+            assert(arena->current->next == NULL);
+            arena->current->next = chunk;
+        }
+        arena->current = chunk;
+        if (arena->next_chunk_size < ARENA_MAX_CHUNK_SIZE)
+        {
+            arena->next_chunk_size *= ARENA_GROWTH_FACTOR;
+        }
+    }
+    void* block = (char*)arena->current->data + arena->current->used;
+    arena->current->used += size;
+    return block;
+}
+
+void arenaReset(Arena arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+    assert(!arenaIsShared(arena));
+    arenaDestroy(arena->kept);
+    arena->kept = NULL;
+    if (arena->first == NULL)
+    {
+        return;
+    }
+    arena->current = arena->first;
+    arena->current->used = 0;
+}
+
+Arena arenaShare(Arena arena)
+{
+    if (arena != NULL)
+    {
+        ARENA_REFCOUNT_INCREMENT(arena->refcount);
+    }
+    return arena;
+}
+
+bool arenaIsShared(Arena arena)
+{
+    return arena != NULL && ARENA_REFCOUNT_LOAD(arena->refcount) > 1;
+}
+
+size_t arenaGetSize(Arena arena)
+{
+    size_t size = 0;
+    for (; arena != NULL; arena = arena->kept)
+    {
+        size += sizeof(*arena);
+        for (Chunk chunk = arena->first; chunk != NULL; chunk = chunk->next)
+        {
+            size += sizeof(*chunk) + chunk->size;
+        }
+    }
+    return size;
+}
+
+void arenaKeepAlive(Arena arena, Arena kept)
+{
+    if (arena == NULL)
+    {
+        arenaDestroy(kept);
+        return;
+    }
+    assert(arena->kept == NULL);
+    arena->kept = kept;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+* Arena Allocator
+*
+* Implements a bump allocator over a list of big chunks.
+* Single allocations cannot be freed, all of the memory is released at once.
+*
+* The following functions are available:
+*   arenaCreate		- Creates a new empty arena
+*   arenaDestroy	- Frees all the chunks of an arena
+*   arenaAllocate	- Allocates a block of memory from the arena
+*   arenaReset		- Makes all the memory of the arena available again in O(1),
+*					  the chunks are kept for reuse.
+*   arenaShare		- Adds an owner to an arena.
+*   arenaIsShared	- Returns whether an arena has more than one owner.
+*   arenaKeepAlive	- Makes an arena own another one until it is destroyed.
+*   arenaGetSize	- Returns the bytes an arena holds.
+*
+* An arena is reference counted: arenaCreate gives it a single owner,
+* arenaShare adds one and arenaDestroy removes one (the chunks are freed with
+* the last one). The count is atomic, but allocating and resetting are not, so
+* only an arena which is not shared should be allocated from or reset.
+*/
+
+typedef struct arena_t *Arena;
+
+/**
+ * @param chunk_size - The size of the first chunk. Every following chunk is
+ *      twice as big as the previous one (up to a limit).
+ * @return
+ * NULL - if the allocation failed.
+ * A new empty arena otherwise.
+ */
+Arena arenaCreate(size_t chunk_size);
+
+/**
+ * @param arena - The arena to release. Once its last owner released it, it is
+ *      freed with all of its chunks. If NULL nothing is done.
+ */
+void arenaDestroy(Arena arena);
+
+/**
+ * @param arena - The arena to allocate from.
+ * @param size - The number of bytes needed.
+ * @return
+ * NULL - if a NULL was sent or a new chunk could not be allocated.
+ * Otherwise a pointer to a block of at least size bytes, aligned for any type.
+ * The block stays valid until the arena is reset or destroyed.
+ */
+void* arenaAllocate(Arena arena, size_t size);
+
+/**
+ * @param arena - The arena to reset. All the blocks allocated from it become
+ *      invalid, and the arenas it kept alive are released.
+ */
+void arenaReset(Arena arena);
+
+/**
+ * @param arena - The arena to share.
+ * @return
+ * The same arena, which now has one more owner (NULL if @param arena is NULL).
+ */
+Arena arenaShare(Arena arena);
+
+/**
+ * @param arena - The arena to check.
+ * @return
+ * true if the arena has more than one owner.
+ */
+bool arenaIsShared(Arena arena);
+
+/**
+ * @param arena - The arena to measure.
+ * @return
+ * The bytes of all the chunks of the arena and of the arenas it keeps alive
+ * (used or not), 0 if @param arena is NULL.
+ */
+size_t arenaGetSize(Arena arena);
+
+/**
+ * Passes one owner of 'kept' to 'arena': 'kept' is released when 'arena' is
+ * freed or reset. Used for starting a new arena while blocks of an older,
+ * shared one are still in use.
+ * @param arena - The arena which becomes an owner. It must not keep another arena alive.
+ * @param kept - The arena to keep alive (the caller gives up its ownership).
+ */
+void arenaKeepAlive(Arena arena, Arena kept);
+
+#endif
\ No newline at end of file
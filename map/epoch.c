@@ -0,0 +1,215 @@
+#define _DEFAULT_SOURCE
+#include "epoch.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/** The epoch of a thread which is not reading (the global epoch starts after it) */
+#define EPOCH_IDLE 0
+
+/**
+ * Readers only load and store whole words, which are plain moves on the usual
+ * processors. Writers use real atomic operations.
+ */
+#if defined(__GNUC__)
+#define EPOCH_LOAD(variable) __atomic_load_n(&(variable), __ATOMIC_RELAXED)
+#define EPOCH_LOAD_ACQUIRE(variable) __atomic_load_n(&(variable), __ATOMIC_ACQUIRE)
+#define EPOCH_STORE(variable, value) __atomic_store_n(&(variable), value, __ATOMIC_RELAXED)
+#define EPOCH_STORE_RELEASE(variable, value) __atomic_store_n(&(variable), value, __ATOMIC_RELEASE)
+#define EPOCH_INCREMENT(variable) __atomic_add_fetch(&(variable), 1, __ATOMIC_SEQ_CST)
+#define EPOCH_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define EPOCH_COMPILER_FENCE() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#define EPOCH_THREAD_LOCAL __thread
+#else
+#define EPOCH_LOAD(variable) (variable)
+#define EPOCH_LOAD_ACQUIRE(variable) (variable)
+#define EPOCH_STORE(variable, value) ((variable) = (value))
+#define EPOCH_STORE_RELEASE(variable, value) ((variable) = (value))
+#define EPOCH_INCREMENT(variable) (++(variable))
+#define EPOCH_FENCE()
+#define EPOCH_COMPILER_FENCE()
+#define EPOCH_THREAD_LOCAL
+#endif
+
+//--------------------EPOCH-STRUCT--------------------//
+/**
+ * The record of a reading thread. Records are never freed: the record of a
+ * thread which exited is reused by the next thread which registers.
+ */
+typedef struct reader_t
+{
+    unsigned long epoch; //EPOCH_IDLE while the thread is not reading
+    int depth; //The reading sections the thread is inside (only the thread itself uses it)
+    bool used;
+    struct reader_t* next;
+} *Reader;
+
+/** The current epoch */
+static unsigned long epoch_global = EPOCH_IDLE + 1;
+
+/** All the records, newest first. New ones are added under 'epoch_lock' */
+static Reader epoch_readers = NULL;
+static pthread_mutex_t epoch_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Gives back the record of a thread when it exits */
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_once = PTHREAD_ONCE_INIT;
+
+/** True if writers make the readers pass a barrier, so readers need no fence of their own */
+static bool epoch_membarrier = false;
+
+/** The record of the calling thread, NULL until it registers */
+static EPOCH_THREAD_LOCAL Reader epoch_thread_reader = NULL;
+
+static void epochInit(void);
+static void epochReleaseReader(void* reader);
+static Reader epochRegister(void);
+static void epochBarrier(void);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * Creates the key of the records and checks whether the system can make all
+ * the threads of the process pass a barrier.
+ */
+static void epochInit(void)
+{
+    pthread_key_create(&epoch_key, epochReleaseReader);
+#if defined(__linux__) && defined(SYS_membarrier)
+    long commands = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    epoch_membarrier = commands > 0 && (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+                       syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#endif
+}
+
+/**
+ * Gives back the record of a thread which exited, for the next thread to use.
+ */
+static void epochReleaseReader(void* reader)
+{
+    pthread_mutex_lock(&epoch_lock);
+    EPOCH_STORE(((Reader)reader)->epoch, EPOCH_IDLE);
+    ((Reader)reader)->depth = 0;
+    ((Reader)reader)->used = false;
+    pthread_mutex_unlock(&epoch_lock);
+}
+
+/**
+ * Gives the calling thread a record, reusing a released one if there is one.
+ * @return
+ * NULL if the allocation failed, otherwise the record.
+ */
+static Reader epochRegister(void)
+{
+    pthread_once(&epoch_once, epochInit);
+    pthread_mutex_lock(&epoch_lock);
+    Reader reader = epoch_readers;
+    while (reader != NULL && reader->used)
+    {
+        reader = reader->next;
+    }
+    if (reader == NULL)
+    {
+        reader = malloc(sizeof(*reader));
+        if (reader == NULL)
+        {
+            pthread_mutex_unlock(&epoch_lock);
+            return NULL;
+        }
+        reader->epoch = EPOCH_IDLE;
+        reader->depth = 0;
+        reader->next = epoch_readers;
+        EPOCH_STORE_RELEASE(epoch_readers, reader);
+    }
+    reader->used = true;
+    pthread_mutex_unlock(&epoch_lock);
+    if (pthread_setspecific(epoch_key, reader) != 0)
+    {
+        epochReleaseReader(reader);
+        return NULL;
+    }
+    epoch_thread_reader = reader;
+    return reader;
+}
+
+/**
+ * Makes sure that every reader either stored its epoch where the caller will
+ * see it, or reads only what was published before this call.
+ */
+static void epochBarrier(void)
+{
+    pthread_once(&epoch_once, epochInit);
+#if defined(__linux__) && defined(SYS_membarrier)
+    if (epoch_membarrier && syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0) == 0)
+    {
+        return;
+    }
+#endif
+    EPOCH_FENCE();
+}
+
+//--------------------EPOCH-FUNCTIONS--------------------//
+bool epochEnter(void)
+{
+    Reader reader = epoch_thread_reader;
+    if (reader == NULL)
+    {
+        reader = epochRegister();
+        if (reader == NULL)
+        {
+            return false;
+        }
+    }
+    if (reader->depth++ > 0)
+    {
+        //An inner section is protected by the epoch of the outermost one
+        return true;
+    }
+    //The epoch is loaded first, so a reader in a new epoch also sees what was published before it
+    EPOCH_STORE(reader->epoch, EPOCH_LOAD_ACQUIRE(epoch_global));
+    if (epoch_membarrier)
+    {
+        EPOCH_COMPILER_FENCE();
+    }
+    else
+    {
+        EPOCH_FENCE();
+    }
+    return true;
+}
+
+void epochExit(void)
+{
+    assert(epoch_thread_reader != NULL && epoch_thread_reader->depth > 0);
+    if (--epoch_thread_reader->depth > 0)
+    {
+        return;
+    }
+    //Everything read before is done before the writer may see the thread as idle
+    EPOCH_STORE_RELEASE(epoch_thread_reader->epoch, EPOCH_IDLE);
+}
+
+unsigned long epochAdvance(void)
+{
+    return EPOCH_INCREMENT(epoch_global);
+}
+
+unsigned long epochGetOldest(void)
+{
+    epochBarrier();
+    unsigned long oldest = EPOCH_LOAD_ACQUIRE(epoch_global);
+    for (Reader reader = EPOCH_LOAD_ACQUIRE(epoch_readers); reader != NULL; reader = reader->next)
+    {
+        unsigned long epoch = EPOCH_LOAD(reader->epoch);
+        if (epoch != EPOCH_IDLE && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+    return oldest;
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdbool.h>
+
+/**
+* Epoch Based Reclamation
+*
+* Lets threads read a structure while another thread replaces parts of it,
+* and tells the writer when the replaced parts are no longer read by anyone.
+*
+* The following functions are available:
+*   epochEnter		- Marks the calling thread as reading.
+*   epochExit		- Marks the calling thread as done reading.
+*   epochAdvance	- Starts a new epoch, after the writer published a change.
+*   epochGetOldest	- Returns the oldest epoch a reader may still be in.
+*
+* A writer publishes a new version of a structure, calls epochAdvance and
+* keeps the old version together with the returned epoch. Once epochGetOldest
+* returns that epoch or a later one, no reader can still see the old version,
+* so it may be freed.
+*
+* Entering and exiting are wait-free and use no atomic read-modify-write
+* operations and (on Linux) no memory fences: they only store the epoch of the
+* thread in a record of its own. The writer pays for the ordering instead, by
+* making every running thread of the process pass a memory barrier (with the
+* membarrier system call) before it looks at the records. Where that is not
+* available, readers fall back to a fence.
+*
+* Reading sections may be nested (a function which reads may call another one):
+* the thread keeps the epoch of the outermost section until it exits it. A
+* thread must not wait for a writer while it is inside a section.
+*/
+
+/**
+ * Marks the calling thread as reading, until it calls epochExit as many times as
+ * it called epochEnter. The first call of a thread registers it.
+ * @return
+ * false if the thread could not be registered (an allocation failed), in which
+ * case it is not protected and must not call epochExit.
+ */
+bool epochEnter(void);
+
+/**
+ * Marks the calling thread as done with its innermost reading section. Once it
+ * exits the outermost one, everything it read since may be freed.
+ */
+void epochExit(void);
+
+/**
+ * Starts a new epoch. Called by a writer after it published a new version.
+ * @return
+ * The new epoch: readers which enter from now on only see the new version.
+ */
+unsigned long epochAdvance(void);
+
+/**
+ * @return
+ * The oldest epoch a thread which is reading right now may have entered at
+ * (the current epoch if none is reading). A version replaced before
+ * epochAdvance returned this epoch, or an earlier one, is no longer read.
+ */
+unsigned long epochGetOldest(void);
+
+#endif
\ No newline at end of file
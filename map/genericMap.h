@@ -0,0 +1,407 @@
+#ifndef GENERIC_MAP_H_
+#define GENERIC_MAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+#include "hash.h"
+
+/**
+* Generic Map Container
+*
+* DEFINE_MAP generates a map type for a given key type and value type, whose
+* functions are all static inline and work on the keys and values by value:
+* an integer key is hashed and compared as an integer, with no formatting,
+* strlen or strcmp. The map is a single open addressing table (linear
+* probing, backward shift removal) kept as three arrays: the hashes, the keys
+* and the values.
+*
+* The map does not copy what keys or values point to: a map of char* stores
+* the pointers, and the caller keeps the strings alive.
+*
+* DEFINE_MAP(Name, KeyType, ValueType, hash_function, equals_function)
+* defines the type Name and the following functions:
+*   NameCreate		- Creates a new empty map
+*   NameDestroy		- Deletes an existing map
+*   NameCopy		- Copies an existing map
+*   NameGetSize		- Returns the number of keys in the map
+*   NameContains	- Returns weather or not a key exists inside the map
+*   NamePut		- Gives a key a given value. If the key exists, the value
+*   				  is overridden
+*   NameGet		- Returns a pointer to the value of a key, which may be
+*   				  changed in place
+*   NameFindOrInsert	- Returns a pointer to the value of a key, adding the
+*   				  key with a zeroed value if it is missing
+*   NameRemove		- Removes a key and its value
+*   NameRemoveIf	- Removes all the keys for which a given predicate holds
+*   NameClear		- Removes all the keys, keeping the room of the map
+*   NameNext		- Returns the slot of the key after a given slot, for
+*   				  iterating over the map (GENERIC_MAP_FOREACH)
+*   NameKeyAt		- Returns the key in a slot
+*   NameValueAt		- Returns a pointer to the value in a slot
+*
+* hash_function(KeyType) returns an unsigned int whose low bits depend on the
+* whole key (genericMapHashInteger and genericMapHashString are such
+* functions), and equals_function(KeyType, KeyType) returns true for equal
+* keys (GENERIC_MAP_EQUALS compares with ==, genericMapEqualsString with
+* strcmp). Either may be a function-like macro.
+*
+* A pointer returned by NameGet, NameFindOrInsert or NameValueAt, and a slot returned by
+* NameNext, are valid until the next NamePut of a new key or the next removal.
+* The functions return the MapResult codes of map.h.
+*/
+
+/** The table of a generic map is grown once more than LOAD_NUMERATOR/LOAD_DENOMINATOR of it is used */
+#define GENERIC_MAP_LOAD_NUMERATOR 3
+#define GENERIC_MAP_LOAD_DENOMINATOR 4
+
+/** The number of slots of the first table of a generic map */
+#define GENERIC_MAP_MIN_CAPACITY 8
+
+/** The factor by which the table of a generic map grows */
+#define GENERIC_MAP_EXPAND_FACTOR 2
+
+/** An equals_function for keys which are compared with == (integers, pointers) */
+#define GENERIC_MAP_EQUALS(first, second) ((first) == (second))
+
+/**
+ * A hash_function for integer keys (any integer type up to 64 bits).
+ * @return
+ * The key mixed so every bit of the hash depends on every bit of the key.
+ */
+static inline unsigned int genericMapHashInteger(int64_t key)
+{
+    uint64_t hash = (uint64_t)key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return (unsigned int)hash;
+}
+
+/**
+ * A hash_function for char* keys, the same as the hash of the string Map.
+ * @return
+ * The hashString of the key.
+ */
+static inline unsigned int genericMapHashString(const char* key)
+{
+    return hashString(key);
+}
+
+/** An equals_function for char* keys */
+static inline bool genericMapEqualsString(const char* first, const char* second)
+{
+    return first == second || !strcmp(first, second);
+}
+
+/**
+ * Iterates over the slots of a generic map, in no particular order.
+ * The keys of the map must not be put or removed meanwhile (values may be changed).
+ * @param Name - The name given to DEFINE_MAP
+ * @param slot - The name of the loop variable: the slot of the current key
+ * @param map - The map
+ */
+#define GENERIC_MAP_FOREACH(Name, slot, map) \
+    for (int slot = Name##Next(map, -1); slot >= 0; slot = Name##Next(map, slot))
+
+/**
+ * Defines a map type called Name from KeyType to ValueType, and its functions
+ * (see above). Expands to definitions, so it is used once per type, at file
+ * scope.
+ */
+#define DEFINE_MAP(Name, KeyType, ValueType, hash_function, equals_function) \
+\
+typedef struct Name##_t { \
+    uint32_t* hashes; /* 0 marks an empty slot */ \
+    KeyType* keys; \
+    ValueType* values; \
+    int capacity; /* The number of slots (0, or a power of 2) */ \
+    int size; \
+} *Name; \
+\
+/** The hash of a key, never 0 (which marks an empty slot) */ \
+static inline uint32_t Name##Hash(KeyType key) \
+{ \
+    uint32_t hash = (uint32_t)hash_function(key); \
+    return hash != 0 ? hash : 1; \
+} \
+\
+/** The slot of a key, or -1 */ \
+static inline int Name##FindSlot(Name map, KeyType key, uint32_t hash) \
+{ \
+    int mask = map->capacity - 1; \
+    for (int slot = hash & mask; map->capacity > 0 && map->hashes[slot] != 0; slot = (slot + 1) & mask) \
+    { \
+        if (map->hashes[slot] == hash && equals_function(map->keys[slot], key)) \
+        { \
+            return slot; \
+        } \
+    } \
+    return -1; \
+} \
+\
+/** Moves the keys to a new table of 'capacity' slots. On failure the map is unchanged */ \
+static inline MapResult Name##Resize(Name map, int capacity) \
+{ \
+    uint32_t* hashes = calloc(capacity, sizeof(uint32_t)); \
+    KeyType* keys = malloc(capacity * sizeof(KeyType)); \
+    ValueType* values = malloc(capacity * sizeof(ValueType)); \
+    if (hashes == NULL || keys == NULL || values == NULL) \
+    { \
+        free(hashes); \
+        free(keys); \
+        free(values); \
+        return MAP_OUT_OF_MEMORY; \
+    } \
+    int mask = capacity - 1; \
+    for (int i = 0; i < map->capacity; i++) \
+    { \
+        if (map->hashes[i] == 0) \
+        { \
+            continue; \
+        } \
+        int slot = map->hashes[i] & mask; \
+        while (hashes[slot] != 0) \
+        { \
+            slot = (slot + 1) & mask; \
+        } \
+        hashes[slot] = map->hashes[i]; \
+        keys[slot] = map->keys[i]; \
+        values[slot] = map->values[i]; \
+    } \
+    free(map->hashes); \
+    free(map->keys); \
+    free(map->values); \
+    map->hashes = hashes; \
+    map->keys = keys; \
+    map->values = values; \
+    map->capacity = capacity; \
+    return MAP_SUCCESS; \
+} \
+\
+/** Empties a used slot, moving back the keys after it which may fill it */ \
+static inline void Name##RemoveSlot(Name map, int slot) \
+{ \
+    int mask = map->capacity - 1; \
+    int hole = slot; \
+    for (int next = (hole + 1) & mask; map->hashes[next] != 0; next = (next + 1) & mask) \
+    { \
+        int home = map->hashes[next] & mask; \
+        /* The key may fill the hole only if the hole is between its home slot and its current slot */ \
+        if (((next - home) & mask) >= ((next - hole) & mask)) \
+        { \
+            map->hashes[hole] = map->hashes[next]; \
+            map->keys[hole] = map->keys[next]; \
+            map->values[hole] = map->values[next]; \
+            hole = next; \
+        } \
+    } \
+    map->hashes[hole] = 0; \
+    map->size--; \
+} \
+\
+static inline Name Name##Create(void) \
+{ \
+    return calloc(1, sizeof(struct Name##_t)); \
+} \
+\
+static inline void Name##Destroy(Name map) \
+{ \
+    if (map == NULL) \
+    { \
+        return; \
+    } \
+    free(map->hashes); \
+    free(map->keys); \
+    free(map->values); \
+    free(map); \
+} \
+\
+static inline Name Name##Copy(Name map) \
+{ \
+    if (map == NULL) \
+    { \
+        return NULL; \
+    } \
+    Name new_map = Name##Create(); \
+    if (new_map == NULL || (map->capacity > 0 && Name##Resize(new_map, map->capacity) != MAP_SUCCESS)) \
+    { \
+        Name##Destroy(new_map); \
+        return NULL; \
+    } \
+    if (map->capacity > 0) \
+    { \
+        memcpy(new_map->hashes, map->hashes, map->capacity * sizeof(uint32_t)); \
+        memcpy(new_map->keys, map->keys, map->capacity * sizeof(KeyType)); \
+        memcpy(new_map->values, map->values, map->capacity * sizeof(ValueType)); \
+    } \
+    new_map->size = map->size; \
+    return new_map; \
+} \
+\
+static inline int Name##GetSize(Name map) \
+{ \
+    return map == NULL ? -1 : map->size; \
+} \
+\
+static inline bool Name##Contains(Name map, KeyType key) \
+{ \
+    return map != NULL && Name##FindSlot(map, key, Name##Hash(key)) >= 0; \
+} \
+\
+/** Adds a key which is not in the map, without its value. Its slot, or -1 if growing the table failed */ \
+static inline int Name##Insert(Name map, KeyType key, uint32_t hash) \
+{ \
+    if ((map->size + 1) * GENERIC_MAP_LOAD_DENOMINATOR > map->capacity * GENERIC_MAP_LOAD_NUMERATOR && \
+        Name##Resize(map, map->capacity == 0 ? GENERIC_MAP_MIN_CAPACITY : \
+                                               GENERIC_MAP_EXPAND_FACTOR * map->capacity) != MAP_SUCCESS) \
+    { \
+        return -1; \
+    } \
+    int mask = map->capacity - 1; \
+    int slot = hash & mask; \
+    while (map->hashes[slot] != 0) \
+    { \
+        slot = (slot + 1) & mask; \
+    } \
+    map->hashes[slot] = hash; \
+    map->keys[slot] = key; \
+    map->size++; \
+    return slot; \
+} \
+\
+static inline MapResult Name##Put(Name map, KeyType key, ValueType value) \
+{ \
+    if (map == NULL) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    uint32_t hash = Name##Hash(key); \
+    int slot = Name##FindSlot(map, key, hash); \
+    if (slot < 0) \
+    { \
+        slot = Name##Insert(map, key, hash); \
+    } \
+    if (slot < 0) \
+    { \
+        return MAP_OUT_OF_MEMORY; \
+    } \
+    map->values[slot] = value; \
+    return MAP_SUCCESS; \
+} \
+\
+static inline ValueType* Name##Get(Name map, KeyType key) \
+{ \
+    int slot = map == NULL ? -1 : Name##FindSlot(map, key, Name##Hash(key)); \
+    return slot >= 0 ? &map->values[slot] : NULL; \
+} \
+\
+/** Sets 'inserted' to whether the key was added. NULL if a NULL was sent or growing the table failed */ \
+static inline ValueType* Name##FindOrInsert(Name map, KeyType key, bool* inserted) \
+{ \
+    if (map == NULL || inserted == NULL) \
+    { \
+        return NULL; \
+    } \
+    uint32_t hash = Name##Hash(key); \
+    int slot = Name##FindSlot(map, key, hash); \
+    *inserted = slot < 0; \
+    if (*inserted) \
+    { \
+        slot = Name##Insert(map, key, hash); \
+        if (slot < 0) \
+        { \
+            return NULL; \
+        } \
+        memset(&map->values[slot], 0, sizeof(ValueType)); \
+    } \
+    return &map->values[slot]; \
+} \
+\
+static inline MapResult Name##Remove(Name map, KeyType key) \
+{ \
+    if (map == NULL) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    int slot = Name##FindSlot(map, key, Name##Hash(key)); \
+    if (slot < 0) \
+    { \
+        return MAP_ITEM_DOES_NOT_EXIST; \
+    } \
+    Name##RemoveSlot(map, slot); \
+    return MAP_SUCCESS; \
+} \
+\
+static inline MapResult Name##RemoveIf(Name map, bool (*predicate)(KeyType, ValueType, void*), void* context) \
+{ \
+    if (map == NULL || predicate == NULL) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    if (map->size == 0) \
+    { \
+        return MAP_SUCCESS; \
+    } \
+    /* A removal only moves keys back from slots after it up to the next empty slot, so walking */ \
+    /* the table from an empty slot visits every key once if a filled hole is checked again */ \
+    int mask = map->capacity - 1; \
+    int start = 0; \
+    while (map->hashes[start] != 0) \
+    { \
+        start++; \
+    } \
+    for (int slot = (start + 1) & mask; slot != start;) \
+    { \
+        if (map->hashes[slot] != 0 && predicate(map->keys[slot], map->values[slot], context)) \
+        { \
+            Name##RemoveSlot(map, slot); \
+            continue; \
+        } \
+        slot = (slot + 1) & mask; \
+    } \
+    return MAP_SUCCESS; \
+} \
+\
+static inline MapResult Name##Clear(Name map) \
+{ \
+    if (map == NULL) \
+    { \
+        return MAP_NULL_ARGUMENT; \
+    } \
+    if (map->capacity > 0) \
+    { \
+        memset(map->hashes, 0, map->capacity * sizeof(uint32_t)); \
+    } \
+    map->size = 0; \
+    return MAP_SUCCESS; \
+} \
+\
+/** The first used slot after 'slot' (-1 for the first of all), or -1 after the last one */ \
+static inline int Name##Next(Name map, int slot) \
+{ \
+    for (slot++; map != NULL && slot < map->capacity; slot++) \
+    { \
+        if (map->hashes[slot] != 0) \
+        { \
+            return slot; \
+        } \
+    } \
+    return -1; \
+} \
+\
+static inline KeyType Name##KeyAt(Name map, int slot) \
+{ \
+    return map->keys[slot]; \
+} \
+\
+static inline ValueType* Name##ValueAt(Name map, int slot) \
+{ \
+    return &map->values[slot]; \
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include "heap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/** The room for pairs of a heap which gets its first pair */
+#define HEAP_MIN_CAPACITY 4
+
+/** The smallest buffer of strings of a heap which has any pairs */
+#define HEAP_MIN_ROOM 256
+
+/** The factor by which the arrays and the buffer grow */
+#define HEAP_GROWTH_FACTOR 2
+
+/** The buffer is compacted instead of grown once at least 1/HEAP_GARBAGE_DIVISOR of it is garbage */
+#define HEAP_GARBAGE_DIVISOR 2
+
+static bool heapRebuild(Heap heap, size_t room);
+static uint32_t heapAppend(Heap heap, const char* string, size_t size);
+static bool heapOwns(Heap heap, const char* string);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * Moves the strings to a new buffer of 'room' bytes, which must fit them all,
+ * leaving their garbage behind.
+ * @return
+ * false if the allocation failed (the heap is unchanged).
+ */
+static bool heapRebuild(Heap heap, size_t room)
+{
+    char* strings = room > 0 ? malloc(room) : NULL;
+    if (room > 0 && strings == NULL)
+    {
+        return false;
+    }
+    heap->bytes_allocated += room;
+    size_t used = 0;
+    for (int i = 0; i < heap->count; i++)
+    {
+        //A replaced value is no longer next to its key, so they are copied apart
+        size_t key_size = strlen(HEAP_KEY(heap, i)) + 1;
+        memcpy(strings + used, HEAP_KEY(heap, i), key_size);
+        heap->key_offsets[i] = (uint32_t)used;
+        used += key_size;
+        size_t value_size = strlen(HEAP_VALUE(heap, i)) + 1;
+        memcpy(strings + used, HEAP_VALUE(heap, i), value_size);
+        heap->value_offsets[i] = (uint32_t)used;
+        used += value_size;
+    }
+    free(heap->strings);
+    heap->strings = strings;
+    heap->room = room;
+    heap->used = used;
+    heap->garbage = 0;
+    return true;
+}
+
+/**
+ * Copies a string of 'size' bytes (with its '\0') after the used part of the
+ * buffer, which must have room for it.
+ * @return
+ * The offset of the copy.
+ */
+static uint32_t heapAppend(Heap heap, const char* string, size_t size)
+{
+    assert(heap->used + size <= heap->room);
+    uint32_t offset = (uint32_t)heap->used;
+    memcpy(heap->strings + offset, string, size);
+    heap->used += size;
+    return offset;
+}
+
+/**
+ * @return
+ * true if the string is in the buffer (it came from HEAP_KEY or HEAP_VALUE),
+ * so it would move if the buffer grows.
+ */
+static bool heapOwns(Heap heap, const char* string)
+{
+    return (uintptr_t)string - (uintptr_t)heap->strings < heap->room;
+}
+
+//--------------------HEAP-FUNCTIONS--------------------//
+Heap heapCreate()
+{
+    return calloc(1, sizeof(struct heap_t));
+}
+
+void heapDestroy(Heap heap)
+{
+    if (heap == NULL)
+    {
+        return;
+    }
+    free(heap->hashes);
+    free(heap->key_offsets);
+    free(heap->value_offsets);
+    free(heap->strings);
+    free(heap);
+}
+
+Heap heapCopy(Heap heap)
+{
+    Heap new_heap = heapCreate();
+    if (new_heap == NULL)
+    {
+        return NULL;
+    }
+    if (heap->capacity > 0)
+    {
+        new_heap->hashes = malloc(heap->capacity * sizeof(uint32_t));
+        new_heap->key_offsets = malloc(heap->capacity * sizeof(uint32_t));
+        new_heap->value_offsets = malloc(heap->capacity * sizeof(uint32_t));
+    }
+    if (heap->room > 0)
+    {
+        new_heap->strings = malloc(heap->room);
+    }
+    if ((heap->capacity > 0 && (new_heap->hashes == NULL || new_heap->key_offsets == NULL ||
+        new_heap->value_offsets == NULL)) || (heap->room > 0 && new_heap->strings == NULL))
+    {
+        heapDestroy(new_heap);
+        return NULL;
+    }
+    if (heap->capacity > 0)
+    {
+        memcpy(new_heap->hashes, heap->hashes, heap->capacity * sizeof(uint32_t));
+        memcpy(new_heap->key_offsets, heap->key_offsets, heap->capacity * sizeof(uint32_t));
+        memcpy(new_heap->value_offsets, heap->value_offsets, heap->capacity * sizeof(uint32_t));
+    }
+    if (heap->used > 0)
+    {
+        memcpy(new_heap->strings, heap->strings, heap->used);
+    }
+    new_heap->count = heap->count;
+    new_heap->capacity = heap->capacity;
+    new_heap->used = heap->used;
+    new_heap->room = heap->room;
+    new_heap->garbage = heap->garbage;
+    return new_heap;
+}
+
+bool heapReserve(Heap heap, int count, size_t bytes)
+{
+    if (heap->count + count > heap->capacity)
+    {
+        int capacity = HEAP_GROWTH_FACTOR * heap->capacity;
+        capacity = capacity < heap->count + count ? heap->count + count : capacity;
+        capacity = capacity < HEAP_MIN_CAPACITY ? HEAP_MIN_CAPACITY : capacity;
+        //Each array keeps the room it got, so a later failure leaves the pairs as they were
+        uint32_t* hashes = realloc(heap->hashes, capacity * sizeof(uint32_t));
+        if (hashes == NULL)
+        {
+            return false;
+        }
+        heap->hashes = hashes;
+        uint32_t* key_offsets = realloc(heap->key_offsets, capacity * sizeof(uint32_t));
+        if (key_offsets == NULL)
+        {
+            return false;
+        }
+        heap->key_offsets = key_offsets;
+        uint32_t* value_offsets = realloc(heap->value_offsets, capacity * sizeof(uint32_t));
+        if (value_offsets == NULL)
+        {
+            return false;
+        }
+        heap->value_offsets = value_offsets;
+        heap->capacity = capacity;
+        heap->growths++;
+        heap->bytes_allocated += 3 * capacity * sizeof(uint32_t);
+    }
+    if (heap->used + bytes <= heap->room)
+    {
+        return true;
+    }
+    //Offsets are 32 bits, so past that the garbage has to go
+    bool compact = heap->garbage * HEAP_GARBAGE_DIVISOR >= heap->used || heap->used + bytes > UINT32_MAX;
+    size_t needed = (compact ? heap->used - heap->garbage : heap->used) + bytes;
+    if (needed > UINT32_MAX)
+    {
+        return false;
+    }
+    size_t room = heap->room < HEAP_MIN_ROOM ? HEAP_MIN_ROOM : heap->room;
+    while (room < needed)
+    {
+        room *= HEAP_GROWTH_FACTOR;
+    }
+    if (compact)
+    {
+        return heapRebuild(heap, room);
+    }
+    char* strings = realloc(heap->strings, room);
+    if (strings == NULL)
+    {
+        return false;
+    }
+    heap->growths++;
+    heap->bytes_allocated += room;
+    heap->strings = strings;
+    heap->room = room;
+    return true;
+}
+
+bool heapAdd(Heap heap, const char* key, const char* value, uint32_t hash)
+{
+    size_t key_size = strlen(key) + 1;
+    size_t value_size = strlen(value) + 1;
+    if (heapOwns(heap, key) || heapOwns(heap, value))
+    {
+        char* copy = malloc(key_size + value_size);
+        if (copy == NULL)
+        {
+            return false;
+        }
+        memcpy(copy, key, key_size);
+        memcpy(copy + key_size, value, value_size);
+        bool added = heapAdd(heap, copy, copy + key_size, hash);
+        free(copy);
+        return added;
+    }
+    if (!heapReserve(heap, 1, key_size + value_size))
+    {
+        return false;
+    }
+    heap->hashes[heap->count] = hash;
+    heap->key_offsets[heap->count] = heapAppend(heap, key, key_size);
+    heap->value_offsets[heap->count] = heapAppend(heap, value, value_size);
+    heap->count++;
+    return true;
+}
+
+bool heapSetValue(Heap heap, int position, const char* value)
+{
+    assert(position >= 0 && position < heap->count);
+    size_t value_size = strlen(value) + 1;
+    if (heapOwns(heap, value))
+    {
+        char* copy = malloc(value_size);
+        if (copy == NULL)
+        {
+            return false;
+        }
+        memcpy(copy, value, value_size);
+        bool set = heapSetValue(heap, position, copy);
+        free(copy);
+        return set;
+    }
+    char* old_value = HEAP_VALUE(heap, position);
+    size_t old_size = strlen(old_value) + 1;
+    if (value_size <= old_size)
+    {
+        memcpy(old_value, value, value_size);
+        heap->garbage += old_size - value_size;
+        return true;
+    }
+    if (!heapReserve(heap, 0, value_size))
+    {
+        return false;
+    }
+    heap->value_offsets[position] = heapAppend(heap, value, value_size);
+    heap->garbage += old_size;
+    return true;
+}
+
+void heapRemove(Heap heap, int position)
+{
+    assert(position >= 0 && position < heap->count);
+    heap->garbage += strlen(HEAP_KEY(heap, position)) + 1 + strlen(HEAP_VALUE(heap, position)) + 1;
+    int last = --heap->count;
+    heap->hashes[position] = heap->hashes[last];
+    heap->key_offsets[position] = heap->key_offsets[last];
+    heap->value_offsets[position] = heap->value_offsets[last];
+    if (heap->count == 0)
+    {
+        heap->used = 0;
+        heap->garbage = 0;
+    }
+}
+
+int heapRemoveIf(Heap heap, HeapPredicate predicate, void* context)
+{
+    int kept = 0;
+    for (int i = 0; i < heap->count; i++)
+    {
+        const char* key = HEAP_KEY(heap, i);
+        const char* value = HEAP_VALUE(heap, i);
+        if (predicate(key, value, context))
+        {
+            heap->garbage += strlen(key) + 1 + strlen(value) + 1;
+            continue;
+        }
+        heap->hashes[kept] = heap->hashes[i];
+        heap->key_offsets[kept] = heap->key_offsets[i];
+        heap->value_offsets[kept] = heap->value_offsets[i];
+        kept++;
+    }
+    heap->count = kept;
+    if (kept == 0)
+    {
+        heap->used = 0;
+        heap->garbage = 0;
+    }
+    return kept;
+}
+
+void heapClear(Heap heap)
+{
+    heap->count = 0;
+    heap->used = 0;
+    heap->garbage = 0;
+}
+
+bool heapShrink(Heap heap)
+{
+    if (heap->room > heap->used - heap->garbage && !heapRebuild(heap, heap->used - heap->garbage))
+    {
+        return false;
+    }
+    if (heap->count == 0)
+    {
+        free(heap->hashes);
+        free(heap->key_offsets);
+        free(heap->value_offsets);
+        heap->hashes = heap->key_offsets = heap->value_offsets = NULL;
+        heap->capacity = 0;
+        return true;
+    }
+    uint32_t* hashes = realloc(heap->hashes, heap->count * sizeof(uint32_t));
+    heap->hashes = hashes != NULL ? hashes : heap->hashes;
+    uint32_t* key_offsets = realloc(heap->key_offsets, heap->count * sizeof(uint32_t));
+    heap->key_offsets = key_offsets != NULL ? key_offsets : heap->key_offsets;
+    uint32_t* value_offsets = realloc(heap->value_offsets, heap->count * sizeof(uint32_t));
+    heap->value_offsets = value_offsets != NULL ? value_offsets : heap->value_offsets;
+    heap->capacity = heap->count;
+    return true;
+}
+
+bool heapFill(Heap heap, const char* const* keys, const char* const* values, int count)
+{
+    assert(heap->count == 0 && heap->room == 0 && count <= heap->capacity);
+    size_t total = 0;
+    for (int p = 0; p < count; p++)
+    {
+        total += strlen(keys[heap->key_offsets[p]]) + 1 + strlen(values[heap->value_offsets[p]]) + 1;
+    }
+    if (total > UINT32_MAX || (total > 0 && (heap->strings = malloc(total)) == NULL))
+    {
+        return false;
+    }
+    heap->room = total;
+    heap->bytes_allocated += total;
+    for (int p = 0; p < count; p++)
+    {
+        const char* key = keys[heap->key_offsets[p]];
+        const char* value = values[heap->value_offsets[p]];
+        heap->key_offsets[p] = heapAppend(heap, key, strlen(key) + 1);
+        heap->value_offsets[p] = heapAppend(heap, value, strlen(value) + 1);
+    }
+    heap->count = count;
+    return true;
+}
+
+size_t heapGetStringBytes(Heap heap, size_t* value_bytes)
+{
+    size_t key_bytes = 0;
+    *value_bytes = 0;
+    for (int i = 0; i < heap->count; i++)
+    {
+        key_bytes += strlen(HEAP_KEY(heap, i)) + 1;
+        *value_bytes += strlen(HEAP_VALUE(heap, i)) + 1;
+    }
+    return key_bytes;
+}
+
+size_t heapGetSize(Heap heap)
+{
+    if (heap == NULL)
+    {
+        return 0;
+    }
+    return sizeof(*heap) + 3 * (size_t)heap->capacity * sizeof(uint32_t) + heap->room;
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+* String Heap
+*
+* Keeps pairs of strings, a key and a value, with the hash of the key, in three
+* arrays indexed by position and one growing buffer which holds all the
+* strings, instead of allocating each string on its own. Positions 0 to
+* count - 1 are used, and a pair is added after the last one.
+* Removed pairs and replaced values stay in the buffer as garbage, which is
+* dropped the next time the buffer has to grow (or by heapShrink).
+*
+* The following functions are available:
+*   heapCreate		- Creates a new empty heap.
+*   heapDestroy		- Frees a heap and its strings.
+*   heapCopy		- Copies a heap.
+*   heapReserve		- Makes room for more pairs and strings.
+*   heapAdd		- Adds a pair after the last one.
+*   heapSetValue	- Replaces the value of a pair.
+*   heapRemove		- Removes a pair, moving the last one into its place.
+*   heapRemoveIf	- Removes the pairs which match a predicate, keeping the others in order.
+*   heapClear		- Removes all the pairs, keeping the room.
+*   heapShrink		- Fits the arrays and the buffer to the pairs.
+*   heapFill		- Copies pairs of string arrays into a buffer of exactly their size.
+*   heapGetStringBytes	- Returns the bytes of the keys and of the values.
+*   heapGetSize		- Returns the bytes a heap allocated.
+*
+* The owner of a heap reads its arrays directly (the key and the value of a
+* position are HEAP_KEY and HEAP_VALUE), and changes them only through these
+* functions. A string returned by HEAP_KEY or HEAP_VALUE is valid until the
+* heap is changed.
+*/
+
+/** The key of a used position */
+#define HEAP_KEY(heap, position) ((heap)->strings + (heap)->key_offsets[position])
+
+/** The value of a used position */
+#define HEAP_VALUE(heap, position) ((heap)->strings + (heap)->value_offsets[position])
+
+typedef struct heap_t {
+    uint32_t* hashes;
+    uint32_t* key_offsets;
+    uint32_t* value_offsets;
+    int count; //The used positions
+    int capacity; //The room of the arrays
+    char* strings;
+    size_t used; //The bytes of 'strings' in use, garbage included
+    size_t room; //The bytes allocated for 'strings'
+    size_t garbage;
+    uint64_t growths; //The times the arrays or the buffer were reallocated (a copy starts from zero)
+    uint64_t bytes_allocated; //...and the bytes they were given
+} *Heap;
+
+/**
+ * The predicate of heapRemoveIf. It gets the key and the value of a pair and
+ * the context given to heapRemoveIf, and returns true to remove the pair.
+ */
+typedef bool (*HeapPredicate)(const char* key, const char* value, void* context);
+
+/**
+ * @return
+ * NULL - if the allocation failed.
+ * A new empty heap otherwise.
+ */
+Heap heapCreate();
+
+/**
+ * @param heap - The heap to free, with its arrays and strings. If NULL nothing is done.
+ */
+void heapDestroy(Heap heap);
+
+/**
+ * @param heap - The heap to copy.
+ * @return
+ * NULL - if an allocation failed.
+ * A new heap with the same pairs and the same room otherwise.
+ */
+Heap heapCopy(Heap heap);
+
+/**
+ * Grows the arrays so 'count' more pairs fit, and the buffer so 'bytes' more
+ * bytes of strings fit. The buffer drops its garbage instead of growing when
+ * there is enough of it.
+ * @param heap - The heap to grow.
+ * @param count - The pairs to make room for.
+ * @param bytes - The bytes of strings (with their '\0's) to make room for.
+ * @return
+ * false if an allocation failed or the strings would not fit in 32-bit offsets
+ * (the heap then holds the same pairs), true otherwise.
+ */
+bool heapReserve(Heap heap, int count, size_t bytes);
+
+/**
+ * Adds a pair after the last one. The key and the value may be strings of the
+ * heap itself.
+ * @param heap - The heap to add to.
+ * @param key - The key.
+ * @param value - The value.
+ * @param hash - The hash of the key.
+ * @return
+ * false if an allocation failed (the heap is unchanged), true otherwise.
+ */
+bool heapAdd(Heap heap, const char* key, const char* value, uint32_t hash);
+
+/**
+ * Replaces the value of a used position. A value which fits in the room of the
+ * one it replaces is copied over it. It may be a string of the heap itself.
+ * @param heap - The heap to change.
+ * @param position - The position.
+ * @param value - The new value.
+ * @return
+ * false if an allocation failed (the old value is kept), true otherwise.
+ */
+bool heapSetValue(Heap heap, int position, const char* value);
+
+/**
+ * Removes the pair of a used position. The last pair moves into its place,
+ * and the strings of the removed one become garbage.
+ * @param heap - The heap to change.
+ * @param position - The position to remove.
+ */
+void heapRemove(Heap heap, int position);
+
+/**
+ * Removes the pairs which match 'predicate', moving the others forward in order.
+ * @param heap - The heap to change.
+ * @param predicate - Called with every pair. It must not change the heap.
+ * @param context - Passed to every call of 'predicate'.
+ * @return
+ * The number of pairs kept.
+ */
+int heapRemoveIf(Heap heap, HeapPredicate predicate, void* context);
+
+/**
+ * @param heap - The heap to empty. The arrays and the buffer keep their room.
+ */
+void heapClear(Heap heap);
+
+/**
+ * Fits the arrays and the buffer to the pairs. An array which cannot be moved
+ * to a smaller block keeps its room.
+ * @param heap - The heap to shrink.
+ * @return
+ * false if the buffer could not be reallocated (the heap is unchanged), true otherwise.
+ */
+bool heapShrink(Heap heap);
+
+/**
+ * Sets the pairs of an empty heap whose arrays have room for 'count' pairs,
+ * and whose key_offsets[p] and value_offsets[p] hold, instead of offsets, the
+ * indexes in 'keys' and 'values' of the key and the value of position p (its
+ * hashes are already set). The strings are copied into a buffer of exactly
+ * their size.
+ * @param heap - The heap to fill.
+ * @param keys - The keys the positions point to.
+ * @param values - The values the positions point to.
+ * @param count - The number of positions.
+ * @return
+ * false if the allocation failed or the strings do not fit in 32-bit offsets
+ * (the heap must then be destroyed), true otherwise.
+ */
+bool heapFill(Heap heap, const char* const* keys, const char* const* values, int count);
+
+/**
+ * @param heap - The heap to measure.
+ * @param value_bytes - Set to the bytes of its values (with their '\0's).
+ * @return
+ * The bytes of its keys (with their '\0's).
+ */
+size_t heapGetStringBytes(Heap heap, size_t* value_bytes);
+
+/**
+ * @param heap - The heap to measure.
+ * @return
+ * The bytes of the heap, its arrays and its buffer (garbage and free room
+ * included), 0 if @param heap is NULL.
+ */
+size_t heapGetSize(Heap heap);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,661 @@
+#define _POSIX_C_SOURCE 200809L
+#include "image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * The first bytes of an image file ("SMAP" when read on a little-endian
+ * machine, so an image of the other byte order is rejected)
+ */
+#define IMAGE_MAGIC 0x50414d53u
+
+/** The version of the image format, which must change whenever the layout or the owner's hash changes */
+#define IMAGE_VERSION 2u
+
+/** The oldest version which is still read (version 1 images are version 2 images without a perfect hash) */
+#define IMAGE_OLDEST_VERSION 1u
+
+/** Set in the flags of the image of a counters map */
+#define IMAGE_COUNTERS 1u
+
+/** Set in the flags of an image whose index is a minimal perfect hash (built by 'imageFreeze') */
+#define IMAGE_PERFECT 2u
+
+/** Marks an unused slot of a hash index */
+#define IMAGE_EMPTY_SLOT -1
+
+/** The sections of an image, and the records of a counters map, are aligned to this size */
+#define IMAGE_ALIGNMENT 8
+#define IMAGE_ALIGN(offset) (((offset) + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT)
+
+/** The zero bytes at the end of an image, so reading a record never runs past the file */
+#define IMAGE_TRAILER (2 * IMAGE_ALIGNMENT)
+
+/** The perfect hash of a frozen image has a bucket of keys, with its own displacement, per this many keys */
+#define IMAGE_PERFECT_BUCKET_SIZE 3
+
+/** Marks the displacement of a bucket of a single key, which holds the key's position instead */
+#define IMAGE_PERFECT_DIRECT 0x80000000u
+
+/** A bucket which fits no displacement below this one makes the build start over with another seed */
+#define IMAGE_PERFECT_MAX_DISPLACEMENT (1u << 20)
+
+/** The number of seeds 'imageFreeze' tries before it gives up */
+#define IMAGE_PERFECT_MAX_SEEDS 16
+
+/** FNV-1a 64-bit parameters used by 'imagePerfectHash' */
+#define IMAGE_PERFECT_OFFSET_BASIS 0xcbf29ce484222325ull
+#define IMAGE_PERFECT_PRIME 0x100000001b3ull
+
+/** Images are shared by the maps of many threads, so their count is atomic */
+#if defined(__GNUC__)
+#define IMAGE_REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define IMAGE_REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#else
+#define IMAGE_REFCOUNT_INCREMENT(count) (++(count))
+#define IMAGE_REFCOUNT_DECREMENT(count) (--(count))
+#endif
+
+//--------------------IMAGE-STRUCT--------------------//
+/**
+ * The header of an image file. It is followed by:
+ * - The hash index: 'index_size' slots, probed linearly from hash % index_size
+ *   (IMAGE_EMPTY_SLOT marks an unused slot).
+ *   In an image built by 'imageFreeze' (IMAGE_PERFECT), a minimal perfect
+ *   hash instead: the uint64_t seed of 'imagePerfectHash', followed by the
+ *   uint32_t displacements of 'index_size' buckets (see 'imagePerfectPosition').
+ * - The offset in the file of the record of every key, in the order of positions.
+ * - The records. A record is the key and '\0', followed by the value and
+ *   '\0', or (in a counters map) by the int64_t counter at the next aligned
+ *   offset.
+ * - IMAGE_TRAILER zero bytes.
+ * All the numbers are in the byte order of the machine which wrote the image.
+ */
+typedef struct ImageHeader_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t index_size;
+    uint64_t count;
+    uint64_t index_offset;
+    uint64_t records_offset;
+    uint64_t size;
+} ImageHeader;
+
+/** A slot of the hash index of an image */
+typedef struct ImageSlot_t {
+    uint32_t hash;
+    int32_t position;
+} ImageSlot;
+
+struct image_t {
+    unsigned int refcount;
+    size_t length;
+    const unsigned char* base;
+    const ImageSlot* slots;
+    const uint32_t* displacements; //NULL unless the index is a perfect hash, which replaces 'slots'
+    uint64_t seed;
+    const uint64_t* records;
+    uint32_t index_size;
+    int count;
+    bool counters;
+    bool allocated; //true if 'base' was allocated by 'imageFreeze', false if it is mapped from a file
+};
+
+static bool imageIsValid(const ImageHeader* header, size_t length);
+static Image imageCreate(const unsigned char* base, size_t length, bool allocated);
+static uint64_t imageRecordEnd(const ImagePairs* pairs, int pair, uint64_t offset);
+static uint64_t imagePerfectHash(const char* key, uint64_t seed);
+static uint32_t imagePerfectBucket(uint64_t hash, uint32_t bucket_count);
+static uint32_t imagePerfectPosition(uint64_t hash, uint32_t displacement, uint32_t count);
+static ImageResult imagePerfectBuild(const uint64_t* hashes, uint32_t count, uint32_t bucket_count,
+                                     uint32_t* displacements, uint32_t* positions);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * Checks the header of an image, without reading any of its records.
+ * @param length - The size of the mapped file
+ * @return
+ * true if the header belongs to an image of this version whose sections are inside the file.
+ */
+static bool imageIsValid(const ImageHeader* header, size_t length)
+{
+    bool perfect = (header->flags & IMAGE_PERFECT) != 0;
+    if (header->magic != IMAGE_MAGIC || header->version < IMAGE_OLDEST_VERSION ||
+        header->version > IMAGE_VERSION || (header->flags & ~(IMAGE_COUNTERS | IMAGE_PERFECT)) != 0 ||
+        header->size != length || length % IMAGE_ALIGNMENT != 0 || header->index_size == 0 ||
+        header->index_size > (uint32_t)INT_MAX + 1 ||
+        (!perfect && (header->index_size & (header->index_size - 1)) != 0) || header->count > INT_MAX)
+    {
+        return false;
+    }
+    uint64_t index_end = header->index_offset + (perfect ? sizeof(uint64_t) + (uint64_t)header->index_size * sizeof(uint32_t) :
+                                                           (uint64_t)header->index_size * sizeof(ImageSlot));
+    uint64_t records_end = header->records_offset + header->count * sizeof(uint64_t);
+    if (header->index_offset < sizeof(*header) || header->index_offset % IMAGE_ALIGNMENT != 0 ||
+        header->records_offset < index_end || header->records_offset % IMAGE_ALIGNMENT != 0 ||
+        records_end > length - IMAGE_TRAILER)
+    {
+        return false;
+    }
+    const unsigned char* trailer = (const unsigned char*)header + length - IMAGE_TRAILER;
+    for (int i = 0; i < IMAGE_TRAILER; i++)
+    {
+        if (trailer[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @param base - A valid image (see 'imageIsValid')
+ * @param allocated - true if 'base' was allocated, false if it is mapped from a file
+ * @return
+ * A new image with a single owner, or NULL if the allocation failed.
+ */
+static Image imageCreate(const unsigned char* base, size_t length, bool allocated)
+{
+    Image image = malloc(sizeof(*image));
+    if (image == NULL)
+    {
+        return NULL;
+    }
+    const ImageHeader* header = (const ImageHeader*)base;
+    image->refcount = 1;
+    image->length = length;
+    image->base = base;
+    image->slots = (const ImageSlot*)(base + header->index_offset);
+    image->displacements = NULL;
+    image->seed = 0;
+    if ((header->flags & IMAGE_PERFECT) != 0)
+    {
+        memcpy(&image->seed, base + header->index_offset, sizeof(image->seed));
+        image->displacements = (const uint32_t*)(base + header->index_offset + sizeof(uint64_t));
+        image->slots = NULL;
+    }
+    image->records = (const uint64_t*)(base + header->records_offset);
+    image->index_size = header->index_size;
+    image->count = (int)header->count;
+    image->counters = (header->flags & IMAGE_COUNTERS) != 0;
+    image->allocated = allocated;
+    return image;
+}
+
+/**
+ * @param pair - The position of a pair in 'pairs'
+ * @param offset - The offset its record starts at
+ * @return
+ * The offset right after its record. Every record of a counters map starts at
+ * an aligned offset, so its size does not depend on the order of the records.
+ */
+static uint64_t imageRecordEnd(const ImagePairs* pairs, int pair, uint64_t offset)
+{
+    offset += strlen(pairs->keys[pair]) + 1;
+    if (pairs->counters != NULL)
+    {
+        return IMAGE_ALIGN(offset) + sizeof(int64_t);
+    }
+    return offset + strlen(pairs->values[pair]) + 1;
+}
+
+/**
+ * @param key - The string to hash
+ * @param seed - Picks one of many hash functions, so a perfect hash which
+ * 	cannot be built with one seed can be built with another.
+ * @return
+ * The 64-bit FNV-1a hash of the string, started from the seed, with a final mix.
+ * Unlike the owner's hash, it is wide enough for the keys of a big map to have
+ * different hashes, which a perfect hash needs.
+ */
+static uint64_t imagePerfectHash(const char* key, uint64_t seed)
+{
+    uint64_t hash = IMAGE_PERFECT_OFFSET_BASIS ^ seed;
+    while (*key)
+    {
+        hash ^= (unsigned char)*key++;
+        hash *= IMAGE_PERFECT_PRIME;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * @return
+ * The bucket of a key of a perfect hash, from the low half of its hash.
+ */
+static uint32_t imagePerfectBucket(uint64_t hash, uint32_t bucket_count)
+{
+    return (uint32_t)(((hash & 0xffffffffu) * bucket_count) >> 32);
+}
+
+/**
+ * @param displacement - The displacement of the key's bucket
+ * @param count - The number of keys of the perfect hash
+ * @return
+ * The position of a key of a perfect hash: its hash, mixed with the
+ * displacement, scaled to the number of keys.
+ */
+static uint32_t imagePerfectPosition(uint64_t hash, uint32_t displacement, uint32_t count)
+{
+    hash ^= displacement * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 32;
+    return (uint32_t)(((hash & 0xffffffffu) * count) >> 32);
+}
+
+/**
+ * Builds a minimal perfect hash of 'count' keys by hash and displace (CHD):
+ * the keys are split into buckets, and the buckets, biggest first, get the
+ * first displacement which sends all their keys to free positions. A bucket
+ * of a single key takes the next free position directly.
+ * @param hashes - The 'imagePerfectHash' of every key
+ * @param displacements - Set to the displacement of each of the 'bucket_count' buckets
+ * @param positions - Set to the position of every key (0 to count - 1)
+ * @return
+ * IMAGE_OUT_OF_MEMORY if an allocation failed, IMAGE_ERROR if some bucket fits
+ * no displacement (or two keys have the same hash), so another seed is needed,
+ * IMAGE_SUCCESS otherwise.
+ */
+static ImageResult imagePerfectBuild(const uint64_t* hashes, uint32_t count, uint32_t bucket_count,
+                                     uint32_t* displacements, uint32_t* positions)
+{
+    //The keys are sorted by bucket: the keys of bucket b are keys[starts[b]] to keys[starts[b + 1] - 1]
+    uint32_t* starts = calloc((size_t)bucket_count + 1, sizeof(*starts));
+    uint32_t* keys = malloc((count > 0 ? count : 1) * sizeof(*keys));
+    uint32_t* next = malloc((size_t)bucket_count * sizeof(*next));
+    //A bit per position, so the positions stay in the cache while displacements are tried
+    uint64_t* taken = calloc(count / 64 + 1, sizeof(*taken));
+    uint32_t* slots = NULL;
+    ImageResult result = starts == NULL || keys == NULL || next == NULL || taken == NULL ? IMAGE_OUT_OF_MEMORY :
+                         IMAGE_SUCCESS;
+    uint32_t biggest = 0;
+    for (uint32_t i = 0; result == IMAGE_SUCCESS && i < count; i++)
+    {
+        starts[imagePerfectBucket(hashes[i], bucket_count) + 1]++;
+    }
+    for (uint32_t b = 0; result == IMAGE_SUCCESS && b < bucket_count; b++)
+    {
+        biggest = starts[b + 1] > biggest ? starts[b + 1] : biggest;
+        starts[b + 1] += starts[b];
+        next[b] = starts[b];
+        displacements[b] = 0;
+    }
+    for (uint32_t i = 0; result == IMAGE_SUCCESS && i < count; i++)
+    {
+        keys[next[imagePerfectBucket(hashes[i], bucket_count)]++] = i;
+    }
+    slots = result == IMAGE_SUCCESS ? malloc((biggest > 0 ? biggest : 1) * sizeof(*slots)) : NULL;
+    result = result == IMAGE_SUCCESS && slots == NULL ? IMAGE_OUT_OF_MEMORY : result;
+    //A pass over the buckets per size is cheap: buckets seldom have more than a dozen keys
+    for (uint32_t size = biggest; result == IMAGE_SUCCESS && size >= 2; size--)
+    {
+        for (uint32_t b = 0; result == IMAGE_SUCCESS && b < bucket_count; b++)
+        {
+            const uint32_t* bucket = keys + starts[b];
+            if (starts[b + 1] - starts[b] != size)
+            {
+                continue;
+            }
+            uint32_t displacement = 0;
+            for (; displacement < IMAGE_PERFECT_MAX_DISPLACEMENT; displacement++)
+            {
+                uint32_t placed = 0;
+                for (; placed < size; placed++)
+                {
+                    slots[placed] = imagePerfectPosition(hashes[bucket[placed]], displacement, count);
+                    bool collides = (taken[slots[placed] / 64] >> (slots[placed] % 64)) & 1;
+                    for (uint32_t j = 0; j < placed && !collides; j++)
+                    {
+                        collides = slots[j] == slots[placed];
+                    }
+                    if (collides)
+                    {
+                        break;
+                    }
+                }
+                if (placed == size)
+                {
+                    break;
+                }
+                if (displacement == 0)
+                {
+                    //Keys with the same hash collide with any displacement
+                    for (uint32_t j = 0; j < size * size && result == IMAGE_SUCCESS; j++)
+                    {
+                        result = j / size < j % size && hashes[bucket[j / size]] == hashes[bucket[j % size]] ?
+                                 IMAGE_ERROR : IMAGE_SUCCESS;
+                    }
+                    if (result != IMAGE_SUCCESS)
+                    {
+                        break;
+                    }
+                }
+            }
+            if (result != IMAGE_SUCCESS || displacement == IMAGE_PERFECT_MAX_DISPLACEMENT)
+            {
+                result = IMAGE_ERROR;
+                break;
+            }
+            displacements[b] = displacement;
+            for (uint32_t j = 0; j < size; j++)
+            {
+                taken[slots[j] / 64] |= (uint64_t)1 << (slots[j] % 64);
+                positions[bucket[j]] = slots[j];
+            }
+        }
+    }
+    //The buckets of one key fill the positions which are left
+    uint32_t free_position = 0;
+    for (uint32_t b = 0; result == IMAGE_SUCCESS && b < bucket_count; b++)
+    {
+        if (starts[b + 1] - starts[b] != 1)
+        {
+            continue;
+        }
+        while ((taken[free_position / 64] >> (free_position % 64)) & 1)
+        {
+            free_position++;
+        }
+        taken[free_position / 64] |= (uint64_t)1 << (free_position % 64);
+        positions[keys[starts[b]]] = free_position;
+        displacements[b] = IMAGE_PERFECT_DIRECT | free_position;
+    }
+    free(starts);
+    free(keys);
+    free(next);
+    free(taken);
+    free(slots);
+    return result;
+}
+
+//--------------------IMAGE-FUNCTIONS--------------------//
+ImageResult imageWrite(const ImagePairs* pairs, uint32_t index_size, FILE* file)
+{
+    int count = pairs->count;
+    ImageSlot* slots = malloc(index_size * sizeof(*slots));
+    uint64_t* records = malloc((count > 0 ? count : 1) * sizeof(*records));
+    if (slots == NULL || records == NULL)
+    {
+        free(slots);
+        free(records);
+        return IMAGE_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < index_size; i++)
+    {
+        slots[i].position = IMAGE_EMPTY_SLOT;
+    }
+    ImageHeader header = {IMAGE_MAGIC, IMAGE_VERSION, pairs->counters != NULL ? IMAGE_COUNTERS : 0, index_size,
+                          count, sizeof(ImageHeader), 0, 0};
+    header.records_offset = header.index_offset + (uint64_t)index_size * sizeof(*slots);
+    //The first pass places the records and fills the index
+    uint64_t offset = header.records_offset + (uint64_t)count * sizeof(*records);
+    for (int position = 0; position < count; position++)
+    {
+        uint32_t slot = pairs->hashes[position] & (index_size - 1);
+        while (slots[slot].position != IMAGE_EMPTY_SLOT)
+        {
+            slot = (slot + 1) & (index_size - 1);
+        }
+        slots[slot].hash = pairs->hashes[position];
+        slots[slot].position = position;
+        records[position] = offset;
+        offset = imageRecordEnd(pairs, position, offset);
+    }
+    header.size = IMAGE_ALIGN(offset) + IMAGE_TRAILER;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(slots, sizeof(*slots), index_size, file) == index_size &&
+                   fwrite(records, sizeof(*records), count, file) == (size_t)count;
+    free(slots);
+    free(records);
+    //The second pass writes the records
+    static const char zeros[IMAGE_ALIGNMENT + IMAGE_TRAILER] = {0};
+    offset = header.records_offset + (uint64_t)count * sizeof(uint64_t);
+    for (int position = 0; written && position < count; position++)
+    {
+        size_t key_size = strlen(pairs->keys[position]) + 1;
+        written = fwrite(pairs->keys[position], 1, key_size, file) == key_size;
+        offset += key_size;
+        if (pairs->counters != NULL)
+        {
+            size_t padding = IMAGE_ALIGN(offset) - offset;
+            written = written && fwrite(zeros, 1, padding, file) == padding &&
+                      fwrite(&pairs->counters[position], sizeof(int64_t), 1, file) == 1;
+            offset += padding + sizeof(int64_t);
+        }
+        else
+        {
+            size_t value_size = strlen(pairs->values[position]) + 1;
+            written = written && fwrite(pairs->values[position], 1, value_size, file) == value_size;
+            offset += value_size;
+        }
+    }
+    size_t padding = header.size - offset;
+    return written && fwrite(zeros, 1, padding, file) == padding ? IMAGE_SUCCESS : IMAGE_ERROR;
+}
+
+bool imageDump(Image image, FILE* file)
+{
+    return fwrite(image->base, 1, image->length, file) == image->length;
+}
+
+Image imageOpen(const char* path)
+{
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        return NULL;
+    }
+    struct stat status;
+    void* base = MAP_FAILED;
+    if (fstat(file, &status) == 0 && (uint64_t)status.st_size >= sizeof(ImageHeader) + IMAGE_TRAILER &&
+        (uint64_t)status.st_size <= SIZE_MAX)
+    {
+        base = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    }
+    close(file);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+    Image image = imageIsValid(base, status.st_size) ? imageCreate(base, status.st_size, false) : NULL;
+    if (image == NULL)
+    {
+        munmap(base, status.st_size);
+    }
+    return image;
+}
+
+Image imageFreeze(const ImagePairs* pairs)
+{
+    int count = pairs->count;
+    size_t array_count = count > 0 ? count : 1;
+    uint32_t bucket_count = (uint32_t)(count / IMAGE_PERFECT_BUCKET_SIZE) + 1;
+    ImageHeader header = {IMAGE_MAGIC, IMAGE_VERSION, (pairs->counters != NULL ? IMAGE_COUNTERS : 0) | IMAGE_PERFECT,
+                          bucket_count, count, sizeof(ImageHeader), 0, 0};
+    header.records_offset = IMAGE_ALIGN(header.index_offset + sizeof(uint64_t) + bucket_count * sizeof(uint32_t));
+    uint64_t* hashes = malloc(array_count * sizeof(*hashes));
+    uint32_t* positions = malloc(array_count * sizeof(*positions));
+    uint32_t* order = malloc(array_count * sizeof(*order));
+    bool allocated = hashes != NULL && positions != NULL && order != NULL;
+    //The records are measured, and the keys hashed with the first seed, in a single pass
+    uint64_t offset = header.records_offset + (uint64_t)count * sizeof(uint64_t);
+    for (int i = 0; allocated && i < count; i++)
+    {
+        offset = imageRecordEnd(pairs, i, offset);
+        hashes[i] = imagePerfectHash(pairs->keys[i], 0);
+    }
+    header.size = IMAGE_ALIGN(offset) + IMAGE_TRAILER;
+    unsigned char* base = allocated ? calloc(1, header.size) : NULL;
+    ImageResult result = base != NULL ? IMAGE_ERROR : IMAGE_OUT_OF_MEMORY;
+    uint64_t seed = 0;
+    uint32_t* displacements = base != NULL ? (uint32_t*)(base + header.index_offset + sizeof(uint64_t)) : NULL;
+    for (int attempt = 0; result == IMAGE_ERROR && attempt < IMAGE_PERFECT_MAX_SEEDS; attempt++)
+    {
+        seed = attempt * 0x9e3779b97f4a7c15ull;
+        for (int i = 0; attempt > 0 && i < count; i++)
+        {
+            hashes[i] = imagePerfectHash(pairs->keys[i], seed);
+        }
+        result = imagePerfectBuild(hashes, count, bucket_count, displacements, positions);
+    }
+    if (result == IMAGE_SUCCESS)
+    {
+        memcpy(base, &header, sizeof(header));
+        memcpy(base + header.index_offset, &seed, sizeof(seed));
+        for (int i = 0; i < count; i++)
+        {
+            order[positions[i]] = i;
+        }
+        //The records are laid out in the order of their positions, like those of imageWrite
+        uint64_t* records = (uint64_t*)(base + header.records_offset);
+        offset = header.records_offset + (uint64_t)count * sizeof(uint64_t);
+        for (int position = 0; position < count; position++)
+        {
+            uint32_t i = order[position];
+            size_t key_size = strlen(pairs->keys[i]) + 1;
+            records[position] = offset;
+            memcpy(base + offset, pairs->keys[i], key_size);
+            offset += key_size;
+            if (pairs->counters != NULL)
+            {
+                offset = IMAGE_ALIGN(offset);
+                memcpy(base + offset, &pairs->counters[i], sizeof(int64_t));
+                offset += sizeof(int64_t);
+            }
+            else
+            {
+                size_t value_size = strlen(pairs->values[i]) + 1;
+                memcpy(base + offset, pairs->values[i], value_size);
+                offset += value_size;
+            }
+        }
+    }
+    free(hashes);
+    free(positions);
+    free(order);
+    Image image = result == IMAGE_SUCCESS ? imageCreate(base, header.size, true) : NULL;
+    if (image == NULL)
+    {
+        free(base);
+    }
+    return image;
+}
+
+Image imageShare(Image image)
+{
+    IMAGE_REFCOUNT_INCREMENT(image->refcount);
+    return image;
+}
+
+void imageDestroy(Image image)
+{
+    if (image == NULL || IMAGE_REFCOUNT_DECREMENT(image->refcount) > 0)
+    {
+        return;
+    }
+    if (image->allocated)
+    {
+        free((void*)image->base);
+    }
+    else
+    {
+        munmap((void*)image->base, image->length);
+    }
+    free(image);
+}
+
+int imageGetCount(Image image)
+{
+    return image->count;
+}
+
+bool imageIsCounters(Image image)
+{
+    return image->counters;
+}
+
+int imageFind(Image image, const char* key, uint32_t hash, int* probes, int* comparisons)
+{
+    *probes = 1;
+    *comparisons = 0;
+    if (image->displacements != NULL)
+    {
+        if (image->count == 0)
+        {
+            return IMAGE_NO_POSITION;
+        }
+        uint64_t perfect_hash = imagePerfectHash(key, image->seed);
+        uint32_t displacement = image->displacements[imagePerfectBucket(perfect_hash, image->index_size)];
+        uint32_t position = (displacement & IMAGE_PERFECT_DIRECT) != 0 ? displacement & ~IMAGE_PERFECT_DIRECT :
+                            imagePerfectPosition(perfect_hash, displacement, image->count);
+        if (position >= (uint32_t)image->count)
+        {
+            return IMAGE_NO_POSITION;
+        }
+        *comparisons = 1;
+        return strcmp(key, imageGetKey(image, position)) == 0 ? (int)position : IMAGE_NO_POSITION;
+    }
+    uint32_t mask = image->index_size - 1;
+    uint32_t slot = hash & mask;
+    //The probes are bounded, so even a damaged image with no unused slot cannot loop forever
+    uint32_t probe = 0;
+    for (; probe < image->index_size && image->slots[slot].position != IMAGE_EMPTY_SLOT; probe++)
+    {
+        int position = image->slots[slot].position;
+        if (image->slots[slot].hash == hash && position >= 0 && position < image->count)
+        {
+            ++*comparisons;
+            if (strcmp(key, imageGetKey(image, position)) == 0)
+            {
+                *probes = probe + 1;
+                return position;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    *probes = probe + 1;
+    return IMAGE_NO_POSITION;
+}
+
+const char* imageGetKey(Image image, int position)
+{
+    uint64_t offset = image->records[position];
+    if (offset >= image->length - IMAGE_TRAILER)
+    {
+        offset = image->length - IMAGE_TRAILER;
+    }
+    return (const char*)image->base + offset;
+}
+
+const char* imageGetValue(Image image, int position)
+{
+    const char* key = imageGetKey(image, position);
+    return key + strlen(key) + 1;
+}
+
+int64_t imageGetInt(Image image, int position)
+{
+    const char* key = imageGetKey(image, position);
+    size_t offset = IMAGE_ALIGN((size_t)((const unsigned char*)key - image->base) + strlen(key) + 1);
+    int64_t value;
+    memcpy(&value, image->base + offset, sizeof(value));
+    return value;
+}
+
+size_t imageGetSize(Image image, size_t* index_bytes, size_t* file_bytes)
+{
+    *index_bytes = image->displacements != NULL ? sizeof(uint64_t) + (size_t)image->index_size * sizeof(uint32_t) :
+                   (size_t)image->index_size * sizeof(ImageSlot);
+    *file_bytes = image->length;
+    return sizeof(*image);
+}
\ No newline at end of file
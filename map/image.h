@@ -0,0 +1,182 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+* Map Image
+*
+* Reads and writes the binary image of a map: a file which holds the pairs of
+* a map together with an index, so a map is opened by mapping the file
+* instead of reading it. An index is either a hash index, probed linearly
+* from the owner's hash of a key, or (in a frozen image) a minimal perfect
+* hash, which gives every key the only position it may be in.
+*
+* The following functions are available:
+*   imageWrite		- Writes the image of pairs, with a hash index, to a file.
+*   imageDump		- Writes an image to a file as it is.
+*   imageOpen		- Maps an image file.
+*   imageFreeze		- Builds the image of pairs, with a perfect hash, in memory.
+*   imageShare		- Adds an owner to an image.
+*   imageDestroy	- Removes an owner of an image, and frees it with the last one.
+*   imageGetCount	- Returns the number of pairs of an image.
+*   imageIsCounters	- Returns whether the values of an image are counters.
+*   imageFind		- Returns the position of a key.
+*   imageGetKey		- Returns the key of a position.
+*   imageGetValue	- Returns the value of a position.
+*   imageGetInt		- Returns the counter of a position.
+*   imageGetSize	- Returns the bytes an image uses.
+*
+* An image is never changed once it is built, so it may be read by any number
+* of threads. It is reference counted like an arena: imageOpen and imageFreeze
+* give it a single owner, imageShare adds one and imageDestroy removes one.
+* The strings it returns are valid until its last owner destroys it.
+*/
+
+/** Returned by imageFind for a key which is not in the image */
+#define IMAGE_NO_POSITION -1
+
+typedef struct image_t *Image;
+
+/** The results of the functions which tell a failed allocation apart */
+typedef enum ImageResult_t {
+    IMAGE_SUCCESS,
+    IMAGE_OUT_OF_MEMORY,
+    IMAGE_ERROR
+} ImageResult;
+
+/**
+ * The pairs an image is built from, in the order of their positions.
+ * A pair of a counters map has a counter instead of a value: its 'values' is
+ * NULL and its 'counters' is not, and the other way around.
+ */
+typedef struct ImagePairs_t {
+    int count;
+    const char** keys;
+    const char** values;
+    int64_t* counters;
+    uint32_t* hashes; //The owner's hash of every key, for the hash index of imageWrite
+} ImagePairs;
+
+/**
+ * Writes the image of pairs, with a hash index, to the current position of a file.
+ * @param pairs - The pairs, with their hashes.
+ * @param index_size - The number of slots of the index (a power of 2, more than
+ *      the number of pairs).
+ * @param file - The file to write to.
+ * @return
+ * IMAGE_OUT_OF_MEMORY if an allocation failed, IMAGE_ERROR if writing failed,
+ * IMAGE_SUCCESS otherwise.
+ */
+ImageResult imageWrite(const ImagePairs* pairs, uint32_t index_size, FILE* file);
+
+/**
+ * Writes an image to the current position of a file as it is, so it keeps its index.
+ * @param image - The image to write.
+ * @param file - The file to write to.
+ * @return
+ * false if writing failed, true otherwise.
+ */
+bool imageDump(Image image, FILE* file);
+
+/**
+ * Maps an image file. Nothing but its header is read: the index and the pairs
+ * are paged in by the lookups which need them.
+ * @param path - The file, as written by imageWrite or imageDump.
+ * @return
+ * NULL - if the file could not be opened or mapped, is not an image, or an
+ * allocation failed.
+ * A new image with a single owner otherwise.
+ */
+Image imageOpen(const char* path);
+
+/**
+ * Builds the image of pairs, with a minimal perfect hash for index, in memory.
+ * The pairs are laid out in the order of their positions in the perfect hash.
+ * @param pairs - The pairs ('hashes' is not used).
+ * @return
+ * NULL - if an allocation failed, or no perfect hash of the keys was found
+ * (as when a key is there twice).
+ * A new image with a single owner otherwise.
+ */
+Image imageFreeze(const ImagePairs* pairs);
+
+/**
+ * @param image - The image to share.
+ * @return
+ * The same image, with one more owner.
+ */
+Image imageShare(Image image);
+
+/**
+ * @param image - The image to release. Once its last owner released it, it is
+ *      unmapped (or freed). If NULL nothing is done.
+ */
+void imageDestroy(Image image);
+
+/**
+ * @param image - The image to measure.
+ * @return
+ * The number of pairs of the image, at positions 0 to this number - 1.
+ */
+int imageGetCount(Image image);
+
+/**
+ * @param image - The image to check.
+ * @return
+ * true if the image holds counters instead of values.
+ */
+bool imageIsCounters(Image image);
+
+/**
+ * Looks a key up in the index of an image. A perfect hash gives the only
+ * position the key may be in, which costs one lookup and one comparison.
+ * @param image - The image to search.
+ * @param key - The key to find.
+ * @param hash - The owner's hash of the key (not used with a perfect hash).
+ * @param probes - Set to the number of slots looked at.
+ * @param comparisons - Set to the number of keys compared.
+ * @return
+ * IMAGE_NO_POSITION if the key is not in the image, its position otherwise.
+ */
+int imageFind(Image image, const char* key, uint32_t hash, int* probes, int* comparisons);
+
+/**
+ * @param image - The image to read.
+ * @param position - A position of the image.
+ * @return
+ * The key of that position. A pair whose record is outside of the file reads
+ * as an empty key and value (or 0).
+ */
+const char* imageGetKey(Image image, int position);
+
+/**
+ * @param image - The image to read, which does not hold counters.
+ * @param position - A position of the image.
+ * @return
+ * The value of that position.
+ */
+const char* imageGetValue(Image image, int position);
+
+/**
+ * @param image - The image to read, which holds counters.
+ * @param position - A position of the image.
+ * @return
+ * The counter of that position.
+ */
+int64_t imageGetInt(Image image, int position);
+
+/**
+ * @param image - The image to measure.
+ * @param index_bytes - Set to the bytes of its index.
+ * @param file_bytes - Set to the bytes of the whole image (the index included),
+ *      which are in the page cache unless the image was built by imageFreeze.
+ * @return
+ * The bytes of the record the image keeps in the heap.
+ */
+size_t imageGetSize(Image image, size_t* index_bytes, size_t* file_bytes);
+
+#endif
\ No newline at end of file
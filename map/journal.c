@@ -0,0 +1,529 @@
+#define _DEFAULT_SOURCE
+#include "journal.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** The bytes in front of the key of every record: checksum, type, key size and value size */
+#define JOURNAL_HEADER_SIZE 13
+
+/** The size of the buffer of a journal which was just created */
+#define JOURNAL_MIN_BUFFER_SIZE 4096
+
+//--------------------JOURNAL-STRUCT--------------------//
+/**
+ * A log file and the changes which are not written to it yet.
+ *
+ * 'lock' guards the buffers and the flags. 'file_lock' is held while a batch is
+ * written and synced: a flush takes it before it swaps the buffers, so the
+ * batches reach the file in order, and appends go on meanwhile. Nothing takes
+ * 'file_lock' while it holds 'lock'.
+ */
+struct journal_t
+{
+    char* path;
+    char* rotated_path;
+    int file;
+    size_t file_size;
+    char* buffer; //The changes which were appended since the last flush
+    size_t used;
+    size_t capacity;
+    char* spare; //The buffer of the batch being written
+    size_t spare_capacity;
+    int pending; //The changes in 'buffer'
+    int batch;
+    int delay_ms;
+    size_t compact_size;
+    JournalCompactFunction compact;
+    void* context;
+    bool failed; //A write failed, so the journal takes no more changes
+    bool stopping;
+    bool compacting;
+    pthread_mutex_t lock;
+    pthread_mutex_t file_lock;
+    pthread_cond_t wake;
+    pthread_t flusher;
+    bool has_flusher;
+    pthread_t compactor;
+    bool has_compactor;
+};
+
+static uint32_t journalChecksum(const char* record, size_t size);
+static char* journalRotatedPath(const char* path);
+static bool journalSyncDirectory(const char* path);
+static bool journalWriteAll(int file, const char* data, size_t size);
+static long journalReplayFile(const char* path, JournalReplayFunction replay, void* context);
+static bool journalFlush(Journal journal);
+static void journalStartCompaction(Journal journal);
+static void* journalFlusher(void* argument);
+static void* journalCompactor(void* argument);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @return
+ * The FNV-1a hash of a record, everything but its checksum.
+ */
+static uint32_t journalChecksum(const char* record, size_t size)
+{
+    return hashBytes(HASH_OFFSET_BASIS, record + sizeof(uint32_t), size - sizeof(uint32_t));
+}
+
+/**
+ * @return
+ * A new string with the path of the rotated log, NULL if the allocation failed.
+ */
+static char* journalRotatedPath(const char* path)
+{
+    size_t size = strlen(path);
+    char* rotated = malloc(size + sizeof(JOURNAL_ROTATED_SUFFIX));
+    if (rotated != NULL)
+    {
+        memcpy(rotated, path, size);
+        memcpy(rotated + size, JOURNAL_ROTATED_SUFFIX, sizeof(JOURNAL_ROTATED_SUFFIX));
+    }
+    return rotated;
+}
+
+/**
+ * Syncs the directory of a file, so a file which was just created, renamed or
+ * deleted stays that way after a crash.
+ */
+static bool journalSyncDirectory(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    char* directory = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : (size_t)(slash - path));
+    if (directory == NULL)
+    {
+        return false;
+    }
+    int file = open(directory, O_RDONLY);
+    free(directory);
+    if (file < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(file) == 0;
+    close(file);
+    return synced;
+}
+
+/**
+ * Writes all the bytes, going on after partial writes and interruptions.
+ */
+static bool journalWriteAll(int file, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = write(file, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/**
+ * Passes the records of one file to 'replay', up to the first one which is cut
+ * short or does not match its checksum.
+ * @return
+ * The number of records replayed, -1 on failure.
+ */
+static long journalReplayFile(const char* path, JournalReplayFunction replay, void* context)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+    char* data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = malloc(size > 0 ? size : 1);
+        if (data != NULL && fread(data, 1, size, file) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    if (data == NULL)
+    {
+        return -1;
+    }
+    //The key and the value are copied out, to end them with '\0'
+    char* strings = NULL;
+    size_t strings_size = 0;
+    bool success = true;
+    long records = 0;
+    size_t offset = 0;
+    while (success && (size_t)size - offset >= JOURNAL_HEADER_SIZE)
+    {
+        const char* record = data + offset;
+        uint32_t checksum, key_size, value_size;
+        unsigned char type = (unsigned char)record[sizeof(checksum)];
+        memcpy(&checksum, record, sizeof(checksum));
+        memcpy(&key_size, record + sizeof(checksum) + 1, sizeof(key_size));
+        memcpy(&value_size, record + sizeof(checksum) + 1 + sizeof(key_size), sizeof(value_size));
+        size_t record_size = JOURNAL_HEADER_SIZE + (size_t)key_size + value_size;
+        if (type > JOURNAL_CLEAR || record_size > (size_t)size - offset ||
+            journalChecksum(record, record_size) != checksum)
+        {
+            break;
+        }
+        if (strings_size < (size_t)key_size + value_size + 2)
+        {
+            free(strings);
+            strings_size = (size_t)key_size + value_size + 2;
+            strings = malloc(strings_size);
+            if (strings == NULL)
+            {
+                success = false;
+                break;
+            }
+        }
+        char* key = strings;
+        char* value = strings + key_size + 1;
+        memcpy(key, record + JOURNAL_HEADER_SIZE, key_size);
+        key[key_size] = '\0';
+        memcpy(value, record + JOURNAL_HEADER_SIZE + key_size, value_size);
+        value[value_size] = '\0';
+        success = replay(context, (JournalRecordType)type, type == JOURNAL_CLEAR ? NULL : key,
+                         type == JOURNAL_PUT ? value : NULL);
+        offset += record_size;
+        records++;
+    }
+    free(strings);
+    free(data);
+    return success ? records : -1;
+}
+
+/**
+ * Writes the buffered changes to the file and syncs it, then starts a
+ * compaction if the file grew past its size.
+ * @return
+ * false if writing failed now or before.
+ */
+static bool journalFlush(Journal journal)
+{
+    pthread_mutex_lock(&journal->file_lock);
+    pthread_mutex_lock(&journal->lock);
+    char* batch = journal->buffer;
+    size_t size = journal->used;
+    journal->buffer = journal->spare;
+    journal->spare = batch;
+    size_t capacity = journal->capacity;
+    journal->capacity = journal->spare_capacity;
+    journal->spare_capacity = capacity;
+    journal->used = 0;
+    journal->pending = 0;
+    bool success = !journal->failed;
+    pthread_mutex_unlock(&journal->lock);
+    if (success && size > 0)
+    {
+        success = journalWriteAll(journal->file, batch, size) && fdatasync(journal->file) == 0;
+        journal->file_size += size;
+    }
+    bool full = journal->compact_size > 0 && journal->file_size >= journal->compact_size;
+    pthread_mutex_unlock(&journal->file_lock);
+    pthread_mutex_lock(&journal->lock);
+    if (!success)
+    {
+        journal->failed = true;
+    }
+    else if (full)
+    {
+        journalStartCompaction(journal);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return success;
+}
+
+/**
+ * Starts the compactor thread, unless it is running already. Called with 'lock' held.
+ */
+static void journalStartCompaction(Journal journal)
+{
+    if (journal->compacting || journal->stopping || journal->compact == NULL)
+    {
+        return;
+    }
+    if (journal->has_compactor)
+    {
+        //The last compaction is done, only its thread is left
+        pthread_join(journal->compactor, NULL);
+        journal->has_compactor = false;
+    }
+    if (pthread_create(&journal->compactor, NULL, journalCompactor, journal) == 0)
+    {
+        journal->has_compactor = true;
+        journal->compacting = true;
+    }
+}
+
+/**
+ * The background thread which syncs the buffered changes 'delay_ms' after they were appended.
+ */
+static void* journalFlusher(void* argument)
+{
+    Journal journal = argument;
+    pthread_mutex_lock(&journal->lock);
+    while (!journal->stopping)
+    {
+        if (journal->pending == 0)
+        {
+            pthread_cond_wait(&journal->wake, &journal->lock);
+            continue;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += journal->delay_ms / 1000;
+        deadline.tv_nsec += (long)(journal->delay_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (!journal->stopping && journal->pending > 0 &&
+               pthread_cond_timedwait(&journal->wake, &journal->lock, &deadline) != ETIMEDOUT)
+        {
+        }
+        if (!journal->stopping && journal->pending > 0)
+        {
+            pthread_mutex_unlock(&journal->lock);
+            journalFlush(journal);
+            pthread_mutex_lock(&journal->lock);
+        }
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+/**
+ * The background thread which runs one compaction.
+ */
+static void* journalCompactor(void* argument)
+{
+    Journal journal = argument;
+    journal->compact(journal->context);
+    pthread_mutex_lock(&journal->lock);
+    journal->compacting = false;
+    pthread_mutex_unlock(&journal->lock);
+    return NULL;
+}
+
+//--------------------JOURNAL-FUNCTIONS--------------------//
+long journalReplay(const char* path, JournalReplayFunction replay, void* context)
+{
+    char* rotated = journalRotatedPath(path);
+    if (rotated == NULL)
+    {
+        return -1;
+    }
+    long rotated_records = journalReplayFile(rotated, replay, context);
+    long records = rotated_records >= 0 ? journalReplayFile(path, replay, context) : -1;
+    free(rotated);
+    return records >= 0 ? rotated_records + records : -1;
+}
+
+bool journalDiscard(const char* path)
+{
+    char* rotated = journalRotatedPath(path);
+    if (rotated == NULL)
+    {
+        return false;
+    }
+    bool success = (remove(rotated) == 0 || errno == ENOENT) && (remove(path) == 0 || errno == ENOENT);
+    free(rotated);
+    return success && journalSyncDirectory(path);
+}
+
+Journal journalCreate(const char* path, int batch, int delay_ms, size_t compact_size,
+                      JournalCompactFunction compact, void* context)
+{
+    Journal journal = calloc(1, sizeof(*journal));
+    if (journal == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&journal->lock, NULL);
+    pthread_mutex_init(&journal->file_lock, NULL);
+    pthread_cond_init(&journal->wake, NULL);
+    journal->path = strdup(path);
+    journal->rotated_path = journalRotatedPath(path);
+    journal->buffer = malloc(JOURNAL_MIN_BUFFER_SIZE);
+    journal->spare = malloc(JOURNAL_MIN_BUFFER_SIZE);
+    journal->file = -1;
+    if (journal->path == NULL || journal->rotated_path == NULL || journal->buffer == NULL || journal->spare == NULL)
+    {
+        journalDestroy(journal);
+        return NULL;
+    }
+    journal->capacity = journal->spare_capacity = JOURNAL_MIN_BUFFER_SIZE;
+    journal->batch = batch > 0 ? batch : 1;
+    journal->delay_ms = delay_ms;
+    journal->compact_size = compact_size;
+    journal->compact = compact;
+    journal->context = context;
+    journal->file = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (journal->file < 0 || !journalSyncDirectory(path) ||
+        (delay_ms > 0 && pthread_create(&journal->flusher, NULL, journalFlusher, journal) != 0))
+    {
+        journalDestroy(journal);
+        return NULL;
+    }
+    journal->has_flusher = delay_ms > 0;
+    return journal;
+}
+
+bool journalDestroy(Journal journal)
+{
+    if (journal == NULL)
+    {
+        return true;
+    }
+    pthread_mutex_lock(&journal->lock);
+    journal->stopping = true;
+    pthread_cond_signal(&journal->wake);
+    pthread_mutex_unlock(&journal->lock);
+    if (journal->has_flusher)
+    {
+        pthread_join(journal->flusher, NULL);
+    }
+    //No compaction starts once the journal is stopping
+    pthread_mutex_lock(&journal->lock);
+    bool has_compactor = journal->has_compactor;
+    pthread_mutex_unlock(&journal->lock);
+    if (has_compactor)
+    {
+        pthread_join(journal->compactor, NULL);
+    }
+    bool success = true;
+    if (journal->file >= 0)
+    {
+        success = journalFlush(journal);
+        close(journal->file);
+    }
+    pthread_mutex_destroy(&journal->lock);
+    pthread_mutex_destroy(&journal->file_lock);
+    pthread_cond_destroy(&journal->wake);
+    free(journal->path);
+    free(journal->rotated_path);
+    free(journal->buffer);
+    free(journal->spare);
+    free(journal);
+    return success;
+}
+
+bool journalAppend(Journal journal, JournalRecordType type, const char* key, const char* value)
+{
+    key = type == JOURNAL_CLEAR ? "" : key;
+    value = type == JOURNAL_PUT ? value : "";
+    uint32_t key_size = (uint32_t)strlen(key);
+    uint32_t value_size = (uint32_t)strlen(value);
+    size_t record_size = JOURNAL_HEADER_SIZE + (size_t)key_size + value_size;
+    pthread_mutex_lock(&journal->lock);
+    if (journal->failed)
+    {
+        pthread_mutex_unlock(&journal->lock);
+        return false;
+    }
+    if (journal->used + record_size > journal->capacity)
+    {
+        size_t capacity = journal->capacity;
+        while (journal->used + record_size > capacity)
+        {
+            capacity *= 2;
+        }
+        char* buffer = realloc(journal->buffer, capacity);
+        if (buffer == NULL)
+        {
+            pthread_mutex_unlock(&journal->lock);
+            return false;
+        }
+        journal->buffer = buffer;
+        journal->capacity = capacity;
+    }
+    char* record = journal->buffer + journal->used;
+    record[sizeof(uint32_t)] = (char)type;
+    memcpy(record + sizeof(uint32_t) + 1, &key_size, sizeof(key_size));
+    memcpy(record + sizeof(uint32_t) + 1 + sizeof(key_size), &value_size, sizeof(value_size));
+    memcpy(record + JOURNAL_HEADER_SIZE, key, key_size);
+    memcpy(record + JOURNAL_HEADER_SIZE + key_size, value, value_size);
+    uint32_t checksum = journalChecksum(record, record_size);
+    memcpy(record, &checksum, sizeof(checksum));
+    journal->used += record_size;
+    bool full = ++journal->pending >= journal->batch;
+    if (journal->pending == 1 && journal->has_flusher)
+    {
+        pthread_cond_signal(&journal->wake);
+    }
+    pthread_mutex_unlock(&journal->lock);
+    return !full || journalFlush(journal);
+}
+
+bool journalSync(Journal journal)
+{
+    return journalFlush(journal);
+}
+
+bool journalRotate(Journal journal)
+{
+    if (!journalFlush(journal))
+    {
+        return false;
+    }
+    pthread_mutex_lock(&journal->file_lock);
+    bool success = true;
+    if (access(journal->rotated_path, F_OK) != 0)
+    {
+        success = rename(journal->path, journal->rotated_path) == 0;
+        if (success)
+        {
+            //From here on the journal must switch files: the old one only holds the rotated log
+            int file = open(journal->path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            success = file >= 0 && journalSyncDirectory(journal->path);
+            if (file >= 0)
+            {
+                close(journal->file);
+                journal->file = file;
+                journal->file_size = 0;
+            }
+            else
+            {
+                pthread_mutex_lock(&journal->lock);
+                journal->failed = true;
+                pthread_mutex_unlock(&journal->lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&journal->file_lock);
+    return success;
+}
+
+bool journalRemoveRotated(Journal journal)
+{
+    return (remove(journal->rotated_path) == 0 || errno == ENOENT) && journalSyncDirectory(journal->rotated_path);
+}
+
+size_t journalGetMemoryUsage(Journal journal)
+{
+    pthread_mutex_lock(&journal->lock);
+    size_t bytes = sizeof(*journal) + journal->capacity + journal->spare_capacity;
+    pthread_mutex_unlock(&journal->lock);
+    return bytes;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+* Write-Ahead Journal
+*
+* Implements an append-only log of changes, which is synced to the disk in
+* groups: changes are buffered, and the buffer is written and synced once it
+* holds a given number of them, or a given time after the first of them.
+*
+* The following functions are available:
+*   journalReplay	- Reads the changes of an existing log, in order.
+*   journalDiscard	- Deletes a log.
+*   journalCreate	- Starts a new empty log.
+*   journalDestroy	- Syncs the changes which are still buffered and closes the log.
+*   journalAppend	- Adds a change to the log.
+*   journalSync		- Writes and syncs all the buffered changes.
+*   journalRotate	- Moves the log aside and starts a new one, for compacting.
+*   journalRemoveRotated	- Deletes the log which was moved aside.
+*   journalGetMemoryUsage	- Returns the bytes the log uses in memory.
+*
+* A log at 'path' may have a second file, 'path' with JOURNAL_ROTATED_SUFFIX,
+* which holds the changes made before it was rotated. A record which was only
+* partly written when the process stopped, and everything after it, is
+* ignored when the log is replayed.
+*
+* Compacting works like this: once the log file grows past a given size, a
+* background thread calls the user's compact function. That function should
+* rotate the log at a moment when the changes in it match a state of the
+* user's data, save that state, and then remove the rotated log. Replaying a
+* change twice must give the same result as replaying it once, so a crash at
+* any point of the compaction loses nothing.
+*/
+
+/** The suffix of the file which holds a rotated log */
+#define JOURNAL_ROTATED_SUFFIX ".old"
+
+typedef struct journal_t *Journal;
+
+/** The kinds of changes a journal records */
+typedef enum JournalRecordType_t {
+    JOURNAL_PUT,
+    JOURNAL_REMOVE,
+    JOURNAL_CLEAR
+} JournalRecordType;
+
+/**
+ * Gets the changes of a log while it is replayed.
+ * 'key' is NULL for JOURNAL_CLEAR, 'value' is NULL for anything but JOURNAL_PUT.
+ * Returns false to stop the replay.
+ */
+typedef bool (*JournalReplayFunction)(void* context, JournalRecordType type, const char* key, const char* value);
+
+/** Compacts the data of a journal, see above. Runs on a background thread */
+typedef void (*JournalCompactFunction)(void* context);
+
+/**
+ * Passes all the changes of the log at 'path' to 'replay', those of the rotated
+ * log first. A missing file is an empty log.
+ * @return
+ * -1 if a file could not be read, an allocation failed or 'replay' returned
+ * false. The number of changes replayed otherwise.
+ */
+long journalReplay(const char* path, JournalReplayFunction replay, void* context);
+
+/**
+ * Deletes the log at 'path' and its rotated log, if they exist.
+ * @return
+ * false if a file could not be deleted.
+ */
+bool journalDiscard(const char* path);
+
+/**
+ * Creates a new empty log at 'path' (an existing file is overwritten).
+ * @param batch - The buffered changes are synced once there are this many of
+ *      them (1 syncs every change before journalAppend returns).
+ * @param delay_ms - ...and at most this many milliseconds after they were
+ *      appended, by a background thread (0 for no background syncs).
+ * @param compact_size - 'compact' is called once the log file grows past this
+ *      many bytes (0 for never).
+ * @param compact - The compact function (may be NULL if compact_size is 0).
+ * @param context - Passed to 'compact'.
+ * @return
+ * NULL if the file could not be created, a thread could not be started or an
+ * allocation failed. The new journal otherwise.
+ */
+Journal journalCreate(const char* path, int batch, int delay_ms, size_t compact_size,
+                      JournalCompactFunction compact, void* context);
+
+/**
+ * Stops the background threads, syncs the changes which are still buffered
+ * and closes the log. If NULL nothing is done.
+ * @return
+ * false if the last sync failed.
+ */
+bool journalDestroy(Journal journal);
+
+/**
+ * Adds a change to the log. It is durable once the batch it belongs to is synced.
+ * @param key - The key of the change (ignored for JOURNAL_CLEAR).
+ * @param value - The value of a JOURNAL_PUT (ignored otherwise).
+ * @return
+ * false if an allocation failed, or writing the log failed now or before (a
+ * journal which failed to write does not take any more changes).
+ */
+bool journalAppend(Journal journal, JournalRecordType type, const char* key, const char* value);
+
+/**
+ * Writes and syncs all the buffered changes.
+ * @return
+ * false if writing the log failed now or before.
+ */
+bool journalSync(Journal journal);
+
+/**
+ * Syncs the log, renames it to the rotated log and starts a new empty log. If
+ * there still is a rotated log (its compaction failed), it is kept, and the log
+ * is only synced: saving the data still covers both logs.
+ * The caller must make sure no change is appended meanwhile.
+ * @return
+ * false if writing, renaming or creating a file failed.
+ */
+bool journalRotate(Journal journal);
+
+/**
+ * Deletes the rotated log, once the data it holds was saved.
+ * @return
+ * false if the file could not be deleted.
+ */
+bool journalRemoveRotated(Journal journal);
+
+/**
+ * @return
+ * The bytes of the journal and of its buffers.
+ */
+size_t journalGetMemoryUsage(Journal journal);
+
+#endif
\ No newline at end of file
@@ -1,12 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
 #include "map.h"
 #include "key.h"
+#include "hash.h"
+#include "arena.h"
+#include "epoch.h"
+#include "journal.h"
+#include "radix.h"
+#include "heap.h"
+#include "image.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h> 
+#include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
 
-/** The initial size of Key's array in a Map */
-#define MAP_INITIAL_SIZE 100
+#if !defined(MAP_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#elif !defined(MAP_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /** The pactor by which to expand the Key's array when needed */
 #define MAP_EXPAND_FACTOR 2
@@ -14,233 +28,4170 @@
 /** Return by 'mapFindKey' function when didn't finde such key */
 #define MAP_NO_SUCH_KEY -1
 
+/** The keys are stored in pages of 2^MAP_PAGE_BITS keys, which copies of a map share */
+#define MAP_PAGE_BITS 6
+#define MAP_PAGE_SIZE (1 << MAP_PAGE_BITS)
+#define MAP_PAGE_MASK (MAP_PAGE_SIZE - 1)
 
+/** The room for keys of a new page, which doubles until it reaches MAP_PAGE_SIZE */
+#define MAP_PAGE_MIN_CAPACITY 4
+
+/** The bytes of a page with room for 'capacity' keys */
+#define MAP_PAGE_BYTES(capacity) (sizeof(struct MapPage_t) + (capacity) * sizeof(Key))
+
+/** The bytes of a table with room for 'capacity' pages */
+#define MAP_TABLE_BYTES(capacity) (sizeof(struct MapTable_t) + (capacity) * sizeof(MapPage))
+
+/**
+ * The hash index is made of chunks of 2^MAP_INDEX_CHUNK_BITS slots (an index
+ * with fewer slots has a single chunk), which copies of a map share
+ */
+#define MAP_INDEX_CHUNK_BITS 10
+#define MAP_INDEX_CHUNK_SLOTS (1 << MAP_INDEX_CHUNK_BITS)
+#define MAP_INDEX_CHUNK_MASK (MAP_INDEX_CHUNK_SLOTS - 1)
+
+/** The number of chunks of an index of 'size' slots */
+#define MAP_INDEX_CHUNKS(size) (((size) + MAP_INDEX_CHUNK_MASK) >> MAP_INDEX_CHUNK_BITS)
+
+/** The bytes of an index of 'size' slots, not counting its chunks */
+#define MAP_INDEX_BYTES(size) (sizeof(struct MapIndex_t) + MAP_INDEX_CHUNKS(size) * sizeof(MapIndexChunk))
+
+/** The bytes of one chunk of an index of 'size' slots */
+#define MAP_INDEX_CHUNK_BYTES(size) \
+    (sizeof(struct MapIndexChunk_t) + ((size) < MAP_INDEX_CHUNK_SLOTS ? (size) : MAP_INDEX_CHUNK_SLOTS) * sizeof(MapSlot))
+
+/** The bytes of an index of 'size' slots, counting its chunks */
+#define MAP_INDEX_ALL_BYTES(size) (MAP_INDEX_BYTES(size) + MAP_INDEX_CHUNKS(size) * MAP_INDEX_CHUNK_BYTES(size))
+
+/** Slot number 'slot' of an index */
+#define MAP_SLOT(index, slot) ((index)->chunks[(slot) >> MAP_INDEX_CHUNK_BITS]->slots[(slot) & MAP_INDEX_CHUNK_MASK])
+
+/** The allocator the keys of a map are created with (NULL for malloc) */
+#define MAP_KEY_ALLOCATOR(map) ((map)->allocator.allocate != NULL ? &(map)->allocator : NULL)
+
+/**
+ * Maps with up to this many keys are searched by scanning the fingerprints,
+ * the hash index is only built once a map grows past it.
+ * All of their keys are in the first page.
+ */
+#define MAP_FINGERPRINT_THRESHOLD MAP_PAGE_SIZE
+
+/** Marks an unused slot in the hash index */
+#define MAP_EMPTY_SLOT -1
+
+/**
+ * Marks a slot of the old index of an incremental map whose key was moved to the
+ * new index or removed. Probing goes on past it, like past a used slot.
+ */
+#define MAP_MOVED_SLOT -2
+
+/** An incremental map starts growing its index once more than 1/MAP_REHASH_START_DIVISOR of it is used */
+#define MAP_REHASH_START_DIVISOR 2
+
+/** The number of slots an incremental map clears or moves in each put of a new key while it grows */
+#define MAP_REHASH_STEP 64
+
+/** The index is grown once more than LOAD_NUMERATOR/LOAD_DENOMINATOR of it is used */
+#define MAP_LOAD_NUMERATOR 3
+#define MAP_LOAD_DENOMINATOR 4
+
+/** The size of the first chunk of an arena map's arena */
+#define MAP_ARENA_CHUNK_SIZE (64 * 1024)
+
+/** 'mapSave' writes to a file with this suffix, and renames it over the old image once it is complete */
+#define MAP_IMAGE_TEMPORARY_SUFFIX ".tmp"
+
+/**
+ * 'mapCreateFromArrays' fills the index a part of this many slots at a time
+ * (a part fits in the cache), instead of in the order of the keys
+ */
+#define MAP_FILL_PART_SLOTS 4096
+
+/**
+ * The Bloom filter of a map (see 'mapEnableFilter') is split into blocks of one
+ * cache line, each of MAP_FILTER_WORDS words. A key sets one bit in every word
+ * of a single block, so checking it reads that one line.
+ */
+#define MAP_FILTER_BLOCK_BYTES 64
+#define MAP_FILTER_WORDS (MAP_FILTER_BLOCK_BYTES / sizeof(uint64_t))
+
+/** A filter has a block for every this many keys it was sized for (16 bits per key) */
+#define MAP_FILTER_KEYS_PER_BLOCK 32
+
+/** Picks the block of a key from its hash (the golden ratio, so every bit of the hash counts) */
+#define MAP_FILTER_BLOCK_MULTIPLIER 0x9e3779b1u
+
+/**
+ * The bits of removed keys stay set until the filter is rebuilt, which happens
+ * once there are more than 1/MAP_FILTER_STALE_DIVISOR as many of them as keys
+ */
+#define MAP_FILTER_STALE_DIVISOR 2
+
+/** The bytes of a filter of 'block_count' blocks, with room to align the first one */
+#define MAP_FILTER_BYTES(block_count) \
+    (sizeof(struct MapFilter_t) + ((size_t)(block_count) + 1) * MAP_FILTER_BLOCK_BYTES)
+
+/** The words of the first block of a filter, at the first aligned address of its room */
+#define MAP_FILTER_BLOCKS(filter) \
+    ((uint64_t*)(((uintptr_t)(filter)->room + MAP_FILTER_BLOCK_BYTES - 1) & \
+                 ~(uintptr_t)(MAP_FILTER_BLOCK_BYTES - 1)))
+
+/** The log of a journaled map is the path of its snapshot with this suffix */
+#define MAP_JOURNAL_SUFFIX ".log"
+
+/** The options of a journaled map opened without any */
+#define MAP_JOURNAL_DEFAULT_BATCH 64
+#define MAP_JOURNAL_DEFAULT_DELAY_MS 10
+#define MAP_JOURNAL_DEFAULT_COMPACT_BYTES (64 * 1024 * 1024)
+
+/** Two IDs are equal if they are the same pointer (as interned IDs are), or have the same characters */
+#define MAP_ID_EQUALS(id, other) ((id) == (other) || !strcmp(id, other))
+
+/** The fingerprint of a key is the top byte of its hash (the index uses the low bits) */
+#define MAP_FINGERPRINT(hash) ((unsigned char)((hash) >> 24))
+
+/** Pages, tables and indexes may be shared by maps used from different threads, so their counts are atomic */
+#if defined(__GNUC__)
+#define MAP_REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define MAP_REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#define MAP_REFCOUNT_LOAD(count) __atomic_load_n(&(count), __ATOMIC_ACQUIRE)
+#define MAP_SNAPSHOT_LOAD(snapshot) __atomic_load_n(&(snapshot), __ATOMIC_ACQUIRE)
+#define MAP_SNAPSHOT_PUBLISH(snapshot, value) __atomic_store_n(&(snapshot), value, __ATOMIC_RELEASE)
+#define MAP_FLAG_SET(flag) __atomic_store_n(&(flag), true, __ATOMIC_RELAXED)
+#else
+#define MAP_REFCOUNT_INCREMENT(count) (++(count))
+#define MAP_REFCOUNT_DECREMENT(count) (--(count))
+#define MAP_REFCOUNT_LOAD(count) (count)
+#define MAP_SNAPSHOT_LOAD(snapshot) (snapshot)
+#define MAP_SNAPSHOT_PUBLISH(snapshot, value) ((snapshot) = (value))
+#define MAP_FLAG_SET(flag) ((flag) = true)
+#endif
+
+/**
+ * Counting for 'mapGetStats', which exists only if the library is compiled
+ * with MAP_ENABLE_STATS; otherwise these macros are nothing. Lookups of
+ * concurrent and read-mostly maps run in many threads at once, so the counts
+ * are relaxed atomics (and the longest probe may miss a rare update).
+ */
+#if defined(MAP_ENABLE_STATS) && defined(__GNUC__)
+#define MAP_STATS_ADD(map, counter, count) __atomic_add_fetch(&(map)->stats.counter, (count), __ATOMIC_RELAXED)
+#define MAP_STATS_LOAD(map, counter) __atomic_load_n(&(map)->stats.counter, __ATOMIC_RELAXED)
+#define MAP_STATS_STORE(map, counter, value) __atomic_store_n(&(map)->stats.counter, (value), __ATOMIC_RELAXED)
+#elif defined(MAP_ENABLE_STATS)
+#define MAP_STATS_ADD(map, counter, count) ((map)->stats.counter += (count))
+#define MAP_STATS_LOAD(map, counter) ((map)->stats.counter)
+#define MAP_STATS_STORE(map, counter, value) ((map)->stats.counter = (value))
+#endif
+#ifdef MAP_ENABLE_STATS
+#define MAP_STATS_PROBE(map, length) \
+    do \
+    { \
+        MAP_STATS_ADD(map, probes, (length)); \
+        if ((uint64_t)(length) > MAP_STATS_LOAD(map, longest_probe)) \
+        { \
+            MAP_STATS_STORE(map, longest_probe, (length)); \
+        } \
+    } while (0)
+#define MAP_STATS_EQUALS(map, id, other) (MAP_STATS_ADD(map, comparisons, 1), MAP_ID_EQUALS(id, other))
+#else
+#define MAP_STATS_ADD(map, counter, count) ((void)0)
+#define MAP_STATS_PROBE(map, length) ((void)0)
+#define MAP_STATS_EQUALS(map, id, other) MAP_ID_EQUALS(id, other)
+#endif
 
 
 //--------------------MAP-STRUCT--------------------//
+/**
+ * A slot of the open-addressing hash index.
+ * 'position' is the index of the Key in the map's keys array, MAP_EMPTY_SLOT or
+ * MAP_MOVED_SLOT.
+ * The full hash is cached so probing rarely has to touch the Key itself.
+ */
+typedef struct MapSlot_t {
+    unsigned int hash;
+    int position;
+} MapSlot;
+
+/**
+ * 'count' consecutive keys of a map, and their fingerprints.
+ * A page with more than one owner is shared by copies of a map and is never
+ * changed; a map which needs to change it makes its own copy first.
+ * Only the last page of a map may be partly used, and it grows its room for keys
+ * from MAP_PAGE_MIN_CAPACITY up to MAP_PAGE_SIZE, so small maps stay small.
+ * The fingerprints always have the full size, so they can be scanned in whole blocks.
+ */
+typedef struct MapPage_t {
+    unsigned int refcount;
+    int count;
+    int capacity;
+    unsigned char fingerprints[MAP_PAGE_SIZE];
+    Key keys[];
+} *MapPage;
+
+/** The pages of a map (NULL for pages which were not needed yet), shared like a page */
+typedef struct MapTable_t {
+    unsigned int refcount;
+    int capacity;
+    MapPage pages[];
+} *MapTable;
+
+/** Consecutive slots of a hash index, shared like a page */
+typedef struct MapIndexChunk_t {
+    unsigned int refcount;
+    MapSlot slots[];
+} *MapIndexChunk;
+
+/**
+ * The hash index of a map, shared like a page. Slot s is in chunk number
+ * s / MAP_INDEX_CHUNK_SLOTS, so a change to a copy of a map copies only the
+ * chunks it writes to.
+ */
+typedef struct MapIndex_t {
+    unsigned int refcount;
+    int size;
+    bool shares_chunks; //Set once the index is copied, as both copies may then share each chunk
+    MapIndexChunk chunks[];
+} *MapIndex;
+
+/**
+ * The blocked Bloom filter of a map, shared like a page. Every key of the map
+ * has its bits set, so a key whose bits are not all set is not in the map.
+ */
+typedef struct MapFilter_t {
+    unsigned int refcount;
+    int capacity; //The keys it was sized for (MAP_FILTER_KEYS_PER_BLOCK per block)
+    int block_count;
+    unsigned char room[];
+} *MapFilter;
+
+/** Multiplied by the hash of a key to pick its bit in each word of its block */
+static const uint32_t mapFilterSalts[MAP_FILTER_WORDS] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                                          0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+
+/**
+ * The durable part of a map opened by 'mapOpenJournaled': every change is made
+ * on 'contents' and then appended to 'log'. The snapshot at 'path' and the log
+ * hold the contents together.
+ */
+typedef struct MapJournal_t {
+    Map contents;
+    Journal log;
+    char* path;
+    pthread_mutex_t lock; //Held by every change, so a compaction copies the contents between two changes
+} *MapJournal;
+
+/**
+ * The context of 'mapJournalFilter': the predicate of a mapRemoveIf on a
+ * journaled map, and the log of the keys it removes.
+ */
+typedef struct MapJournalFilter_t {
+    MapPredicate predicate;
+    void* context;
+    Journal log;
+    bool failed;
+} MapJournalFilter;
+
+/** What 'mapRadixVisit' passes on to the visitor of mapForEachPrefix */
+typedef struct MapPrefixVisit_t {
+    Map map;
+    MapVisitor visitor;
+    void* context;
+} MapPrefixVisit;
+
+/**
+ * The key in position p is table->pages[p / MAP_PAGE_SIZE]->keys[p % MAP_PAGE_SIZE],
+ * and positions 0 to size - 1 are all used.
+ */
 struct Map_t {
-    Key* keys;
+    MapTable table;
+    MapIndex index; //NULL while the map is small enough for a fingerprint scan
     int size;
-    int max_size;
     int iterator;
+    Arena arena; //NULL unless the map was created by 'mapCreateArena'
+    bool counters; //True if the map was created by 'mapCreateCounters', so its keys are integer keys
+    bool interned; //True if the map was created by 'mapCreateInterned', so its keys are interned keys
+    Map* stripes; //NULL unless the map was created by 'mapCreateConcurrent', whose keys are in its stripes
+    pthread_rwlock_t* locks; //locks[i] guards stripes[i]
+    int stripe_count;
+    Map snapshot; //NULL unless the map was created by 'mapCreateReadMostly': the version of the map readers see
+    Map retired; //Replaced snapshots of a read-mostly map (linked by this field), until no reader sees them
+    unsigned long retired_epoch; //For a replaced snapshot, the epoch from which no new reader sees it
+    unsigned int pins; //For a snapshot: the cursors and iterators walking it, which keep it from being freed once replaced
+    Map iterated; //NULL unless the internal iterator of a read-mostly map is walking: the snapshot it walks (pinned)
+    pthread_mutex_t* write_lock; //Serialises the writers of a read-mostly map
+    Image image; //NULL unless the map was opened by 'mapOpenMapped' (or built by 'mapFreeze'): the file which holds its keys
+    MapJournal journal; //NULL unless the map was opened by 'mapOpenJournaled'
+    Heap heap; //NULL unless the map was created by 'mapCreateCompact': the arrays which hold its elements (by position)
+    bool incremental; //True if the map was created by 'mapCreateIncremental', so it grows its index a step at a time
+    MapIndex next_index; //While an incremental map grows: the bigger index, whose slots are being cleared
+    MapIndex old_index; //Once they are: the replaced index, whose keys are being moved to 'index'
+    int rehash_slot; //The next slot of 'next_index' to clear, or of 'old_index' to move
+    KeyAllocator allocator; //Where the map and its keys get their memory ('allocate' is NULL for malloc)
+    Radix radix; //NULL unless the map was created by 'mapCreateRadix': the index of its keys, instead of 'index'
+    MapFilter filter; //NULL unless 'mapEnableFilter' was called: checked before the index by every lookup
+    int filter_stale; //The keys removed since the filter was built, whose bits are still set
+#ifdef MAP_ENABLE_STATS
+    MapStats stats; //The counts of the lookups and the growth of this map (not of its stripes or snapshot)
+#endif
 };
 
-static int mapFindKey(Map map, const char* key);
-static MapResult mapExpand(Map map);
+static unsigned int mapHash(const char* key);
+static Key mapKeyAt(Map map, int position);
+static int mapScanFingerprints(Map map, const char* key, unsigned int hash);
+static int mapFindSlot(Map map, const char* key, unsigned int hash, bool* in_old_index);
+static int mapFindKey(Map map, const char* key, unsigned int hash);
+static void mapIndexInsert(MapIndex index, unsigned int hash, int position);
+static void mapIndexRemove(MapIndex index, int slot);
+static void* mapAllocate(Map map, size_t size);
+static void* mapReallocate(Map map, void* block, size_t old_size, size_t new_size);
+static void mapFree(Map map, void* block, size_t size);
+static void mapInitialize(Map map);
+static MapIndex mapIndexAllocate(Map map, int size);
+static MapIndex mapIndexCreate(Map map, int size);
+static void mapReleaseIndexChunk(Map map, MapIndexChunk chunk, int size);
+static bool mapIndexIsShared(MapIndex index);
+static void mapReleasePage(Map map, MapPage page, bool destroy_keys);
+static void mapReleaseTable(Map map, MapTable table, bool destroy_keys);
+static void mapReleaseIndex(Map map, MapIndex index);
+static MapResult mapMakeTableWritable(Map map, int capacity);
+static MapResult mapMakePageWritable(Map map, int page_number, int capacity);
+static MapResult mapMakeChunksWritable(Map map, MapIndex* index, int first, int count);
+static MapResult mapMakeRunWritable(Map map, MapIndex* index, int slot);
+static MapResult mapMakeRadixWritable(Map map);
+static int mapIndexSizeFor(int count);
+static MapResult mapResizeIndex(Map map, int index_size);
+static MapResult mapBuildIndex(Map map, int count);
+static MapResult mapReserve(Map map, int count);
+static MapResult mapRemoveKey(Map map, const char* key, unsigned int hash);
+static Key mapNewKey(Map map, const char* key, const char* data);
+static MapResult mapInsertKey(Map map, Key new_key, unsigned int hash);
+static Key* mapGetWritableKey(Map map, int position);
+static MapResult mapSetValueAt(Map map, int position, const char* data);
+static MapResult mapSetIntAt(Map map, int position, int64_t value);
+static MapResult mapPutHashed(Map map, const char* key, const char* data, unsigned int hash);
+static MapResult mapPutIntHashed(Map map, const char* key, int64_t value, unsigned int hash);
+static MapResult mapIncrementHashed(Map map, const char* key, int64_t delta, int64_t* new_value, unsigned int hash);
+static Map mapCreateStriped(int stripe_count, Map (*create_stripe)(void));
+static int mapLockStripe(Map map, unsigned int hash, bool write);
+static Map mapCursorPosition(const MapCursor* cursor, int* position);
+static Map mapBeginRead(Map map, bool* locked);
+static Map mapPinSnapshot(Map map);
+static void mapUnpinSnapshot(Map snapshot);
+static void mapEndIteration(Map map);
+static void mapEndRead(Map map, bool locked);
+static Map mapBeginWrite(Map map);
+static void mapEndWrite(Map map, Map next, bool publish);
+static int mapImageFind(Map map, const char* key, unsigned int hash);
+static char* mapIdAt(Map map, int position);
+static char* mapValueAt(Map map, int position);
+static int64_t mapIntAt(Map map, int position);
+static MapResult mapCollectPairs(Map map, int count, bool hashes, ImagePairs* pairs);
+static void mapFreePairs(ImagePairs* pairs);
+static MapResult mapLogChange(MapJournal journal, MapResult result, JournalRecordType type, const char* key,
+                              const char* data);
+static bool mapJournalFilter(const char* key, const char* data, void* context);
+static bool mapReplayChange(void* context, JournalRecordType type, const char* key, const char* value);
+static void mapCompactJournal(void* context);
+static Map mapLoadSnapshot(const char* path);
+static MapResult mapMakeIndexRoom(Map map, unsigned int hash);
+static bool mapVisitPrefix(Map map, const char* prefix, MapVisitor visitor, void* context);
+static bool mapRadixVisit(int position, void* context);
+static MapResult mapRehashStep(Map map, int steps);
+static int mapFilterCapacityFor(int count);
+static MapFilter mapFilterCreate(Map map, int capacity, MapFilter source);
+static void mapFilterFill(Map map, MapFilter filter);
+static void mapFilterAdd(MapFilter filter, unsigned int hash);
+static bool mapFilterMayContain(MapFilter filter, unsigned int hash);
+static void mapReleaseFilter(Map map, MapFilter filter);
+static MapResult mapMakeFilterRoom(Map map, int count);
+static void mapFilterRemove(Map map);
+static int mapProbeIndex(Map map, MapIndex index, const char* key, unsigned int hash);
+static int mapHeapFind(Map map, const char* key, unsigned int hash, int* slot);
+static MapResult mapHeapInsert(Map map, const char* key, const char* data, unsigned int hash);
+static MapResult mapHeapPut(Map map, const char* key, const char* data, unsigned int hash);
+static MapResult mapIndexFill(Map map, const char* const* keys, int count);
+static void mapHeapDropDuplicates(Map map, const char* const* keys, int count);
+static bool mapHeapFill(Map map, const char* const* keys, const char* const* values, int count, bool unique);
+static MapResult mapHeapRemove(Map map, const char* key, unsigned int hash);
+#ifdef MAP_ENABLE_STATS
+static void mapAddStats(MapStats* total, Map map);
+#endif
+
+
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @param key - The string to hash
+ * @return
+ * The hashString of the key, as every string container hashes it.
+ */
+static unsigned int mapHash(const char* key)
+{
+    assert(key != NULL);
+    return hashString(key);
+}
+
+/**
+ * @param map - The Key's map
+ * @param position - A used position (0 to size - 1)
+ * @return
+ * The Key in that position.
+ */
+static Key mapKeyAt(Map map, int position)
+{
+    assert(position >= 0 && position < map->size);
+    return map->table->pages[position >> MAP_PAGE_BITS]->keys[position & MAP_PAGE_MASK];
+}
+
+/**
+ * Compares the fingerprint of the key with a whole block of fingerprints at
+ * once (32 with AVX2, 16 with SSE2, one at a time otherwise), and runs strcmp
+ * only on the keys whose fingerprint matched.
+ * The map must be small enough for all of its keys to be in the first page.
+ * @param map - The Key's map
+ * @param key - The wanted key
+ * @param hash - The hash of the wanted key
+ * @return
+ * -1 if key not found
+ * Otherwise the key index
+ */
+static int mapScanFingerprints(Map map, const char* key, unsigned int hash)
+{
+    assert(map != NULL && key != NULL && map->size <= MAP_PAGE_SIZE);
+    if (map->size == 0)
+    {
+        return MAP_NO_SUCH_KEY;
+    }
+    MapPage page = map->table->pages[0];
+    unsigned char fingerprint = MAP_FINGERPRINT(hash);
+#if !defined(MAP_NO_SIMD) && defined(__AVX2__)
+    const __m256i wanted = _mm256_set1_epi8((char)fingerprint);
+    for (int block = 0; block < map->size; block += 32)
+    {
+        __m256i fingerprints = _mm256_loadu_si256((const __m256i*)(page->fingerprints + block));
+        unsigned int hits = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(fingerprints, wanted));
+        if (map->size - block < 32)
+        {
+            hits &= (1u << (map->size - block)) - 1;
+        }
+        while (hits)
+        {
+            int index = block + __builtin_ctz(hits);
+            if (MAP_STATS_EQUALS(map, key, keyGetID(page->keys[index])))
+            {
+                return index;
+            }
+            hits &= hits - 1;
+        }
+    }
+#elif !defined(MAP_NO_SIMD) && defined(__SSE2__)
+    const __m128i wanted = _mm_set1_epi8((char)fingerprint);
+    for (int block = 0; block < map->size; block += 16)
+    {
+        __m128i fingerprints = _mm_loadu_si128((const __m128i*)(page->fingerprints + block));
+        unsigned int hits = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(fingerprints, wanted));
+        if (map->size - block < 16)
+        {
+            hits &= (1u << (map->size - block)) - 1;
+        }
+        while (hits)
+        {
+            int index = block + __builtin_ctz(hits);
+            if (MAP_STATS_EQUALS(map, key, keyGetID(page->keys[index])))
+            {
+                return index;
+            }
+            hits &= hits - 1;
+        }
+    }
+#else
+    for (int index = 0; index < map->size; index++)
+    {
+        if (page->fingerprints[index] == fingerprint && MAP_STATS_EQUALS(map, key, keyGetID(page->keys[index])))
+        {
+            return index;
+        }
+    }
+#endif
+    return MAP_NO_SUCH_KEY;
+}
+
+/**
+ * @param map - The Key's map, which must have a hash index
+ * @param key - The wanted key
+ * @param hash - The hash of the wanted key
+ * @param in_old_index - Set to true if the slot is in the old index of an
+ *      incremental map, and to false if it is in its index.
+ * @return 
+ * -1 if key not found 
+ * Otherwise the index of the slot in the hash index which points to the key
+ */
+static int mapFindSlot(Map map, const char* key, unsigned int hash, bool* in_old_index)
+{
+    assert(map != NULL && key != NULL && map->index != NULL);
+    int slot = mapProbeIndex(map, map->index, key, hash);
+    *in_old_index = slot == MAP_NO_SUCH_KEY && map->old_index != NULL;
+    return *in_old_index ? mapProbeIndex(map, map->old_index, key, hash) : slot;
+}
+
+/**
+ * @param index - The index of the map or its old index
+ * @return
+ * -1 if key not found
+ * Otherwise the index of the slot in 'index' which points to the key
+ */
+static int mapProbeIndex(Map map, MapIndex index, const char* key, unsigned int hash)
+{
+    int mask = index->size - 1;
+    int slot = hash & mask;
+    for (MapSlot* entry = &MAP_SLOT(index, slot); entry->position != MAP_EMPTY_SLOT; entry = &MAP_SLOT(index, slot))
+    {
+        if (entry->hash == hash && entry->position >= 0 &&
+            MAP_STATS_EQUALS(map, key, keyGetID(mapKeyAt(map, entry->position))))
+        {
+            MAP_STATS_PROBE(map, ((slot - (int)(hash & mask)) & mask) + 1);
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    MAP_STATS_PROBE(map, ((slot - (int)(hash & mask)) & mask) + 1);
+    return MAP_NO_SUCH_KEY;
+}
+
+/**
+ * @param map - The Key's map
+ * @param key - The wanted key
+ * @param hash - The hash of the wanted key
+ * @return 
+ * -1 if key not found 
+ * Otherwise the key index 
+ */
+static int mapFindKey(Map map, const char* key, unsigned int hash)
+{
+    assert (map != NULL && key != NULL);
+    int position;
+    bool filtered = map->filter != NULL && !mapFilterMayContain(map->filter, hash);
+    if (filtered)
+    {
+        position = MAP_NO_SUCH_KEY;
+    }
+    else if (map->image != NULL)
+    {
+        position = mapImageFind(map, key, hash);
+    }
+    else if (map->heap != NULL)
+    {
+        position = mapHeapFind(map, key, hash, NULL);
+    }
+    else if (map->radix != NULL)
+    {
+        position = radixGet(map->radix, key);
+    }
+    else if (map->index == NULL)
+    {
+        position = mapScanFingerprints(map, key, hash);
+    }
+    else
+    {
+        bool in_old_index;
+        int slot = mapFindSlot(map, key, hash, &in_old_index);
+        position = slot == MAP_NO_SUCH_KEY ? MAP_NO_SUCH_KEY :
+                   MAP_SLOT(in_old_index ? map->old_index : map->index, slot).position;
+    }
+    MAP_STATS_ADD(map, lookups, 1);
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        MAP_STATS_ADD(map, misses, 1);
+        MAP_STATS_ADD(map, filter_rejections, filtered);
+        MAP_STATS_ADD(map, filter_false_positives, !filtered && map->filter != NULL);
+    }
+    else
+    {
+        MAP_STATS_ADD(map, hits, 1);
+    }
+    return position;
+}
+
+/**
+ * Inserts a position to the first free slot of its probe sequence.
+ * The index must have at least one free slot, and the chunks of the run from
+ * the home slot of 'hash' must be writable.
+ */
+static void mapIndexInsert(MapIndex index, unsigned int hash, int position)
+{
+    int mask = index->size - 1;
+    int slot = hash & mask;
+    while (MAP_SLOT(index, slot).position != MAP_EMPTY_SLOT)
+    {
+        slot = (slot + 1) & mask;
+    }
+    MAP_SLOT(index, slot).hash = hash;
+    MAP_SLOT(index, slot).position = position;
+}
+
+/**
+ * Empties a slot of the hash index, shifting back the following slots of the
+ * cluster so no probe sequence is broken (no tombstones are needed).
+ * The chunks of the run from 'slot' must be writable.
+ */
+static void mapIndexRemove(MapIndex index, int slot)
+{
+    int mask = index->size - 1;
+    int hole = slot;
+    for (int next = (hole + 1) & mask; MAP_SLOT(index, next).position != MAP_EMPTY_SLOT; next = (next + 1) & mask)
+    {
+        int home = MAP_SLOT(index, next).hash & mask;
+        //The entry may fill the hole only if the hole is between its home slot and its current slot
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            MAP_SLOT(index, hole) = MAP_SLOT(index, next);
+            hole = next;
+        }
+    }
+    MAP_SLOT(index, hole).position = MAP_EMPTY_SLOT;
+}
+
+/**
+ * @return
+ * A block of 'size' bytes from the map's allocator (malloc if it has none), or NULL.
+ */
+static void* mapAllocate(Map map, size_t size)
+{
+    return map->allocator.allocate == NULL ? malloc(size) : map->allocator.allocate(map->allocator.context, size);
+}
+
+/**
+ * Resizes a block from the map's allocator (as realloc does, 'block' may be NULL).
+ * @param old_size - The size the block was allocated with
+ */
+static void* mapReallocate(Map map, void* block, size_t old_size, size_t new_size)
+{
+    if (map->allocator.allocate == NULL)
+    {
+        return realloc(block, new_size);
+    }
+    if (block == NULL)
+    {
+        return map->allocator.allocate(map->allocator.context, new_size);
+    }
+    return map->allocator.reallocate(map->allocator.context, block, old_size, new_size);
+}
+
+/**
+ * Gives a block of 'size' bytes back to the map's allocator (free if it has none).
+ */
+static void mapFree(Map map, void* block, size_t size)
+{
+    if (map->allocator.allocate == NULL)
+    {
+        free(block);
+    }
+    else if (block != NULL)
+    {
+        map->allocator.release(map->allocator.context, block, size);
+    }
+}
+
+/**
+ * @param size - The number of slots (a power of 2)
+ * @return
+ * A new index whose slots are not set yet, or NULL if an allocation failed.
+ */
+static MapIndex mapIndexAllocate(Map map, int size)
+{
+    MapIndex index = mapAllocate(map, MAP_INDEX_BYTES(size));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    index->refcount = 1;
+    index->size = size;
+    index->shares_chunks = false;
+    for (int i = 0; i < MAP_INDEX_CHUNKS(size); i++)
+    {
+        index->chunks[i] = mapAllocate(map, MAP_INDEX_CHUNK_BYTES(size));
+        if (index->chunks[i] == NULL)
+        {
+            while (i-- > 0)
+            {
+                mapFree(map, index->chunks[i], MAP_INDEX_CHUNK_BYTES(size));
+            }
+            mapFree(map, index, MAP_INDEX_BYTES(size));
+            return NULL;
+        }
+        index->chunks[i]->refcount = 1;
+    }
+    return index;
+}
+
+/**
+ * @param size - The number of slots (a power of 2)
+ * @return
+ * A new empty index, or NULL if an allocation failed.
+ */
+static MapIndex mapIndexCreate(Map map, int size)
+{
+    MapIndex index = mapIndexAllocate(map, size);
+    for (int i = 0; index != NULL && i < size; i++)
+    {
+        MAP_SLOT(index, i).position = MAP_EMPTY_SLOT;
+    }
+    return index;
+}
+
+/**
+ * Releases a page, and frees it (and its keys, if destroy_keys) if it was the last owner.
+ */
+static void mapReleasePage(Map map, MapPage page, bool destroy_keys)
+{
+    if (page == NULL || MAP_REFCOUNT_DECREMENT(page->refcount) > 0)
+    {
+        return;
+    }
+    for (int i = 0; destroy_keys && i < page->count; i++)
+    {
+        keyDestroyWithAllocator(page->keys[i], MAP_KEY_ALLOCATOR(map));
+    }
+    mapFree(map, page, MAP_PAGE_BYTES(page->capacity));
+}
+
+/**
+ * Releases a table, and frees it (and releases its pages) if it was the last owner.
+ */
+static void mapReleaseTable(Map map, MapTable table, bool destroy_keys)
+{
+    if (table == NULL || MAP_REFCOUNT_DECREMENT(table->refcount) > 0)
+    {
+        return;
+    }
+    for (int i = 0; i < table->capacity; i++)
+    {
+        mapReleasePage(map, table->pages[i], destroy_keys);
+    }
+    mapFree(map, table, MAP_TABLE_BYTES(table->capacity));
+}
+
+/**
+ * Releases a chunk of an index of 'size' slots, and frees it if it was the last owner.
+ */
+static void mapReleaseIndexChunk(Map map, MapIndexChunk chunk, int size)
+{
+    if (MAP_REFCOUNT_DECREMENT(chunk->refcount) == 0)
+    {
+        mapFree(map, chunk, MAP_INDEX_CHUNK_BYTES(size));
+    }
+}
+
+/**
+ * Releases an index, and frees it (and releases its chunks) if it was the last owner.
+ */
+static void mapReleaseIndex(Map map, MapIndex index)
+{
+    if (index == NULL || MAP_REFCOUNT_DECREMENT(index->refcount) > 0)
+    {
+        return;
+    }
+    for (int i = 0; i < MAP_INDEX_CHUNKS(index->size); i++)
+    {
+        mapReleaseIndexChunk(map, index->chunks[i], index->size);
+    }
+    mapFree(map, index, MAP_INDEX_BYTES(index->size));
+}
+
+/**
+ * @return
+ * true if the index or one of its chunks has another owner, so its slots may not be written.
+ */
+static bool mapIndexIsShared(MapIndex index)
+{
+    if (MAP_REFCOUNT_LOAD(index->refcount) > 1)
+    {
+        return true;
+    }
+    if (!index->shares_chunks)
+    {
+        return false;
+    }
+    for (int i = 0; i < MAP_INDEX_CHUNKS(index->size); i++)
+    {
+        if (MAP_REFCOUNT_LOAD(index->chunks[i]->refcount) > 1)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Makes sure the map is the only owner of its table, and that the table has
+ * room for at least 'capacity' pages. A shared table is copied (its pages
+ * become shared by both tables), a small one is expanded.
+ * On failure the map is unchanged.
+ */
+static MapResult mapMakeTableWritable(Map map, int capacity)
+{
+    MapTable table = map->table;
+    bool shared = table != NULL && MAP_REFCOUNT_LOAD(table->refcount) > 1;
+    int old_capacity = table == NULL ? 0 : table->capacity;
+    if (!shared && old_capacity >= capacity)
+    {
+        return MAP_SUCCESS;
+    }
+    int new_capacity = old_capacity > capacity ? old_capacity : capacity;
+    MapTable new_table = shared ? mapAllocate(map, MAP_TABLE_BYTES(new_capacity)) :
+                                  mapReallocate(map, table, MAP_TABLE_BYTES(old_capacity), MAP_TABLE_BYTES(new_capacity));
+    if (new_table == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MAP_STATS_ADD(map, expansions, new_capacity > old_capacity);
+    MAP_STATS_ADD(map, bytes_reallocated, MAP_TABLE_BYTES(new_capacity));
+    if (shared)
+    {
+        new_table->refcount = 1;
+        for (int i = 0; i < old_capacity; i++)
+        {
+            new_table->pages[i] = table->pages[i];
+            if (new_table->pages[i] != NULL)
+            {
+                MAP_REFCOUNT_INCREMENT(new_table->pages[i]->refcount);
+            }
+        }
+        mapReleaseTable(map, table, map->arena == NULL);
+    }
+    else if (table == NULL)
+    {
+        new_table->refcount = 1;
+    }
+    for (int i = old_capacity; i < new_capacity; i++)
+    {
+        new_table->pages[i] = NULL;
+    }
+    new_table->capacity = new_capacity;
+    map->table = new_table;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Makes sure the map is the only owner of one of its pages, and that the page
+ * has room for at least 'capacity' keys. A missing page is allocated, a shared
+ * one is copied (its keys become shared by both pages) and a small one grows.
+ * The table must already be writable.
+ * On failure the map is unchanged.
+ */
+static MapResult mapMakePageWritable(Map map, int page_number, int capacity)
+{
+    assert(map->table != NULL && page_number < map->table->capacity && capacity <= MAP_PAGE_SIZE);
+    MapPage page = map->table->pages[page_number];
+    bool shared = page != NULL && MAP_REFCOUNT_LOAD(page->refcount) > 1;
+    int old_capacity = page == NULL ? 0 : page->capacity;
+    if (page != NULL && !shared && old_capacity >= capacity)
+    {
+        return MAP_SUCCESS;
+    }
+    int new_capacity = old_capacity > 0 ? old_capacity : MAP_PAGE_MIN_CAPACITY;
+    while (new_capacity < capacity)
+    {
+        new_capacity *= MAP_EXPAND_FACTOR;
+    }
+    new_capacity = new_capacity < MAP_PAGE_SIZE ? new_capacity : MAP_PAGE_SIZE;
+    MapPage new_page = page != NULL && !shared ?
+                       mapReallocate(map, page, MAP_PAGE_BYTES(old_capacity), MAP_PAGE_BYTES(new_capacity)) :
+                       mapAllocate(map, MAP_PAGE_BYTES(new_capacity));
+    if (new_page == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MAP_STATS_ADD(map, expansions, new_capacity > old_capacity);
+    MAP_STATS_ADD(map, bytes_reallocated, MAP_PAGE_BYTES(new_capacity));
+    if (page == NULL)
+    {
+        new_page->refcount = 1;
+        new_page->count = 0;
+    }
+    else if (shared)
+    {
+        new_page->refcount = 1;
+        memcpy(new_page->fingerprints, page->fingerprints, page->count);
+        for (int i = 0; i < page->count; i++)
+        {
+            new_page->keys[i] = keyShare(page->keys[i]);
+        }
+        new_page->count = page->count;
+        mapReleasePage(map, page, map->arena == NULL);
+    }
+    new_page->capacity = new_capacity;
+    map->table->pages[page_number] = new_page;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Makes sure the map is the only owner of one of its indexes, and of 'count'
+ * of its chunks from chunk number 'first' on (wrapping around after the last
+ * one). A shared index is copied (its chunks become shared by both indexes),
+ * and so is each of these chunks which is shared.
+ * On failure the map is unchanged.
+ * @param index - The map's index or old index (which may be replaced by a copy)
+ */
+static MapResult mapMakeChunksWritable(Map map, MapIndex* index, int first, int count)
+{
+    int chunk_count = MAP_INDEX_CHUNKS((*index)->size);
+    if (MAP_REFCOUNT_LOAD((*index)->refcount) > 1)
+    {
+        MapIndex new_index = mapAllocate(map, MAP_INDEX_BYTES((*index)->size));
+        if (new_index == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        MAP_STATS_ADD(map, bytes_reallocated, MAP_INDEX_BYTES((*index)->size));
+        new_index->refcount = 1;
+        new_index->size = (*index)->size;
+        new_index->shares_chunks = true;
+        //The other owners check it only once they own the index alone, which is after this is set
+        MAP_FLAG_SET((*index)->shares_chunks);
+        for (int i = 0; i < chunk_count; i++)
+        {
+            new_index->chunks[i] = (*index)->chunks[i];
+            MAP_REFCOUNT_INCREMENT(new_index->chunks[i]->refcount);
+        }
+        mapReleaseIndex(map, *index);
+        *index = new_index;
+    }
+    count = count < chunk_count ? count : chunk_count;
+    for (int i = 0; i < count; i++)
+    {
+        MapIndexChunk* chunk = &(*index)->chunks[(first + i) & (chunk_count - 1)];
+        if (MAP_REFCOUNT_LOAD((*chunk)->refcount) == 1)
+        {
+            continue;
+        }
+        size_t bytes = MAP_INDEX_CHUNK_BYTES((*index)->size);
+        MapIndexChunk new_chunk = mapAllocate(map, bytes);
+        if (new_chunk == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        MAP_STATS_ADD(map, bytes_reallocated, bytes);
+        new_chunk->refcount = 1;
+        memcpy(new_chunk->slots, (*chunk)->slots, bytes - sizeof(struct MapIndexChunk_t));
+        mapReleaseIndexChunk(map, *chunk, (*index)->size);
+        *chunk = new_chunk;
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * Makes sure the map is the only owner of the chunks of one of its indexes
+ * which inserting into the probe sequence of 'slot', or removing 'slot', writes
+ * to: those from the chunk of 'slot' to the chunk of the first empty slot after it.
+ * On failure the map is unchanged.
+ * @param index - The map's index or old index (which may be replaced by a copy)
+ */
+static MapResult mapMakeRunWritable(Map map, MapIndex* index, int slot)
+{
+    if (MAP_REFCOUNT_LOAD((*index)->refcount) == 1 && !(*index)->shares_chunks)
+    {
+        return MAP_SUCCESS;
+    }
+    int mask = (*index)->size - 1;
+    int end = slot;
+    while (MAP_SLOT(*index, end).position != MAP_EMPTY_SLOT)
+    {
+        end = (end + 1) & mask;
+    }
+    //Counted from the length of the run, which may wrap around into the chunk it starts in
+    int length = (end - slot) & mask;
+    return mapMakeChunksWritable(map, index, slot >> MAP_INDEX_CHUNK_BITS,
+                                 (((slot & MAP_INDEX_CHUNK_MASK) + length) >> MAP_INDEX_CHUNK_BITS) + 1);
+}
+
+/**
+ * Makes sure the map is the only owner of its radix tree (if it has one).
+ * On failure the map is unchanged.
+ */
+static MapResult mapMakeRadixWritable(Map map)
+{
+    if (map->radix != NULL && radixIsShared(map->radix))
+    {
+        Radix radix = radixCopy(map->radix);
+        if (radix == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        MAP_STATS_ADD(map, bytes_reallocated, radixGetSize(radix));
+        radixDestroy(map->radix);
+        map->radix = radix;
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * @param count - A number of keys
+ * @return
+ * The size of an index with room for twice that many keys.
+ */
+static int mapIndexSizeFor(int count)
+{
+    int index_size = 1;
+    while (index_size * MAP_LOAD_NUMERATOR < MAP_EXPAND_FACTOR * count * MAP_LOAD_DENOMINATOR)
+    {
+        index_size *= 2;
+    }
+    return index_size;
+}
+
+/**
+ * Moves the used slots of the hash index to a new index of 'index_size' slots.
+ * On failure the old index is kept as is.
+ */
+static MapResult mapResizeIndex(Map map, int index_size)
+{
+    assert(map != NULL && map->index != NULL && map->next_index == NULL && map->old_index == NULL);
+    MapIndex new_index = mapIndexCreate(map, index_size);
+    if (new_index == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MAP_STATS_ADD(map, expansions, index_size > map->index->size);
+    MAP_STATS_ADD(map, bytes_reallocated, MAP_INDEX_ALL_BYTES(index_size));
+    for (int i = 0; i < map->index->size; i++)
+    {
+        if (MAP_SLOT(map->index, i).position != MAP_EMPTY_SLOT)
+        {
+            mapIndexInsert(new_index, MAP_SLOT(map->index, i).hash, MAP_SLOT(map->index, i).position);
+        }
+    }
+    mapReleaseIndex(map, map->index);
+    map->index = new_index;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Builds the hash index of a map which is about to outgrow the fingerprint scan.
+ * The index gets room for twice 'count' keys.
+ */
+static MapResult mapBuildIndex(Map map, int count)
+{
+    assert(map != NULL && map->index == NULL);
+    MapIndex index = mapIndexCreate(map, mapIndexSizeFor(count));
+    if (index == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MAP_STATS_ADD(map, expansions, 1);
+    MAP_STATS_ADD(map, bytes_reallocated, MAP_INDEX_ALL_BYTES(index->size));
+    for (int i = 0; i < map->size; i++)
+    {
+        mapIndexInsert(index, map->heap != NULL ? map->heap->hashes[i] : mapHash(keyGetID(mapKeyAt(map, i))), i);
+    }
+    map->index = index;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Builds or grows the index if one more key needs it, and makes the map the
+ * only owner of the part of the index the key is inserted into.
+ * On failure the map is unchanged.
+ * @param hash - The hash of the key
+ */
+static MapResult mapMakeIndexRoom(Map map, unsigned int hash)
+{
+    if (map->radix != NULL)
+    {
+        return mapMakeRadixWritable(map);
+    }
+    if (map->index == NULL && map->size >= MAP_FINGERPRINT_THRESHOLD)
+    {
+        return mapBuildIndex(map, map->size + 1);
+    }
+    if (map->incremental && map->index != NULL && mapRehashStep(map, MAP_REHASH_STEP) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->incremental && map->index != NULL && map->next_index == NULL && map->old_index == NULL &&
+        (map->size + 1) * MAP_REHASH_START_DIVISOR > map->index->size)
+    {
+        //The bigger index is only allocated here: its slots are cleared by the next puts
+        map->next_index = mapIndexAllocate(map, MAP_EXPAND_FACTOR * map->index->size);
+        if (map->next_index != NULL)
+        {
+            MAP_STATS_ADD(map, expansions, 1);
+            MAP_STATS_ADD(map, bytes_reallocated, MAP_INDEX_ALL_BYTES(map->next_index->size));
+            map->rehash_slot = 0;
+        }
+    }
+    if (map->index != NULL && (map->size + 1) * MAP_LOAD_DENOMINATOR > map->index->size * MAP_LOAD_NUMERATOR &&
+        map->incremental && mapRehashStep(map, INT_MAX) != MAP_SUCCESS)
+    {
+        //The steps did not keep up (or the bigger index could not be allocated before), so growing ends now
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->index != NULL && (map->size + 1) * MAP_LOAD_DENOMINATOR > map->index->size * MAP_LOAD_NUMERATOR &&
+        mapResizeIndex(map, MAP_EXPAND_FACTOR * map->index->size) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    //Only the chunks of the run the key joins are copied, so a change to a copy costs about a chunk
+    return map->index != NULL ? mapMakeRunWritable(map, &map->index, hash & (map->index->size - 1)) : MAP_SUCCESS;
+}
+
+/**
+ * Does up to 'steps' slots of the growth of an incremental map's index: first
+ * the slots of the next index are cleared, then it replaces the index, and the
+ * keys of the old index are moved to it. Does nothing if the index is not
+ * growing. On failure (making the indexes writable) the map keeps its keys,
+ * and the growth goes on from where it stopped.
+ */
+static MapResult mapRehashStep(Map map, int steps)
+{
+    if (map->next_index == NULL && map->old_index == NULL)
+    {
+        return MAP_SUCCESS;
+    }
+    MapIndex next = map->next_index;
+    if (next != NULL)
+    {
+        //The next index is never shared
+        int end = steps < next->size - map->rehash_slot ? map->rehash_slot + steps : next->size;
+        steps -= end - map->rehash_slot;
+        for (; map->rehash_slot < end; map->rehash_slot++)
+        {
+            MAP_SLOT(next, map->rehash_slot).position = MAP_EMPTY_SLOT;
+        }
+        if (end < next->size)
+        {
+            return MAP_SUCCESS;
+        }
+        //Lookups now try the new index first and then the old one
+        map->old_index = map->index;
+        map->index = next;
+        map->next_index = NULL;
+        map->rehash_slot = 0;
+    }
+    int end = steps < map->old_index->size - map->rehash_slot ? map->rehash_slot + steps : map->old_index->size;
+    int first_chunk = map->rehash_slot >> MAP_INDEX_CHUNK_BITS;
+    if (map->rehash_slot < end &&
+        mapMakeChunksWritable(map, &map->old_index, first_chunk, ((end - 1) >> MAP_INDEX_CHUNK_BITS) - first_chunk + 1)
+        != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MapIndex old = map->old_index;
+    for (; map->rehash_slot < end; map->rehash_slot++)
+    {
+        MapSlot* slot = &MAP_SLOT(old, map->rehash_slot);
+        if (slot->position < 0)
+        {
+            continue;
+        }
+        if (mapMakeRunWritable(map, &map->index, slot->hash & (map->index->size - 1)) != MAP_SUCCESS)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        mapIndexInsert(map->index, slot->hash, slot->position);
+        slot->position = MAP_MOVED_SLOT;
+    }
+    if (end == old->size)
+    {
+        mapReleaseIndex(map, old);
+        map->old_index = NULL;
+        map->rehash_slot = 0;
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * @param count - A number of keys
+ * @return
+ * The capacity of a filter with room for twice that many keys (in whole blocks).
+ */
+static int mapFilterCapacityFor(int count)
+{
+    long long blocks = ((long long)MAP_EXPAND_FACTOR * count + MAP_FILTER_KEYS_PER_BLOCK - 1) /
+                       MAP_FILTER_KEYS_PER_BLOCK;
+    blocks = blocks < 1 ? 1 : blocks;
+    return blocks > INT_MAX / MAP_FILTER_KEYS_PER_BLOCK ? INT_MAX / MAP_FILTER_KEYS_PER_BLOCK * MAP_FILTER_KEYS_PER_BLOCK :
+                                                          (int)blocks * MAP_FILTER_KEYS_PER_BLOCK;
+}
+
+/**
+ * @param capacity - The keys the filter is sized for (a multiple of MAP_FILTER_KEYS_PER_BLOCK)
+ * @param source - A filter of the same capacity whose bits are copied, or NULL
+ * 	for a filter without any bits set.
+ * @return
+ * A new filter, or NULL if the allocation failed.
+ */
+static MapFilter mapFilterCreate(Map map, int capacity, MapFilter source)
+{
+    assert(source == NULL || source->capacity == capacity);
+    int block_count = capacity / MAP_FILTER_KEYS_PER_BLOCK;
+    MapFilter filter = mapAllocate(map, MAP_FILTER_BYTES(block_count));
+    if (filter == NULL)
+    {
+        return NULL;
+    }
+    filter->refcount = 1;
+    filter->capacity = capacity;
+    filter->block_count = block_count;
+    if (source != NULL)
+    {
+        memcpy(MAP_FILTER_BLOCKS(filter), MAP_FILTER_BLOCKS(source), (size_t)block_count * MAP_FILTER_BLOCK_BYTES);
+    }
+    else
+    {
+        memset(MAP_FILTER_BLOCKS(filter), 0, (size_t)block_count * MAP_FILTER_BLOCK_BYTES);
+    }
+    return filter;
+}
+
+/**
+ * Clears the bits of a filter the map owns, and sets those of the map's keys.
+ */
+static void mapFilterFill(Map map, MapFilter filter)
+{
+    memset(MAP_FILTER_BLOCKS(filter), 0, (size_t)filter->block_count * MAP_FILTER_BLOCK_BYTES);
+    for (int i = 0; i < map->size; i++)
+    {
+        mapFilterAdd(filter, map->heap != NULL ? map->heap->hashes[i] : mapHash(keyGetID(mapKeyAt(map, i))));
+    }
+}
+
+/**
+ * Sets the bits of a key in its block: one in every word, picked by a
+ * different multiple of its hash.
+ */
+static void mapFilterAdd(MapFilter filter, unsigned int hash)
+{
+    uint64_t* block = MAP_FILTER_BLOCKS(filter) +
+                      (((uint64_t)(uint32_t)(hash * MAP_FILTER_BLOCK_MULTIPLIER) * filter->block_count) >> 32) *
+                      MAP_FILTER_WORDS;
+    for (size_t i = 0; i < MAP_FILTER_WORDS; i++)
+    {
+        block[i] |= (uint64_t)1 << ((uint32_t)(hash * mapFilterSalts[i]) >> 26);
+    }
+}
+
+/**
+ * @return
+ * false if the key of this hash is surely not in the filter's map, true if it may be.
+ */
+static bool mapFilterMayContain(MapFilter filter, unsigned int hash)
+{
+    const uint64_t* block = MAP_FILTER_BLOCKS(filter) +
+                            (((uint64_t)(uint32_t)(hash * MAP_FILTER_BLOCK_MULTIPLIER) * filter->block_count) >> 32) *
+                            MAP_FILTER_WORDS;
+    //All the words are checked, without a branch per word
+    uint64_t missing = 0;
+    for (size_t i = 0; i < MAP_FILTER_WORDS; i++)
+    {
+        missing |= ~block[i] & ((uint64_t)1 << ((uint32_t)(hash * mapFilterSalts[i]) >> 26));
+    }
+    return missing == 0;
+}
+
+/**
+ * Releases a filter, and frees it if it was the last owner.
+ */
+static void mapReleaseFilter(Map map, MapFilter filter)
+{
+    if (filter != NULL && MAP_REFCOUNT_DECREMENT(filter->refcount) == 0)
+    {
+        mapFree(map, filter, MAP_FILTER_BYTES(filter->block_count));
+    }
+}
+
+/**
+ * Makes the map the only owner of its filter (if it has one), and makes sure
+ * the filter has room for 'count' more keys. A filter which is too small, or
+ * has too many bits of removed keys, is rebuilt from the keys of the map.
+ * On failure the map is unchanged.
+ */
+static MapResult mapMakeFilterRoom(Map map, int count)
+{
+    MapFilter filter = map->filter;
+    if (filter == NULL)
+    {
+        return MAP_SUCCESS;
+    }
+    bool shared = MAP_REFCOUNT_LOAD(filter->refcount) > 1;
+    bool stale = map->filter_stale * MAP_FILTER_STALE_DIVISOR > map->size;
+    bool full = (long long)map->size + map->filter_stale + count > filter->capacity;
+    if (!shared && !full)
+    {
+        if (stale)
+        {
+            mapFilterFill(map, filter);
+            map->filter_stale = 0;
+        }
+        return MAP_SUCCESS;
+    }
+    int capacity = full ? mapFilterCapacityFor(map->size + count) : filter->capacity;
+    //A shared filter which is still good is copied, instead of being rebuilt
+    MapFilter new_filter = mapFilterCreate(map, capacity, full || stale ? NULL : filter);
+    if (new_filter == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MAP_STATS_ADD(map, expansions, capacity > filter->capacity);
+    MAP_STATS_ADD(map, bytes_reallocated, MAP_FILTER_BYTES(new_filter->block_count));
+    if (full || stale)
+    {
+        mapFilterFill(map, new_filter);
+        map->filter_stale = 0;
+    }
+    mapReleaseFilter(map, filter);
+    map->filter = new_filter;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Counts a key just removed from a map with a filter, whose bits stay set, and
+ * rebuilds the filter once there are too many of them (unless a copy shares
+ * it: then the next put rebuilds it). Never allocates.
+ */
+static void mapFilterRemove(Map map)
+{
+    if (map->filter == NULL)
+    {
+        return;
+    }
+    map->filter_stale++;
+    if (map->filter_stale * MAP_FILTER_STALE_DIVISOR > map->size && MAP_REFCOUNT_LOAD(map->filter->refcount) == 1)
+    {
+        mapFilterFill(map, map->filter);
+        map->filter_stale = 0;
+    }
+}
+
+/**
+ * Grows the table and the index of a map, so 'count' more keys can be put
+ * without growing them again.
+ */
+static MapResult mapReserve(Map map, int count)
+{
+    int total = map->size + count;
+    if ((map->heap != NULL ? !heapReserve(map->heap, count, 0) :
+                             mapMakeTableWritable(map, (total + MAP_PAGE_SIZE - 1) >> MAP_PAGE_BITS) != MAP_SUCCESS) ||
+        mapMakeFilterRoom(map, count) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (total <= MAP_FINGERPRINT_THRESHOLD || map->radix != NULL)
+    {
+        return MAP_SUCCESS;
+    }
+    if (map->index == NULL)
+    {
+        return mapBuildIndex(map, total);
+    }
+    if (mapRehashStep(map, INT_MAX) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (total * MAP_LOAD_DENOMINATOR > map->index->size * MAP_LOAD_NUMERATOR)
+    {
+        return mapResizeIndex(map, mapIndexSizeFor(total));
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * @return
+ * A new key, allocated from the map's arena if it has one (or interned, if the map is).
+ * NULL if the allocation failed.
+ */
+static Key mapNewKey(Map map, const char* key, const char* data)
+{
+    MAP_STATS_ADD(map, key_allocations, 1);
+    if (map->interned)
+    {
+        return keyCreateInterned(key, data);
+    }
+    if (map->arena == NULL)
+    {
+        return keyCreateWithAllocator(key, data, MAP_KEY_ALLOCATOR(map));
+    }
+    if (arenaIsShared(map->arena))
+    {
+        //Copies of the map still use the shared arena, so new keys go to a new one
+        Arena arena = arenaCreate(MAP_ARENA_CHUNK_SIZE);
+        if (arena == NULL)
+        {
+            return NULL;
+        }
+        arenaKeepAlive(arena, map->arena);
+        map->arena = arena;
+    }
+    size_t size = keyGetRequiredSize(key, data);
+    void* buffer = arenaAllocate(map->arena, size);
+    return buffer == NULL ? NULL : keyCreateInBuffer(buffer, size, key, data);
+}
+
+/**
+ * Adds a new key after the last one, growing the table and the index as needed.
+ * @param new_key - The key to add (NULL if creating it failed). On failure it is destroyed.
+ * @param hash - The hash of the key's ID, which is not in the map yet.
+ */
+static MapResult mapInsertKey(Map map, Key new_key, unsigned int hash)
+{
+    if (new_key == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    int page_number = map->size >> MAP_PAGE_BITS;
+    int capacity = map->table == NULL ? 0 : map->table->capacity;
+    if (mapMakeTableWritable(map, page_number < capacity ? capacity : MAP_EXPAND_FACTOR * capacity + 1)
+        != MAP_SUCCESS || mapMakePageWritable(map, page_number, (map->size & MAP_PAGE_MASK) + 1) != MAP_SUCCESS ||
+        mapMakeIndexRoom(map, hash) != MAP_SUCCESS || mapMakeFilterRoom(map, 1) != MAP_SUCCESS ||
+        (map->radix != NULL && !radixSet(map->radix, keyGetID(new_key), map->size)))
+    {
+        keyDestroyWithAllocator(new_key, MAP_KEY_ALLOCATOR(map));
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->index != NULL)
+    {
+        mapIndexInsert(map->index, hash, map->size);
+    }
+    if (map->filter != NULL)
+    {
+        mapFilterAdd(map->filter, hash);
+    }
+    MapPage page = map->table->pages[page_number];
+    page->fingerprints[page->count] = MAP_FINGERPRINT(hash);
+    page->keys[page->count++] = new_key;
+    map->size++;
+    return MAP_SUCCESS;
+}
+
+/**
+ * @param position - A used position
+ * @return
+ * The place of the key in that position, in a page only this map owns (the key
+ * itself may still be shared). NULL if copying the page failed.
+ */
+static Key* mapGetWritableKey(Map map, int position)
+{
+    int page_number = position >> MAP_PAGE_BITS;
+    if (mapMakeTableWritable(map, 0) != MAP_SUCCESS || mapMakePageWritable(map, page_number, 0) != MAP_SUCCESS)
+    {
+        return NULL;
+    }
+    return &map->table->pages[page_number]->keys[position & MAP_PAGE_MASK];
+}
+
+/**
+ * Removes a key, as 'mapRemove' does, without checking the arguments.
+ * @param hash - The hash of the key
+ */
+static MapResult mapRemoveKey(Map map, const char* key, unsigned int hash)
+{
+    assert(map != NULL && key != NULL);
+    if(map->filter != NULL && !mapFilterMayContain(map->filter, hash))
+    {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    if(map->heap != NULL)
+    {
+        return mapHeapRemove(map, key, hash);
+    }
+    int slot = MAP_NO_SUCH_KEY;
+    int i = MAP_NO_SUCH_KEY;
+    bool in_old_index = false;
+    if(map->radix != NULL)
+    {
+        i = radixGet(map->radix, key);
+    }
+    else if(map->index != NULL)
+    {
+        slot = mapFindSlot(map, key, hash, &in_old_index);
+        i = slot == MAP_NO_SUCH_KEY ? MAP_NO_SUCH_KEY : MAP_SLOT(in_old_index ? map->old_index : map->index, slot).position;
+    }
+    else
+    {
+        i = mapScanFingerprints(map, key, hash);
+    }
+    if(i == MAP_NO_SUCH_KEY)
+    {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    int last = map->size - 1;
+    //The last key fills the hole, so its slot is written too
+    int moved_slot = MAP_NO_SUCH_KEY;
+    bool moved_in_old_index = false;
+    if(i != last && map->index != NULL)
+    {
+        const char* moved_key = keyGetID(mapKeyAt(map, last));
+        moved_slot = mapFindSlot(map, moved_key, mapHash(moved_key), &moved_in_old_index);
+    }
+    if(mapMakeTableWritable(map, 0) != MAP_SUCCESS || mapMakePageWritable(map, i >> MAP_PAGE_BITS, 0) != MAP_SUCCESS ||
+       mapMakePageWritable(map, last >> MAP_PAGE_BITS, 0) != MAP_SUCCESS ||
+       mapMakeRadixWritable(map) != MAP_SUCCESS ||
+       (slot != MAP_NO_SUCH_KEY &&
+        mapMakeRunWritable(map, in_old_index ? &map->old_index : &map->index, slot) != MAP_SUCCESS) ||
+       (moved_slot != MAP_NO_SUCH_KEY &&
+        mapMakeChunksWritable(map, moved_in_old_index ? &map->old_index : &map->index,
+                              moved_slot >> MAP_INDEX_CHUNK_BITS, 1) != MAP_SUCCESS))
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    MapPage page = map->table->pages[i >> MAP_PAGE_BITS];
+    MapPage last_page = map->table->pages[last >> MAP_PAGE_BITS];
+    if(map->radix != NULL)
+    {
+        //'key' may be the ID of the key itself, so it is removed from the tree first
+        radixRemove(map->radix, key);
+    }
+    keyDestroyWithAllocator(page->keys[i & MAP_PAGE_MASK], MAP_KEY_ALLOCATOR(map));
+    if(moved_slot != MAP_NO_SUCH_KEY)
+    {
+        //The last key fills the hole, so its slot points to the new position (before removing a slot shifts it)
+        MAP_SLOT(moved_in_old_index ? map->old_index : map->index, moved_slot).position = i;
+    }
+    if(in_old_index)
+    {
+        //Shifting keys back in the old index could move them behind the slots already moved
+        MAP_SLOT(map->old_index, slot).position = MAP_MOVED_SLOT;
+    }
+    else if(map->index != NULL)
+    {
+        mapIndexRemove(map->index, slot);
+    }
+    if(i != last)
+    {
+        page->keys[i & MAP_PAGE_MASK] = last_page->keys[last & MAP_PAGE_MASK];
+        page->fingerprints[i & MAP_PAGE_MASK] = last_page->fingerprints[last & MAP_PAGE_MASK];
+        if(map->radix != NULL)
+        {
+            radixSet(map->radix, keyGetID(page->keys[i & MAP_PAGE_MASK]), i);
+        }
+    }
+    last_page->count--;
+    map->size--;
+    mapFilterRemove(map);
+    return MAP_SUCCESS;
+}
+
+/**
+ * Replaces the data element in a used position of a map which is not a
+ * counters map, without searching for its key.
+ */
+static MapResult mapSetValueAt(Map map, int position, const char* data)
+{
+    if (map->heap != NULL)
+    {
+        return heapSetValue(map->heap, position, data) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    Key* old_key = mapGetWritableKey(map, position);
+    if (old_key == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (keyIsShared(*old_key) || (map->arena != NULL && !keyValueFits(*old_key, data)))
+    {
+        //A shared key is immutable and an arena key cannot grow, so it is replaced
+        Key new_key = mapNewKey(map, keyGetID(*old_key), data);
+        if (new_key == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        keyDestroyWithAllocator(*old_key, MAP_KEY_ALLOCATOR(map));
+        *old_key = new_key;
+        return MAP_SUCCESS;
+    }
+    if (keySetValueWithAllocator(*old_key, data, MAP_KEY_ALLOCATOR(map)) != KEY_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * Replaces the counter in a used position of a counters map, without
+ * searching for its key.
+ */
+static MapResult mapSetIntAt(Map map, int position, int64_t value)
+{
+    Key* old_key = mapGetWritableKey(map, position);
+    if (old_key == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (keyIsShared(*old_key))
+    {
+        Key new_key = keyCreateIntWithAllocator(keyGetID(*old_key), value, MAP_KEY_ALLOCATOR(map));
+        if (new_key == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        keyDestroyWithAllocator(*old_key, MAP_KEY_ALLOCATOR(map));
+        *old_key = new_key;
+        return MAP_SUCCESS;
+    }
+    keySetInt(*old_key, value);
+    return MAP_SUCCESS;
+}
+
+/**
+ * Puts a key, as 'mapPut' does, without checking the arguments.
+ * @param hash - The hash of the key
+ */
+static MapResult mapPutHashed(Map map, const char* key, const char* data, unsigned int hash)
+{
+    if (map->heap != NULL)
+    {
+        return mapHeapPut(map, key, data, hash);
+    }
+    int position = mapFindKey(map, key, hash);
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        return mapInsertKey(map, mapNewKey(map, key, data), hash);
+    }
+    return mapSetValueAt(map, position, data);
+}
+
+
+/**
+ * Puts a key of a counters map, as 'mapPutInt' does, without checking the arguments.
+ * @param hash - The hash of the key
+ */
+static MapResult mapPutIntHashed(Map map, const char* key, int64_t value, unsigned int hash)
+{
+    int position = mapFindKey(map, key, hash);
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        return mapInsertKey(map, keyCreateIntWithAllocator(key, value, MAP_KEY_ALLOCATOR(map)), hash);
+    }
+    return mapSetIntAt(map, position, value);
+}
+
+
+/**
+ * Adds to a key of a counters map, as 'mapIncrement' does, without checking the arguments.
+ * @param hash - The hash of the key
+ */
+static MapResult mapIncrementHashed(Map map, const char* key, int64_t delta, int64_t* new_value, unsigned int hash)
+{
+    int position = mapFindKey(map, key, hash);
+    int64_t value = delta;
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        if (mapInsertKey(map, keyCreateIntWithAllocator(key, delta, MAP_KEY_ALLOCATOR(map)), hash) != MAP_SUCCESS)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+    }
+    else
+    {
+        Key* old_key = mapGetWritableKey(map, position);
+        if (old_key == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        if (keyIsShared(*old_key))
+        {
+            value += keyGetInt(*old_key);
+            Key new_key = keyCreateIntWithAllocator(key, value, MAP_KEY_ALLOCATOR(map));
+            if (new_key == NULL)
+            {
+                return MAP_OUT_OF_MEMORY;
+            }
+            keyDestroyWithAllocator(*old_key, MAP_KEY_ALLOCATOR(map));
+            *old_key = new_key;
+        }
+        else
+        {
+            value = keyAddInt(*old_key, delta);
+        }
+    }
+    if (new_value != NULL)
+    {
+        *new_value = value;
+    }
+    return MAP_SUCCESS;
+}
+
+
+/**
+ * Creates a concurrent map of 'stripe_count' stripes, each created by 'create_stripe'.
+ * @return
+ * NULL if an allocation failed, otherwise the new map.
+ */
+static Map mapCreateStriped(int stripe_count, Map (*create_stripe)(void))
+{
+    if (stripe_count <= 0)
+    {
+        return NULL;
+    }
+    Map new_map = create_stripe();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->stripes = malloc(stripe_count * sizeof(*new_map->stripes));
+    new_map->locks = malloc(stripe_count * sizeof(*new_map->locks));
+    if (new_map->stripes == NULL || new_map->locks == NULL)
+    {
+        free(new_map->stripes);
+        free(new_map->locks);
+        new_map->stripes = NULL;
+        new_map->locks = NULL;
+        mapDestroy(new_map);
+        return NULL;
+    }
+    for (new_map->stripe_count = 0; new_map->stripe_count < stripe_count; new_map->stripe_count++)
+    {
+        int i = new_map->stripe_count;
+        new_map->stripes[i] = create_stripe();
+        if (new_map->stripes[i] == NULL || pthread_rwlock_init(&new_map->locks[i], NULL) != 0)
+        {
+            mapDestroy(new_map->stripes[i]);
+            mapDestroy(new_map);
+            return NULL;
+        }
+    }
+    return new_map;
+}
+
+/**
+ * Locks the stripe of a concurrent map which holds the keys of a hash.
+ * @param write - true for the exclusive lock, false for the shared one
+ * @return
+ * The number of the locked stripe.
+ */
+static int mapLockStripe(Map map, unsigned int hash, bool write)
+{
+    assert(map->stripes != NULL);
+    //The stripe is picked by remixed bits, so the keys of a stripe still spread over all of its slots
+    unsigned int mixed = (hash ^ (hash >> 15)) * 0x2c1b3c6du;
+    int stripe = (mixed >> 16) % map->stripe_count;
+    if (write)
+    {
+        pthread_rwlock_wrlock(&map->locks[stripe]);
+    }
+    else
+    {
+        pthread_rwlock_rdlock(&map->locks[stripe]);
+    }
+    return stripe;
+}
+
+/**
+ * Finds the key the cursor returned last (which must exist).
+ * @param position - Set to the position of the key in the map which holds it.
+ * @return
+ * The map which holds the key (the stripe, for a concurrent map).
+ */
+static Map mapCursorPosition(const MapCursor* cursor, int* position)
+{
+    if (cursor->map->stripes == NULL)
+    {
+        *position = cursor->current;
+        return cursor->map;
+    }
+    *position = cursor->current - cursor->offset;
+    return cursor->map->stripes[cursor->stripe];
+}
+
+/**
+ * Starts a read of a read-mostly map. The snapshot it returns is not freed
+ * before 'mapEndRead', even if a writer replaces it.
+ * @param locked - Set to true if the thread could not be registered as a
+ *      reader, so it holds the writers' lock instead.
+ * @return
+ * The snapshot to read.
+ */
+static Map mapBeginRead(Map map, bool* locked)
+{
+    assert(map->snapshot != NULL);
+    *locked = !epochEnter();
+    if (*locked)
+    {
+        pthread_mutex_lock(map->write_lock);
+    }
+    return MAP_SNAPSHOT_LOAD(map->snapshot);
+}
+
+/**
+ * Ends a read of a read-mostly map started by 'mapBeginRead'.
+ */
+static void mapEndRead(Map map, bool locked)
+{
+    if (locked)
+    {
+        pthread_mutex_unlock(map->write_lock);
+    }
+    else
+    {
+        epochExit();
+    }
+}
+
+/**
+ * Pins the snapshot of a read-mostly map, so it is not freed before
+ * 'mapUnpinSnapshot', even if writers replace it meanwhile. Unlike a read, a pin
+ * is not tied to the thread, so a walk may be handed to another thread.
+ * @return
+ * The pinned snapshot.
+ */
+static Map mapPinSnapshot(Map map)
+{
+    //The read keeps the snapshot alive until the pin does
+    bool locked;
+    Map snapshot = mapBeginRead(map, &locked);
+    MAP_REFCOUNT_INCREMENT(snapshot->pins);
+    mapEndRead(map, locked);
+    return snapshot;
+}
+
+/**
+ * Unpins a snapshot pinned by 'mapPinSnapshot'. If it was replaced, the next
+ * write frees it.
+ */
+static void mapUnpinSnapshot(Map snapshot)
+{
+    assert(MAP_REFCOUNT_LOAD(snapshot->pins) > 0);
+    MAP_REFCOUNT_DECREMENT(snapshot->pins);
+}
+
+/**
+ * Stops the internal iterator of a read-mostly map, unpinning the snapshot it walked.
+ */
+static void mapEndIteration(Map map)
+{
+    if (map->iterated != NULL)
+    {
+        mapUnpinSnapshot(map->iterated);
+        map->iterated = NULL;
+    }
+}
+
+/**
+ * Starts a change of a read-mostly map: locks it for writing, and copies its
+ * snapshot so the change is made on a version no reader sees.
+ * Whatever the result, it must be followed by 'mapEndWrite'.
+ * @return
+ * The copy to change, NULL if copying failed.
+ */
+static Map mapBeginWrite(Map map)
+{
+    assert(map->snapshot != NULL);
+    pthread_mutex_lock(map->write_lock);
+    Map next = mapCopy(map->snapshot);
+#ifdef MAP_ENABLE_STATS
+    //The next snapshot goes on counting where this one is
+    if (next != NULL)
+    {
+        mapAddStats(&next->stats, map->snapshot);
+    }
+#endif
+    return next;
+}
+
+/**
+ * Ends a change of a read-mostly map started by 'mapBeginWrite', frees the
+ * replaced snapshots no reader sees anymore and unlocks the map.
+ * @param next - The changed copy (may be NULL).
+ * @param publish - true if the copy should replace the snapshot, false if it should be dropped.
+ */
+static void mapEndWrite(Map map, Map next, bool publish)
+{
+    if (next != NULL && publish)
+    {
+        Map old = map->snapshot;
+        MAP_SNAPSHOT_PUBLISH(map->snapshot, next);
+        old->retired_epoch = epochAdvance();
+        old->retired = map->retired;
+        map->retired = old;
+    }
+    else
+    {
+        mapDestroy(next);
+    }
+    unsigned long oldest = map->retired != NULL ? epochGetOldest() : 0;
+    Map* link = &map->retired;
+    while (*link != NULL)
+    {
+        Map retired = *link;
+        if (retired->retired_epoch > oldest || MAP_REFCOUNT_LOAD(retired->pins) > 0)
+        {
+            link = &retired->retired;
+            continue;
+        }
+        *link = retired->retired;
+        retired->retired = NULL;
+        mapDestroy(retired);
+    }
+    pthread_mutex_unlock(map->write_lock);
+}
+
+/**
+ * Looks a key up in the index of an image, like 'mapFindSlot' does.
+ * @return
+ * -1 if key not found
+ * Otherwise the key index
+ */
+static int mapImageFind(Map map, const char* key, unsigned int hash)
+{
+    int probes;
+    int compared;
+    int position = imageFind(map->image, key, hash, &probes, &compared);
+    MAP_STATS_PROBE(map, probes);
+    MAP_STATS_ADD(map, comparisons, compared);
+    return position != IMAGE_NO_POSITION ? position : MAP_NO_SUCH_KEY;
+}
+
+/**
+ * @param position - A used position
+ * @return
+ * The key element in that position.
+ */
+static char* mapIdAt(Map map, int position)
+{
+    if (map->image != NULL)
+    {
+        return (char*)imageGetKey(map->image, position);
+    }
+    if (map->heap != NULL)
+    {
+        return HEAP_KEY(map->heap, position);
+    }
+    return keyGetID(mapKeyAt(map, position));
+}
+
+/**
+ * @param position - A used position of a map which is not a counters map
+ * @return
+ * The data element in that position.
+ */
+static char* mapValueAt(Map map, int position)
+{
+    if (map->image != NULL)
+    {
+        return (char*)imageGetValue(map->image, position);
+    }
+    if (map->heap != NULL)
+    {
+        return HEAP_VALUE(map->heap, position);
+    }
+    return keyGetValue(mapKeyAt(map, position));
+}
+
+/**
+ * @param position - A used position of a counters map
+ * @return
+ * The counter in that position.
+ */
+static int64_t mapIntAt(Map map, int position)
+{
+    if (map->image != NULL)
+    {
+        return imageGetInt(map->image, position);
+    }
+    return keyGetInt(mapKeyAt(map, position));
+}
+
+/**
+ * Collects the elements of a map, in iteration order, for 'imageWrite' or 'imageFreeze'.
+ * The strings are the map's own, so the map must not change while they are used.
+ * @param count - The size of the map, which must not change meanwhile
+ * @param hashes - true to also collect the 'mapHash' of every key element
+ * @param pairs - Set to the elements, to be freed by 'mapFreePairs'
+ * @return
+ * MAP_OUT_OF_MEMORY if an allocation failed, MAP_ERROR if the map changed,
+ * MAP_SUCCESS otherwise.
+ */
+static MapResult mapCollectPairs(Map map, int count, bool hashes, ImagePairs* pairs)
+{
+    size_t array_count = count > 0 ? count : 1;
+    pairs->count = count;
+    pairs->keys = malloc(array_count * sizeof(*pairs->keys));
+    pairs->values = map->counters ? NULL : malloc(array_count * sizeof(*pairs->values));
+    pairs->counters = map->counters ? malloc(array_count * sizeof(*pairs->counters)) : NULL;
+    pairs->hashes = hashes ? malloc(array_count * sizeof(*pairs->hashes)) : NULL;
+    if (pairs->keys == NULL || (pairs->values == NULL && pairs->counters == NULL) || (hashes && pairs->hashes == NULL))
+    {
+        mapFreePairs(pairs);
+        return MAP_OUT_OF_MEMORY;
+    }
+    int collected = 0;
+    MAP_CURSOR_FOREACH(id, cursor, map)
+    {
+        if (collected == count)
+        {
+            collected++;
+            break;
+        }
+        pairs->keys[collected] = id;
+        if (hashes)
+        {
+            pairs->hashes[collected] = mapHash(id);
+        }
+        if (map->counters)
+        {
+            mapCursorGetInt(&cursor, &pairs->counters[collected]);
+        }
+        else
+        {
+            pairs->values[collected] = mapCursorGetValue(&cursor);
+        }
+        collected++;
+    }
+    if (collected != count)
+    {
+        mapFreePairs(pairs);
+        return MAP_ERROR;
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * Frees the arrays of elements collected by 'mapCollectPairs' (not the strings, which are the map's).
+ */
+static void mapFreePairs(ImagePairs* pairs)
+{
+    free(pairs->keys);
+    free(pairs->values);
+    free(pairs->counters);
+    free(pairs->hashes);
+}
+
+/**
+ * Appends a change which was made on the contents of a journaled map to its log.
+ * @param result - The result of the change: only a change which succeeded is logged.
+ * @return
+ * MAP_ERROR if the change could not be logged, 'result' otherwise.
+ */
+static MapResult mapLogChange(MapJournal journal, MapResult result, JournalRecordType type, const char* key,
+                              const char* data)
+{
+    if (result == MAP_SUCCESS && !journalAppend(journal->log, type, key, data))
+    {
+        return MAP_ERROR;
+    }
+    return result;
+}
+
+/**
+ * The predicate of a mapRemoveIf on the contents of a journaled map: asks the
+ * user's predicate, and logs the keys it removes. Once a removal could not be
+ * logged, that key and all the keys after it are kept, so the contents never
+ * lose a key the log still has.
+ */
+static bool mapJournalFilter(const char* key, const char* data, void* context)
+{
+    MapJournalFilter* filter = context;
+    if (filter->failed || !filter->predicate(key, data, filter->context))
+    {
+        return false;
+    }
+    if (!journalAppend(filter->log, JOURNAL_REMOVE, key, NULL))
+    {
+        filter->failed = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Applies a change of the log of a journaled map to its contents, while the map is opened.
+ */
+static bool mapReplayChange(void* context, JournalRecordType type, const char* key, const char* value)
+{
+    Map contents = context;
+    switch (type)
+    {
+    case JOURNAL_PUT:
+        return mapPut(contents, key, value) == MAP_SUCCESS;
+    case JOURNAL_REMOVE:
+        return mapRemove(contents, key) != MAP_OUT_OF_MEMORY;
+    default:
+        return mapClear(contents) == MAP_SUCCESS;
+    }
+}
+
+/**
+ * Compacts the log of a journaled map (on the journal's background thread): the
+ * contents are copied between two changes, at which point the log is rotated,
+ * and the copy becomes the new snapshot while the map goes on changing.
+ */
+static void mapCompactJournal(void* context)
+{
+    MapJournal journal = context;
+    pthread_mutex_lock(&journal->lock);
+    Map copy = mapCopy(journal->contents);
+    bool rotated = copy != NULL && journalRotate(journal->log);
+    pthread_mutex_unlock(&journal->lock);
+    if (rotated && mapSave(copy, journal->path) == MAP_SUCCESS)
+    {
+        journalRemoveRotated(journal->log);
+    }
+    mapDestroy(copy);
+}
+
+/**
+ * @return
+ * A new map with the elements of the snapshot of a journaled map, or a new empty
+ * map if there is no snapshot. NULL if the snapshot could not be read or an
+ * allocation failed.
+ */
+static Map mapLoadSnapshot(const char* path)
+{
+    if (access(path, F_OK) != 0)
+    {
+        return mapCreate();
+    }
+    Map image = mapOpenMapped(path);
+    Map contents = image != NULL ? mapCreateWithCapacity(image->size) : NULL;
+    MAP_CURSOR_FOREACH(id, cursor, contents != NULL ? image : NULL)
+    {
+        if (mapPut(contents, id, mapCursorGetValue(&cursor)) != MAP_SUCCESS)
+        {
+            mapDestroy(contents);
+            contents = NULL;
+            break;
+        }
+    }
+    mapDestroy(image);
+    return contents;
+}
+
+/**
+ * Finds a key of a compact map: by its hash in the array of hashes while the
+ * map is small, and through the hash index afterwards.
+ * @param slot - If not NULL, set to the slot which points to the key (if the
+ *      map has an index).
+ * @return
+ * -1 if key not found
+ * Otherwise the key index
+ */
+static int mapHeapFind(Map map, const char* key, unsigned int hash, int* slot)
+{
+    Heap heap = map->heap;
+    if (map->index == NULL)
+    {
+        for (int i = 0; i < map->size; i++)
+        {
+            if (heap->hashes[i] == hash && MAP_STATS_EQUALS(map, key, HEAP_KEY(heap, i)))
+            {
+                return i;
+            }
+        }
+        return MAP_NO_SUCH_KEY;
+    }
+    MapIndex index = map->index;
+    int mask = index->size - 1;
+    int i = hash & mask;
+    for (; MAP_SLOT(index, i).position != MAP_EMPTY_SLOT; i = (i + 1) & mask)
+    {
+        if (MAP_SLOT(index, i).hash == hash && MAP_STATS_EQUALS(map, key, HEAP_KEY(heap, MAP_SLOT(index, i).position)))
+        {
+            MAP_STATS_PROBE(map, ((i - (int)(hash & mask)) & mask) + 1);
+            if (slot != NULL)
+            {
+                *slot = i;
+            }
+            return MAP_SLOT(index, i).position;
+        }
+    }
+    MAP_STATS_PROBE(map, ((i - (int)(hash & mask)) & mask) + 1);
+    return MAP_NO_SUCH_KEY;
+}
+
+/**
+ * Adds a key which is not in a compact map after its last element.
+ * @param hash - The hash of the key
+ */
+static MapResult mapHeapInsert(Map map, const char* key, const char* data, unsigned int hash)
+{
+    if (mapMakeIndexRoom(map, hash) != MAP_SUCCESS || mapMakeFilterRoom(map, 1) != MAP_SUCCESS ||
+        !heapAdd(map->heap, key, data, hash))
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->index != NULL)
+    {
+        mapIndexInsert(map->index, hash, map->size);
+    }
+    if (map->filter != NULL)
+    {
+        mapFilterAdd(map->filter, hash);
+    }
+    map->size++;
+    return MAP_SUCCESS;
+}
+
+/**
+ * Puts a key of a compact map, as 'mapPut' does, without checking the arguments.
+ * @param hash - The hash of the key
+ */
+static MapResult mapHeapPut(Map map, const char* key, const char* data, unsigned int hash)
+{
+    int position = mapFindKey(map, key, hash);
+    if (position != MAP_NO_SUCH_KEY)
+    {
+        return heapSetValue(map->heap, position, data) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    return mapHeapInsert(map, key, data, hash);
+}
+
+/**
+ * Fills the empty index of a compact map with positions 0 to count - 1, whose
+ * hashes are in the map's array of hashes. The positions are first sorted by
+ * the part of MAP_FILL_PART_SLOTS slots their probes start in, so the index is
+ * filled one part after the other instead of at random slots.
+ * @param keys - The keys of the positions, which are compared on equal hashes
+ *      (NULL if they are known to be distinct)
+ * @return
+ * MAP_ITEM_ALREADY_EXISTS if two positions have equal keys (the index is then
+ * partly filled), MAP_OUT_OF_MEMORY if an allocation failed, MAP_SUCCESS otherwise.
+ */
+static MapResult mapIndexFill(Map map, const char* const* keys, int count)
+{
+    MapIndex index = map->index;
+    const uint32_t* hashes = map->heap->hashes;
+    int mask = index->size - 1;
+    int part_count = map->index->size > MAP_FILL_PART_SLOTS ? map->index->size / MAP_FILL_PART_SLOTS : 1;
+    int* part_ends = calloc(part_count + 1, sizeof(int));
+    MapSlot* sorted = malloc(count * sizeof(MapSlot));
+    if (part_ends == NULL || sorted == NULL)
+    {
+        free(part_ends);
+        free(sorted);
+        return MAP_OUT_OF_MEMORY;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        part_ends[(hashes[i] & mask) / MAP_FILL_PART_SLOTS + 1]++;
+    }
+    for (int part = 0; part < part_count; part++)
+    {
+        part_ends[part + 1] += part_ends[part];
+    }
+    //part_ends[p] starts as the beginning of part p, and ends as its end
+    for (int i = 0; i < count; i++)
+    {
+        MapSlot* entry = &sorted[part_ends[(hashes[i] & mask) / MAP_FILL_PART_SLOTS]++];
+        entry->hash = hashes[i];
+        entry->position = i;
+    }
+    MapResult result = MAP_SUCCESS;
+    for (int j = 0; j < count && result == MAP_SUCCESS; j++)
+    {
+        int slot = sorted[j].hash & mask;
+        for (; MAP_SLOT(index, slot).position != MAP_EMPTY_SLOT; slot = (slot + 1) & mask)
+        {
+            if (keys != NULL && MAP_SLOT(index, slot).hash == sorted[j].hash &&
+                MAP_STATS_EQUALS(map, keys[sorted[j].position], keys[MAP_SLOT(index, slot).position]))
+            {
+                result = MAP_ITEM_ALREADY_EXISTS;
+                break;
+            }
+        }
+        MAP_SLOT(index, slot) = sorted[j];
+    }
+    free(part_ends);
+    free(sorted);
+    return result;
+}
+
+/**
+ * Drops the duplicate keys of the arrays of 'mapCreateFromArrays' from a
+ * compact map whose hashes array holds the hashes of all of them, and whose
+ * index (if it has one) is empty. As with mapPut in order, the last data
+ * element of a key wins, and the key keeps the position of its first
+ * appearance. key_offsets[p] and value_offsets[p] are set to the indexes in
+ * the arrays of the key and the data element of position p.
+ */
+static void mapHeapDropDuplicates(Map map, const char* const* keys, int count)
+{
+    Heap heap = map->heap;
+    map->size = 0;
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int hash = heap->hashes[i];
+        int position = MAP_NO_SUCH_KEY;
+        if (map->index != NULL)
+        {
+            MapIndex index = map->index;
+            int mask = index->size - 1;
+            int slot = hash & mask;
+            for (; MAP_SLOT(index, slot).position != MAP_EMPTY_SLOT; slot = (slot + 1) & mask)
+            {
+                if (MAP_SLOT(index, slot).hash == hash &&
+                    MAP_STATS_EQUALS(map, keys[i], keys[heap->key_offsets[MAP_SLOT(index, slot).position]]))
+                {
+                    position = MAP_SLOT(index, slot).position;
+                    break;
+                }
+            }
+            if (position == MAP_NO_SUCH_KEY)
+            {
+                MAP_SLOT(index, slot).hash = hash;
+                MAP_SLOT(index, slot).position = map->size;
+            }
+        }
+        for (int j = 0; map->index == NULL && j < map->size && position == MAP_NO_SUCH_KEY; j++)
+        {
+            if (heap->hashes[j] == hash && MAP_STATS_EQUALS(map, keys[i], keys[heap->key_offsets[j]]))
+            {
+                position = j;
+            }
+        }
+        if (position != MAP_NO_SUCH_KEY)
+        {
+            heap->value_offsets[position] = (uint32_t)i;
+            continue;
+        }
+        //Position map->size is at most i, so its hash is not needed any more
+        heap->hashes[map->size] = hash;
+        heap->key_offsets[map->size] = (uint32_t)i;
+        heap->value_offsets[map->size] = (uint32_t)i;
+        map->size++;
+    }
+}
+
+/**
+ * Puts the pairs of 'mapCreateFromArrays' into an empty compact map. The keys
+ * are hashed once, and the index is filled in the order of its slots. If that
+ * finds a duplicate key, the index is filled again in the order of the keys,
+ * dropping the duplicates. The strings are then copied into a buffer of
+ * exactly their size.
+ * @param unique - true if the keys are known to be distinct, so they are not compared
+ * @return
+ * false if an allocation failed or the strings do not fit in 32-bit offsets
+ * (the map may then hold some of the arrays, and must be destroyed).
+ */
+static bool mapHeapFill(Map map, const char* const* keys, const char* const* values, int count, bool unique)
+{
+    Heap heap = map->heap;
+    if (!heapReserve(heap, count, 0) ||
+        (count > MAP_FINGERPRINT_THRESHOLD && (map->index = mapIndexCreate(map, mapIndexSizeFor(count))) == NULL))
+    {
+        return false;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        heap->hashes[i] = mapHash(keys[i]);
+    }
+    MapResult result = MAP_ITEM_ALREADY_EXISTS;
+    if (map->index != NULL)
+    {
+        result = mapIndexFill(map, unique ? NULL : keys, count);
+    }
+    else if (unique)
+    {
+        result = MAP_SUCCESS;
+    }
+    if (result == MAP_OUT_OF_MEMORY)
+    {
+        return false;
+    }
+    if (result == MAP_SUCCESS)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            heap->key_offsets[i] = (uint32_t)i;
+            heap->value_offsets[i] = (uint32_t)i;
+        }
+        map->size = count;
+    }
+    else
+    {
+        for (int i = 0; map->index != NULL && i < map->index->size; i++)
+        {
+            MAP_SLOT(map->index, i).position = MAP_EMPTY_SLOT;
+        }
+        mapHeapDropDuplicates(map, keys, count);
+    }
+    return heapFill(heap, keys, values, map->size);
+}
+
+/**
+ * Removes a key of a compact map, as 'mapRemove' does, without checking the
+ * arguments. The last element fills the hole, and the strings of the removed
+ * one become garbage.
+ * @param hash - The hash of the key
+ */
+static MapResult mapHeapRemove(Map map, const char* key, unsigned int hash)
+{
+    int slot = MAP_NO_SUCH_KEY;
+    int position = mapHeapFind(map, key, hash, &slot);
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    int last = map->size - 1;
+    int mask = map->index != NULL ? map->index->size - 1 : 0;
+    //The slot of the moved element is the one on its probe sequence which points to 'last'
+    int moved_slot = map->heap->hashes[last] & mask;
+    while (position != last && map->index != NULL && MAP_SLOT(map->index, moved_slot).position != last)
+    {
+        moved_slot = (moved_slot + 1) & mask;
+    }
+    if (map->index != NULL &&
+        (mapMakeRunWritable(map, &map->index, slot) != MAP_SUCCESS ||
+         (position != last &&
+          mapMakeChunksWritable(map, &map->index, moved_slot >> MAP_INDEX_CHUNK_BITS, 1) != MAP_SUCCESS)))
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->index != NULL)
+    {
+        //The moved element's slot points to its new position before removing the slot shifts it
+        if (position != last)
+        {
+            MAP_SLOT(map->index, moved_slot).position = position;
+        }
+        mapIndexRemove(map->index, slot);
+    }
+    heapRemove(map->heap, position);
+    map->size--;
+    mapFilterRemove(map);
+    return MAP_SUCCESS;
+}
+
+#ifdef MAP_ENABLE_STATS
+/**
+ * Adds the counts of a map (not of its stripes or snapshot) to 'total'. The
+ * longest probe is the longest of both.
+ */
+static void mapAddStats(MapStats* total, Map map)
+{
+    total->lookups += MAP_STATS_LOAD(map, lookups);
+    total->hits += MAP_STATS_LOAD(map, hits);
+    total->misses += MAP_STATS_LOAD(map, misses);
+    total->comparisons += MAP_STATS_LOAD(map, comparisons);
+    total->probes += MAP_STATS_LOAD(map, probes);
+    uint64_t longest_probe = MAP_STATS_LOAD(map, longest_probe);
+    total->longest_probe = longest_probe > total->longest_probe ? longest_probe : total->longest_probe;
+    total->expansions += MAP_STATS_LOAD(map, expansions);
+    total->bytes_reallocated += MAP_STATS_LOAD(map, bytes_reallocated);
+    total->key_allocations += MAP_STATS_LOAD(map, key_allocations);
+    total->filter_rejections += MAP_STATS_LOAD(map, filter_rejections);
+    total->filter_false_positives += MAP_STATS_LOAD(map, filter_false_positives);
+    if (map->heap != NULL)
+    {
+        //The arrays and the buffer of a compact map count their own growth
+        total->expansions += map->heap->growths;
+        total->bytes_reallocated += map->heap->bytes_allocated;
+    }
+}
+#endif
+
+/**
+ * Sets the fields of a new map, as an empty map without any mode (which uses malloc).
+ */
+static void mapInitialize(Map map)
+{
+    map->table = NULL;
+    map->index = NULL;
+    map->size = 0;
+    map->iterator = 0;
+    map->arena = NULL;
+    map->counters = false;
+    map->interned = false;
+    map->stripes = NULL;
+    map->locks = NULL;
+    map->stripe_count = 0;
+    map->snapshot = NULL;
+    map->retired = NULL;
+    map->retired_epoch = 0;
+    map->pins = 0;
+    map->iterated = NULL;
+    map->write_lock = NULL;
+    map->image = NULL;
+    map->journal = NULL;
+    map->heap = NULL;
+    map->incremental = false;
+    map->next_index = NULL;
+    map->old_index = NULL;
+    map->rehash_slot = 0;
+#ifdef MAP_ENABLE_STATS
+    memset(&map->stats, 0, sizeof(map->stats));
+#endif
+    map->allocator.allocate = NULL;
+    map->allocator.reallocate = NULL;
+    map->allocator.release = NULL;
+    map->allocator.context = NULL;
+    map->radix = NULL;
+    map->filter = NULL;
+    map->filter_stale = 0;
+}
+
+/**
+ * Calls the visitor of mapForEachPrefix for a key of a radix map.
+ * @param position - The position of the key
+ * @param context - A MapPrefixVisit
+ */
+static bool mapRadixVisit(int position, void* context)
+{
+    MapPrefixVisit* visit = context;
+    return visit->visitor(mapIdAt(visit->map, position), mapValueAt(visit->map, position), visit->context);
+}
+
+/**
+ * mapForEachPrefix, without checking the arguments.
+ * @return
+ * false if the visitor stopped the walk, true otherwise.
+ */
+static bool mapVisitPrefix(Map map, const char* prefix, MapVisitor visitor, void* context)
+{
+    if (map->journal != NULL)
+    {
+        return mapVisitPrefix(map->journal->contents, prefix, visitor, context);
+    }
+    bool done = true;
+    if (map->stripes != NULL)
+    {
+        for (int i = 0; done && i < map->stripe_count; i++)
+        {
+            pthread_rwlock_rdlock(&map->locks[i]);
+            done = mapVisitPrefix(map->stripes[i], prefix, visitor, context);
+            pthread_rwlock_unlock(&map->locks[i]);
+        }
+        return done;
+    }
+    if (map->snapshot != NULL)
+    {
+        bool locked;
+        Map snapshot = mapBeginRead(map, &locked);
+        done = mapVisitPrefix(snapshot, prefix, visitor, context);
+        mapEndRead(map, locked);
+        return done;
+    }
+    if (map->radix != NULL)
+    {
+        MapPrefixVisit visit = {map, visitor, context};
+        return radixForEachPrefix(map->radix, prefix, mapRadixVisit, &visit);
+    }
+    //Other maps have no order to search, so all their keys are compared with the prefix
+    size_t length = strlen(prefix);
+    for (int i = 0; done && i < map->size; i++)
+    {
+        const char* key = mapIdAt(map, i);
+        if (strncmp(key, prefix, length) == 0)
+        {
+            done = visitor(key, map->counters ? NULL : mapValueAt(map, i), context);
+        }
+    }
+    return done;
+}
+
+//--------------------HEADER-FUNCTIONS--------------------//
+Map mapCreate()
+{
+    Map new_map = malloc(sizeof(*new_map));
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    mapInitialize(new_map);
+    return new_map;
+}
+
+Map mapCreateRadix()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->radix = radixCreate();
+    if (new_map->radix == NULL)
+    {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+Map mapCreateWithAllocator(const MapAllocator* allocator)
+{
+    if (allocator == NULL || allocator->allocate == NULL || allocator->reallocate == NULL ||
+        allocator->release == NULL)
+    {
+        return NULL;
+    }
+    Map new_map = allocator->allocate(allocator->context, sizeof(*new_map));
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    mapInitialize(new_map);
+    new_map->allocator.allocate = allocator->allocate;
+    new_map->allocator.reallocate = allocator->reallocate;
+    new_map->allocator.release = allocator->release;
+    new_map->allocator.context = allocator->context;
+    return new_map;
+}
+
+Map mapCreateCounters()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->counters = true;
+    return new_map;
+}
+
+Map mapCreateInterned()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->interned = true;
+    return new_map;
+}
+
+Map mapCreateConcurrent(int stripes)
+{
+    return mapCreateStriped(stripes, mapCreate);
+}
+
+Map mapCreateConcurrentCounters(int stripes)
+{
+    return mapCreateStriped(stripes, mapCreateCounters);
+}
+
+Map mapCreateReadMostly()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->snapshot = mapCreate();
+    new_map->write_lock = malloc(sizeof(*new_map->write_lock));
+    if (new_map->snapshot == NULL || new_map->write_lock == NULL ||
+        pthread_mutex_init(new_map->write_lock, NULL) != 0)
+    {
+        free(new_map->write_lock);
+        new_map->write_lock = NULL;
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+Map mapCreateWithCapacity(int capacity)
+{
+    if (capacity < 0)
+    {
+        return NULL;
+    }
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    if (mapReserve(new_map, capacity) != MAP_SUCCESS)
+    {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+Map mapCreateCompact()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->heap = heapCreate();
+    if (new_map->heap == NULL)
+    {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+Map mapCreateFromArrays(const char* const* keys, const char* const* values, int count, unsigned int flags)
+{
+    if (keys == NULL || values == NULL || count < 0)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (keys[i] == NULL || values[i] == NULL)
+        {
+            return NULL;
+        }
+    }
+    Map new_map = mapCreateCompact();
+    if (new_map == NULL || count == 0)
+    {
+        return new_map;
+    }
+    if (!mapHeapFill(new_map, keys, values, count, (flags & MAP_ARRAYS_UNIQUE_KEYS) != 0))
+    {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+Map mapCreateIncremental()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->incremental = true;
+    return new_map;
+}
+
+Map mapCreateArena()
+{
+    Map new_map = mapCreate();
+    if (new_map == NULL)
+    {
+        return NULL;
+    }
+    new_map->arena = arenaCreate(MAP_ARENA_CHUNK_SIZE);
+    if (new_map->arena == NULL)
+    {
+        mapDestroy(new_map);
+        return NULL;
+    }
+    return new_map;
+}
+
+void mapDestroy(Map map)
+{
+    if(!map)
+    {
+        return;
+    }
+    for(int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        mapDestroy(map->stripes[i]);
+        pthread_rwlock_destroy(&map->locks[i]);
+    }
+    free(map->stripes);
+    free(map->locks);
+    mapDestroy(map->snapshot);
+    while(map->retired != NULL)
+    {
+        Map retired = map->retired;
+        map->retired = retired->retired;
+        retired->retired = NULL;
+        mapDestroy(retired);
+    }
+    if(map->write_lock != NULL)
+    {
+        pthread_mutex_destroy(map->write_lock);
+        free(map->write_lock);
+    }
+    mapReleaseTable(map, map->table, map->arena == NULL);
+    mapReleaseIndex(map, map->index);
+    mapReleaseIndex(map, map->next_index);
+    mapReleaseIndex(map, map->old_index);
+    radixDestroy(map->radix);
+    mapReleaseFilter(map, map->filter);
+    imageDestroy(map->image);
+    heapDestroy(map->heap);
+    if(map->journal != NULL)
+    {
+        //Closing the log waits for a running compaction, which still uses the contents
+        journalDestroy(map->journal->log);
+        mapDestroy(map->journal->contents);
+        pthread_mutex_destroy(&map->journal->lock);
+        free(map->journal->path);
+        free(map->journal);
+    }
+    arenaDestroy(map->arena);
+    mapFree(map, map, sizeof(*map));
+}
+
+Map mapCopy(Map map)
+{
+    if(!map)
+    {
+        return NULL;
+    }
+    if(map->stripes != NULL)
+    {
+        Map new_map = mapCreateStriped(map->stripe_count, map->counters ? mapCreateCounters : mapCreate);
+        for(int i = 0; new_map != NULL && i < map->stripe_count; i++)
+        {
+            //The exclusive lock keeps counters from being added to while their pages become shared
+            pthread_rwlock_wrlock(&map->locks[i]);
+            Map stripe = mapCopy(map->stripes[i]);
+            pthread_rwlock_unlock(&map->locks[i]);
+            if(stripe == NULL)
+            {
+                mapDestroy(new_map);
+                return NULL;
+            }
+            mapDestroy(new_map->stripes[i]);
+            new_map->stripes[i] = stripe;
+        }
+        return new_map;
+    }
+    if(map->snapshot != NULL)
+    {
+        Map new_map = mapCreateReadMostly();
+        pthread_mutex_lock(map->write_lock);
+        Map snapshot = new_map != NULL ? mapCopy(map->snapshot) : NULL;
+        pthread_mutex_unlock(map->write_lock);
+        if(snapshot == NULL)
+        {
+            mapDestroy(new_map);
+            return NULL;
+        }
+        mapDestroy(new_map->snapshot);
+        new_map->snapshot = snapshot;
+        return new_map;
+    }
+    if(map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        Map new_map = mapCopy(map->journal->contents);
+        pthread_mutex_unlock(&map->journal->lock);
+        return new_map;
+    }
+    Map new_map = mapAllocate(map, sizeof(*new_map));
+    if(!new_map)
+    {
+        return NULL;
+    }
+    //Everything is shared, and copied by whichever map changes it first
+    //(but the arrays of a compact map, which are copied now)
+    *new_map = *map;
+    new_map->pins = 0;
+    if(map->heap != NULL)
+    {
+        new_map->heap = heapCopy(map->heap);
+        if(new_map->heap == NULL)
+        {
+            mapFree(map, new_map, sizeof(*new_map));
+            return NULL;
+        }
+    }
+#ifdef MAP_ENABLE_STATS
+    memset(&new_map->stats, 0, sizeof(new_map->stats));
+#endif
+    if(map->table != NULL)
+    {
+        MAP_REFCOUNT_INCREMENT(map->table->refcount);
+    }
+    if(map->index != NULL)
+    {
+        MAP_REFCOUNT_INCREMENT(map->index->refcount);
+    }
+    if(map->old_index != NULL)
+    {
+        MAP_REFCOUNT_INCREMENT(map->old_index->refcount);
+    }
+    if(map->next_index != NULL)
+    {
+        //The next index is still being cleared, so the copy starts growing its index again on its own
+        new_map->next_index = NULL;
+        new_map->rehash_slot = 0;
+    }
+    if(map->image != NULL)
+    {
+        imageShare(map->image);
+    }
+    if(map->filter != NULL)
+    {
+        MAP_REFCOUNT_INCREMENT(map->filter->refcount);
+    }
+    arenaShare(map->arena);
+    radixShare(map->radix);
+    return new_map;
+}
+
+int mapGetSize(Map map)
+{
+    if (map == NULL)
+    {
+        return -1;
+    }
+    int size = map->size;
+    for (int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        pthread_rwlock_rdlock(&map->locks[i]);
+        size += map->stripes[i]->size;
+        pthread_rwlock_unlock(&map->locks[i]);
+    }
+    if (map->snapshot != NULL)
+    {
+        bool locked;
+        size = mapBeginRead(map, &locked)->size;
+        mapEndRead(map, locked);
+    }
+    if (map->journal != NULL)
+    {
+        size = map->journal->contents->size;
+    }
+    return size;
+}
+
+bool mapContains(Map map, const char* key)
+{
+    if (map == NULL || key == NULL)
+    {
+        return false;
+    }
+    if (map->journal != NULL)
+    {
+        return mapContains(map->journal->contents, key);
+    }
+    unsigned int hash = mapHash(key);
+    if (map->stripes != NULL)
+    {
+        int stripe = mapLockStripe(map, hash, false);
+        bool result = mapFindKey(map->stripes[stripe], key, hash) != MAP_NO_SUCH_KEY;
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        return result;
+    }
+    if (map->snapshot != NULL)
+    {
+        bool locked;
+        bool result = mapFindKey(mapBeginRead(map, &locked), key, hash) != MAP_NO_SUCH_KEY;
+        mapEndRead(map, locked);
+        return result;
+    }
+    if (mapFindKey(map, key, hash) == MAP_NO_SUCH_KEY)
+    {
+        return false;
+    }
+    return true;
+}
+
+MapResult mapPut(Map map, const char* key, const char* data)
+{
+    if (map == NULL || key == NULL || data == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (map->counters || map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    unsigned int hash = mapHash(key);
+    if (map->stripes != NULL)
+    {
+        int stripe = mapLockStripe(map, hash, true);
+        MapResult result = mapPutHashed(map->stripes[stripe], key, data, hash);
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        return result;
+    }
+    if (map->snapshot != NULL)
+    {
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapPutHashed(next, key, data, hash) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    if (map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapPutHashed(map->journal->contents, key, data, hash);
+        result = mapLogChange(map->journal, result, JOURNAL_PUT, key, data);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result;
+    }
+    return mapPutHashed(map, key, data, hash);
+}
+
+MapResult mapPutInt(Map map, const char* key, int64_t value)
+{
+    if (map == NULL || key == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!map->counters || map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    unsigned int hash = mapHash(key);
+    if (map->stripes != NULL)
+    {
+        int stripe = mapLockStripe(map, hash, true);
+        MapResult result = mapPutIntHashed(map->stripes[stripe], key, value, hash);
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        return result;
+    }
+    return mapPutIntHashed(map, key, value, hash);
+}
+
+MapResult mapIncrement(Map map, const char* key, int64_t delta, int64_t* new_value)
+{
+    if (map == NULL || key == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!map->counters || map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    unsigned int hash = mapHash(key);
+    if (map->stripes == NULL)
+    {
+        return mapIncrementHashed(map, key, delta, new_value, hash);
+    }
+    //An existing counter which no copy shares is added to atomically under the shared lock
+    int stripe = mapLockStripe(map, hash, false);
+    Map stripe_map = map->stripes[stripe];
+    int position = mapFindKey(stripe_map, key, hash);
+    if (position != MAP_NO_SUCH_KEY && MAP_REFCOUNT_LOAD(stripe_map->table->refcount) == 1 &&
+        MAP_REFCOUNT_LOAD(stripe_map->table->pages[position >> MAP_PAGE_BITS]->refcount) == 1 &&
+        !keyIsShared(mapKeyAt(stripe_map, position)))
+    {
+        int64_t value = keyAddInt(mapKeyAt(stripe_map, position), delta);
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        if (new_value != NULL)
+        {
+            *new_value = value;
+        }
+        return MAP_SUCCESS;
+    }
+    pthread_rwlock_unlock(&map->locks[stripe]);
+    stripe = mapLockStripe(map, hash, true);
+    MapResult result = mapIncrementHashed(map->stripes[stripe], key, delta, new_value, hash);
+    pthread_rwlock_unlock(&map->locks[stripe]);
+    return result;
+}
+
+MapEntry mapFindOrInsert(Map map, const char* key, bool* inserted)
+{
+    MapEntry entry = {NULL, MAP_NO_SUCH_KEY};
+    if (map == NULL || key == NULL || inserted == NULL)
+    {
+        return entry;
+    }
+    *inserted = false;
+    if (map->stripes != NULL || map->snapshot != NULL || map->journal != NULL || map->image != NULL)
+    {
+        //Their elements are moved by other threads, or changed only through a log or not at all
+        return entry;
+    }
+    unsigned int hash = mapHash(key);
+    int position = mapFindKey(map, key, hash);
+    if (position == MAP_NO_SUCH_KEY)
+    {
+        MapResult result;
+        if (map->heap != NULL)
+        {
+            result = mapHeapInsert(map, key, "", hash);
+        }
+        else
+        {
+            Key new_key = map->counters ? keyCreateIntWithAllocator(key, 0, MAP_KEY_ALLOCATOR(map))
+                                        : mapNewKey(map, key, "");
+            result = mapInsertKey(map, new_key, hash);
+        }
+        if (result != MAP_SUCCESS)
+        {
+            return entry;
+        }
+        position = map->size - 1;
+        *inserted = true;
+    }
+    entry.map = map;
+    entry.position = position;
+    return entry;
+}
+
+char* mapEntryGetKey(const MapEntry* entry)
+{
+    if (entry == NULL || entry->map == NULL)
+    {
+        return NULL;
+    }
+    return mapIdAt(entry->map, entry->position);
+}
+
+char* mapEntryGetValue(const MapEntry* entry)
+{
+    if (entry == NULL || entry->map == NULL || entry->map->counters)
+    {
+        return NULL;
+    }
+    return mapValueAt(entry->map, entry->position);
+}
+
+MapResult mapEntrySetValue(const MapEntry* entry, const char* data)
+{
+    if (entry == NULL || entry->map == NULL || data == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (entry->map->counters)
+    {
+        return MAP_ERROR;
+    }
+    return mapSetValueAt(entry->map, entry->position, data);
+}
+
+MapResult mapEntryGetInt(const MapEntry* entry, int64_t* value)
+{
+    if (entry == NULL || entry->map == NULL || value == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!entry->map->counters)
+    {
+        return MAP_ERROR;
+    }
+    *value = mapIntAt(entry->map, entry->position);
+    return MAP_SUCCESS;
+}
+
+MapResult mapEntrySetInt(const MapEntry* entry, int64_t value)
+{
+    if (entry == NULL || entry->map == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!entry->map->counters)
+    {
+        return MAP_ERROR;
+    }
+    return mapSetIntAt(entry->map, entry->position, value);
+}
+
+MapResult mapGetInt(Map map, const char* key, int64_t* value)
+{
+    if (map == NULL || key == NULL || value == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!map->counters)
+    {
+        return MAP_ERROR;
+    }
+    unsigned int hash = mapHash(key);
+    int stripe = map->stripes != NULL ? mapLockStripe(map, hash, false) : 0;
+    Map stripe_map = map->stripes != NULL ? map->stripes[stripe] : map;
+    int position = mapFindKey(stripe_map, key, hash);
+    if (position != MAP_NO_SUCH_KEY)
+    {
+        *value = mapIntAt(stripe_map, position);
+    }
+    if (map->stripes != NULL)
+    {
+        pthread_rwlock_unlock(&map->locks[stripe]);
+    }
+    return position == MAP_NO_SUCH_KEY ? MAP_ITEM_DOES_NOT_EXIST : MAP_SUCCESS;
+}
+
+char* mapGet(Map map, const char* key)
+{
+    if(!map || !key)
+    {
+        return NULL;
+    }
+    if (map->counters)
+    {
+        return NULL;
+    }
+    if (map->journal != NULL)
+    {
+        return mapGet(map->journal->contents, key);
+    }
+    unsigned int hash = mapHash(key);
+    if (map->stripes != NULL)
+    {
+        int stripe = mapLockStripe(map, hash, false);
+        int key_index = mapFindKey(map->stripes[stripe], key, hash);
+        char* data = key_index == MAP_NO_SUCH_KEY ? NULL : keyGetValue(mapKeyAt(map->stripes[stripe], key_index));
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        return data;
+    }
+    if (map->snapshot != NULL)
+    {
+        bool locked;
+        Map snapshot = mapBeginRead(map, &locked);
+        int key_index = mapFindKey(snapshot, key, hash);
+        char* data = key_index == MAP_NO_SUCH_KEY ? NULL : keyGetValue(mapKeyAt(snapshot, key_index));
+        mapEndRead(map, locked);
+        return data;
+    }
+    int key_index = mapFindKey(map, key, hash);
+    return key_index == MAP_NO_SUCH_KEY ? NULL : mapValueAt(map, key_index);
+}
+
+MapResult mapRemove(Map map, const char* key)
+{
+    if(!map || !key)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if(map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    unsigned int hash = mapHash(key);
+    if(map->stripes != NULL)
+    {
+        int stripe = mapLockStripe(map, hash, true);
+        MapResult result = mapRemoveKey(map->stripes[stripe], key, hash);
+        pthread_rwlock_unlock(&map->locks[stripe]);
+        return result;
+    }
+    if(map->snapshot != NULL)
+    {
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapRemoveKey(next, key, hash) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    if(map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapRemoveKey(map->journal->contents, key, hash);
+        result = mapLogChange(map->journal, result, JOURNAL_REMOVE, key, NULL);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result;
+    }
+    return mapRemoveKey(map, key, hash);
+}
+
+MapResult mapRemoveIf(Map map, MapPredicate predicate, void* context)
+{
+    if(!map || !predicate)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if(map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    for(int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        pthread_rwlock_wrlock(&map->locks[i]);
+        MapResult result = mapRemoveIf(map->stripes[i], predicate, context);
+        pthread_rwlock_unlock(&map->locks[i]);
+        if(result != MAP_SUCCESS)
+        {
+            return result;
+        }
+    }
+    if(map->snapshot != NULL)
+    {
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapRemoveIf(next, predicate, context) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    if(map->journal != NULL)
+    {
+        MapJournalFilter filter = {predicate, context, map->journal->log, false};
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapRemoveIf(map->journal->contents, mapJournalFilter, &filter);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result == MAP_SUCCESS && filter.failed ? MAP_ERROR : result;
+    }
+    if(map->size == 0)
+    {
+        return MAP_SUCCESS;
+    }
+    //The index is rebuilt below, which needs the growth of an incremental map's index to be over
+    if(mapRehashStep(map, INT_MAX) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    //Any page may change, so all of them are made writable before the first change
+    if(map->heap == NULL && mapMakeTableWritable(map, 0) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    for(int i = 0; map->heap == NULL && i <= (map->size - 1) >> MAP_PAGE_BITS; i++)
+    {
+        if(mapMakePageWritable(map, i, 0) != MAP_SUCCESS)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+    }
+    if(mapMakeRadixWritable(map) != MAP_SUCCESS || mapMakeFilterRoom(map, 0) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    //The index is rebuilt afterwards, so a shared one (or one with shared chunks) is replaced by an empty one
+    MapIndex index = map->index;
+    if(index != NULL && mapIndexIsShared(index))
+    {
+        index = mapIndexCreate(map, index->size);
+        if(index == NULL)
+        {
+            return MAP_OUT_OF_MEMORY;
+        }
+        mapReleaseIndex(map, map->index);
+        map->index = index;
+    }
+    int kept = map->heap != NULL ? heapRemoveIf(map->heap, predicate, context) : 0;
+    for(int i = 0; map->heap == NULL && i < map->size; i++)
+    {
+        MapPage page = map->table->pages[i >> MAP_PAGE_BITS];
+        Key key = page->keys[i & MAP_PAGE_MASK];
+        if(predicate(keyGetID(key), map->counters ? NULL : keyGetValue(key), context))
+        {
+            if(map->radix != NULL)
+            {
+                radixRemove(map->radix, keyGetID(key));
+            }
+            keyDestroyWithAllocator(key, MAP_KEY_ALLOCATOR(map));
+            continue;
+        }
+        if(kept != i && map->radix != NULL)
+        {
+            //The tree is updated as the keys move, instead of being rebuilt
+            radixSet(map->radix, keyGetID(key), kept);
+        }
+        if(kept != i)
+        {
+            MapPage kept_page = map->table->pages[kept >> MAP_PAGE_BITS];
+            kept_page->keys[kept & MAP_PAGE_MASK] = key;
+            kept_page->fingerprints[kept & MAP_PAGE_MASK] = page->fingerprints[i & MAP_PAGE_MASK];
+        }
+        kept++;
+    }
+    for(int i = 0; map->heap == NULL && i <= (map->size - 1) >> MAP_PAGE_BITS; i++)
+    {
+        int count = kept - (i << MAP_PAGE_BITS);
+        map->table->pages[i]->count = count < 0 ? 0 : (count > MAP_PAGE_SIZE ? MAP_PAGE_SIZE : count);
+    }
+    map->size = kept;
+    if(map->filter != NULL)
+    {
+        mapFilterFill(map, map->filter);
+        map->filter_stale = 0;
+    }
+    if(index != NULL && kept <= MAP_FINGERPRINT_THRESHOLD)
+    {
+        mapReleaseIndex(map, index);
+        map->index = NULL;
+    }
+    else if(index != NULL)
+    {
+        for(int i = 0; i < index->size; i++)
+        {
+            MAP_SLOT(index, i).position = MAP_EMPTY_SLOT;
+        }
+        for(int i = 0; i < kept; i++)
+        {
+            mapIndexInsert(index, map->heap != NULL ? map->heap->hashes[i] : mapHash(keyGetID(mapKeyAt(map, i))), i);
+        }
+    }
+    return MAP_SUCCESS;
+}
+
+MapResult mapForEachPrefix(Map map, const char* prefix, MapVisitor visitor, void* context)
+{
+    if(!map || !prefix || !visitor)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    mapVisitPrefix(map, prefix, visitor, context);
+    return MAP_SUCCESS;
+}
+
+MapResult mapPutBatch(Map map, const char* const* keys, const char* const* data, int count)
+{
+    if(!map || !keys || !data)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if(count < 0)
+    {
+        return MAP_ERROR;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(!keys[i] || !data[i])
+        {
+            return MAP_NULL_ARGUMENT;
+        }
+    }
+    if(map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    if(map->snapshot != NULL)
+    {
+        //The whole batch is published at once (or not at all)
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapPutBatch(next, keys, data, count) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    //The keys of a concurrent map are spread over its stripes, which grow on their own
+    //(and each key put in a journaled map is logged on its own)
+    if(map->stripes == NULL && map->journal == NULL && mapReserve(map, count) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        MapResult result = mapPut(map, keys[i], data[i]);
+        if(result != MAP_SUCCESS)
+        {
+            return result;
+        }
+    }
+    return MAP_SUCCESS;
+}
+
+MapResult mapRemoveBatch(Map map, const char* const* keys, int count)
+{
+    if(!map || !keys)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if(count < 0)
+    {
+        return MAP_ERROR;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(!keys[i])
+        {
+            return MAP_NULL_ARGUMENT;
+        }
+    }
+    if(map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    if(map->snapshot != NULL)
+    {
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapRemoveBatch(next, keys, count) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        MapResult result = mapRemove(map, keys[i]);
+        if(result == MAP_OUT_OF_MEMORY || result == MAP_ERROR)
+        {
+            return result;
+        }
+    }
+    return MAP_SUCCESS;
+}
+
+char* mapGetFirst(Map map)
+{
+    if(!map)
+    {
+        return NULL;
+    }
+    if(map->snapshot != NULL)
+    {
+        //The iterator walks the snapshot of the time it started, which writes do not free meanwhile
+        mapEndIteration(map);
+        map->iterated = mapPinSnapshot(map);
+        char* key = mapGetFirst(map->iterated);
+        if(key == NULL)
+        {
+            mapEndIteration(map);
+        }
+        return key;
+    }
+    if(map->journal != NULL)
+    {
+        //A compaction may be copying the contents, iterator included
+        pthread_mutex_lock(&map->journal->lock);
+        char* key = mapGetFirst(map->journal->contents);
+        pthread_mutex_unlock(&map->journal->lock);
+        return key;
+    }
+    map->iterator = 0;
+    if(map->stripes != NULL)
+    {
+        //The iterator of a concurrent map is the number of the stripe being walked
+        for(; map->iterator < map->stripe_count; map->iterator++)
+        {
+            char* key = mapGetFirst(map->stripes[map->iterator]);
+            if(key != NULL)
+            {
+                return key;
+            }
+        }
+        return NULL;
+    }
+    return map->size > 0? mapIdAt(map, map->iterator) : NULL;
+}
+
+char* mapGetNext(Map map)
+{
+    if(!map)
+    {
+        return NULL;
+    }
+    if(map->snapshot != NULL)
+    {
+        char* key = map->iterated != NULL ? mapGetNext(map->iterated) : NULL;
+        if(key == NULL)
+        {
+            mapEndIteration(map);
+        }
+        return key;
+    }
+    if(map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        char* key = mapGetNext(map->journal->contents);
+        pthread_mutex_unlock(&map->journal->lock);
+        return key;
+    }
+    if(map->stripes != NULL)
+    {
+        if(map->iterator >= map->stripe_count)
+        {
+            return NULL;
+        }
+        char* key = mapGetNext(map->stripes[map->iterator]);
+        while(key == NULL && ++map->iterator < map->stripe_count)
+        {
+            key = mapGetFirst(map->stripes[map->iterator]);
+        }
+        return key;
+    }
+    map->iterator++;
+    return map->iterator >= map->size? NULL : mapIdAt(map, map->iterator);
+}
+
+MapCursor mapCursorCreate(Map map)
+{
+    return mapCursorCreateRange(map, 0, 1);
+}
 
+MapCursor mapCursorCreateRange(Map map, int part, int parts)
+{
+    MapCursor cursor = {NULL, 0, 0, MAP_NO_SUCH_KEY, 0, 0, false};
+    if (map == NULL || parts <= 0 || part < 0 || part >= parts)
+    {
+        return cursor;
+    }
+    //A cursor over a read-mostly map walks the snapshot of the time it was created, pinned until the walk ends
+    cursor.pinned = map->snapshot != NULL;
+    map = cursor.pinned ? mapPinSnapshot(map) : map;
+    map = map->journal != NULL ? map->journal->contents : map;
+    cursor.map = map;
+    //The positions are dense, so a part is a contiguous slice of them
+    //(the positions of a concurrent map run over its stripes one after the other)
+    int size = mapGetSize(map);
+    cursor.next = (int)((long long)size * part / parts);
+    cursor.end = (int)((long long)size * (part + 1) / parts);
+    return cursor;
+}
 
+char* mapCursorNext(MapCursor* cursor)
+{
+    if (cursor == NULL || cursor->map == NULL || cursor->next >= cursor->end)
+    {
+        mapCursorRelease(cursor);
+        return NULL;
+    }
+    cursor->current = cursor->next++;
+    while (cursor->map->stripes != NULL && cursor->current - cursor->offset >= cursor->map->stripes[cursor->stripe]->size)
+    {
+        cursor->offset += cursor->map->stripes[cursor->stripe++]->size;
+    }
+    int position;
+    Map owner = mapCursorPosition(cursor, &position);
+    return mapIdAt(owner, position);
+}
 
-//--------------------STATIC-FUNCTIONS--------------------//
-/**
- * @param map - The Key's map
- * @param key - The wanted key
- * @return 
- * -1 if key not found 
- * Otherwise the key index 
- */
+void mapCursorRelease(MapCursor* cursor)
+{
+    if (cursor == NULL)
+    {
+        return;
+    }
+    if (cursor->pinned)
+    {
+        mapUnpinSnapshot(cursor->map);
+        cursor->pinned = false;
+        cursor->map = NULL;
+    }
+    cursor->current = MAP_NO_SUCH_KEY;
+}
 
-static int mapFindKey(Map map, const char* key)
+char* mapCursorGetValue(const MapCursor* cursor)
 {
-    assert (map != NULL && key != NULL);
-    for (int index = 0; index < map->size; index++)
+    if (cursor == NULL || cursor->map == NULL || cursor->current == MAP_NO_SUCH_KEY || cursor->map->counters)
     {
-        if (!strcmp(key,keyGetID((map->keys[index]))))
-        {
-            return index;
-        }
+        return NULL;
     }
-    return MAP_NO_SUCH_KEY;
+    int position;
+    Map owner = mapCursorPosition(cursor, &position);
+    return mapValueAt(owner, position);
 }
 
+MapResult mapCursorGetInt(const MapCursor* cursor, int64_t* value)
+{
+    if (cursor == NULL || cursor->map == NULL || cursor->current == MAP_NO_SUCH_KEY || value == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!cursor->map->counters)
+    {
+        return MAP_ERROR;
+    }
+    int position;
+    Map owner = mapCursorPosition(cursor, &position);
+    *value = mapIntAt(owner, position);
+    return MAP_SUCCESS;
+}
 
-static MapResult mapExpand(Map map)
+MapResult mapSave(Map map, const char* path)
 {
-    assert(map != NULL);
-    int new_size = MAP_EXPAND_FACTOR * map->max_size ;
-    Key* new_keys_array = realloc(map->keys, new_size* sizeof(*new_keys_array));
-    if (new_keys_array == NULL)
+    if (map == NULL || path == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    int count = mapGetSize(map);
+    //The index of an image is never changed, so it is filled up to the load limit
+    uint32_t index_size = 1;
+    while ((uint64_t)index_size * MAP_LOAD_NUMERATOR <= (uint64_t)count * MAP_LOAD_DENOMINATOR)
+    {
+        index_size *= 2;
+    }
+    //The image is written aside and renamed over the old one, which maps may still be reading
+    char* temporary_path = malloc(strlen(path) + sizeof(MAP_IMAGE_TEMPORARY_SUFFIX));
+    if (temporary_path == NULL)
     {
         return MAP_OUT_OF_MEMORY;
-    } 
-    map->keys = new_keys_array;
-    map->max_size = new_size;
-    return MAP_SUCCESS;
+    }
+    strcpy(temporary_path, path);
+    strcat(temporary_path, MAP_IMAGE_TEMPORARY_SUFFIX);
+    FILE* file = fopen(temporary_path, "wb");
+    if (file == NULL)
+    {
+        free(temporary_path);
+        return MAP_ERROR;
+    }
+    //An image (such as a frozen map's) is written as it is, so it keeps its index
+    MapResult result = MAP_SUCCESS;
+    if (map->image != NULL)
+    {
+        result = imageDump(map->image, file) ? MAP_SUCCESS : MAP_ERROR;
+    }
+    else
+    {
+        ImagePairs pairs;
+        result = mapCollectPairs(map, count, true, &pairs);
+        if (result == MAP_SUCCESS)
+        {
+            ImageResult written = imageWrite(&pairs, index_size, file);
+            result = written == IMAGE_SUCCESS ? MAP_SUCCESS : written == IMAGE_OUT_OF_MEMORY ? MAP_OUT_OF_MEMORY :
+                     MAP_ERROR;
+            mapFreePairs(&pairs);
+        }
+    }
+    //The image is on the disk before it replaces the old one
+    if (result == MAP_SUCCESS && (fflush(file) != 0 || fsync(fileno(file)) != 0))
+    {
+        result = MAP_ERROR;
+    }
+    if (fclose(file) != 0 && result == MAP_SUCCESS)
+    {
+        result = MAP_ERROR;
+    }
+    if (result == MAP_SUCCESS && rename(temporary_path, path) != 0)
+    {
+        result = MAP_ERROR;
+    }
+    if (result != MAP_SUCCESS)
+    {
+        remove(temporary_path);
+    }
+    free(temporary_path);
+    return result;
 }
 
-//--------------------HEADER-FUNCTIONS--------------------//
-Map mapCreate()
+Map mapOpenMapped(const char* path)
 {
-    Map new_map = malloc(sizeof(*new_map));
-    if (new_map == NULL)
+    if (path == NULL)
     {
         return NULL;
     }
-    Key* new_array = malloc(MAP_INITIAL_SIZE*sizeof(Key));
-    if (new_array == NULL)
+    //Nothing is read but the header: the index and the records are paged in by the lookups which need them
+    Image image = imageOpen(path);
+    Map new_map = image != NULL ? mapCreate() : NULL;
+    if (new_map == NULL)
     {
-        free(new_map);
+        imageDestroy(image);
         return NULL;
     }
-    new_map->keys = new_array;
-    new_map->size = 0;
-    new_map->max_size = MAP_INITIAL_SIZE;
-    new_map->iterator = 0;
+    new_map->image = image;
+    new_map->size = imageGetCount(image);
+    new_map->counters = imageIsCounters(image);
     return new_map;
 }
 
-void mapDestroy(Map map)
+Map mapFreeze(Map map)
 {
-    if(!map)
+    if (map == NULL)
     {
-        return;
+        return NULL;
+    }
+    //The elements are collected first, since every record goes to the position the perfect hash gives its key
+    ImagePairs pairs;
+    if (mapCollectPairs(map, mapGetSize(map), false, &pairs) != MAP_SUCCESS)
+    {
+        return NULL;
+    }
+    Image image = imageFreeze(&pairs);
+    mapFreePairs(&pairs);
+    Map frozen = image != NULL ? mapCreate() : NULL;
+    if (frozen == NULL)
+    {
+        imageDestroy(image);
+        return NULL;
     }
-    mapClear(map);
-    free(map->keys);
-    free(map);
+    frozen->image = image;
+    frozen->size = imageGetCount(image);
+    frozen->counters = imageIsCounters(image);
+    return frozen;
 }
 
-Map mapCopy(Map map)
+Map mapOpenJournaled(const char* path, const MapJournalOptions* options)
 {
-    Map new_map = mapCreate();
-    if(!new_map || !map)
+    if (path == NULL)
+    {
+        return NULL;
+    }
+    MapJournalOptions defaults = {MAP_JOURNAL_DEFAULT_BATCH, MAP_JOURNAL_DEFAULT_DELAY_MS,
+                                  MAP_JOURNAL_DEFAULT_COMPACT_BYTES};
+    options = options != NULL ? options : &defaults;
+    char* log_path = malloc(strlen(path) + sizeof(MAP_JOURNAL_SUFFIX));
+    Map new_map = log_path != NULL ? mapCreate() : NULL;
+    MapJournal journal = new_map != NULL ? calloc(1, sizeof(*journal)) : NULL;
+    if (journal == NULL || pthread_mutex_init(&journal->lock, NULL) != 0)
     {
+        free(journal);
         mapDestroy(new_map);
+        free(log_path);
         return NULL;
     }
-    for(int i = 0; i < map->size; i++)
+    new_map->journal = journal;
+    strcpy(log_path, path);
+    strcat(log_path, MAP_JOURNAL_SUFFIX);
+    journal->path = strdup(path);
+    journal->contents = journal->path != NULL ? mapLoadSnapshot(path) : NULL;
+    //What the log adds to the snapshot is saved as a new snapshot, so the new log starts empty
+    long changes = journal->contents != NULL ? journalReplay(log_path, mapReplayChange, journal->contents) : -1;
+    if (changes < 0 || (changes > 0 && mapSave(journal->contents, path) != MAP_SUCCESS) || !journalDiscard(log_path))
     {
-        (new_map->keys)[i] = keyCreate(keyGetID((map->keys)[i]), keyGetValue((map->keys)[i]));
-        if((new_map->keys)[i] == NULL)
-        {
-            mapDestroy(new_map);
-            return NULL;            
-        }
+        mapDestroy(new_map);
+        free(log_path);
+        return NULL;
+    }
+    journal->log = journalCreate(log_path, options->batch, options->delay_ms, options->compact_bytes,
+                                 mapCompactJournal, journal);
+    free(log_path);
+    if (journal->log == NULL)
+    {
+        mapDestroy(new_map);
+        return NULL;
     }
-    new_map->size = map->size;
-    new_map->max_size = map->max_size;
-    new_map->iterator = map->iterator;
     return new_map;
 }
 
-int mapGetSize(Map map)
+#ifdef MAP_ENABLE_STATS
+MapResult mapGetStats(Map map, MapStats* stats)
 {
-    if (map == NULL)
+    if (map == NULL || stats == NULL)
     {
-        return -1;
+        return MAP_NULL_ARGUMENT;
+    }
+    memset(stats, 0, sizeof(*stats));
+    mapAddStats(stats, map);
+    for (int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        mapAddStats(stats, map->stripes[i]);
+    }
+    if (map->snapshot != NULL)
+    {
+        bool locked;
+        mapAddStats(stats, mapBeginRead(map, &locked));
+        mapEndRead(map, locked);
+    }
+    if (map->journal != NULL)
+    {
+        mapAddStats(stats, map->journal->contents);
     }
-    return map->size;
+    return MAP_SUCCESS;
 }
+#endif
 
-bool mapContains(Map map, const char* key)
+MapResult mapSync(Map map)
 {
-    if (map == NULL || key == NULL)
+    if (map == NULL)
     {
-        return false;
+        return MAP_NULL_ARGUMENT;
     }
-    if (mapFindKey(map,key) == MAP_NO_SUCH_KEY)
+    if (map->journal != NULL && !journalSync(map->journal->log))
     {
-        return false;
+        return MAP_ERROR;
     }
-    return true;
+    return MAP_SUCCESS;
 }
 
-MapResult mapPut(Map map, const char* key, const char* data)
+MapResult mapClear(Map map)
 {
-    if (map == NULL || key == NULL || data == NULL)
+    if (map == NULL)
     {
         return MAP_NULL_ARGUMENT;
     }
-    int key_index = mapFindKey(map,key);
-    if (key_index == MAP_NO_SUCH_KEY)
+    if (map->image != NULL)
     {
-        Key new_key = keyCreate(key, data);
-        if (new_key == NULL)
+        return MAP_ERROR;
+    }
+    for (int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        pthread_rwlock_wrlock(&map->locks[i]);
+        mapClear(map->stripes[i]);
+        pthread_rwlock_unlock(&map->locks[i]);
+    }
+    if (map->snapshot != NULL)
+    {
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapClear(next) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    if (map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapClear(map->journal->contents);
+        result = mapLogChange(map->journal, result, JOURNAL_CLEAR, NULL, NULL);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result;
+    }
+    if (map->radix != NULL && radixIsShared(map->radix))
+    {
+        //Copies still use the tree, so the map starts a new one
+        Radix radix = radixCreate();
+        if (radix == NULL)
         {
             return MAP_OUT_OF_MEMORY;
         }
-        if ((map->size >= map->max_size) && mapExpand(map) != MAP_SUCCESS)
+        radixDestroy(map->radix);
+        map->radix = radix;
+    }
+    else
+    {
+        radixClear(map->radix);
+    }
+    if (map->filter != NULL && MAP_REFCOUNT_LOAD(map->filter->refcount) > 1)
+    {
+        //Likewise for the filter, which keeps its size
+        MapFilter filter = mapFilterCreate(map, map->filter->capacity, NULL);
+        if (filter == NULL)
         {
-            keyDestroy(new_key);
             return MAP_OUT_OF_MEMORY;
         }
-        map->keys[map->size++] = new_key;
-        return MAP_SUCCESS;
+        mapReleaseFilter(map, map->filter);
+        map->filter = filter;
     }
-    if (keySetValue(map->keys[key_index] , data) != KEY_SUCCESS)
+    MapTable table = map->table;
+    if (table != NULL && MAP_REFCOUNT_LOAD(table->refcount) > 1)
     {
-        return MAP_OUT_OF_MEMORY;
+        mapReleaseTable(map, table, map->arena == NULL);
+        map->table = NULL;
+    }
+    //The pages of a table the map owns are emptied and kept, unless a copy shares them
+    for (int i = 0; map->table != NULL && i < map->table->capacity; i++)
+    {
+        MapPage page = map->table->pages[i];
+        if (page != NULL && MAP_REFCOUNT_LOAD(page->refcount) > 1)
+        {
+            mapReleasePage(map, page, map->arena == NULL);
+            map->table->pages[i] = NULL;
+        }
+        else if (page != NULL)
+        {
+            for (int j = 0; map->arena == NULL && j < page->count; j++)
+            {
+                keyDestroyWithAllocator(page->keys[j], MAP_KEY_ALLOCATOR(map));
+            }
+            page->count = 0;
+        }
+    }
+    //A cleared map is small again, so it goes back to the fingerprint scan
+    mapReleaseIndex(map, map->index);
+    mapReleaseIndex(map, map->next_index);
+    mapReleaseIndex(map, map->old_index);
+    map->index = NULL;
+    map->next_index = NULL;
+    map->old_index = NULL;
+    map->rehash_slot = 0;
+    if (map->arena != NULL && arenaIsShared(map->arena))
+    {
+        //Copies still use the arena, so the map starts a new one (or continues without one)
+        arenaDestroy(map->arena);
+        map->arena = arenaCreate(MAP_ARENA_CHUNK_SIZE);
+    }
+    else if (map->arena != NULL)
+    {
+        arenaReset(map->arena);
+    }
+    if (map->heap != NULL)
+    {
+        heapClear(map->heap);
+    }
+    map->size = 0;
+    if (map->filter != NULL)
+    {
+        mapFilterFill(map, map->filter);
+        map->filter_stale = 0;
     }
     return MAP_SUCCESS;
 }
 
-char* mapGet(Map map, const char* key)
+MapResult mapShrinkToFit(Map map)
 {
-    if(!map || !key)
+    if (map == NULL)
     {
-        return NULL;
+        return MAP_NULL_ARGUMENT;
+    }
+    for (int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        pthread_rwlock_wrlock(&map->locks[i]);
+        MapResult result = mapShrinkToFit(map->stripes[i]);
+        pthread_rwlock_unlock(&map->locks[i]);
+        if (result != MAP_SUCCESS)
+        {
+            return result;
+        }
+    }
+    if (map->image != NULL)
+    {
+        return MAP_SUCCESS;
+    }
+    if (map->journal != NULL)
+    {
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapShrinkToFit(map->journal->contents);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result;
+    }
+    if (map->snapshot != NULL)
+    {
+        //Shrinking also frees the replaced snapshots which no reader sees anymore
+        //(the copy gets a table of its own, which readers do not see and which can shrink)
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL && mapMakeTableWritable(next, 0) == MAP_SUCCESS ? mapShrinkToFit(next) :
+                                                                                          MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
+    }
+    if ((map->heap != NULL && !heapShrink(map->heap)) || mapRehashStep(map, INT_MAX) != MAP_SUCCESS)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    int pages = (map->size + MAP_PAGE_SIZE - 1) >> MAP_PAGE_BITS;
+    MapTable table = map->table;
+    //A shared table is still needed by the copies, so only a table the map owns is shrunk
+    if (table != NULL && MAP_REFCOUNT_LOAD(table->refcount) == 1 && table->capacity > pages)
+    {
+        for (int i = pages; i < table->capacity; i++)
+        {
+            mapReleasePage(map, table->pages[i], map->arena == NULL);
+        }
+        int old_capacity = table->capacity;
+        table->capacity = pages;
+        if (pages == 0)
+        {
+            mapFree(map, table, MAP_TABLE_BYTES(old_capacity));
+            map->table = NULL;
+        }
+        else
+        {
+            MapTable new_table = mapReallocate(map, table, MAP_TABLE_BYTES(old_capacity), MAP_TABLE_BYTES(pages));
+            map->table = new_table != NULL ? new_table : table;
+        }
     }
-    for(int i = 0; i < map->size; i++)
+    //The last page may have room for more keys than it has
+    MapPage last = map->size > 0 && map->heap == NULL && MAP_REFCOUNT_LOAD(map->table->refcount) == 1 ? map->table->pages[pages - 1] : NULL;
+    if (last != NULL && MAP_REFCOUNT_LOAD(last->refcount) == 1 && last->capacity > last->count &&
+        last->capacity > MAP_PAGE_MIN_CAPACITY)
     {
-        if(!strcmp(key, keyGetID((map->keys)[i])))
+        int capacity = last->count > MAP_PAGE_MIN_CAPACITY ? last->count : MAP_PAGE_MIN_CAPACITY;
+        MapPage new_last = mapReallocate(map, last, MAP_PAGE_BYTES(last->capacity), MAP_PAGE_BYTES(capacity));
+        if (new_last != NULL)
         {
-            return keyGetValue((map->keys)[i]);
+            new_last->capacity = capacity;
+            map->table->pages[pages - 1] = new_last;
         }
     }
-    return NULL;
+    //A smaller filter is only an improvement, so the old one is kept if it cannot be allocated
+    MapFilter filter = map->filter != NULL && mapFilterCapacityFor(map->size) < map->filter->capacity ?
+                       mapFilterCreate(map, mapFilterCapacityFor(map->size), NULL) : NULL;
+    if (filter != NULL)
+    {
+        mapFilterFill(map, filter);
+        mapReleaseFilter(map, map->filter);
+        map->filter = filter;
+        map->filter_stale = 0;
+    }
+    if (map->index != NULL && map->size <= MAP_FINGERPRINT_THRESHOLD)
+    {
+        mapReleaseIndex(map, map->index);
+        map->index = NULL;
+    }
+    else if (map->index != NULL && mapIndexSizeFor(map->size) < map->index->size)
+    {
+        return mapResizeIndex(map, mapIndexSizeFor(map->size));
+    }
+    return MAP_SUCCESS;
 }
 
-MapResult mapRemove(Map map, const char* key)
+MapResult mapEnableFilter(Map map)
 {
-    if(!map || !key)
+    if (map == NULL)
     {
         return MAP_NULL_ARGUMENT;
     }
-    for(int i = 0; i < map->size; i++)
+    if (map->image != NULL)
+    {
+        return MAP_ERROR;
+    }
+    if (map->stripes != NULL)
     {
-        if(!strcmp(keyGetID((map->keys)[i]), key))
+        for (int i = 0; i < map->stripe_count; i++)
         {
-            keyDestroy((map->keys)[i]);
-            if(i != map->size - 1)
+            pthread_rwlock_wrlock(&map->locks[i]);
+            MapResult result = mapEnableFilter(map->stripes[i]);
+            pthread_rwlock_unlock(&map->locks[i]);
+            if (result != MAP_SUCCESS)
             {
-                (map->keys)[i] = (map->keys)[map->size - 1];
+                return result;
             }
-            map->size--;
-            return MAP_SUCCESS;
         }
+        return MAP_SUCCESS;
     }
-    return MAP_ITEM_DOES_NOT_EXIST;
-}
-
-char* mapGetFirst(Map map)
-{
-    if(!map)
+    if (map->snapshot != NULL)
     {
-        return NULL;
+        Map next = mapBeginWrite(map);
+        MapResult result = next != NULL ? mapEnableFilter(next) : MAP_OUT_OF_MEMORY;
+        mapEndWrite(map, next, result == MAP_SUCCESS);
+        return result;
     }
-    map->iterator = 0;
-    return map->size > 0? keyGetID((map->keys)[map->iterator]) : NULL;
-}
-
-char* mapGetNext(Map map)
-{
-    if(!map)
+    if (map->journal != NULL)
     {
-        return NULL;
+        pthread_mutex_lock(&map->journal->lock);
+        MapResult result = mapEnableFilter(map->journal->contents);
+        pthread_mutex_unlock(&map->journal->lock);
+        return result;
     }
-    map->iterator++;
-    return map->iterator >= map->size? NULL : keyGetID((map->keys)[map->iterator]);
+    if (map->filter != NULL)
+    {
+        return MAP_SUCCESS;
+    }
+    map->filter = mapFilterCreate(map, mapFilterCapacityFor(map->size), NULL);
+    if (map->filter == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    mapFilterFill(map, map->filter);
+    map->filter_stale = 0;
+    return MAP_SUCCESS;
 }
 
-MapResult mapClear(Map map)
+size_t mapMemoryUsage(Map map, MapMemoryUsage* usage)
 {
+    MapMemoryUsage result = {0, 0, 0, 0, 0};
     if (map == NULL)
     {
-        return MAP_NULL_ARGUMENT;
+        if (usage != NULL)
+        {
+            *usage = result;
+        }
+        return 0;
     }
-    for(int i = 0; i < map->size; i++)
+    result.table = sizeof(*map);
+    if (map->table != NULL)
     {
-        keyDestroy((map->keys)[i]);
+        result.table += sizeof(*map->table) + map->table->capacity * sizeof(MapPage);
+        for (int i = 0; i < map->table->capacity; i++)
+        {
+            result.table += map->table->pages[i] != NULL ? MAP_PAGE_BYTES(map->table->pages[i]->capacity) : 0;
+        }
     }
-    map->size = 0;
-    return MAP_SUCCESS;
+    MapIndex indexes[] = {map->index, map->next_index, map->old_index};
+    for (int i = 0; i < 3; i++)
+    {
+        result.index += indexes[i] != NULL ? MAP_INDEX_ALL_BYTES(indexes[i]->size) : 0;
+    }
+    result.index += radixGetSize(map->radix);
+    result.index += map->filter != NULL ? MAP_FILTER_BYTES(map->filter->block_count) : 0;
+    if (map->image != NULL)
+    {
+        //The image is mapped from its file, so these bytes are in the page cache rather than in the heap
+        //(unless the map was built by mapFreeze)
+        size_t file_bytes;
+        result.table += imageGetSize(map->image, &result.index, &file_bytes);
+        result.keys = file_bytes - result.index;
+    }
+    if (map->heap != NULL)
+    {
+        //The garbage and the free room of the buffer are counted with the table
+        result.keys = heapGetStringBytes(map->heap, &result.values);
+        result.table += heapGetSize(map->heap) - result.keys - result.values;
+    }
+    for (int i = 0; map->image == NULL && map->heap == NULL && i < map->size; i++)
+    {
+        size_t value_bytes = 0;
+        result.keys += keyGetMemoryUsage(mapKeyAt(map, i), &value_bytes);
+        result.values += value_bytes;
+    }
+    result.arena = arenaGetSize(map->arena);
+    result.table += map->stripe_count * (sizeof(*map->stripes) + sizeof(*map->locks));
+    for (int i = 0; map->stripes != NULL && i < map->stripe_count; i++)
+    {
+        MapMemoryUsage stripe;
+        pthread_rwlock_rdlock(&map->locks[i]);
+        mapMemoryUsage(map->stripes[i], &stripe);
+        pthread_rwlock_unlock(&map->locks[i]);
+        result.table += stripe.table;
+        result.index += stripe.index;
+        result.keys += stripe.keys;
+        result.values += stripe.values;
+    }
+    if (map->snapshot != NULL)
+    {
+        MapMemoryUsage snapshot;
+        pthread_mutex_lock(map->write_lock);
+        mapMemoryUsage(map->snapshot, &snapshot);
+        pthread_mutex_unlock(map->write_lock);
+        result.table += sizeof(*map->write_lock) + snapshot.table;
+        result.index += snapshot.index;
+        result.keys += snapshot.keys;
+        result.values += snapshot.values;
+    }
+    if (map->journal != NULL)
+    {
+        //The buffered changes of the log are counted with the table
+        MapMemoryUsage contents;
+        mapMemoryUsage(map->journal->contents, &contents);
+        result.table += sizeof(*map->journal) + strlen(map->journal->path) + 1 + journalGetMemoryUsage(map->journal->log) +
+                        contents.table;
+        result.index += contents.index;
+        result.keys += contents.keys;
+        result.values += contents.values;
+    }
+    if (usage != NULL)
+    {
+        *usage = result;
+    }
+    //The keys and values of an arena map are inside its arena
+    return result.table + result.index + (map->arena != NULL ? result.arena : result.keys + result.values);
 }
\ No newline at end of file
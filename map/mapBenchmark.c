@@ -0,0 +1,1591 @@
+#define _POSIX_C_SOURCE 200809L
+#include "map.h"
+#include "genericMap.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <limits.h>
+
+/**
+* Map Benchmark
+*
+* Measures the throughput of the Map point operations.
+* Usage: mapBenchmark [max number of keys]   (default: 10000000)
+*        mapBenchmark small
+*        mapBenchmark memory
+*        mapBenchmark threads [max number of threads]   (default: 16)
+*        mapBenchmark readers [max number of threads]   (default: 16)
+*        mapBenchmark mapped [number of keys]   (default: 10000000)
+*        mapBenchmark journal [number of keys]   (default: 200000)
+*        mapBenchmark compact [number of keys]   (default: 1000000)
+*        mapBenchmark generic [number of keys]   (default: 1000000)
+*        mapBenchmark latency [number of keys]   (default: 10000000)
+*        mapBenchmark allocator [number of keys]   (default: 1000000)
+*        mapBenchmark prefix [number of keys]   (default: 1000000)
+*        mapBenchmark filter [number of keys]   (default: 1000000)
+*        mapBenchmark frozen [number of keys]   (default: 1000000)
+*        mapBenchmark upsert [number of keys]   (default: 1000000)
+*        mapBenchmark bulk [number of keys]   (default: 10000000)
+*
+* For every size n = 1e2, 1e3, ... up to the maximum, n keys are put into an
+* empty map, then all of them are looked up and finally all of them are removed.
+* The result is printed as millions of operations per second.
+*
+* 'small' compares mapGet on small maps (which scan the key fingerprints)
+* with a plain strcmp scan over the same keys, for hits and for misses.
+* The result is printed as nanoseconds per lookup.
+*
+* 'memory' prints the bytes per key reported by mapMemoryUsage for maps of
+* 1 to BENCHMARK_MEMORY_MAX_KEYS keys, then again after removing nine keys out
+* of ten and calling mapShrinkToFit.
+*
+* 'threads' runs 1, 2, 4, ... threads which count votes with mapIncrement on
+* a shared concurrent counters map (one lookup in 16 adds a new key), once with
+* a single stripe (one lock for the whole map) and once with
+* BENCHMARK_THREADS_STRIPES stripes. The result is printed as millions of
+* increments per second, for all the threads together.
+*
+* 'readers' runs 1, 2, 4, ... threads which look up keys of a small table
+* (BENCHMARK_READERS_KEYS keys, like the election's areas) with mapGet, while
+* the first thread also changes a key every BENCHMARK_READERS_WRITE_INTERVAL
+* lookups. It is run once on a concurrent map with a single stripe (a shared
+* reader-writer lock) and once on a read-mostly map. The result is printed as
+* millions of lookups per second, for all the threads together.
+*
+* 'mapped' builds a map of n keys with mapPut, saves it to
+* BENCHMARK_MAPPED_PATH with mapSave, and then opens the file with
+* mapOpenMapped. It prints the time of each step, the time from opening the
+* file to the answer of the first lookup, and the throughput of lookups on the
+* mapped map. The file is removed afterwards.
+*
+* 'journal' puts n keys into a journaled map at BENCHMARK_JOURNAL_PATH, for
+* several group commit windows: batches of 1 (a sync for every change) to
+* 1024 changes, and then delays of 1 and 10 milliseconds with no batch limit.
+* A round makes at most BENCHMARK_JOURNAL_SYNCS batches, so the small batches
+* put fewer keys. The result is printed as thousands of mapPut per second
+* (ending with a mapSync), followed by the time mapOpenJournaled takes to
+* replay a log of n changes. The files are removed afterwards.
+*
+* 'compact' puts n keys (each with itself as data) into a map created by
+* mapCreate and into one created by mapCreateCompact, then looks all of them
+* up in a random order and walks the map with a cursor, reading every data
+* element. It prints millions of operations per second for each step, and the
+* bytes per key reported by mapMemoryUsage.
+*
+* 'generic' runs the put/get/remove round over n integer keys twice: on a
+* counters Map, formatting every key with sprintf as the election used to, and
+* on a map of int64_t to int64_t made by DEFINE_MAP. The result is printed as
+* millions of operations per second.
+*
+* 'latency' times every mapPut of n new keys, into a map created by mapCreate
+* and into one created by mapCreateIncremental. It prints a histogram of the
+* latencies (in power of 2 buckets of nanoseconds) and their percentiles.
+*
+* 'allocator' runs BENCHMARK_ALLOCATOR_ROUNDS rounds on one map: n keys are
+* put, then given longer values (which move out of the keys) and finally
+* removed. It is run on a map created by mapCreate and on one created by
+* mapCreateWithAllocator with a pool, and prints millions of operations per
+* second for each step (over all the rounds).
+*
+* 'prefix' puts n votes keyed "area-tribe" (BENCHMARK_PREFIX_TRIBES tribes per
+* area) into a map created by mapCreate and into one created by
+* mapCreateRadix, and looks all of them up. Then it sums the votes of
+* BENCHMARK_PREFIX_QUERIES areas with mapForEachPrefix (prefix "area-"). It
+* prints millions of puts and lookups per second, and microseconds per area.
+*
+* 'filter' puts n keys into a map created by mapCreate, with and without
+* mapEnableFilter, then looks up all of them (hits) and n keys which are not in
+* the map (misses) with mapContains. Then it removes every other key and looks
+* up the n missing keys and the removed ones. It prints millions of lookups per
+* second for each step, the bytes of the index and the filter per key and
+* (when compiled with MAP_ENABLE_STATS) the false positive rate of the filter.
+*
+* 'frozen' puts n keys (each with itself as data) into a map created by
+* mapCreate, and freezes it with mapFreeze. Then it looks up the n keys in a
+* random order, and n keys which are not in the map, on both maps. It prints
+* the time of the freeze, millions of lookups per second, and the bytes per key
+* reported by mapMemoryUsage next to the bytes of the strings themselves.
+*
+* 'upsert' counts BENCHMARK_UPSERT_PASSES visits of each of n keys, in a random
+* order, in the data elements of a map (as decimal strings): once with mapGet
+* followed by mapPut, and once with mapFindOrInsert and its entry. The first
+* visit of a key adds it. It is run for n = 1e3, 1e4, ... up to the number of
+* keys, and prints millions of visits per second.
+*
+* 'bulk' builds a compact map of n keys (each with itself as data) from arrays:
+* with a mapPut per key, with mapPutBatch, and with mapCreateFromArrays (with
+* and without MAP_ARRAYS_UNIQUE_KEYS). It prints the time of each, next to the
+* time of a memcpy of the strings into one buffer.
+*/
+
+/** The default number of keys in the biggest round */
+#define BENCHMARK_DEFAULT_MAX_KEYS 10000000
+
+/** The size of the buffer used for generating keys */
+#define BENCHMARK_KEY_LENGTH 16
+
+/** The biggest map measured by the 'small' benchmark */
+#define BENCHMARK_SMALL_MAX_KEYS 512
+
+/** The number of lookups measured for every size of the 'small' benchmark */
+#define BENCHMARK_SMALL_LOOKUPS 2000000
+
+/** The biggest map measured by the 'memory' benchmark */
+#define BENCHMARK_MEMORY_MAX_KEYS 1000000
+
+/** The default number of threads in the biggest round of the 'threads' benchmark */
+#define BENCHMARK_DEFAULT_MAX_THREADS 16
+
+/** The number of stripes of the striped map of the 'threads' benchmark */
+#define BENCHMARK_THREADS_STRIPES 64
+
+/** The number of increments every thread does in the 'threads' benchmark */
+#define BENCHMARK_THREADS_OPERATIONS 1000000
+
+/** The number of distinct keys of the 'threads' benchmark */
+#define BENCHMARK_THREADS_KEYS 100000
+
+/** The number of lookups every thread does in the 'readers' benchmark */
+#define BENCHMARK_READERS_OPERATIONS 4000000
+
+/** The number of keys of the 'readers' benchmark */
+#define BENCHMARK_READERS_KEYS 1000
+
+/** The first thread of the 'readers' benchmark changes a key once in this many lookups */
+#define BENCHMARK_READERS_WRITE_INTERVAL 4096
+
+/** The image file written by the 'mapped' benchmark, in the current directory */
+#define BENCHMARK_MAPPED_PATH "mapBenchmark.image"
+
+/** The snapshot written by the 'journal' benchmark, in the current directory (its log is next to it) */
+#define BENCHMARK_JOURNAL_PATH "mapBenchmark.journal"
+#define BENCHMARK_JOURNAL_LOG_PATH BENCHMARK_JOURNAL_PATH ".log"
+
+/** The default number of keys of the 'journal' benchmark */
+#define BENCHMARK_JOURNAL_KEYS 200000
+
+/** A round of the 'journal' benchmark makes at most this many batches */
+#define BENCHMARK_JOURNAL_SYNCS 2000
+
+/** The default number of keys of the 'compact' benchmark */
+#define BENCHMARK_COMPACT_KEYS 1000000
+
+/** The default number of keys of the 'generic' benchmark */
+#define BENCHMARK_GENERIC_KEYS 1000000
+
+/** The default number of keys of the 'latency' benchmark */
+#define BENCHMARK_LATENCY_KEYS 10000000
+
+/** The default number of keys of the 'allocator' benchmark */
+#define BENCHMARK_ALLOCATOR_KEYS 1000000
+
+/** The number of times the 'allocator' benchmark fills and empties its map */
+#define BENCHMARK_ALLOCATOR_ROUNDS 5
+
+/** The default number of keys of the 'prefix' benchmark */
+#define BENCHMARK_PREFIX_KEYS 1000000
+
+/** The number of tribes of every area of the 'prefix' benchmark */
+#define BENCHMARK_PREFIX_TRIBES 100
+
+/** The number of areas whose votes the 'prefix' benchmark sums */
+#define BENCHMARK_PREFIX_QUERIES 1000
+
+/** The default number of keys of the 'filter' benchmark */
+#define BENCHMARK_FILTER_KEYS 1000000
+
+/** The default number of keys of the 'frozen' benchmark */
+#define BENCHMARK_FROZEN_KEYS 1000000
+
+/** The default number of keys of the 'upsert' benchmark */
+#define BENCHMARK_UPSERT_KEYS 1000000
+
+/** The number of times the 'upsert' benchmark visits every key */
+#define BENCHMARK_UPSERT_PASSES 4
+
+/** The default number of keys of the 'bulk' benchmark */
+#define BENCHMARK_BULK_KEYS 10000000
+
+/** The histogram of the 'latency' benchmark has buckets of up to 2^i nanoseconds for i below this */
+#define BENCHMARK_LATENCY_BUCKETS 32
+
+/** What a thread of the 'threads' or 'readers' benchmark works on */
+typedef struct BenchmarkThread_t {
+    Map map;
+    char (*keys)[BENCHMARK_KEY_LENGTH];
+    int first;
+    bool failed;
+} BenchmarkThread;
+
+DEFINE_MAP(BenchmarkIntMap, int64_t, int64_t, genericMapHashInteger, GENERIC_MAP_EQUALS)
+
+/**
+ * @return
+ * A monotonic time stamp in seconds.
+ */
+static double benchmarkNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * Fills a preallocated array of n keys, so generating them is not measured.
+ * The keys look like the election's vote keys ("area-tribe").
+ */
+static void benchmarkGenerateKeys(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        sprintf(keys[i], "%d-%d", i / 1000, i % 1000);
+    }
+}
+
+/**
+ * @param seconds - The time a round took
+ * @param n - The number of operations in the round
+ * @return
+ * Millions of operations per second.
+ */
+static double benchmarkMops(double seconds, int n)
+{
+    return seconds > 0 ? n / seconds / 1e6 : 0;
+}
+
+/**
+ * Runs one put/get/remove round over n keys and prints its throughput.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    Map map = mapCreate();
+    if (map == NULL)
+    {
+        return false;
+    }
+    double start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        if (mapPut(map, keys[i], "1") != MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+    }
+    double put_time = benchmarkNow() - start;
+    start = benchmarkNow();
+    int found = 0;
+    for (int i = 0; i < n; i++)
+    {
+        found += mapGet(map, keys[i]) != NULL;
+    }
+    double get_time = benchmarkNow() - start;
+    start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        mapRemove(map, keys[i]);
+    }
+    double remove_time = benchmarkNow() - start;
+    printf("%10d %12.2f %12.2f %12.2f\n", n, benchmarkMops(put_time, n), benchmarkMops(get_time, n),
+           benchmarkMops(remove_time, n));
+    mapDestroy(map);
+    return found == n;
+}
+
+/**
+ * @param ids - The keys to scan
+ * @param n - The number of keys
+ * @param key - The wanted key
+ * @return
+ * The scalar baseline: the index of the key found by strcmp on every key, or -1.
+ */
+static int benchmarkScalarScan(char** ids, int n, const char* key)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (!strcmp(key, ids[i]))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Measures lookups in maps of 8 to BENCHMARK_SMALL_MAX_KEYS keys, against a
+ * strcmp scan over the keys stored in the same map.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkSmall(char (*keys)[BENCHMARK_KEY_LENGTH])
+{
+    char* ids[BENCHMARK_SMALL_MAX_KEYS];
+    printf("%10s %12s %12s %12s %12s   (ns/lookup)\n", "keys", "map hit", "scan hit", "map miss", "scan miss");
+    for (int n = 8; n <= BENCHMARK_SMALL_MAX_KEYS; n *= 2)
+    {
+        Map map = mapCreate();
+        for (int i = 0; i < n; i++)
+        {
+            if (mapPut(map, keys[i], "1") != MAP_SUCCESS)
+            {
+                mapDestroy(map);
+                return false;
+            }
+        }
+        int count = 0;
+        MAP_FOREACH(id, map)
+        {
+            ids[count++] = id;
+        }
+        long checksum = 0;
+        double times[4];
+        for (int kind = 0; kind < 4; kind++)
+        {
+            //Hits look up the keys of the map, misses the keys right after them
+            int offset = kind < 2 ? 0 : n;
+            double start = benchmarkNow();
+            for (int i = 0; i < BENCHMARK_SMALL_LOOKUPS; i++)
+            {
+                const char* key = keys[offset + i % n];
+                checksum += kind % 2 == 0 ? mapGet(map, key) != NULL : benchmarkScalarScan(ids, count, key);
+            }
+            times[kind] = (benchmarkNow() - start) * 1e9 / BENCHMARK_SMALL_LOOKUPS;
+        }
+        printf("%10d %12.1f %12.1f %12.1f %12.1f\n", n, times[0], times[1], times[2], times[3]);
+        mapDestroy(map);
+        if (checksum == 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Prints the memory usage of a map, in bytes per key.
+ */
+static void benchmarkPrintUsage(const char* title, Map map)
+{
+    MapMemoryUsage usage;
+    size_t total = mapMemoryUsage(map, &usage);
+    double n = mapGetSize(map) > 0 ? mapGetSize(map) : 1;
+    printf("%10d %8s %10.1f %10.1f %10.1f %10.1f %10.1f\n", mapGetSize(map), title, usage.table / n,
+           usage.index / n, usage.keys / n, usage.values / n, total / n);
+}
+
+/**
+ * Measures the memory of maps of 1 to BENCHMARK_MEMORY_MAX_KEYS keys, before
+ * and after most of the keys are removed.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkMemory(char (*keys)[BENCHMARK_KEY_LENGTH])
+{
+    printf("%10s %8s %10s %10s %10s %10s %10s   (bytes/key)\n", "keys", "", "table", "index", "keys", "values",
+           "total");
+    for (int n = 1; n <= BENCHMARK_MEMORY_MAX_KEYS; n *= 10)
+    {
+        Map map = mapCreate();
+        for (int i = 0; i < n; i++)
+        {
+            if (mapPut(map, keys[i], "1") != MAP_SUCCESS)
+            {
+                mapDestroy(map);
+                return false;
+            }
+        }
+        benchmarkPrintUsage("full", map);
+        for (int i = 0; i < n; i++)
+        {
+            if (i % 10 != 0)
+            {
+                mapRemove(map, keys[i]);
+            }
+        }
+        benchmarkPrintUsage("removed", map);
+        if (mapShrinkToFit(map) != MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+        benchmarkPrintUsage("shrunk", map);
+        mapDestroy(map);
+    }
+    return true;
+}
+
+/**
+ * The body of a thread of the 'threads' benchmark.
+ */
+static void* benchmarkThreadRun(void* argument)
+{
+    BenchmarkThread* thread = argument;
+    unsigned int state = thread->first * 2654435761u + 1;
+    for (int i = 0; i < BENCHMARK_THREADS_OPERATIONS; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        if (mapIncrement(thread->map, thread->keys[(state >> 8) % BENCHMARK_THREADS_KEYS], 1, NULL) != MAP_SUCCESS)
+        {
+            thread->failed = true;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Runs 'count' threads of the 'threads' benchmark on one map.
+ * @return
+ * The millions of increments per second, or a negative number if the map failed.
+ */
+static double benchmarkThreadsRound(char (*keys)[BENCHMARK_KEY_LENGTH], int count, int stripes)
+{
+    Map map = mapCreateConcurrentCounters(stripes);
+    BenchmarkThread* threads = malloc(count * sizeof(*threads));
+    pthread_t* ids = malloc(count * sizeof(*ids));
+    if (map == NULL || threads == NULL || ids == NULL)
+    {
+        mapDestroy(map);
+        free(threads);
+        free(ids);
+        return -1;
+    }
+    //One key in 16 is new, the others were counted before
+    for (int i = 0; i < BENCHMARK_THREADS_KEYS; i++)
+    {
+        if (i % 16 != 0 && mapPutInt(map, keys[i], 0) != MAP_SUCCESS)
+        {
+            count = 0;
+        }
+    }
+    double start = benchmarkNow();
+    int started = 0;
+    for (; started < count; started++)
+    {
+        threads[started] = (BenchmarkThread){map, keys, started, false};
+        if (pthread_create(&ids[started], NULL, benchmarkThreadRun, &threads[started]) != 0)
+        {
+            break;
+        }
+    }
+    bool failed = started < count || count == 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(ids[i], NULL);
+        failed = failed || threads[i].failed;
+    }
+    double seconds = benchmarkNow() - start;
+    mapDestroy(map);
+    free(threads);
+    free(ids);
+    return failed ? -1 : benchmarkMops(seconds, count * BENCHMARK_THREADS_OPERATIONS);
+}
+
+/**
+ * The body of a thread of the 'readers' benchmark.
+ */
+static void* benchmarkReaderRun(void* argument)
+{
+    BenchmarkThread* thread = argument;
+    unsigned int state = thread->first * 2654435761u + 1;
+    for (int i = 0; i < BENCHMARK_READERS_OPERATIONS; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        const char* key = thread->keys[(state >> 8) % BENCHMARK_READERS_KEYS];
+        if (thread->first == 0 && i % BENCHMARK_READERS_WRITE_INTERVAL == 0 && mapPut(thread->map, key, key) != MAP_SUCCESS)
+        {
+            thread->failed = true;
+        }
+        if (mapGet(thread->map, key) == NULL)
+        {
+            thread->failed = true;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Runs 'count' threads of the 'readers' benchmark on one map.
+ * @param read_mostly - true for a read-mostly map, false for a single stripe concurrent map
+ * @return
+ * The millions of lookups per second, or a negative number if the map failed.
+ */
+static double benchmarkReadersRound(char (*keys)[BENCHMARK_KEY_LENGTH], int count, bool read_mostly)
+{
+    Map map = read_mostly ? mapCreateReadMostly() : mapCreateConcurrent(1);
+    BenchmarkThread* threads = malloc(count * sizeof(*threads));
+    pthread_t* ids = malloc(count * sizeof(*ids));
+    if (map == NULL || threads == NULL || ids == NULL)
+    {
+        mapDestroy(map);
+        free(threads);
+        free(ids);
+        return -1;
+    }
+    for (int i = 0; i < BENCHMARK_READERS_KEYS; i++)
+    {
+        if (mapPut(map, keys[i], keys[i]) != MAP_SUCCESS)
+        {
+            count = 0;
+        }
+    }
+    double start = benchmarkNow();
+    int started = 0;
+    for (; started < count; started++)
+    {
+        threads[started] = (BenchmarkThread){map, keys, started, false};
+        if (pthread_create(&ids[started], NULL, benchmarkReaderRun, &threads[started]) != 0)
+        {
+            break;
+        }
+    }
+    bool failed = started < count || count == 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(ids[i], NULL);
+        failed = failed || threads[i].failed;
+    }
+    double seconds = benchmarkNow() - start;
+    mapDestroy(map);
+    free(threads);
+    free(ids);
+    return failed ? -1 : benchmarkMops(seconds, count * BENCHMARK_READERS_OPERATIONS);
+}
+
+/**
+ * Measures concurrent lookups from 1 to max_threads threads.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkReaders(char (*keys)[BENCHMARK_KEY_LENGTH], int max_threads)
+{
+    printf("%10s %12s %12s   (Mops/s)\n", "threads", "locked", "read-mostly");
+    for (int count = 1; count <= max_threads; count *= 2)
+    {
+        double locked = benchmarkReadersRound(keys, count, false);
+        double read_mostly = benchmarkReadersRound(keys, count, true);
+        if (locked < 0 || read_mostly < 0)
+        {
+            return false;
+        }
+        printf("%10d %12.2f %12.2f\n", count, locked, read_mostly);
+    }
+    return true;
+}
+
+/**
+ * Measures building, saving and opening a mapped map of n keys.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkMapped(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    Map map = mapCreate();
+    if (map == NULL)
+    {
+        return false;
+    }
+    double start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        if (mapPut(map, keys[i], keys[i]) != MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+    }
+    double put_time = benchmarkNow() - start;
+    start = benchmarkNow();
+    MapResult saved = mapSave(map, BENCHMARK_MAPPED_PATH);
+    double save_time = benchmarkNow() - start;
+    mapDestroy(map);
+    if (saved != MAP_SUCCESS)
+    {
+        return false;
+    }
+    start = benchmarkNow();
+    Map mapped = mapOpenMapped(BENCHMARK_MAPPED_PATH);
+    double open_time = benchmarkNow() - start;
+    char* first = mapped != NULL ? mapGet(mapped, keys[n / 2]) : NULL;
+    double first_time = benchmarkNow() - start;
+    if (first == NULL)
+    {
+        mapDestroy(mapped);
+        remove(BENCHMARK_MAPPED_PATH);
+        return false;
+    }
+    MapMemoryUsage usage;
+    mapMemoryUsage(mapped, &usage);
+    unsigned int state = 1;
+    int found = 0;
+    start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        found += mapGet(mapped, keys[state % n]) != NULL;
+    }
+    double get_time = benchmarkNow() - start;
+    mapDestroy(mapped);
+    remove(BENCHMARK_MAPPED_PATH);
+    printf("keys: %d, file: %.1f MB\n", n, (usage.index + usage.keys) / 1e6);
+    printf("mapPut all keys:         %10.1f ms\n", put_time * 1e3);
+    printf("mapSave:                 %10.1f ms\n", save_time * 1e3);
+    printf("mapOpenMapped:           %10.3f ms\n", open_time * 1e3);
+    printf("open to first mapGet:    %10.3f ms\n", first_time * 1e3);
+    printf("mapGet on the mapped map: %9.2f Mops/s\n", benchmarkMops(get_time, n));
+    return found == n;
+}
+
+/**
+ * Puts keys into a new journaled map with the given group commit window.
+ * @return
+ * Thousands of mapPut per second, -1 if the map failed.
+ */
+static double benchmarkJournalRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, int batch, int delay_ms)
+{
+    remove(BENCHMARK_JOURNAL_PATH);
+    remove(BENCHMARK_JOURNAL_LOG_PATH);
+    MapJournalOptions options = {batch, delay_ms, 0};
+    Map map = mapOpenJournaled(BENCHMARK_JOURNAL_PATH, &options);
+    if (map == NULL)
+    {
+        return -1;
+    }
+    double start = benchmarkNow();
+    bool failed = false;
+    for (int i = 0; i < n && !failed; i++)
+    {
+        failed = mapPut(map, keys[i], keys[i]) != MAP_SUCCESS;
+    }
+    failed = failed || mapSync(map) != MAP_SUCCESS;
+    double seconds = benchmarkNow() - start;
+    mapDestroy(map);
+    return failed ? -1 : n / seconds / 1e3;
+}
+
+/**
+ * Measures a journaled map at several group commit windows, then the replay of its log.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkJournal(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    printf("%10s %10s %10s %12s\n", "batch", "delay ms", "keys", "kops/s");
+    for (int batch = 1; batch <= 1024; batch *= 4)
+    {
+        int count = (long long)batch * BENCHMARK_JOURNAL_SYNCS < n ? batch * BENCHMARK_JOURNAL_SYNCS : n;
+        double kops = benchmarkJournalRound(keys, count, batch, 0);
+        if (kops < 0)
+        {
+            return false;
+        }
+        printf("%10d %10d %10d %12.1f\n", batch, 0, count, kops);
+    }
+    for (int delay_ms = 1; delay_ms <= 10; delay_ms *= 10)
+    {
+        double kops = benchmarkJournalRound(keys, n, INT_MAX, delay_ms);
+        if (kops < 0)
+        {
+            return false;
+        }
+        printf("%10s %10d %10d %12.1f\n", "-", delay_ms, n, kops);
+    }
+    //The last round left a log of n changes and no snapshot
+    double start = benchmarkNow();
+    Map map = mapOpenJournaled(BENCHMARK_JOURNAL_PATH, NULL);
+    double open_time = benchmarkNow() - start;
+    bool replayed = map != NULL && mapGetSize(map) == n;
+    mapDestroy(map);
+    remove(BENCHMARK_JOURNAL_PATH);
+    remove(BENCHMARK_JOURNAL_LOG_PATH);
+    printf("mapOpenJournaled replaying %d changes: %.1f ms\n", n, open_time * 1e3);
+    return replayed;
+}
+
+/**
+ * Runs one put/get/scan round over n keys on a map and prints its throughput
+ * and its bytes per key.
+ * @param title - The name of the map's kind
+ * @param map - A new empty map, which is destroyed
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkCompactRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, const char* title, Map map)
+{
+    if (map == NULL)
+    {
+        return false;
+    }
+    double start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        if (mapPut(map, keys[i], keys[i]) != MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+    }
+    double put_time = benchmarkNow() - start;
+    unsigned int state = 1;
+    int found = 0;
+    start = benchmarkNow();
+    for (int i = 0; i < n; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        found += mapGet(map, keys[state % n]) != NULL;
+    }
+    double get_time = benchmarkNow() - start;
+    size_t bytes = 0;
+    start = benchmarkNow();
+    MAP_CURSOR_FOREACH(key, cursor, map)
+    {
+        bytes += strlen(mapCursorGetValue(&cursor));
+    }
+    double scan_time = benchmarkNow() - start;
+    size_t usage = mapMemoryUsage(map, NULL);
+    mapDestroy(map);
+    printf("%10s %12.2f %12.2f %12.2f %12.1f\n", title, benchmarkMops(put_time, n), benchmarkMops(get_time, n),
+           benchmarkMops(scan_time, n), (double)usage / n);
+    return found == n && bytes > 0;
+}
+
+/**
+ * Compares a compact map with a map of allocated keys.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkCompact(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    printf("keys: %d\n", n);
+    printf("%10s %12s %12s %12s %12s   (Mops/s, bytes/key)\n", "map", "put", "get", "scan", "memory");
+    return benchmarkCompactRound(keys, n, "mapCreate", mapCreate()) &&
+           benchmarkCompactRound(keys, n, "compact", mapCreateCompact());
+}
+
+/**
+ * Runs the put/get/remove round of the 'generic' benchmark on a counters Map.
+ * @param times - Set to the seconds of the three steps
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkGenericStringRound(int n, double times[3])
+{
+    Map map = mapCreateCounters();
+    char key[BENCHMARK_KEY_LENGTH];
+    bool failed = map == NULL;
+    double start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        sprintf(key, "%d", i);
+        failed = mapPutInt(map, key, i) != MAP_SUCCESS;
+    }
+    times[0] = benchmarkNow() - start;
+    int64_t sum = 0;
+    start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        int64_t value = 0;
+        sprintf(key, "%d", i);
+        failed = mapGetInt(map, key, &value) != MAP_SUCCESS;
+        sum += value;
+    }
+    times[1] = benchmarkNow() - start;
+    start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        sprintf(key, "%d", i);
+        failed = mapRemove(map, key) != MAP_SUCCESS;
+    }
+    times[2] = benchmarkNow() - start;
+    mapDestroy(map);
+    return !failed && sum == (int64_t)n * (n - 1) / 2;
+}
+
+/**
+ * Runs the put/get/remove round of the 'generic' benchmark on a map made by DEFINE_MAP.
+ * @param times - Set to the seconds of the three steps
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkGenericIntRound(int n, double times[3])
+{
+    BenchmarkIntMap map = BenchmarkIntMapCreate();
+    bool failed = map == NULL;
+    double start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        failed = BenchmarkIntMapPut(map, i, i) != MAP_SUCCESS;
+    }
+    times[0] = benchmarkNow() - start;
+    int64_t sum = 0;
+    start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        int64_t* value = BenchmarkIntMapGet(map, i);
+        failed = value == NULL;
+        sum += failed ? 0 : *value;
+    }
+    times[1] = benchmarkNow() - start;
+    start = benchmarkNow();
+    for (int i = 0; i < n && !failed; i++)
+    {
+        failed = BenchmarkIntMapRemove(map, i) != MAP_SUCCESS;
+    }
+    times[2] = benchmarkNow() - start;
+    BenchmarkIntMapDestroy(map);
+    return !failed && sum == (int64_t)n * (n - 1) / 2;
+}
+
+/**
+ * Compares integer keys formatted for the string Map with a map made by DEFINE_MAP.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkGeneric(int n)
+{
+    double string_times[3];
+    double int_times[3];
+    if (!benchmarkGenericStringRound(n, string_times) || !benchmarkGenericIntRound(n, int_times))
+    {
+        return false;
+    }
+    printf("keys: %d\n", n);
+    printf("%16s %12s %12s %12s   (Mops/s)\n", "map", "put", "get", "remove");
+    printf("%16s %12.2f %12.2f %12.2f\n", "Map + sprintf", benchmarkMops(string_times[0], n),
+           benchmarkMops(string_times[1], n), benchmarkMops(string_times[2], n));
+    printf("%16s %12.2f %12.2f %12.2f\n", "DEFINE_MAP int64", benchmarkMops(int_times[0], n),
+           benchmarkMops(int_times[1], n), benchmarkMops(int_times[2], n));
+    return true;
+}
+
+/**
+ * Orders latencies for qsort.
+ */
+static int benchmarkCompareLatencies(const void* first, const void* second)
+{
+    uint32_t a = *(const uint32_t*)first;
+    uint32_t b = *(const uint32_t*)second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Puts n new keys into a map, timing each put.
+ * @param latencies - Set to the nanoseconds of every put, sorted
+ * @param histogram - Set to the number of puts in each bucket
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkLatencyRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, Map map, uint32_t* latencies,
+                                  long histogram[BENCHMARK_LATENCY_BUCKETS])
+{
+    if (map == NULL)
+    {
+        return false;
+    }
+    memset(histogram, 0, BENCHMARK_LATENCY_BUCKETS * sizeof(long));
+    for (int i = 0; i < n; i++)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        MapResult result = mapPut(map, keys[i], "1");
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (result != MAP_SUCCESS)
+        {
+            mapDestroy(map);
+            return false;
+        }
+        long long nanoseconds = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+        latencies[i] = nanoseconds < UINT32_MAX ? (uint32_t)nanoseconds : UINT32_MAX;
+        int bucket = 0;
+        while (bucket < BENCHMARK_LATENCY_BUCKETS - 1 && (1LL << bucket) < nanoseconds)
+        {
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+    mapDestroy(map);
+    qsort(latencies, n, sizeof(*latencies), benchmarkCompareLatencies);
+    return true;
+}
+
+/**
+ * Compares the latencies of mapPut on a map which grows its index at once and
+ * on an incremental map.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkLatency(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    uint32_t* latencies[2] = {malloc((size_t)n * sizeof(uint32_t)), malloc((size_t)n * sizeof(uint32_t))};
+    long histograms[2][BENCHMARK_LATENCY_BUCKETS];
+    bool result = latencies[0] != NULL && latencies[1] != NULL &&
+                  benchmarkLatencyRound(keys, n, mapCreate(), latencies[0], histograms[0]) &&
+                  benchmarkLatencyRound(keys, n, mapCreateIncremental(), latencies[1], histograms[1]);
+    if (result)
+    {
+        printf("keys: %d\n", n);
+        printf("%14s %14s %14s   (number of mapPut)\n", "ns up to", "mapCreate", "incremental");
+        for (int i = 0; i < BENCHMARK_LATENCY_BUCKETS; i++)
+        {
+            if (histograms[0][i] != 0 || histograms[1][i] != 0)
+            {
+                printf("%14lld %14ld %14ld\n", 1LL << i, histograms[0][i], histograms[1][i]);
+            }
+        }
+        const double percentiles[] = {50, 99, 99.9, 99.99, 100};
+        printf("%14s %14s %14s   (ns)\n", "percentile", "mapCreate", "incremental");
+        for (int i = 0; i < (int)(sizeof(percentiles) / sizeof(*percentiles)); i++)
+        {
+            long rank = (long)(percentiles[i] / 100 * (n - 1));
+            printf("%14g %14u %14u\n", percentiles[i], latencies[0][rank], latencies[1][rank]);
+        }
+    }
+    free(latencies[0]);
+    free(latencies[1]);
+    return result;
+}
+
+/**
+ * Runs the rounds of the 'allocator' benchmark on a map.
+ * @param map - A new empty map, which is destroyed
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkAllocatorRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, const char* title, Map map)
+{
+    if (map == NULL)
+    {
+        return false;
+    }
+    double times[3] = {0, 0, 0};
+    char value[4 * BENCHMARK_KEY_LENGTH];
+    bool result = true;
+    for (int round = 0; result && round < BENCHMARK_ALLOCATOR_ROUNDS; round++)
+    {
+        double start = benchmarkNow();
+        for (int i = 0; result && i < n; i++)
+        {
+            result = mapPut(map, keys[i], keys[i]) == MAP_SUCCESS;
+        }
+        times[0] += benchmarkNow() - start;
+        start = benchmarkNow();
+        for (int i = 0; result && i < n; i++)
+        {
+            sprintf(value, "%s:%s:%s", keys[i], keys[i], keys[i]);
+            result = mapPut(map, keys[i], value) == MAP_SUCCESS;
+        }
+        times[1] += benchmarkNow() - start;
+        start = benchmarkNow();
+        for (int i = 0; result && i < n; i++)
+        {
+            result = mapRemove(map, keys[i]) == MAP_SUCCESS;
+        }
+        times[2] += benchmarkNow() - start;
+    }
+    mapDestroy(map);
+    printf("%10s %12.2f %12.2f %12.2f\n", title, benchmarkMops(times[0], BENCHMARK_ALLOCATOR_ROUNDS * n),
+           benchmarkMops(times[1], BENCHMARK_ALLOCATOR_ROUNDS * n),
+           benchmarkMops(times[2], BENCHMARK_ALLOCATOR_ROUNDS * n));
+    return result;
+}
+
+/**
+ * Compares a map which allocates with malloc with one which allocates from a pool.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkAllocator(char (*keys)[BENCHMARK_KEY_LENGTH], int n)
+{
+    Pool pool = poolCreate();
+    if (pool == NULL)
+    {
+        return false;
+    }
+    MapAllocator allocator = poolGetAllocator(pool);
+    printf("keys: %d, rounds: %d\n", n, BENCHMARK_ALLOCATOR_ROUNDS);
+    printf("%10s %12s %12s %12s   (Mops/s)\n", "map", "put", "update", "remove");
+    bool result = benchmarkAllocatorRound(keys, n, "mapCreate", mapCreate()) &&
+                  benchmarkAllocatorRound(keys, n, "pool", mapCreateWithAllocator(&allocator));
+    poolDestroy(pool);
+    return result;
+}
+
+/**
+ * A visitor for mapForEachPrefix, which adds the votes of a key to a sum.
+ * @param context - The sum (a long)
+ */
+static bool benchmarkSumVotes(const char* key, const char* data, void* context)
+{
+    (void)key;
+    *(long*)context += atol(data);
+    return true;
+}
+
+/**
+ * Runs the 'prefix' benchmark on a map.
+ * @param keys - n keys "area-tribe", the votes of the tribe in the area are its tribe
+ * @param map - A new empty map, which is destroyed
+ * @return
+ * false if the map failed or summed wrong, true otherwise.
+ */
+static bool benchmarkPrefixRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, const char* title, Map map)
+{
+    if (map == NULL)
+    {
+        return false;
+    }
+    bool result = true;
+    double start = benchmarkNow();
+    for (int i = 0; result && i < n; i++)
+    {
+        result = mapPut(map, keys[i], strchr(keys[i], '-') + 1) == MAP_SUCCESS;
+    }
+    double put_time = benchmarkNow() - start;
+    unsigned int state = 1;
+    start = benchmarkNow();
+    for (int i = 0; result && i < n; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        result = mapGet(map, keys[state % n]) != NULL;
+    }
+    double get_time = benchmarkNow() - start;
+    int areas = (n + BENCHMARK_PREFIX_TRIBES - 1) / BENCHMARK_PREFIX_TRIBES;
+    char prefix[BENCHMARK_KEY_LENGTH];
+    start = benchmarkNow();
+    for (int i = 0; result && i < BENCHMARK_PREFIX_QUERIES; i++)
+    {
+        int area = i % areas;
+        long sum = 0;
+        long tribes = area < areas - 1 ? BENCHMARK_PREFIX_TRIBES : n - area * BENCHMARK_PREFIX_TRIBES;
+        sprintf(prefix, "%d-", area);
+        result = mapForEachPrefix(map, prefix, benchmarkSumVotes, &sum) == MAP_SUCCESS &&
+                 sum == tribes * (tribes - 1) / 2;
+    }
+    double query_time = benchmarkNow() - start;
+    mapDestroy(map);
+    printf("%10s %12.2f %12.2f %12.2f\n", title, benchmarkMops(put_time, n), benchmarkMops(get_time, n),
+           query_time * 1e6 / BENCHMARK_PREFIX_QUERIES);
+    return result;
+}
+
+/**
+ * Compares the prefix queries of a map which compares all its keys with
+ * those of a radix map.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkPrefix(int n)
+{
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc((size_t)n * sizeof(*keys));
+    if (keys == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        sprintf(keys[i], "%d-%d", i / BENCHMARK_PREFIX_TRIBES, i % BENCHMARK_PREFIX_TRIBES);
+    }
+    printf("keys: %d, tribes per area: %d\n", n, BENCHMARK_PREFIX_TRIBES);
+    printf("%10s %12s %12s %12s   (Mops/s, us per area)\n", "map", "put", "get", "area votes");
+    bool result = benchmarkPrefixRound(keys, n, "mapCreate", mapCreate()) &&
+                  benchmarkPrefixRound(keys, n, "radix", mapCreateRadix());
+    free(keys);
+    return result;
+}
+
+/**
+ * Runs the 'filter' benchmark on a map.
+ * @param keys - 2n keys: the first n are put, the others are missing
+ * @param map - A new empty map, which is destroyed
+ * @return
+ * false if the map failed or answered wrong, true otherwise.
+ */
+static bool benchmarkFilterRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, const char* title, Map map)
+{
+    if (map == NULL)
+    {
+        return false;
+    }
+    bool result = true;
+    for (int i = 0; result && i < n; i++)
+    {
+        result = mapPut(map, keys[i], keys[i]) == MAP_SUCCESS;
+    }
+    double times[3] = {0, 0, 0};
+    double start = benchmarkNow();
+    for (int i = 0; result && i < n; i++)
+    {
+        result = mapContains(map, keys[i]);
+    }
+    times[0] = benchmarkNow() - start;
+    start = benchmarkNow();
+    for (int i = n; result && i < 2 * n; i++)
+    {
+        result = !mapContains(map, keys[i]);
+    }
+    times[1] = benchmarkNow() - start;
+    MapMemoryUsage usage;
+    mapMemoryUsage(map, &usage);
+    for (int i = 0; result && i < n; i += 2)
+    {
+        result = mapRemove(map, keys[i]) == MAP_SUCCESS;
+    }
+    //Half of the misses are keys which were in the map
+    start = benchmarkNow();
+    for (int i = n / 2; result && i < 2 * n; i++)
+    {
+        result = !mapContains(map, keys[i < n ? 2 * (i - n / 2) : i]);
+    }
+    times[2] = benchmarkNow() - start;
+    printf("%10s %12.2f %12.2f %12.2f %12.2f", title, benchmarkMops(times[0], n), benchmarkMops(times[1], n),
+           benchmarkMops(times[2], n + n / 2), (double)usage.index / n);
+#ifdef MAP_ENABLE_STATS
+    MapStats stats;
+    mapGetStats(map, &stats);
+    uint64_t filtered = stats.filter_rejections + stats.filter_false_positives;
+    printf(" %12.4f", filtered > 0 ? 100.0 * stats.filter_false_positives / filtered : 0);
+#endif
+    printf("\n");
+    mapDestroy(map);
+    return result;
+}
+
+/**
+ * Compares the lookups of missing keys of a map without a filter with those
+ * of a map with one.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkFilter(int n)
+{
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc(2 * (size_t)n * sizeof(*keys));
+    if (keys == NULL)
+    {
+        return false;
+    }
+    benchmarkGenerateKeys(keys, 2 * n);
+    printf("keys: %d\n", n);
+    printf("%10s %12s %12s %12s %12s", "map", "hits", "misses", "after remove", "index B/key");
+#ifdef MAP_ENABLE_STATS
+    printf(" %12s", "false pos %");
+#endif
+    printf("   (Mops/s)\n");
+    bool result = benchmarkFilterRound(keys, n, "mapCreate", mapCreate());
+    Map filtered = result ? mapCreate() : NULL;
+    if (filtered != NULL && mapEnableFilter(filtered) != MAP_SUCCESS)
+    {
+        mapDestroy(filtered);
+        filtered = NULL;
+    }
+    result = result && benchmarkFilterRound(keys, n, "filter", filtered);
+    free(keys);
+    return result;
+}
+
+/**
+ * Runs the lookups of the 'frozen' benchmark on a map.
+ * @param keys - 2n keys: the first n are in the map, the others are missing
+ * @return
+ * false if the map answered wrong, true otherwise.
+ */
+static bool benchmarkFrozenRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, const char* title, Map map)
+{
+    bool result = true;
+    unsigned int state = 1;
+    double start = benchmarkNow();
+    for (int i = 0; result && i < n; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        result = mapGet(map, keys[state % n]) != NULL;
+    }
+    double hit_time = benchmarkNow() - start;
+    start = benchmarkNow();
+    for (int i = n; result && i < 2 * n; i++)
+    {
+        result = mapGet(map, keys[i]) == NULL;
+    }
+    double miss_time = benchmarkNow() - start;
+    printf("%10s %12.2f %12.2f %12.1f\n", title, benchmarkMops(hit_time, n), benchmarkMops(miss_time, n),
+           (double)mapMemoryUsage(map, NULL) / n);
+    return result;
+}
+
+/**
+ * Compares the lookups and the size of a map with those of its frozen copy.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkFrozen(int n)
+{
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc(2 * (size_t)n * sizeof(*keys));
+    Map map = mapCreate();
+    bool result = keys != NULL && map != NULL;
+    size_t string_bytes = 0;
+    if (result)
+    {
+        benchmarkGenerateKeys(keys, 2 * n);
+    }
+    for (int i = 0; result && i < n; i++)
+    {
+        result = mapPut(map, keys[i], keys[i]) == MAP_SUCCESS;
+        string_bytes += 2 * strlen(keys[i]);
+    }
+    double start = benchmarkNow();
+    Map frozen = result ? mapFreeze(map) : NULL;
+    double freeze_time = benchmarkNow() - start;
+    if (frozen != NULL)
+    {
+        printf("keys: %d, strings: %.1f bytes per key, mapFreeze: %.1f ms\n", n, (double)string_bytes / n,
+               freeze_time * 1e3);
+        printf("%10s %12s %12s %12s   (Mops/s)\n", "map", "hits", "misses", "bytes/key");
+    }
+    result = frozen != NULL && benchmarkFrozenRound(keys, n, "mapCreate", map) &&
+             benchmarkFrozenRound(keys, n, "frozen", frozen);
+    mapDestroy(frozen);
+    mapDestroy(map);
+    free(keys);
+    return result;
+}
+
+/**
+ * Counts the visits of the 'upsert' benchmark in a new map.
+ * @param use_entries - true to count with mapFindOrInsert, false with mapGet and mapPut
+ * @return
+ * The time it took, or a negative number if the map failed or counted wrong.
+ */
+static double benchmarkUpsertRound(char (*keys)[BENCHMARK_KEY_LENGTH], int n, bool use_entries)
+{
+    Map map = mapCreate();
+    bool result = map != NULL;
+    unsigned int state = 1;
+    char count[BENCHMARK_KEY_LENGTH];
+    double start = benchmarkNow();
+    for (int i = 0; result && i < BENCHMARK_UPSERT_PASSES * n; i++)
+    {
+        state = state * 1103515245u + 12345u;
+        const char* key = keys[state % n];
+        if (use_entries)
+        {
+            bool inserted;
+            MapEntry entry = mapFindOrInsert(map, key, &inserted);
+            const char* old_count = mapEntryGetValue(&entry);
+            snprintf(count, sizeof(count), "%d", old_count != NULL ? atoi(old_count) + 1 : 0);
+            result = old_count != NULL && mapEntrySetValue(&entry, count) == MAP_SUCCESS;
+        }
+        else
+        {
+            const char* old_count = mapGet(map, key);
+            snprintf(count, sizeof(count), "%d", old_count != NULL ? atoi(old_count) + 1 : 1);
+            result = mapPut(map, key, count) == MAP_SUCCESS;
+        }
+    }
+    double time = benchmarkNow() - start;
+    int total = 0;
+    MAP_CURSOR_FOREACH(key, cursor, map)
+    {
+        total += atoi(mapCursorGetValue(&cursor));
+    }
+    result = result && total == BENCHMARK_UPSERT_PASSES * n;
+    mapDestroy(map);
+    return result ? time : -1;
+}
+
+/**
+ * Compares read-modify-writes through mapGet and mapPut with those through an entry.
+ * @param max_keys - The number of keys of the biggest round
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkUpsert(int max_keys)
+{
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc((size_t)max_keys * sizeof(*keys));
+    if (keys == NULL)
+    {
+        return false;
+    }
+    benchmarkGenerateKeys(keys, max_keys);
+    bool result = true;
+    printf("%10s %12s %12s   (Mops/s)\n", "keys", "get+put", "entry");
+    for (int n = 1000; result && n <= max_keys && n > 0; n *= 10)
+    {
+        double get_put_time = benchmarkUpsertRound(keys, n, false);
+        double entry_time = benchmarkUpsertRound(keys, n, true);
+        result = get_put_time >= 0 && entry_time >= 0;
+        printf("%10d %12.2f %12.2f\n", n, benchmarkMops(get_put_time, BENCHMARK_UPSERT_PASSES * n),
+               benchmarkMops(entry_time, BENCHMARK_UPSERT_PASSES * n));
+    }
+    free(keys);
+    return result;
+}
+
+/**
+ * Builds the map of one way of the 'bulk' benchmark, and checks it.
+ * @param way - 0 for mapPut, 1 for mapPutBatch, 2 for mapCreateFromArrays
+ *      and 3 for mapCreateFromArrays with MAP_ARRAYS_UNIQUE_KEYS
+ * @return
+ * The time the build took, or a negative number if the map failed.
+ */
+static double benchmarkBulkRound(const char* const* keys, int n, int way)
+{
+    double start = benchmarkNow();
+    Map map = way >= 2 ? mapCreateFromArrays(keys, keys, n, way == 3 ? MAP_ARRAYS_UNIQUE_KEYS : 0) :
+                         mapCreateCompact();
+    bool result = map != NULL;
+    if (result && way == 1)
+    {
+        result = mapPutBatch(map, keys, keys, n) == MAP_SUCCESS;
+    }
+    for (int i = 0; result && way == 0 && i < n; i++)
+    {
+        result = mapPut(map, keys[i], keys[i]) == MAP_SUCCESS;
+    }
+    double time = benchmarkNow() - start;
+    for (int i = 0; result && i < n; i += n / 1000 + 1)
+    {
+        const char* data = mapGet(map, keys[i]);
+        result = data != NULL && !strcmp(data, keys[i]);
+    }
+    result = result && mapGetSize(map) == n;
+    mapDestroy(map);
+    return result ? time : -1;
+}
+
+/**
+ * Compares the ways to build a map from arrays.
+ * @return
+ * false if a map failed, true otherwise.
+ */
+static bool benchmarkBulk(int n)
+{
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc((size_t)n * sizeof(*keys));
+    const char** key_pointers = malloc((size_t)n * sizeof(*key_pointers));
+    char* copy = NULL;
+    bool result = keys != NULL && key_pointers != NULL;
+    size_t bytes = 0;
+    if (result)
+    {
+        benchmarkGenerateKeys(keys, n);
+        for (int i = 0; i < n; i++)
+        {
+            key_pointers[i] = keys[i];
+            bytes += 2 * (strlen(keys[i]) + 1);
+        }
+        copy = malloc(bytes);
+        result = copy != NULL;
+    }
+    if (result)
+    {
+        double start = benchmarkNow();
+        size_t used = 0;
+        for (int i = 0; i < n; i++)
+        {
+            for (int twice = 0; twice < 2; twice++)
+            {
+                size_t size = strlen(keys[i]) + 1;
+                memcpy(copy + used, keys[i], size);
+                used += size;
+            }
+        }
+        printf("keys: %d, strings: %.1f MB\n", n, bytes / 1e6);
+        printf("%28s %10.1f ms\n", "memcpy of the strings", (benchmarkNow() - start) * 1e3);
+    }
+    const char* titles[] = {"mapPut", "mapPutBatch", "mapCreateFromArrays", "... MAP_ARRAYS_UNIQUE_KEYS"};
+    for (int way = 0; result && way < 4; way++)
+    {
+        double time = benchmarkBulkRound(key_pointers, n, way);
+        result = time >= 0;
+        printf("%28s %10.1f ms\n", titles[way], time * 1e3);
+    }
+    free(copy);
+    free(key_pointers);
+    free(keys);
+    return result;
+}
+
+/**
+ * Measures concurrent counting from 1 to max_threads threads.
+ * @return
+ * false if the map failed, true otherwise.
+ */
+static bool benchmarkThreads(char (*keys)[BENCHMARK_KEY_LENGTH], int max_threads)
+{
+    printf("%10s %12s %12s   (Mops/s)\n", "threads", "1 stripe", "striped");
+    for (int count = 1; count <= max_threads; count *= 2)
+    {
+        double single = benchmarkThreadsRound(keys, count, 1);
+        double striped = benchmarkThreadsRound(keys, count, BENCHMARK_THREADS_STRIPES);
+        if (single < 0 || striped < 0)
+        {
+            return false;
+        }
+        printf("%10d %12.2f %12.2f\n", count, single, striped);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && (!strcmp(argv[1], "threads") || !strcmp(argv[1], "readers")))
+    {
+        int max_threads = argc > 2 ? atoi(argv[2]) : BENCHMARK_DEFAULT_MAX_THREADS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = malloc(BENCHMARK_THREADS_KEYS * sizeof(*keys));
+        if (keys == NULL || max_threads <= 0)
+        {
+            free(keys);
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, BENCHMARK_THREADS_KEYS);
+        bool result = !strcmp(argv[1], "threads") ? benchmarkThreads(keys, max_threads) :
+                                                    benchmarkReaders(keys, max_threads);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "mapped"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_DEFAULT_MAX_KEYS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = n > 0 ? malloc((size_t)n * sizeof(*keys)) : NULL;
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, n);
+        bool result = benchmarkMapped(keys, n);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "journal"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_JOURNAL_KEYS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = n > 0 ? malloc((size_t)n * sizeof(*keys)) : NULL;
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, n);
+        bool result = benchmarkJournal(keys, n);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "compact"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_COMPACT_KEYS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = n > 0 ? malloc((size_t)n * sizeof(*keys)) : NULL;
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, n);
+        bool result = benchmarkCompact(keys, n);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "generic"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_GENERIC_KEYS;
+        return n > 0 && benchmarkGeneric(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "latency"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_LATENCY_KEYS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = n > 0 ? malloc((size_t)n * sizeof(*keys)) : NULL;
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, n);
+        bool result = benchmarkLatency(keys, n);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "allocator"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_ALLOCATOR_KEYS;
+        char (*keys)[BENCHMARK_KEY_LENGTH] = n > 0 ? malloc((size_t)n * sizeof(*keys)) : NULL;
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, n);
+        bool result = benchmarkAllocator(keys, n);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "prefix"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_PREFIX_KEYS;
+        return n > 0 && benchmarkPrefix(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "filter"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_FILTER_KEYS;
+        return n > 0 && benchmarkFilter(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "frozen"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_FROZEN_KEYS;
+        return n > 0 && benchmarkFrozen(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "upsert"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_UPSERT_KEYS;
+        return n > 0 && benchmarkUpsert(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "bulk"))
+    {
+        int n = argc > 2 ? atoi(argv[2]) : BENCHMARK_BULK_KEYS;
+        return n > 0 && benchmarkBulk(n) ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "memory"))
+    {
+        char (*keys)[BENCHMARK_KEY_LENGTH] = malloc(BENCHMARK_MEMORY_MAX_KEYS * sizeof(*keys));
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, BENCHMARK_MEMORY_MAX_KEYS);
+        bool result = benchmarkMemory(keys);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    if (argc > 1 && !strcmp(argv[1], "small"))
+    {
+        char (*keys)[BENCHMARK_KEY_LENGTH] = malloc(2 * BENCHMARK_SMALL_MAX_KEYS * sizeof(*keys));
+        if (keys == NULL)
+        {
+            return 1;
+        }
+        benchmarkGenerateKeys(keys, 2 * BENCHMARK_SMALL_MAX_KEYS);
+        bool result = benchmarkSmall(keys);
+        free(keys);
+        return result ? 0 : 1;
+    }
+    int max_keys = argc > 1 ? atoi(argv[1]) : BENCHMARK_DEFAULT_MAX_KEYS;
+    if (max_keys <= 0)
+    {
+        fprintf(stderr, "Usage: mapBenchmark [max number of keys] | small | memory | threads [max number of threads] | readers [max number of threads] | mapped [number of keys] | journal [number of keys] | compact [number of keys] | generic [number of keys] | latency [number of keys] | allocator [number of keys] | prefix [number of keys] | filter [number of keys] | frozen [number of keys] | upsert [number of keys] | bulk [number of keys]\n");
+        return 1;
+    }
+    char (*keys)[BENCHMARK_KEY_LENGTH] = malloc((size_t)max_keys * sizeof(*keys));
+    if (keys == NULL)
+    {
+        fprintf(stderr, "Not enough memory for %d keys\n", max_keys);
+        return 1;
+    }
+    benchmarkGenerateKeys(keys, max_keys);
+    printf("%10s %12s %12s %12s   (Mops/s)\n", "keys", "put", "get", "remove");
+    for (int n = 100; n <= max_keys && n > 0; n *= 10)
+    {
+        if (!benchmarkRound(keys, n))
+        {
+            fprintf(stderr, "Map failed at %d keys\n", n);
+            free(keys);
+            return 1;
+        }
+    }
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,736 @@
+#include "orderedMap.h"
+#include "key.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/** The minimum degree of the B-tree: every node but the root has at least DEGREE-1 keys */
+#define ORDERED_MAP_DEGREE 16
+
+/** The maximum number of keys in a node */
+#define ORDERED_MAP_MAX_KEYS (2 * ORDERED_MAP_DEGREE - 1)
+
+/** Bigger than the height of any B-tree with less than 2^31 keys and the degree above */
+#define ORDERED_MAP_MAX_DEPTH 32
+
+//--------------------ORDERED-MAP-STRUCT--------------------//
+/**
+ * A B-tree node. Only inner nodes are allocated with room for the 'children'
+ * (ORDERED_MAP_MAX_KEYS + 1 of them), and a node never changes from a leaf to
+ * an inner node or back.
+ */
+typedef struct node_t
+{
+    int count;
+    bool leaf;
+    Key keys[ORDERED_MAP_MAX_KEYS];
+    struct node_t* children[];
+} *Node;
+
+/**
+ * The iterator is the path from the root to the current key: path[depth-1] is
+ * the current node and positions[depth-1] the index of the current key in it.
+ * Every other node in the path is positioned on the key which follows the
+ * subtree the iterator is in. depth 0 means the iteration has ended.
+ */
+struct OrderedMap_t
+{
+    Node root;
+    int size;
+    OrderedMapCompare compare;
+    Node path[ORDERED_MAP_MAX_DEPTH];
+    int positions[ORDERED_MAP_MAX_DEPTH];
+    int depth;
+    char* range_end; //The last key of the iterated range, NULL if there is no such limit
+};
+
+static Node nodeCreate(bool leaf);
+static void nodeDestroy(Node node);
+static Node nodeCopy(Node node);
+static int nodeSearch(OrderedMap map, Node node, const char* key, bool* found);
+static Key orderedMapFindKey(OrderedMap map, const char* key);
+static void nodeSplitChild(Node parent, int index, Node sibling);
+static void nodeInsertNonFull(OrderedMap map, Node node, Key key, Node* spares);
+static void nodeMergeChildren(Node parent, int index);
+static int nodeFillChild(Node parent, int index);
+static Key nodeRemove(OrderedMap map, Node node, const char* key);
+static void orderedMapDescend(OrderedMap map, Node node);
+static char* orderedMapSettle(OrderedMap map);
+static void orderedMapResetIterator(OrderedMap map);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @param leaf - Whether the new node is a leaf
+ * @return
+ * NULL if the allocation failed, otherwise a new empty node.
+ */
+static Node nodeCreate(bool leaf)
+{
+    Node node = malloc(sizeof(struct node_t) + (leaf ? 0 : (ORDERED_MAP_MAX_KEYS + 1) * sizeof(Node)));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+/**
+ * Frees a node, its subtree and all of their keys.
+ */
+static void nodeDestroy(Node node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < node->count; i++)
+    {
+        keyDestroy(node->keys[i]);
+    }
+    for (int i = 0; !node->leaf && i <= node->count; i++)
+    {
+        nodeDestroy(node->children[i]);
+    }
+    free(node);
+}
+
+/**
+ * @return
+ * A deep copy of the subtree of the node, NULL if an allocation failed.
+ */
+static Node nodeCopy(Node node)
+{
+    Node copy = nodeCreate(node->leaf);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    if (!node->leaf)
+    {
+        copy->children[0] = nodeCopy(node->children[0]);
+        if (copy->children[0] == NULL)
+        {
+            free(copy);
+            return NULL;
+        }
+    }
+    //The copy is kept destroyable: it always has 'count' keys and 'count + 1' children
+    for (int i = 0; i < node->count; i++)
+    {
+        Key key = keyCreate(keyGetID(node->keys[i]), keyGetValue(node->keys[i]));
+        Node child = node->leaf ? NULL : nodeCopy(node->children[i + 1]);
+        if (key == NULL || (!node->leaf && child == NULL))
+        {
+            keyDestroy(key);
+            nodeDestroy(child);
+            nodeDestroy(copy);
+            return NULL;
+        }
+        copy->keys[i] = key;
+        if (!node->leaf)
+        {
+            copy->children[i + 1] = child;
+        }
+        copy->count++;
+    }
+    return copy;
+}
+
+/**
+ * Binary searches the keys of a single node.
+ * @param found - Set to whether keys[returned index] equals the key
+ * @return
+ * The index of the first key in the node which is not smaller than the key
+ * (node->count if there is no such key).
+ */
+static int nodeSearch(OrderedMap map, Node node, const char* key, bool* found)
+{
+    int low = 0, high = node->count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (map->compare(keyGetID(node->keys[middle]), key) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    *found = low < node->count && map->compare(keyGetID(node->keys[low]), key) == 0;
+    return low;
+}
+
+/**
+ * @return
+ * The Key in the map which equals the key, NULL if there is no such Key.
+ */
+static Key orderedMapFindKey(OrderedMap map, const char* key)
+{
+    Node node = map->root;
+    while (true)
+    {
+        bool found = false;
+        int index = nodeSearch(map, node, key, &found);
+        if (found)
+        {
+            return node->keys[index];
+        }
+        if (node->leaf)
+        {
+            return NULL;
+        }
+        node = node->children[index];
+    }
+}
+
+/**
+ * Splits the full child 'index' of a node which is not full: the middle key
+ * moves up to the parent and the upper half moves to a new sibling.
+ * @param sibling - An empty node for the upper half, of the same kind as the child.
+ */
+static void nodeSplitChild(Node parent, int index, Node sibling)
+{
+    Node child = parent->children[index];
+    assert(child->count == ORDERED_MAP_MAX_KEYS && parent->count < ORDERED_MAP_MAX_KEYS);
+    assert(sibling->leaf == child->leaf);
+    sibling->count = ORDERED_MAP_DEGREE - 1;
+    memcpy(sibling->keys, child->keys + ORDERED_MAP_DEGREE, (ORDERED_MAP_DEGREE - 1) * sizeof(Key));
+    if (!child->leaf)
+    {
+        memcpy(sibling->children, child->children + ORDERED_MAP_DEGREE, ORDERED_MAP_DEGREE * sizeof(Node));
+    }
+    child->count = ORDERED_MAP_DEGREE - 1;
+    memmove(parent->children + index + 2, parent->children + index + 1,
+            (parent->count - index) * sizeof(Node));
+    parent->children[index + 1] = sibling;
+    memmove(parent->keys + index + 1, parent->keys + index, (parent->count - index) * sizeof(Key));
+    parent->keys[index] = child->keys[ORDERED_MAP_DEGREE - 1];
+    parent->count++;
+}
+
+/**
+ * Inserts a key which is not in the map to the subtree of a node which is not
+ * full, splitting the full nodes on the way down.
+ * @param spares - The empty nodes for the splits, in the order of the splits
+ *      (see 'orderedMapPut'), so the insertion itself cannot fail.
+ */
+static void nodeInsertNonFull(OrderedMap map, Node node, Key key, Node* spares)
+{
+    bool found = false;
+    while (!node->leaf)
+    {
+        int index = nodeSearch(map, node, keyGetID(key), &found);
+        if (node->children[index]->count == ORDERED_MAP_MAX_KEYS)
+        {
+            nodeSplitChild(node, index, *spares++);
+            if (map->compare(keyGetID(node->keys[index]), keyGetID(key)) < 0)
+            {
+                index++;
+            }
+        }
+        node = node->children[index];
+    }
+    int index = nodeSearch(map, node, keyGetID(key), &found);
+    assert(!found);
+    memmove(node->keys + index + 1, node->keys + index, (node->count - index) * sizeof(Key));
+    node->keys[index] = key;
+    node->count++;
+}
+
+/**
+ * Merges child 'index + 1' and the key 'index' of the parent into child 'index'.
+ * Both children must have DEGREE-1 keys.
+ */
+static void nodeMergeChildren(Node parent, int index)
+{
+    Node left = parent->children[index];
+    Node right = parent->children[index + 1];
+    assert(left->count + right->count + 1 <= ORDERED_MAP_MAX_KEYS);
+    left->keys[left->count] = parent->keys[index];
+    memcpy(left->keys + left->count + 1, right->keys, right->count * sizeof(Key));
+    if (!left->leaf)
+    {
+        memcpy(left->children + left->count + 1, right->children, (right->count + 1) * sizeof(Node));
+    }
+    left->count += right->count + 1;
+    memmove(parent->keys + index, parent->keys + index + 1, (parent->count - index - 1) * sizeof(Key));
+    memmove(parent->children + index + 1, parent->children + index + 2,
+            (parent->count - index - 1) * sizeof(Node));
+    parent->count--;
+    free(right);
+}
+
+/**
+ * Makes sure the child 'index' has at least DEGREE keys before descending into
+ * it, by moving a key from a sibling through the parent or by merging it with
+ * a sibling.
+ * @return
+ * The index of the child which now holds the keys of the original child.
+ */
+static int nodeFillChild(Node parent, int index)
+{
+    Node child = parent->children[index];
+    if (child->count >= ORDERED_MAP_DEGREE)
+    {
+        return index;
+    }
+    if (index > 0 && parent->children[index - 1]->count >= ORDERED_MAP_DEGREE)
+    {
+        Node left = parent->children[index - 1];
+        memmove(child->keys + 1, child->keys, child->count * sizeof(Key));
+        child->keys[0] = parent->keys[index - 1];
+        if (!child->leaf)
+        {
+            memmove(child->children + 1, child->children, (child->count + 1) * sizeof(Node));
+            child->children[0] = left->children[left->count];
+        }
+        parent->keys[index - 1] = left->keys[left->count - 1];
+        left->count--;
+        child->count++;
+        return index;
+    }
+    if (index < parent->count && parent->children[index + 1]->count >= ORDERED_MAP_DEGREE)
+    {
+        Node right = parent->children[index + 1];
+        child->keys[child->count] = parent->keys[index];
+        if (!child->leaf)
+        {
+            child->children[child->count + 1] = right->children[0];
+            memmove(right->children, right->children + 1, right->count * sizeof(Node));
+        }
+        parent->keys[index] = right->keys[0];
+        memmove(right->keys, right->keys + 1, (right->count - 1) * sizeof(Key));
+        right->count--;
+        child->count++;
+        return index;
+    }
+    if (index < parent->count)
+    {
+        nodeMergeChildren(parent, index);
+        return index;
+    }
+    nodeMergeChildren(parent, index - 1);
+    return index - 1;
+}
+
+/**
+ * Detaches a key from the subtree of a node (without freeing it). Every node
+ * the search descends to is first filled up to at least DEGREE keys, so the
+ * removal never has to go back up the tree.
+ * @return
+ * The detached Key, or NULL if the key is not in the subtree.
+ */
+static Key nodeRemove(OrderedMap map, Node node, const char* key)
+{
+    while (true)
+    {
+        bool found = false;
+        int index = nodeSearch(map, node, key, &found);
+        if (found && node->leaf)
+        {
+            Key removed = node->keys[index];
+            memmove(node->keys + index, node->keys + index + 1, (node->count - index - 1) * sizeof(Key));
+            node->count--;
+            return removed;
+        }
+        if (found)
+        {
+            Key removed = node->keys[index];
+            if (node->children[index]->count >= ORDERED_MAP_DEGREE)
+            {
+                //The predecessor takes the place of the removed key
+                Node predecessor = node->children[index];
+                while (!predecessor->leaf)
+                {
+                    predecessor = predecessor->children[predecessor->count];
+                }
+                const char* id = keyGetID(predecessor->keys[predecessor->count - 1]);
+                node->keys[index] = nodeRemove(map, node->children[index], id);
+                return removed;
+            }
+            if (node->children[index + 1]->count >= ORDERED_MAP_DEGREE)
+            {
+                Node successor = node->children[index + 1];
+                while (!successor->leaf)
+                {
+                    successor = successor->children[0];
+                }
+                const char* id = keyGetID(successor->keys[0]);
+                node->keys[index] = nodeRemove(map, node->children[index + 1], id);
+                return removed;
+            }
+            //Both neighbours are minimal, so the key moves down into their merge
+            nodeMergeChildren(node, index);
+            node = node->children[index];
+            continue;
+        }
+        if (node->leaf)
+        {
+            return NULL;
+        }
+        node = node->children[nodeFillChild(node, index)];
+    }
+}
+
+/**
+ * Pushes the path from a node down to the smallest key of its subtree.
+ */
+static void orderedMapDescend(OrderedMap map, Node node)
+{
+    while (true)
+    {
+        assert(map->depth < ORDERED_MAP_MAX_DEPTH);
+        map->path[map->depth] = node;
+        map->positions[map->depth++] = 0;
+        if (node->leaf)
+        {
+            return;
+        }
+        node = node->children[0];
+    }
+}
+
+/**
+ * Pops the nodes whose keys were all visited, until the top of the path is
+ * positioned on a key.
+ * @return
+ * That key, or NULL if the iteration ended (or passed the end of the range).
+ */
+static char* orderedMapSettle(OrderedMap map)
+{
+    while (map->depth > 0 && map->positions[map->depth - 1] >= map->path[map->depth - 1]->count)
+    {
+        map->depth--;
+    }
+    if (map->depth == 0)
+    {
+        return NULL;
+    }
+    char* key = keyGetID(map->path[map->depth - 1]->keys[map->positions[map->depth - 1]]);
+    if (map->range_end != NULL && map->compare(key, map->range_end) > 0)
+    {
+        map->depth = 0;
+        return NULL;
+    }
+    return key;
+}
+
+/**
+ * Ends the current iteration and drops its range.
+ */
+static void orderedMapResetIterator(OrderedMap map)
+{
+    map->depth = 0;
+    free(map->range_end);
+    map->range_end = NULL;
+}
+
+//--------------------HEADER-FUNCTIONS--------------------//
+OrderedMap orderedMapCreate(OrderedMapCompare compare)
+{
+    OrderedMap map = malloc(sizeof(*map));
+    if (map == NULL)
+    {
+        return NULL;
+    }
+    map->root = nodeCreate(true);
+    if (map->root == NULL)
+    {
+        free(map);
+        return NULL;
+    }
+    map->size = 0;
+    map->compare = compare != NULL ? compare : strcmp;
+    map->depth = 0;
+    map->range_end = NULL;
+    return map;
+}
+
+void orderedMapDestroy(OrderedMap map)
+{
+    if (map == NULL)
+    {
+        return;
+    }
+    nodeDestroy(map->root);
+    free(map->range_end);
+    free(map);
+}
+
+OrderedMap orderedMapCopy(OrderedMap map)
+{
+    if (map == NULL)
+    {
+        return NULL;
+    }
+    OrderedMap copy = orderedMapCreate(map->compare);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    Node root = nodeCopy(map->root);
+    if (root == NULL)
+    {
+        orderedMapDestroy(copy);
+        return NULL;
+    }
+    nodeDestroy(copy->root);
+    copy->root = root;
+    copy->size = map->size;
+    return copy;
+}
+
+int orderedMapGetSize(OrderedMap map)
+{
+    return map == NULL ? -1 : map->size;
+}
+
+bool orderedMapContains(OrderedMap map, const char* key)
+{
+    return map != NULL && key != NULL && orderedMapFindKey(map, key) != NULL;
+}
+
+MapResult orderedMapPut(OrderedMap map, const char* key, const char* data)
+{
+    if (map == NULL || key == NULL || data == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    orderedMapResetIterator(map);
+    Key existing = orderedMapFindKey(map, key);
+    if (existing != NULL)
+    {
+        return keySetValue(existing, data) == KEY_SUCCESS ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    Key new_key = keyCreate(key, data);
+    if (new_key == NULL)
+    {
+        return MAP_OUT_OF_MEMORY;
+    }
+    //Every full node on the search path will be split, so all of their new
+    //siblings (and a new root) are allocated before the tree is changed
+    Node spares[ORDERED_MAP_MAX_DEPTH + 1];
+    int spares_count = 0;
+    Node new_root = NULL;
+    if (map->root->count == ORDERED_MAP_MAX_KEYS)
+    {
+        new_root = nodeCreate(false);
+    }
+    bool failed = map->root->count == ORDERED_MAP_MAX_KEYS && new_root == NULL;
+    bool found = false;
+    for (Node node = map->root; !failed; node = node->children[nodeSearch(map, node, key, &found)])
+    {
+        if (node->count == ORDERED_MAP_MAX_KEYS)
+        {
+            spares[spares_count] = nodeCreate(node->leaf);
+            failed = spares[spares_count++] == NULL;
+        }
+        if (node->leaf)
+        {
+            break;
+        }
+    }
+    if (failed)
+    {
+        for (int i = 0; i < spares_count; i++)
+        {
+            free(spares[i]);
+        }
+        free(new_root);
+        keyDestroy(new_key);
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (new_root != NULL)
+    {
+        new_root->children[0] = map->root;
+        map->root = new_root;
+    }
+    nodeInsertNonFull(map, map->root, new_key, spares);
+    map->size++;
+    return MAP_SUCCESS;
+}
+
+char* orderedMapGet(OrderedMap map, const char* key)
+{
+    if (map == NULL || key == NULL)
+    {
+        return NULL;
+    }
+    Key found = orderedMapFindKey(map, key);
+    return found == NULL ? NULL : keyGetValue(found);
+}
+
+MapResult orderedMapRemove(OrderedMap map, const char* key)
+{
+    if (map == NULL || key == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    orderedMapResetIterator(map);
+    Key removed = nodeRemove(map, map->root, key);
+    if (map->root->count == 0 && !map->root->leaf)
+    {
+        Node old_root = map->root;
+        map->root = old_root->children[0];
+        free(old_root);
+    }
+    if (removed == NULL)
+    {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    keyDestroy(removed);
+    map->size--;
+    return MAP_SUCCESS;
+}
+
+char* orderedMapGetMin(OrderedMap map)
+{
+    if (map == NULL || map->size == 0)
+    {
+        return NULL;
+    }
+    Node node = map->root;
+    while (!node->leaf)
+    {
+        node = node->children[0];
+    }
+    return keyGetID(node->keys[0]);
+}
+
+char* orderedMapGetMax(OrderedMap map)
+{
+    if (map == NULL || map->size == 0)
+    {
+        return NULL;
+    }
+    Node node = map->root;
+    while (!node->leaf)
+    {
+        node = node->children[node->count];
+    }
+    return keyGetID(node->keys[node->count - 1]);
+}
+
+char* orderedMapLowerBound(OrderedMap map, const char* key)
+{
+    if (map == NULL || key == NULL)
+    {
+        return NULL;
+    }
+    char* bound = NULL;
+    Node node = map->root;
+    while (true)
+    {
+        bool found = false;
+        int index = nodeSearch(map, node, key, &found);
+        if (index < node->count)
+        {
+            bound = keyGetID(node->keys[index]);
+        }
+        if (found || node->leaf)
+        {
+            return bound;
+        }
+        node = node->children[index];
+    }
+}
+
+char* orderedMapGetFirst(OrderedMap map)
+{
+    if (map == NULL)
+    {
+        return NULL;
+    }
+    orderedMapResetIterator(map);
+    orderedMapDescend(map, map->root);
+    return orderedMapSettle(map);
+}
+
+char* orderedMapGetFirstInRange(OrderedMap map, const char* from, const char* to)
+{
+    if (map == NULL || from == NULL || to == NULL)
+    {
+        return NULL;
+    }
+    orderedMapResetIterator(map);
+    map->range_end = malloc(strlen(to) + 1);
+    if (map->range_end == NULL)
+    {
+        return NULL;
+    }
+    strcpy(map->range_end, to);
+    Node node = map->root;
+    while (true)
+    {
+        bool found = false;
+        int index = nodeSearch(map, node, from, &found);
+        assert(map->depth < ORDERED_MAP_MAX_DEPTH);
+        map->path[map->depth] = node;
+        map->positions[map->depth++] = index;
+        if (found || node->leaf)
+        {
+            return orderedMapSettle(map);
+        }
+        node = node->children[index];
+    }
+}
+
+char* orderedMapGetNext(OrderedMap map)
+{
+    if (map == NULL || map->depth == 0)
+    {
+        return NULL;
+    }
+    Node node = map->path[map->depth - 1];
+    int index = ++map->positions[map->depth - 1];
+    if (!node->leaf)
+    {
+        orderedMapDescend(map, node->children[index]);
+    }
+    return orderedMapSettle(map);
+}
+
+MapResult orderedMapClear(OrderedMap map)
+{
+    if (map == NULL)
+    {
+        return MAP_NULL_ARGUMENT;
+    }
+    Node root = nodeCreate(true);
+    if (root == NULL)
+    {
+        //Keeps the map valid by emptying the old root instead of replacing it
+        for (int i = 0; !map->root->leaf && i <= map->root->count; i++)
+        {
+            nodeDestroy(map->root->children[i]);
+        }
+        for (int i = 0; i < map->root->count; i++)
+        {
+            keyDestroy(map->root->keys[i]);
+        }
+        map->root->count = 0;
+        map->root->leaf = true;
+    }
+    else
+    {
+        nodeDestroy(map->root);
+        map->root = root;
+    }
+    orderedMapResetIterator(map);
+    map->size = 0;
+    return MAP_SUCCESS;
+}
+
+int orderedMapCompareNumeric(const char* first, const char* second)
+{
+    size_t first_length = strlen(first), second_length = strlen(second);
+    if (first_length != second_length)
+    {
+        return first_length < second_length ? -1 : 1;
+    }
+    return strcmp(first, second);
+}
\ No newline at end of file
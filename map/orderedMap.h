@@ -0,0 +1,249 @@
+#ifndef ORDERED_MAP_H_
+#define ORDERED_MAP_H_
+
+#include <stdbool.h>
+#include "map.h"
+
+/**
+* Ordered Map Container
+*
+* Implements a map container type whose keys are kept sorted, in a B-tree.
+* The type of the key and the value is string (char *)
+* The keys are ordered by a comparison function given on creation (strcmp by
+* default), and the internal iterator visits them in increasing order.
+* For all functions where the state of the iterator after calling that function
+* is not stated, it is undefined. That is you cannot assume anything about it.
+*
+* The following functions are available:
+*   orderedMapCreate		- Creates a new empty ordered map
+*   orderedMapDestroy		- Deletes an existing ordered map and frees all resources
+*   orderedMapCopy		- Copies an existing ordered map
+*   orderedMapGetSize		- Returns the size of a given ordered map
+*   orderedMapContains		- returns weather or not a key exists inside the map.
+*   orderedMapPut		    - Gives a specific key a given value.
+*   orderedMapGet  	    - Returns the data paired to a key which matches the given key.
+*   orderedMapRemove		- Removes a pair of (key,data) elements.
+*   orderedMapGetMin		- Returns the smallest key in the map.
+*   orderedMapGetMax		- Returns the biggest key in the map.
+*   orderedMapLowerBound	- Returns the smallest key which is not smaller than a given key.
+*   orderedMapGetFirst		- Sets the internal iterator to the smallest key and returns it.
+*   orderedMapGetFirstInRange	- Sets the internal iterator to the smallest key in a
+*   				  range of keys and returns it.
+*   orderedMapGetNext		- Advances the internal iterator to the next key and returns it.
+*   orderedMapClear		- Clears the contents of the map.
+*   ORDERED_MAP_FOREACH		- A macro for iterating over the map's elements in order.
+*   ORDERED_MAP_FOREACH_IN_RANGE - A macro for iterating over a range of keys in order.
+*   orderedMapCompareNumeric	- A comparison function for keys which are non-negative
+*   				  integers written in decimal.
+*/
+
+/** Type for defining the ordered map */
+typedef struct OrderedMap_t* OrderedMap;
+
+/**
+ * Type of the function which orders the keys of an ordered map.
+ * Returns a negative number if first < second, 0 if they are equal and a
+ * positive number if first > second (like strcmp).
+ */
+typedef int (*OrderedMapCompare)(const char* first, const char* second);
+
+/**
+* orderedMapCreate: Allocates a new empty ordered map.
+*
+* @param compare - The function which orders the keys. If NULL, strcmp is used.
+* @return
+* 	NULL - if allocations failed.
+* 	A new OrderedMap in case of success.
+*/
+OrderedMap orderedMapCreate(OrderedMapCompare compare);
+
+/**
+* orderedMapDestroy: Deallocates an existing ordered map. Clears all elements.
+*
+* @param map - Target map to be deallocated. If map is NULL nothing will be
+* 		done
+*/
+void orderedMapDestroy(OrderedMap map);
+
+/**
+* orderedMapCopy: Creates a copy of target ordered map, with the same comparison function.
+* Iterator values for both maps is undefined after this operation.
+*
+* @param map - Target map.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	An OrderedMap containing the same elements as map otherwise.
+*/
+OrderedMap orderedMapCopy(OrderedMap map);
+
+/**
+* orderedMapGetSize: Returns the number of elements in an ordered map
+* @param map - The map which size is requested
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	Otherwise the number of elements in the map.
+*/
+int orderedMapGetSize(OrderedMap map);
+
+/**
+* orderedMapContains: Checks if a key element exists in the map, using the
+* map's comparison function. Takes O(log n).
+*
+* @param map - The map to search in
+* @param key - The key to look for.
+* @return
+* 	false - if one or more of the inputs is null, or if the key element was not found.
+* 	true - if the key element was found in the map.
+*/
+bool orderedMapContains(OrderedMap map, const char* key);
+
+/**
+*	orderedMapPut: Gives a specified key a specific value. Takes O(log n).
+*  Iterator's value is undefined after this operation.
+*
+* @param map - The map for which to assign/reassign the data element
+* @param key - The key element which need to be assigned/reassigned.
+*       A copy of the key element will be inserted.
+* @param data - The new data element to associate with the given key.
+*      A copy of the data element will be inserted and old data memory would be deleted.
+* @return
+* 	MAP_NULL_ARGUMENT if one of the params is NULL
+* 	MAP_OUT_OF_MEMORY if an allocation failed
+* 	MAP_SUCCESS the paired elements had been inserted successfully
+*/
+MapResult orderedMapPut(OrderedMap map, const char* key, const char* data);
+
+/**
+*	orderedMapGet: Returns the data associated with a specific key in the map(not a copy).
+*			Iterator status unchanged. Takes O(log n).
+*
+* @param map - The map for which to get the data element from.
+* @param key - The key element which need to be found and who's data we want to get.
+* @return
+*  NULL if a NULL pointer was sent or if the map does not contain the requested key.
+* 	A pointer to the data element associated with the key otherwise.
+*/
+char* orderedMapGet(OrderedMap map, const char* key);
+
+/**
+* 	orderedMapRemove: Removes a pair of key and data elements from the map, and
+*  deallocates them. Takes O(log n).
+*  Iterator's value is undefined after this operation.
+*
+* @param map - The map to remove the elements from.
+* @param key - The key element to find and remove from the map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent to the function
+*  MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in the map
+* 	MAP_SUCCESS the paired elements had been removed successfully
+*/
+MapResult orderedMapRemove(OrderedMap map, const char* key);
+
+/**
+*	orderedMapGetMin: Returns the smallest key in the map (not a copy).
+*			Iterator status unchanged. Takes O(log n).
+*
+* @param map - The map to search in.
+* @return
+* 	NULL if a NULL pointer was sent or the map is empty.
+* 	The smallest key element of the map otherwise.
+*/
+char* orderedMapGetMin(OrderedMap map);
+
+/**
+*	orderedMapGetMax: Returns the biggest key in the map (not a copy).
+*			Iterator status unchanged. Takes O(log n).
+*
+* @param map - The map to search in.
+* @return
+* 	NULL if a NULL pointer was sent or the map is empty.
+* 	The biggest key element of the map otherwise.
+*/
+char* orderedMapGetMax(OrderedMap map);
+
+/**
+*	orderedMapLowerBound: Returns the smallest key in the map which is not
+*	smaller than a given key (not a copy). Iterator status unchanged. Takes O(log n).
+*
+* @param map - The map to search in.
+* @param key - The bound. It does not have to be in the map.
+* @return
+* 	NULL if a NULL pointer was sent or all the keys of the map are smaller than key.
+* 	The first key element which is not smaller than key otherwise.
+*/
+char* orderedMapLowerBound(OrderedMap map, const char* key);
+
+/**
+*	orderedMapGetFirst: Sets the internal iterator to the smallest key element
+*	in the map, and returns it.
+*	To continue iteration use orderedMapGetNext
+*
+* @param map - The map for which to set the iterator and return the first key element.
+* @return
+* 	NULL if a NULL pointer was sent or the map is empty.
+* 	The first key element of the map otherwise
+*/
+char* orderedMapGetFirst(OrderedMap map);
+
+/**
+*	orderedMapGetFirstInRange: Sets the internal iterator to the smallest key
+*	element which is in the range [from, to], and returns it. Takes O(log n).
+*	orderedMapGetNext then returns the following keys up to (and including) to.
+*
+* @param map - The map for which to set the iterator.
+* @param from - The smallest key of the range. It does not have to be in the map.
+* @param to - The biggest key of the range. It does not have to be in the map.
+* @return
+* 	NULL if a NULL pointer was sent, a memory allocation failed or no key is in the range.
+* 	The first key element in the range otherwise
+*/
+char* orderedMapGetFirstInRange(OrderedMap map, const char* from, const char* to);
+
+/**
+*	orderedMapGetNext: Advances the map iterator to the next key element (in
+*	order) and returns it. Takes O(1) amortized.
+* @param map - The map for which to advance the iterator
+* @return
+* 	NULL if reached the end of the map (or of the range), or the iterator is at
+* 	an invalid state or a NULL sent as argument
+* 	The next key element on the map in case of success
+*/
+char* orderedMapGetNext(OrderedMap map);
+
+/**
+* orderedMapClear: Removes all key and data elements from target map.
+* The elements are deallocated.
+* @param map
+* 	Target map to remove all element from.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult orderedMapClear(OrderedMap map);
+
+/**
+ * orderedMapCompareNumeric: Orders keys which are non-negative integers
+ * written in decimal without leading zeros (like "7" < "12"), without
+ * converting them to numbers.
+ */
+int orderedMapCompareNumeric(const char* first, const char* second);
+
+/*!
+* Macro for iterating over an ordered map, in increasing order of the keys.
+* Declares a new iterator for the loop.
+*/
+#define ORDERED_MAP_FOREACH(iterator, map) \
+    for(char* iterator = (char*) orderedMapGetFirst(map) ; \
+        iterator ;\
+        iterator = orderedMapGetNext(map))
+
+/*!
+* Macro for iterating over the keys of an ordered map in the range [from, to],
+* in increasing order. Declares a new iterator for the loop.
+*/
+#define ORDERED_MAP_FOREACH_IN_RANGE(iterator, map, from, to) \
+    for(char* iterator = (char*) orderedMapGetFirstInRange(map, from, to) ; \
+        iterator ;\
+        iterator = orderedMapGetNext(map))
+
+#endif /* ORDERED_MAP_H_ */
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Every block returned by the pool is aligned to this size, and its size rounded up to it */
+#define POOL_ALIGNMENT 16
+
+/** Blocks bigger than this come from malloc */
+#define POOL_MAX_BLOCK_SIZE 1024
+
+/** The number of free lists, one per size */
+#define POOL_CLASS_COUNT (POOL_MAX_BLOCK_SIZE / POOL_ALIGNMENT)
+
+/** The usable bytes of every chunk */
+#define POOL_CHUNK_SIZE (64 * 1024)
+
+/** The free list a block of 'size' bytes (at most POOL_MAX_BLOCK_SIZE) belongs to */
+#define POOL_CLASS(size) ((size) > 0 ? ((size) - 1) / POOL_ALIGNMENT : 0)
+
+//--------------------POOL-STRUCT--------------------//
+typedef struct pool_chunk_t
+{
+    struct pool_chunk_t* next;
+    //Keeps 'data' aligned for any type
+    union
+    {
+        long double alignment_long_double;
+        void* alignment_pointer;
+        long long alignment_long_long;
+    } data[];
+} *PoolChunk;
+
+/** A free block, which holds the next one of its list */
+typedef struct pool_block_t
+{
+    struct pool_block_t* next;
+} *PoolBlock;
+
+struct pool_t
+{
+    PoolBlock free_blocks[POOL_CLASS_COUNT];
+    PoolChunk chunks;
+    char* next; //The start of the part of the newest chunk which was never allocated
+    char* end;
+    size_t chunk_bytes;
+    size_t big_bytes; //The bytes of the blocks from malloc which were not released yet
+};
+
+static void* poolAllocateFromContext(void* context, size_t size);
+static void* poolReallocateFromContext(void* context, void* block, size_t old_size, size_t new_size);
+static void poolReleaseFromContext(void* context, void* block, size_t size);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * poolAllocate, with the pool as a MapAllocator context.
+ */
+static void* poolAllocateFromContext(void* context, size_t size)
+{
+    return poolAllocate(context, size);
+}
+
+/**
+ * poolReallocate, with the pool as a MapAllocator context.
+ */
+static void* poolReallocateFromContext(void* context, void* block, size_t old_size, size_t new_size)
+{
+    return poolReallocate(context, block, old_size, new_size);
+}
+
+/**
+ * poolRelease, with the pool as a MapAllocator context.
+ */
+static void poolReleaseFromContext(void* context, void* block, size_t size)
+{
+    poolRelease(context, block, size);
+}
+
+//--------------------POOL-FUNCTIONS--------------------//
+Pool poolCreate()
+{
+    Pool pool = malloc(sizeof(*pool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < POOL_CLASS_COUNT; i++)
+    {
+        pool->free_blocks[i] = NULL;
+    }
+    pool->chunks = NULL;
+    pool->next = NULL;
+    pool->end = NULL;
+    pool->chunk_bytes = 0;
+    pool->big_bytes = 0;
+    return pool;
+}
+
+void poolDestroy(Pool pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    PoolChunk chunk = pool->chunks;
+    while (chunk != NULL)
+    {
+        PoolChunk next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(pool);
+}
+
+void* poolAllocate(Pool pool, size_t size)
+{
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    if (size > POOL_MAX_BLOCK_SIZE)
+    {
+        void* block = malloc(size);
+        pool->big_bytes += block != NULL ? size : 0;
+        return block;
+    }
+    size_t class = POOL_CLASS(size);
+    PoolBlock block = pool->free_blocks[class];
+    if (block != NULL)
+    {
+        pool->free_blocks[class] = block->next;
+        return block;
+    }
+    size_t block_size = (class + 1) * POOL_ALIGNMENT;
+    if (pool->next == NULL || (size_t)(pool->end - pool->next) < block_size)
+    {
+        //The rest of the newest chunk is too small for this block, and is left unused
+        PoolChunk chunk = malloc(sizeof(*chunk) + POOL_CHUNK_SIZE);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        pool->next = (char*)chunk->data;
+        pool->end = pool->next + POOL_CHUNK_SIZE;
+        pool->chunk_bytes += sizeof(*chunk) + POOL_CHUNK_SIZE;
+    }
+    void* new_block = pool->next;
+    pool->next += block_size;
+    return new_block;
+}
+
+void* poolReallocate(Pool pool, void* block, size_t old_size, size_t new_size)
+{
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    if (block == NULL)
+    {
+        return poolAllocate(pool, new_size);
+    }
+    if (old_size > POOL_MAX_BLOCK_SIZE && new_size > POOL_MAX_BLOCK_SIZE)
+    {
+        void* new_block = realloc(block, new_size);
+        if (new_block != NULL)
+        {
+            pool->big_bytes += new_size - old_size;
+        }
+        return new_block;
+    }
+    if (old_size <= POOL_MAX_BLOCK_SIZE && new_size <= POOL_MAX_BLOCK_SIZE &&
+        POOL_CLASS(old_size) == POOL_CLASS(new_size))
+    {
+        return block;
+    }
+    void* new_block = poolAllocate(pool, new_size);
+    if (new_block == NULL)
+    {
+        return NULL;
+    }
+    memcpy(new_block, block, old_size < new_size ? old_size : new_size);
+    poolRelease(pool, block, old_size);
+    return new_block;
+}
+
+void poolRelease(Pool pool, void* block, size_t size)
+{
+    if (pool == NULL || block == NULL)
+    {
+        return;
+    }
+    if (size > POOL_MAX_BLOCK_SIZE)
+    {
+        pool->big_bytes -= size;
+        free(block);
+        return;
+    }
+    PoolBlock free_block = block;
+    free_block->next = pool->free_blocks[POOL_CLASS(size)];
+    pool->free_blocks[POOL_CLASS(size)] = free_block;
+}
+
+size_t poolGetSize(Pool pool)
+{
+    return pool == NULL ? 0 : sizeof(*pool) + pool->chunk_bytes + pool->big_bytes;
+}
+
+MapAllocator poolGetAllocator(Pool pool)
+{
+    MapAllocator allocator;
+    allocator.allocate = poolAllocateFromContext;
+    allocator.reallocate = poolReallocateFromContext;
+    allocator.release = poolReleaseFromContext;
+    allocator.context = pool;
+    return allocator;
+}
\ No newline at end of file
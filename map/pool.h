@@ -0,0 +1,91 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include "map.h"
+
+/**
+* Pool Allocator
+*
+* Implements an allocator of small blocks, kept in free lists by size. Blocks
+* are rounded up to a multiple of 16 bytes, and each size gets its own list,
+* so a freed block is reused by the next allocation of the same size in O(1).
+* New blocks are cut from big chunks, which are freed only with the pool.
+* Blocks bigger than a limit come from malloc. The key elements of a map come
+* in a few such sizes, which makes a pool a good allocator for maps of many
+* short elements (see mapCreateWithAllocator).
+*
+* The following functions are available:
+*   poolCreate		- Creates a new empty pool
+*   poolDestroy		- Frees all the chunks of a pool
+*   poolAllocate	- Allocates a block of memory from the pool
+*   poolReallocate	- Resizes a block of the pool
+*   poolRelease		- Gives a block back to the pool
+*   poolGetSize		- Returns the bytes a pool holds.
+*   poolGetAllocator	- Returns the functions for using a pool as the allocator of a map.
+*
+* A pool is not thread safe: it must be used by one thread at a time.
+*/
+
+typedef struct pool_t *Pool;
+
+/**
+ * @return
+ * NULL - if the allocation failed.
+ * A new empty pool otherwise.
+ */
+Pool poolCreate();
+
+/**
+ * @param pool - The pool to free, with all of its chunks. All the blocks
+ *      allocated from it become invalid, but big blocks which were not
+ *      released are not freed (so the maps which use the pool are destroyed
+ *      first). If NULL nothing is done.
+ */
+void poolDestroy(Pool pool);
+
+/**
+ * @param pool - The pool to allocate from.
+ * @param size - The number of bytes needed.
+ * @return
+ * NULL - if a NULL was sent or a new chunk could not be allocated.
+ * Otherwise a pointer to a block of at least size bytes, aligned to 16 bytes.
+ */
+void* poolAllocate(Pool pool, size_t size);
+
+/**
+ * @param pool - The pool the block came from.
+ * @param block - A block of the pool, or NULL (then a new block is allocated).
+ * @param old_size - The size the block was allocated (or last resized) with.
+ * @param new_size - The number of bytes needed.
+ * @return
+ * NULL - if the allocation failed (the block is kept as is).
+ * Otherwise the resized block, which keeps the contents of the old one up to
+ * the smaller of the sizes (it is the same block if both sizes round the same).
+ */
+void* poolReallocate(Pool pool, void* block, size_t old_size, size_t new_size);
+
+/**
+ * @param pool - The pool the block came from.
+ * @param block - A block of the pool. If NULL nothing is done.
+ * @param size - The size the block was allocated (or last resized) with.
+ */
+void poolRelease(Pool pool, void* block, size_t size);
+
+/**
+ * @param pool - The pool to measure.
+ * @return
+ * The bytes of all the chunks of the pool (used or not) and of its big blocks,
+ * 0 if @param pool is NULL.
+ */
+size_t poolGetSize(Pool pool);
+
+/**
+ * @param pool - The pool to allocate from.
+ * @return
+ * The functions which allocate from the pool, for mapCreateWithAllocator.
+ * The pool must outlive every map created with them.
+ */
+MapAllocator poolGetAllocator(Pool pool);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,586 @@
+#include "radix.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/** A node keeps up to this many children in a sorted array, and more of them in a table */
+#define RADIX_SMALL_CHILDREN 16
+
+/** The size of the table of children of a node with many children, one per first byte */
+#define RADIX_TABLE_CHILDREN 256
+
+/** The room for children of a node which gets its first child */
+#define RADIX_MIN_CHILDREN 4
+
+/** The factor by which the sorted array of children grows */
+#define RADIX_GROWTH_FACTOR 2
+
+/** Trees may be shared by maps used from different threads, so their counts are atomic */
+#if defined(__GNUC__)
+#define RADIX_REFCOUNT_INCREMENT(count) __atomic_add_fetch(&(count), 1, __ATOMIC_RELAXED)
+#define RADIX_REFCOUNT_DECREMENT(count) __atomic_sub_fetch(&(count), 1, __ATOMIC_ACQ_REL)
+#define RADIX_REFCOUNT_LOAD(count) __atomic_load_n(&(count), __ATOMIC_ACQUIRE)
+#else
+#define RADIX_REFCOUNT_INCREMENT(count) (++(count))
+#define RADIX_REFCOUNT_DECREMENT(count) (--(count))
+#define RADIX_REFCOUNT_LOAD(count) (count)
+#endif
+
+//--------------------RADIX-STRUCT--------------------//
+/**
+ * A node of the tree. The strings of its subtree are the labels of the nodes
+ * on the path from the root, one after the other. Every node but the root has
+ * a label of at least one byte, and the labels of the children of a node start
+ * with different bytes.
+ */
+typedef struct radix_node_t
+{
+    struct radix_node_t** children; //'capacity' children (sorted like 'bytes'), or a table indexed by the first byte
+    int value;                      //RADIX_NO_VALUE if no string ends at this node
+    unsigned int length;            //The bytes of 'label'
+    unsigned int room;              //The bytes allocated for 'label'
+    unsigned short count;           //The number of children
+    unsigned short capacity;        //The room of 'children' (RADIX_TABLE_CHILDREN for a table)
+    unsigned char bytes[RADIX_SMALL_CHILDREN]; //The first bytes of the labels of the children (not of a table)
+    char label[];                   //Not terminated by '\0'
+} *RadixNode;
+
+struct radix_t
+{
+    RadixNode root; //Its label is empty
+    unsigned int refcount;
+};
+
+static RadixNode radixNodeCreate(const char* label, size_t length, int value);
+static void radixNodeDestroy(RadixNode node);
+static RadixNode radixNodeCopy(RadixNode node);
+static size_t radixMatch(RadixNode node, const char* string);
+static RadixNode* radixFindChild(RadixNode node, char byte);
+static bool radixAddChild(RadixNode node, RadixNode child);
+static void radixRemoveChild(RadixNode node, char byte);
+static bool radixSplit(RadixNode* slot, const char* string, size_t matched, int value);
+static void radixMergeChild(RadixNode* slot);
+static bool radixNodeRemove(RadixNode node, const char* string);
+static bool radixNodeVisit(RadixNode node, RadixVisitor visitor, void* context);
+static size_t radixNodeGetSize(RadixNode node);
+
+//--------------------STATIC-FUNCTIONS--------------------//
+/**
+ * @param label - The bytes of the label (not necessarily terminated)
+ * @return
+ * NULL if the allocation failed, otherwise a new node without children.
+ */
+static RadixNode radixNodeCreate(const char* label, size_t length, int value)
+{
+    RadixNode node = malloc(sizeof(*node) + length);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->children = NULL;
+    node->value = value;
+    node->length = length;
+    node->room = length;
+    node->count = 0;
+    node->capacity = 0;
+    memcpy(node->label, label, length);
+    return node;
+}
+
+/**
+ * Frees a node and its subtree.
+ */
+static void radixNodeDestroy(RadixNode node)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    int children = node->capacity == RADIX_TABLE_CHILDREN ? RADIX_TABLE_CHILDREN : node->count;
+    for (int i = 0; i < children; i++)
+    {
+        radixNodeDestroy(node->children[i]);
+    }
+    free(node->children);
+    free(node);
+}
+
+/**
+ * @return
+ * A deep copy of the subtree of the node, NULL if an allocation failed.
+ */
+static RadixNode radixNodeCopy(RadixNode node)
+{
+    RadixNode copy = radixNodeCreate(node->label, node->length, node->value);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    if (node->capacity == 0)
+    {
+        return copy;
+    }
+    bool table = node->capacity == RADIX_TABLE_CHILDREN;
+    copy->children = table ? calloc(RADIX_TABLE_CHILDREN, sizeof(RadixNode)) : malloc(node->capacity * sizeof(RadixNode));
+    if (copy->children == NULL)
+    {
+        free(copy);
+        return NULL;
+    }
+    copy->capacity = node->capacity;
+    memcpy(copy->bytes, node->bytes, sizeof(node->bytes));
+    for (int i = 0; i < (table ? RADIX_TABLE_CHILDREN : node->count); i++)
+    {
+        if (node->children[i] == NULL)
+        {
+            continue;
+        }
+        copy->children[i] = radixNodeCopy(node->children[i]);
+        if (copy->children[i] == NULL)
+        {
+            radixNodeDestroy(copy);
+            return NULL;
+        }
+        copy->count++;
+    }
+    return copy;
+}
+
+/**
+ * @return
+ * The number of bytes at the start of 'string' which match the label of the node.
+ */
+static size_t radixMatch(RadixNode node, const char* string)
+{
+    size_t matched = 0;
+    //A label has no '\0', so the end of the string stops the loop too
+    while (matched < node->length && string[matched] == node->label[matched])
+    {
+        matched++;
+    }
+    return matched;
+}
+
+/**
+ * @return
+ * The place of the child of the node whose label starts with 'byte', NULL if
+ * there is no such child.
+ */
+static RadixNode* radixFindChild(RadixNode node, char byte)
+{
+    if (node->capacity == RADIX_TABLE_CHILDREN)
+    {
+        RadixNode* child = &node->children[(unsigned char)byte];
+        return *child != NULL ? child : NULL;
+    }
+    for (int i = 0; i < node->count; i++)
+    {
+        if (node->bytes[i] == (unsigned char)byte)
+        {
+            return &node->children[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Adds a child, whose label starts with a byte no other child starts with.
+ * The sorted array grows up to RADIX_SMALL_CHILDREN children, and is then
+ * replaced by a table.
+ * @return
+ * false if an allocation failed (the node is unchanged), true otherwise.
+ */
+static bool radixAddChild(RadixNode node, RadixNode child)
+{
+    unsigned char byte = (unsigned char)child->label[0];
+    if (node->count == node->capacity && node->capacity == RADIX_SMALL_CHILDREN)
+    {
+        RadixNode* table = calloc(RADIX_TABLE_CHILDREN, sizeof(RadixNode));
+        if (table == NULL)
+        {
+            return false;
+        }
+        for (int i = 0; i < node->count; i++)
+        {
+            table[node->bytes[i]] = node->children[i];
+        }
+        free(node->children);
+        node->children = table;
+        node->capacity = RADIX_TABLE_CHILDREN;
+    }
+    else if (node->count == node->capacity)
+    {
+        int capacity = node->capacity > 0 ? RADIX_GROWTH_FACTOR * node->capacity : RADIX_MIN_CHILDREN;
+        RadixNode* children = realloc(node->children, capacity * sizeof(RadixNode));
+        if (children == NULL)
+        {
+            return false;
+        }
+        node->children = children;
+        node->capacity = capacity;
+    }
+    if (node->capacity == RADIX_TABLE_CHILDREN)
+    {
+        node->children[byte] = child;
+        node->count++;
+        return true;
+    }
+    int i = node->count;
+    for (; i > 0 && node->bytes[i - 1] > byte; i--)
+    {
+        node->bytes[i] = node->bytes[i - 1];
+        node->children[i] = node->children[i - 1];
+    }
+    node->bytes[i] = byte;
+    node->children[i] = child;
+    node->count++;
+    return true;
+}
+
+/**
+ * Removes the child whose label starts with 'byte' from the node (without freeing it).
+ * A table stays a table.
+ */
+static void radixRemoveChild(RadixNode node, char byte)
+{
+    RadixNode* child = radixFindChild(node, byte);
+    assert(child != NULL);
+    node->count--;
+    if (node->capacity == RADIX_TABLE_CHILDREN)
+    {
+        *child = NULL;
+        return;
+    }
+    int i = child - node->children;
+    memmove(&node->bytes[i], &node->bytes[i + 1], node->count - i);
+    memmove(&node->children[i], &node->children[i + 1], (node->count - i) * sizeof(RadixNode));
+}
+
+/**
+ * Adds a string which ends inside the label of a node, or leaves it there: the
+ * node is replaced by a new node with the matched part of the label, whose
+ * children are the node (with the rest of its label) and a new node with the
+ * rest of the string.
+ * @param slot - The place of the node
+ * @param string - The part of the string which the node's label should start
+ * @param matched - The bytes of the label the string matches (at least one,
+ *      and less than the label's length)
+ * @return
+ * false if an allocation failed (the tree is unchanged), true otherwise.
+ */
+static bool radixSplit(RadixNode* slot, const char* string, size_t matched, int value)
+{
+    RadixNode node = *slot;
+    assert(matched > 0 && matched < node->length);
+    const char* rest = string + matched;
+    RadixNode middle = radixNodeCreate(node->label, matched, *rest == '\0' ? value : RADIX_NO_VALUE);
+    RadixNode leaf = *rest == '\0' ? NULL : radixNodeCreate(rest, strlen(rest), value);
+    RadixNode* children = malloc(RADIX_MIN_CHILDREN * sizeof(RadixNode));
+    if (middle == NULL || (*rest != '\0' && leaf == NULL) || children == NULL)
+    {
+        free(middle);
+        free(leaf);
+        free(children);
+        return false;
+    }
+    middle->children = children;
+    middle->capacity = RADIX_MIN_CHILDREN;
+    node->length -= matched;
+    memmove(node->label, node->label + matched, node->length);
+    //The children have room, so adding them does not fail
+    radixAddChild(middle, node);
+    if (leaf != NULL)
+    {
+        radixAddChild(middle, leaf);
+    }
+    *slot = middle;
+    return true;
+}
+
+/**
+ * Merges a node without a value and with a single child into that child, so
+ * chains of single children stay a single node. If the allocation fails the
+ * node is kept as is (the tree is still correct).
+ * @param slot - The place of the node
+ */
+static void radixMergeChild(RadixNode* slot)
+{
+    RadixNode node = *slot;
+    assert(node->value == RADIX_NO_VALUE && node->count == 1);
+    RadixNode child = node->children[0];
+    for (int i = 0; child == NULL; i++)
+    {
+        child = node->children[i];
+    }
+    size_t length = node->length + child->length;
+    if (length > child->room)
+    {
+        RadixNode bigger = realloc(child, sizeof(*child) + length);
+        if (bigger == NULL)
+        {
+            return;
+        }
+        child = bigger;
+        child->room = length;
+    }
+    memmove(child->label + node->length, child->label, child->length);
+    memcpy(child->label, node->label, node->length);
+    child->length = length;
+    *slot = child;
+    free(node->children);
+    free(node);
+}
+
+/**
+ * Removes a string from the subtree of a node, and then frees (or merges) the
+ * child it went through if that child became empty (or a chain link).
+ * @param string - The part of the string after the labels down to the node
+ * @return
+ * true if the string was removed, false if it was not in the tree.
+ */
+static bool radixNodeRemove(RadixNode node, const char* string)
+{
+    if (*string == '\0')
+    {
+        bool removed = node->value != RADIX_NO_VALUE;
+        node->value = RADIX_NO_VALUE;
+        return removed;
+    }
+    RadixNode* slot = radixFindChild(node, *string);
+    if (slot == NULL)
+    {
+        return false;
+    }
+    RadixNode child = *slot;
+    size_t matched = radixMatch(child, string);
+    if (matched < child->length || !radixNodeRemove(child, string + matched))
+    {
+        return false;
+    }
+    if (child->value == RADIX_NO_VALUE && child->count == 0)
+    {
+        radixRemoveChild(node, child->label[0]);
+        radixNodeDestroy(child);
+    }
+    else if (child->value == RADIX_NO_VALUE && child->count == 1)
+    {
+        radixMergeChild(slot);
+    }
+    return true;
+}
+
+/**
+ * Calls the visitor with the values of the node and of its subtree, in order.
+ * @return
+ * false if the visitor stopped the walk, true otherwise.
+ */
+static bool radixNodeVisit(RadixNode node, RadixVisitor visitor, void* context)
+{
+    if (node->value != RADIX_NO_VALUE && !visitor(node->value, context))
+    {
+        return false;
+    }
+    int children = node->capacity == RADIX_TABLE_CHILDREN ? RADIX_TABLE_CHILDREN : node->count;
+    for (int i = 0; i < children; i++)
+    {
+        if (node->children[i] != NULL && !radixNodeVisit(node->children[i], visitor, context))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return
+ * The bytes of the node and of its subtree.
+ */
+static size_t radixNodeGetSize(RadixNode node)
+{
+    size_t size = sizeof(*node) + node->room + node->capacity * sizeof(RadixNode);
+    int children = node->capacity == RADIX_TABLE_CHILDREN ? RADIX_TABLE_CHILDREN : node->count;
+    for (int i = 0; i < children; i++)
+    {
+        size += node->children[i] != NULL ? radixNodeGetSize(node->children[i]) : 0;
+    }
+    return size;
+}
+
+//--------------------RADIX-FUNCTIONS--------------------//
+Radix radixCreate()
+{
+    Radix radix = malloc(sizeof(*radix));
+    if (radix == NULL)
+    {
+        return NULL;
+    }
+    radix->root = radixNodeCreate("", 0, RADIX_NO_VALUE);
+    if (radix->root == NULL)
+    {
+        free(radix);
+        return NULL;
+    }
+    radix->refcount = 1;
+    return radix;
+}
+
+void radixDestroy(Radix radix)
+{
+    if (radix == NULL || RADIX_REFCOUNT_DECREMENT(radix->refcount) > 0)
+    {
+        return;
+    }
+    radixNodeDestroy(radix->root);
+    free(radix);
+}
+
+Radix radixShare(Radix radix)
+{
+    if (radix != NULL)
+    {
+        RADIX_REFCOUNT_INCREMENT(radix->refcount);
+    }
+    return radix;
+}
+
+bool radixIsShared(Radix radix)
+{
+    return radix != NULL && RADIX_REFCOUNT_LOAD(radix->refcount) > 1;
+}
+
+Radix radixCopy(Radix radix)
+{
+    if (radix == NULL)
+    {
+        return NULL;
+    }
+    Radix copy = malloc(sizeof(*copy));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->root = radixNodeCopy(radix->root);
+    if (copy->root == NULL)
+    {
+        free(copy);
+        return NULL;
+    }
+    copy->refcount = 1;
+    return copy;
+}
+
+void radixClear(Radix radix)
+{
+    if (radix == NULL)
+    {
+        return;
+    }
+    assert(!radixIsShared(radix));
+    RadixNode root = radix->root;
+    int children = root->capacity == RADIX_TABLE_CHILDREN ? RADIX_TABLE_CHILDREN : root->count;
+    for (int i = 0; i < children; i++)
+    {
+        radixNodeDestroy(root->children[i]);
+    }
+    free(root->children);
+    root->children = NULL;
+    root->count = 0;
+    root->capacity = 0;
+    root->value = RADIX_NO_VALUE;
+}
+
+int radixGet(Radix radix, const char* string)
+{
+    assert(radix != NULL && string != NULL);
+    RadixNode node = radix->root;
+    for (;;)
+    {
+        size_t matched = radixMatch(node, string);
+        if (matched < node->length)
+        {
+            return RADIX_NO_VALUE;
+        }
+        string += matched;
+        if (*string == '\0')
+        {
+            return node->value;
+        }
+        RadixNode* child = radixFindChild(node, *string);
+        if (child == NULL)
+        {
+            return RADIX_NO_VALUE;
+        }
+        node = *child;
+    }
+}
+
+bool radixSet(Radix radix, const char* string, int value)
+{
+    assert(radix != NULL && string != NULL && value >= 0 && !radixIsShared(radix));
+    RadixNode* slot = &radix->root;
+    for (;;)
+    {
+        RadixNode node = *slot;
+        size_t matched = radixMatch(node, string);
+        if (matched < node->length)
+        {
+            return radixSplit(slot, string, matched, value);
+        }
+        string += matched;
+        if (*string == '\0')
+        {
+            node->value = value;
+            return true;
+        }
+        RadixNode* child = radixFindChild(node, *string);
+        if (child == NULL)
+        {
+            RadixNode leaf = radixNodeCreate(string, strlen(string), value);
+            if (leaf == NULL || !radixAddChild(node, leaf))
+            {
+                free(leaf);
+                return false;
+            }
+            return true;
+        }
+        slot = child;
+    }
+}
+
+bool radixRemove(Radix radix, const char* string)
+{
+    assert(radix != NULL && string != NULL && !radixIsShared(radix));
+    //The root's label is empty, so the whole string follows it
+    return radixNodeRemove(radix->root, string);
+}
+
+bool radixForEachPrefix(Radix radix, const char* prefix, RadixVisitor visitor, void* context)
+{
+    assert(radix != NULL && prefix != NULL && visitor != NULL);
+    RadixNode node = radix->root;
+    for (;;)
+    {
+        size_t matched = radixMatch(node, prefix);
+        if (prefix[matched] == '\0')
+        {
+            //The prefix ends inside (or at the end of) the node's label, so its whole subtree matches
+            return radixNodeVisit(node, visitor, context);
+        }
+        if (matched < node->length)
+        {
+            return true;
+        }
+        prefix += matched;
+        RadixNode* child = radixFindChild(node, *prefix);
+        if (child == NULL)
+        {
+            return true;
+        }
+        node = *child;
+    }
+}
+
+size_t radixGetSize(Radix radix)
+{
+    return radix == NULL ? 0 : sizeof(*radix) + radixNodeGetSize(radix->root);
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#ifndef RADIX_H
+#define RADIX_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+* Radix Tree
+*
+* Implements a compressed radix tree (a trie whose chains of single children
+* are merged into one node) from strings to non-negative ints. Finding a
+* string costs O(its length), whatever the number of strings in the tree, and
+* the strings which start with a prefix are found in O(the prefix's length +
+* the strings found), in increasing strcmp order.
+* As in an adaptive radix tree, a node keeps its first 16 children in a small
+* sorted array, and more children in a table indexed by their first byte.
+*
+* The following functions are available:
+*   radixCreate		- Creates a new empty tree
+*   radixDestroy	- Removes an owner of a tree, and frees it with the last one
+*   radixShare		- Adds an owner to a tree.
+*   radixIsShared	- Returns whether a tree has more than one owner.
+*   radixCopy		- Copies a tree
+*   radixClear		- Removes all the strings of a tree.
+*   radixGet		- Returns the value of a string.
+*   radixSet		- Adds a string, or changes its value.
+*   radixRemove		- Removes a string.
+*   radixForEachPrefix	- Visits the values of the strings which start with a prefix.
+*   radixGetSize	- Returns the bytes a tree uses.
+*
+* A tree is reference counted like an arena: radixCreate gives it a single
+* owner, radixShare adds one and radixDestroy removes one. The count is
+* atomic, but the other functions are not, so only a tree which is not shared
+* should be changed.
+*/
+
+/** The value of a string which is not in the tree */
+#define RADIX_NO_VALUE -1
+
+typedef struct radix_t *Radix;
+
+/**
+ * The function radixForEachPrefix calls for every string it finds, with the
+ * string's value and the context given to radixForEachPrefix. It returns false
+ * to stop the walk. It must not change the tree.
+ */
+typedef bool (*RadixVisitor)(int value, void* context);
+
+/**
+ * @return
+ * NULL - if the allocation failed.
+ * A new empty tree otherwise.
+ */
+Radix radixCreate();
+
+/**
+ * @param radix - The tree to release. Once its last owner released it, it is
+ *      freed with all of its nodes. If NULL nothing is done.
+ */
+void radixDestroy(Radix radix);
+
+/**
+ * @param radix - The tree to share.
+ * @return
+ * The same tree, which now has one more owner (NULL if @param radix is NULL).
+ */
+Radix radixShare(Radix radix);
+
+/**
+ * @param radix - The tree to check.
+ * @return
+ * true if the tree has more than one owner.
+ */
+bool radixIsShared(Radix radix);
+
+/**
+ * @param radix - The tree to copy.
+ * @return
+ * NULL - if a NULL was sent or an allocation failed.
+ * A new tree (with a single owner) which holds the same strings otherwise.
+ */
+Radix radixCopy(Radix radix);
+
+/**
+ * @param radix - The tree to empty. Its nodes are freed. If NULL nothing is done.
+ */
+void radixClear(Radix radix);
+
+/**
+ * @param radix - The tree to search.
+ * @param string - The wanted string.
+ * @return
+ * The value of the string, RADIX_NO_VALUE if it is not in the tree.
+ */
+int radixGet(Radix radix, const char* string);
+
+/**
+ * Adds a string with a value, or changes the value of a string which is
+ * already in the tree (which never allocates, so it never fails).
+ * @param radix - The tree to change.
+ * @param string - The string.
+ * @param value - Its value (not negative).
+ * @return
+ * false if an allocation failed (the tree is unchanged), true otherwise.
+ */
+bool radixSet(Radix radix, const char* string, int value);
+
+/**
+ * @param radix - The tree to change.
+ * @param string - The string to remove.
+ * @return
+ * true if the string was removed, false if it was not in the tree.
+ */
+bool radixRemove(Radix radix, const char* string);
+
+/**
+ * Calls 'visitor' with the value of every string which starts with 'prefix'
+ * (all of them for an empty prefix), in increasing strcmp order of the strings.
+ * @param radix - The tree to search.
+ * @param prefix - The prefix of the wanted strings.
+ * @param visitor - The function to call.
+ * @param context - Passed to every call of 'visitor'.
+ * @return
+ * false if the visitor stopped the walk, true otherwise.
+ */
+bool radixForEachPrefix(Radix radix, const char* prefix, RadixVisitor visitor, void* context);
+
+/**
+ * @param radix - The tree to measure.
+ * @return
+ * The bytes of all the nodes of the tree, 0 if @param radix is NULL.
+ */
+size_t radixGetSize(Radix radix);
+
+#endif
\ No newline at end of file